@@ -41,7 +41,7 @@ THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "linked_list_hashmap.h"
 
 #ifndef TA_CALLOC
-#define TA_CALLOC TA_CALLOC
+#define TA_CALLOC calloc
 #endif
 
 #ifndef TA_FREE
@@ -100,30 +100,46 @@ static long __ulong_compare(const void *e1, const void *e2)
 
 /**
  * Create a texture atlas.
- * @param width The size of this atlas
+ * @param width The width of this atlas
+ * @param height The height of this atlas
  * @param write_pixels_to_texture Callback for writing pixels to the atlas
  * @param create_texture_cb Callback for creating a new texture
+ * @param destroy_texture_cb Callback for destroying the texture
  * @return a pointer to the newly allocated texture atlas */
-void * ta_init(int const width,
+void * ta_init(int const width, int const height,
     void (*write_pixels_to_texture) (
     const void * pixels,
     const ta_rect_t * rect,
     const unsigned int texture),
     int (*create_texture_cb) (
-    const int w, const int h))
+    const int w, const int h),
+    void (*destroy_texture_cb) (
+    const unsigned int texture))
 {
     ta_atlas_t *at;
     ta_texture_t *tex;
 
     at = TA_CALLOC(1, sizeof(ta_atlas_t));
+    if (!at)
+    {
+	return NULL;
+    }
+
     tex = at->root = TA_CALLOC(1, sizeof(ta_texture_t));
+    if (!tex)
+    {
+	TA_FREE(at);
+	return NULL;
+    }
+
     tex->rect.x = 0;
     tex->rect.y = 0;
     tex->rect.w = width;
-    tex->rect.h = width;
+    tex->rect.h = height;
     at->textures = ll_hashmap_new(__ulong_hash, __ulong_compare, 11);
     at->write_pixels_to_texture_cb = write_pixels_to_texture;
     at->create_texture_cb = create_texture_cb;
+    at->destroy_texture_cb = destroy_texture_cb;
     if (at->create_texture_cb)
     {
 	at->texture_handle =
@@ -159,7 +175,10 @@ void ta_destroy(void* att)
     ta_atlas_t *at = att;
 
     assert(at->root);
-    at->destroy_texture_cb(at->texture_handle);
+    if (at->destroy_texture_cb)
+    {
+	at->destroy_texture_cb(at->texture_handle);
+    }
 
     __remove(at->root);
     at->root = NULL;
@@ -239,6 +258,13 @@ static ta_texture_t *__insert(ta_texture_t * tex,
 	    /* alloc memory for sub-divisions */
 	    tex->kids[0] = TA_CALLOC(1, sizeof(ta_texture_t));
 	    tex->kids[1] = TA_CALLOC(1, sizeof(ta_texture_t));
+	    if (!tex->kids[0] || !tex->kids[1])
+	    {
+		TA_FREE(tex->kids[0]);
+		TA_FREE(tex->kids[1]);
+		tex->kids[0] = tex->kids[1] = NULL;
+		return NULL;
+	    }
 
 	    /* create sub-divisions */
 	    dw = tex->rect.w - w;
@@ -322,7 +348,7 @@ int ta_contains_texid(const void *att,
     const unsigned long texid)
 {
     const ta_atlas_t *at = att;
-    return NULL != ll_hashmap_get(at->textures, (void *) texid);
+    return NULL != ll_hashmap_get(at->textures, (const void *) texid);
 }
 
 /**
@@ -332,7 +358,7 @@ int ta_contains_texid(const void *att,
  * @param begin start texture coordinates
  * @param end end texture coordinates
  */
-void ta_get_coords_from_texid(void *att,
+void ta_get_coords_from_texid(const void *att,
     const unsigned long texid,
     float* begin, float* end)
 {
@@ -342,7 +368,7 @@ void ta_get_coords_from_texid(void *att,
 
     assert( ta_contains_texid(att, texid));
 
-    tex = ll_hashmap_get(at->textures, (void *) texid);
+    tex = ll_hashmap_get(at->textures, (const void *) texid);
 
     begin[0] = (float) tex->rect.x / at->root->rect.w;
     begin[1] = (float) tex->rect.y / at->root->rect.h;
@@ -351,10 +377,30 @@ void ta_get_coords_from_texid(void *att,
     end[1] = begin[1] + (float) tex->rect.h / at->root->rect.h;
 }
 
+/**
+ * Get the rectangle, in pixels, using texture id
+ * @param att texture atlas
+ * @param texid texture on texture atlas
+ * @param rect the rectangle the texture has been written to
+ */
+void ta_get_rect_from_texid(const void *att,
+    const unsigned long texid,
+    ta_rect_t* rect)
+{
+    const ta_atlas_t *at = att;
+
+    ta_texture_t *tex;
+
+    assert( ta_contains_texid(att, texid));
+
+    tex = ll_hashmap_get(at->textures, (const void *) texid);
+    *rect = tex->rect;
+}
+
 /**
  * @param att texture atlas 
  * @return texture handle */
-int ta_get_texture(void *att)
+int ta_get_texture(const void *att)
 {
     const ta_atlas_t *at = att;
     return at->texture_handle;
@@ -363,7 +409,7 @@ int ta_get_texture(void *att)
 /**
  * @param att texture atlas 
  * @return number of textures */
-int ta_get_ntextures(void *att)
+int ta_get_ntextures(const void *att)
 {
     const ta_atlas_t *at = att;
     return at->ntextures;
@@ -11,6 +11,7 @@ typedef struct {
 
 void* ta_init(
     int width,
+    int height,
     void (*write_pixels_to_texture) (const void *pixels,
                                      const ta_rect_t * rect,
                                      const unsigned int texture),
@@ -41,6 +42,12 @@ void ta_get_coords_from_texid(
     float* end
 );
 
+void ta_get_rect_from_texid(
+    const void* att,
+    const unsigned long texid,
+    ta_rect_t* rect
+);
+
 int ta_get_texture(
     const void* att
 );
@@ -50,5 +57,5 @@ int ta_get_ntextures(
 );
 
 #if defined(__cplusplus)
-// extern "C" {
+} // extern "C" {
 #endif
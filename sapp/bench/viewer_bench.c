@@ -0,0 +1,668 @@
+/**
+ * Headless benchmark of the wavefront and glTF loaders.
+ *
+ * Each object is imported repeatedly, measuring every stage on its own:
+ * reading the file, parsing it, and post-processing it into a model of
+ * the geometry pass, whose resources are created by the sokol dummy
+ * backend. Besides the bundled object, synthetic spheres are generated,
+ * so that the loader can be measured at scale. glTF files are mapped
+ * instead of read, and loaded as a whole. The batched math of the scene
+ * update is checked against its scalar reference, on the poses and the
+ * bounds of a synthetic scene. Results go out as JSON.
+ *
+ * Arguments:
+ *  obj=<file>          object to import, the bundled one by default
+ *  gltf=<file>         glTF file to import, the bundled scene by
+ *                      default, none if empty
+ *  synthetic=1,4,16    synthetic objects, in hundreds of thousands of
+ *                      triangles, none if empty
+ *  repeat=3            imports of each object
+ *  workers=0           job workers, 0 for one per core but the main one
+ *  tmp_dir=.           where synthetic objects are written to
+ *  nodes=65536         synthetic scene nodes the batched math is
+ *                      checked with, none if 0
+ *  out=<file>          JSON report, stdout by default
+ */
+
+#include "../viewer_file.h"
+#include "../viewer_memory.h"
+#include "../viewer_jobs.h"
+#include "../viewer_wavefront.h"
+#include "../viewer_gltf.h"
+#include "../viewer_geometry_pass.h"
+#include "../viewer_math.h"
+#include "../viewer_log.h"
+
+#include "sokol_args.h"
+#include "sokol_gfx.h"
+#include "sokol_time.h"
+#include "cute_path.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <sys/resource.h>
+#endif
+
+#define BENCH_MAX_INPUTS 16
+#define BENCH_SYNTHETIC_TRIANGLES 100000   // per unit of scale
+#define BENCH_SYNTHETIC_SHAPES 8           // object groups per sphere
+#define BENCH_MATH_TOLERANCE 1e-5f         // relative, batched vs scalar
+#define BENCH_BOUNDS_TOLERANCE 1e-3f       // of bounds across a plane
+
+typedef enum {
+    BENCH_STAGE_READ,
+    BENCH_STAGE_PARSE,
+    BENCH_STAGE_MAKE_MODEL,
+    BENCH_NUM_STAGES
+} bench_stage_t;
+
+static const char* stage_names[BENCH_NUM_STAGES] = {
+    "file_readall",
+    "wavefront_parse_obj",
+    "wavefront_make_model"
+};
+
+static const char* gltf_stage_names[BENCH_NUM_STAGES] = {
+    "file_map",
+    "gltf_load",
+    "gltf_make_model"
+};
+
+typedef struct {
+    double min_ms;
+    double total_ms;
+    memory_stats_t memory;  // calls made by the last run of the stage
+    uint64_t peak_rss;      // in bytes, after the last run of the stage
+} bench_timing_t;
+
+typedef struct {
+    char name[WAVEFRONT_MAX_PATH];
+    char filename[WAVEFRONT_MAX_PATH];
+    bool synthetic;
+    bool gltf;
+    uint64_t bytes;
+    uint64_t triangles;
+    uint32_t runs;
+    bench_timing_t stages[BENCH_NUM_STAGES];
+    const char* error;
+} bench_input_t;
+
+typedef struct {
+    uint32_t nodes;
+    float poses_error;      // largest relative difference of any element
+    float parents_error;
+    uint32_t visible_bounds;
+    uint32_t bounds_mismatches;  // but those across a plane, see below
+    const char* error;
+} bench_math_t;
+
+static jobs_t jobs;
+static geometry_pass_t geometry_pass;
+
+// peak resident set size of the process, 0 if unknown
+static uint64_t peak_rss_bytes(void) {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return (uint64_t)counters.PeakWorkingSetSize;
+    }
+
+    return 0;
+#elif defined(__EMSCRIPTEN__)
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+
+#if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+static memory_stats_t memory_stats_since(memory_stats_t start) {
+    memory_stats_t now = memory_get_stats();
+    return (memory_stats_t){
+        .allocations = now.allocations - start.allocations,
+        .reallocations = now.reallocations - start.reallocations,
+        .frees = now.frees - start.frees
+    };
+}
+
+static void stage_begin(uint64_t* time, memory_stats_t* memory) {
+    *memory = memory_get_stats();
+    *time = stm_now();
+}
+
+static void stage_end(bench_timing_t* timing, uint32_t run,
+    uint64_t time, memory_stats_t memory) {
+    double ms = stm_ms(stm_since(time));
+    timing->memory = memory_stats_since(memory);
+    timing->peak_rss = peak_rss_bytes();
+    timing->total_ms += ms;
+    timing->min_ms = (run == 0 || ms < timing->min_ms) ? ms : timing->min_ms;
+}
+
+// uv sphere of about num_triangles, split in a few object groups,
+// with positions, uvs and normals, written as an obj file
+static bool write_synthetic_obj(const char* filename, uint32_t num_triangles) {
+    FILE* fd = fopen(filename, "wb");
+    if (!fd) {
+        return false;
+    }
+
+    // rings * segments quads, with segments = 2 * rings
+    uint32_t rings = (uint32_t)sqrt(num_triangles / 4.0);
+    rings = (rings < BENCH_SYNTHETIC_SHAPES) ? BENCH_SYNTHETIC_SHAPES : rings;
+    uint32_t segments = rings * 2;
+    const double pi = 3.14159265358979323846;
+
+    fprintf(fd, "# synthetic sphere, %u triangles\n", rings * segments * 2);
+    for (uint32_t r = 0; r <= rings; ++r) {
+        double theta = pi * r / rings;
+        for (uint32_t s = 0; s <= segments; ++s) {
+            double phi = 2.0 * pi * s / segments;
+            double x = sin(theta) * cos(phi);
+            double y = cos(theta);
+            double z = sin(theta) * sin(phi);
+            fprintf(fd, "v %.6f %.6f %.6f\n", x, y, z);
+            fprintf(fd, "vt %.6f %.6f\n", (double)s / segments, (double)r / rings);
+            fprintf(fd, "vn %.4f %.4f %.4f\n", x, y, z);
+        }
+    }
+
+    // rings are evenly distributed among the groups
+    for (uint32_t r = 0; r < rings; ++r) {
+        if (r % (rings / BENCH_SYNTHETIC_SHAPES) == 0) {
+            fprintf(fd, "o synthetic_%u\n", r / (rings / BENCH_SYNTHETIC_SHAPES));
+        }
+
+        for (uint32_t s = 0; s < segments; ++s) {
+            // obj indices are 1-based
+            uint32_t a = r * (segments + 1) + s + 1;
+            uint32_t b = a + 1;
+            uint32_t c = a + segments + 1;
+            uint32_t d = c + 1;
+            fprintf(fd, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+            fprintf(fd, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, d, d, d, c, c, c);
+        }
+    }
+
+    bool written = !ferror(fd);
+    fclose(fd);
+    return written;
+}
+
+static void run_input(bench_input_t* input, uint32_t run) {
+    uint64_t time;
+    memory_stats_t memory;
+
+    file_t file = file_open(input->filename, FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(file)) {
+        input->error = "file not found";
+        return;
+    }
+
+    // read the whole file into memory
+    char* buffer_data = NULL;
+    size_t buffer_size = 0;
+    stage_begin(&time, &memory);
+    int32_t read_result = file_readall(
+        file, &buffer_data, &buffer_size, memory_realloc);
+    stage_end(&input->stages[BENCH_STAGE_READ], run, time, memory);
+    file_close(file);
+
+    if (read_result != FILE_READALL_OK) {
+        input->error = "file not readable";
+        if (buffer_data) {
+            memory_realloc(buffer_data, 0);
+        }
+
+        return;
+    }
+
+    char base_path[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(input->filename, base_path, NULL);
+
+    // parse the object, and decode its textures
+    wavefront_model_t wf_model = {0};
+    stage_begin(&time, &memory);
+    wavefront_result_t wf_result = wavefront_parse_obj(&(wavefront_data_t){
+        .allocator = memory_realloc,
+        .jobs = &jobs,
+        .base_path = base_path,
+        .obj_data = buffer_data,
+        .data_size = buffer_size,
+        .atlas_width = 1024,
+        .atlas_height = 1024,
+        .import_options = WAVEFRONT_IMPORT_DEFAULT,
+        .label = input->name
+    }, &wf_model);
+    stage_end(&input->stages[BENCH_STAGE_PARSE], run, time, memory);
+    memory_realloc(buffer_data, 0);
+
+    if (wf_result != WAVEFRONT_RESULT_OK) {
+        input->error = "object not valid";
+        return;
+    }
+
+    // build the render model: quantisation, levels of detail,
+    // clusters and mip chains, with no actual device behind
+    stage_begin(&time, &memory);
+    model_id_t model_id = wavefront_make_model(&geometry_pass, &wf_model);
+    stage_end(&input->stages[BENCH_STAGE_MAKE_MODEL], run, time, memory);
+
+    input->bytes = buffer_size;
+    input->triangles = wf_model.mesh->num_indices / 3;
+    input->runs = run + 1;
+    wavefront_release_obj(&wf_model);
+
+    if (!handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)) {
+        input->error = "model not created";
+    }
+
+    // start every run from an empty pass
+    geometry_pass_cleanup(&geometry_pass);
+    geometry_pass_init(&geometry_pass);
+}
+
+static void run_gltf_input(bench_input_t* input, uint32_t run) {
+    uint64_t time;
+    memory_stats_t memory;
+
+    // only the document is mapped, buffers are by the loader
+    file_map_t map;
+    stage_begin(&time, &memory);
+    bool mapped = file_map(input->filename, &map);
+    stage_end(&input->stages[BENCH_STAGE_READ], run, time, memory);
+
+    if (!mapped) {
+        input->error = "file not found";
+        return;
+    }
+
+    char base_path[GLTF_MAX_PATH] = {0};
+    path_pop(input->filename, base_path, NULL);
+
+    // resolve the scene, and convert its primitives
+    gltf_model_t gltf_model;
+    stage_begin(&time, &memory);
+    gltf_result_t gltf_result = gltf_load(&(gltf_data_t){
+        .jobs = &jobs,
+        .base_path = base_path,
+        .gltf_data = map.data,
+        .data_size = map.size,
+        .num_lods = GEOMETRY_PASS_MAX_LODS,
+        .label = input->name
+    }, &gltf_model);
+    stage_end(&input->stages[BENCH_STAGE_PARSE], run, time, memory);
+
+    if (gltf_result != GLTF_RESULT_OK) {
+        input->error = "glTF not valid";
+        gltf_release(&gltf_model);
+        file_unmap(&map);
+        return;
+    }
+
+    stage_begin(&time, &memory);
+    model_id_t model_id = gltf_make_model(&geometry_pass, &gltf_model);
+    stage_end(&input->stages[BENCH_STAGE_MAKE_MODEL], run, time, memory);
+
+    input->bytes = map.size;
+    for (uint32_t b = 0; b < gltf_model.num_buffers; ++b) {
+        input->bytes += gltf_model.buffers[b].size;
+    }
+
+    input->triangles = gltf_model.num_indices / 3;
+    input->runs = run + 1;
+    gltf_release(&gltf_model);
+    file_unmap(&map);
+
+    if (!handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)) {
+        input->error = "model not created";
+    }
+
+    geometry_pass_cleanup(&geometry_pass);
+    geometry_pass_init(&geometry_pass);
+}
+
+static float random_range(float min_val, float max_val) {
+    return min_val + (max_val - min_val) * ((float)rand() / (float)RAND_MAX);
+}
+
+static float poses_error(const mat4f_t* poses, const mat4f_t* ref_poses,
+    uint32_t count) {
+    float error = 0.f;
+    for (uint32_t i = 0; i < count; ++i) {
+        for (int32_t e = 0; e < 16; ++e) {
+            float ref = ref_poses[i].v[e];
+            float scale = (fabsf(ref) > 1.f) ? fabsf(ref) : 1.f;
+            float diff = fabsf(poses[i].v[e] - ref) / scale;
+            error = (diff > error) ? diff : error;
+        }
+    }
+
+    return error;
+}
+
+// bounds lying across a plane, up to the rounding of its distance,
+// may be found visible by one of the tests and not by the other,
+// which is told by testing them grown, and shrunk, by the tolerance
+static bool bounds_across_plane(const frustum_t* frustum,
+    sphere_t sphere, box_t box) {
+    sphere_t spheres[2] = {sphere, sphere};
+    box_t boxes[2] = {box, box};
+    spheres[0].radius += BENCH_BOUNDS_TOLERANCE;
+    spheres[1].radius -= BENCH_BOUNDS_TOLERANCE;
+    boxes[0].extents = svec3_add_f(box.extents, BENCH_BOUNDS_TOLERANCE);
+    boxes[1].extents = svec3_subtract_f(box.extents, BENCH_BOUNDS_TOLERANCE);
+
+    bool visible[2];
+    frustum_test_bounds_scalar(frustum, spheres, boxes, 2, visible);
+    return visible[0] != visible[1];
+}
+
+// nodes of random transforms, gathered in a random order, are
+// composed, then multiplied by random parents, or by the root, and
+// their bounds tested against the view, with the widest instructions
+// the CPU supports and one at a time
+static void check_scene_math(bench_math_t* math) {
+    uint32_t count = math->nodes;
+    transform_t* transforms = memory_malloc(sizeof(transform_t) * count);
+    int32_t* indices = memory_malloc(sizeof(int32_t) * count * 2);
+    mat4f_t* poses = memory_malloc(sizeof(mat4f_t) * count * 4);
+    sphere_t* spheres = memory_malloc(sizeof(sphere_t) * count);
+    box_t* boxes = memory_malloc(sizeof(box_t) * count);
+    bool* visible = memory_malloc(sizeof(bool) * count * 2);
+    if (!transforms || !indices || !poses || !spheres || !boxes || !visible) {
+        if (transforms) memory_free(transforms);
+        if (indices) memory_free(indices);
+        if (poses) memory_free(poses);
+        if (spheres) memory_free(spheres);
+        if (boxes) memory_free(boxes);
+        if (visible) memory_free(visible);
+        math->error = "not enough memory";
+        return;
+    }
+
+    int32_t* parent_indices = indices + count;
+    mat4f_t* ref_poses = poses + count;
+    mat4f_t* world_poses = poses + count * 2;
+    mat4f_t* ref_world_poses = poses + count * 3;
+
+    srand(1);
+    for (uint32_t i = 0; i < count; ++i) {
+        transforms[i] = (transform_t){
+            .position = svec3(random_range(-20.f, 20.f),
+                random_range(-20.f, 20.f), random_range(-20.f, 20.f)),
+            .scale = svec3(random_range(0.5f, 2.f),
+                random_range(0.5f, 2.f), random_range(0.5f, 2.f)),
+            .rotation = squat_from_axis_angle(svec3_normalize(svec3(
+                random_range(-1.f, 1.f), random_range(-1.f, 1.f), 1.f)),
+                random_range(-3.14f, 3.14f))
+        };
+
+        // a quarter of the nodes are roots
+        indices[i] = rand() % (int32_t)count;
+        parent_indices[i] = (rand() % 4) ? rand() % (int32_t)count : -1;
+    }
+
+    mat4s_from_transforms(transforms, indices, count, poses);
+    mat4s_from_transforms_scalar(transforms, indices, count, ref_poses);
+    math->poses_error = poses_error(poses, ref_poses, count);
+
+    // both multiply the same parents
+    mat4f_t root = transform_to_mat4(transforms[0]);
+    mat4s_multiply_parents(ref_poses, parent_indices, &root,
+        ref_poses, count, world_poses);
+    mat4s_multiply_parents_scalar(ref_poses, parent_indices, &root,
+        ref_poses, count, ref_world_poses);
+    math->parents_error = poses_error(world_poses, ref_world_poses, count);
+
+    // boxes of random extents, around the origin of the nodes, within
+    // spheres, seen from far enough for about half of them to be visible
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* pose = ref_world_poses[i].v;
+        boxes[i] = (box_t){
+            .center = svec3(pose[12], pose[13], pose[14]),
+            .extents = svec3(random_range(0.1f, 5.f),
+                random_range(0.1f, 5.f), random_range(0.1f, 5.f))
+        };
+
+        spheres[i] = (sphere_t){
+            .center = boxes[i].center,
+            .radius = svec3_length(boxes[i].extents)
+        };
+    }
+
+    frustum_t frustum = frustum_from_matrix(smat4_multiply(
+        smat4_perspective_fov(1.f, 800.f, 600.f, 0.1f, 200.f),
+        smat4_look_at(svec3(0.f, 0.f, 30.f), svec3_zero(), svec3(0.f, 1.f, 0.f))));
+
+    bool* ref_visible = visible + count;
+    frustum_test_bounds(&frustum, spheres, boxes, count, visible);
+    frustum_test_bounds_scalar(&frustum, spheres, boxes, count, ref_visible);
+    for (uint32_t i = 0; i < count; ++i) {
+        math->visible_bounds += ref_visible[i];
+        math->bounds_mismatches += visible[i] != ref_visible[i]
+            && !bounds_across_plane(&frustum, spheres[i], boxes[i]);
+    }
+
+    if (math->poses_error > BENCH_MATH_TOLERANCE) {
+        math->error = "batched poses differ from the scalar ones";
+    }
+    else if (math->parents_error > BENCH_MATH_TOLERANCE) {
+        math->error = "batched parents differ from the scalar ones";
+    }
+    else if (math->bounds_mismatches > 0) {
+        math->error = "batched bounds tests differ from the scalar ones";
+    }
+
+    memory_free(transforms);
+    memory_free(indices);
+    memory_free(poses);
+    memory_free(spheres);
+    memory_free(boxes);
+    memory_free(visible);
+}
+
+static void write_math_report(FILE* fd, const bench_math_t* math) {
+    fprintf(fd, "  \"math\": {\n");
+    fprintf(fd, "    \"nodes\": %u,\n", math->nodes);
+    if (math->error) {
+        fprintf(fd, "    \"error\": \"%s\",\n", math->error);
+    }
+
+    fprintf(fd, "    \"poses_max_error\": %g,\n", math->poses_error);
+    fprintf(fd, "    \"parents_max_error\": %g,\n", math->parents_error);
+    fprintf(fd, "    \"visible_bounds\": %u,\n", math->visible_bounds);
+    fprintf(fd, "    \"bounds_mismatches\": %u\n", math->bounds_mismatches);
+    fprintf(fd, "  },\n");
+}
+
+static void write_report(FILE* fd, const bench_input_t* inputs,
+    uint32_t num_inputs, const bench_math_t* math, uint32_t repeat) {
+    fprintf(fd, "{\n");
+    fprintf(fd, "  \"workers\": %u,\n", jobs_num_workers(&jobs));
+    fprintf(fd, "  \"repeat\": %u,\n", repeat);
+    fprintf(fd, "  \"inputs\": [");
+
+    for (uint32_t i = 0; i < num_inputs; ++i) {
+        const bench_input_t* input = &inputs[i];
+        fprintf(fd, "%s\n    {\n", (i > 0) ? "," : "");
+        fprintf(fd, "      \"name\": \"%s\",\n", input->name);
+        fprintf(fd, "      \"synthetic\": %s,\n", input->synthetic ? "true" : "false");
+
+        if (input->error) {
+            fprintf(fd, "      \"error\": \"%s\"\n    }", input->error);
+            continue;
+        }
+
+        fprintf(fd, "      \"bytes\": %llu,\n", (unsigned long long)input->bytes);
+        fprintf(fd, "      \"triangles\": %llu,\n", (unsigned long long)input->triangles);
+        fprintf(fd, "      \"stages\": [");
+
+        double total_ms = 0.0;
+        for (uint32_t s = 0; s < BENCH_NUM_STAGES; ++s) {
+            const bench_timing_t* timing = &input->stages[s];
+            double seconds = timing->min_ms / 1000.0;
+            total_ms += timing->min_ms;
+
+            fprintf(fd, "%s\n        {\n", (s > 0) ? "," : "");
+            fprintf(fd, "          \"stage\": \"%s\",\n",
+                input->gltf ? gltf_stage_names[s] : stage_names[s]);
+            fprintf(fd, "          \"min_ms\": %.3f,\n", timing->min_ms);
+            fprintf(fd, "          \"mean_ms\": %.3f,\n",
+                timing->total_ms / input->runs);
+            fprintf(fd, "          \"mb_per_s\": %.2f,\n", (seconds > 0.0)
+                ? input->bytes / (1024.0 * 1024.0) / seconds : 0.0);
+            fprintf(fd, "          \"triangles_per_s\": %.0f,\n",
+                (seconds > 0.0) ? input->triangles / seconds : 0.0);
+            fprintf(fd, "          \"allocations\": %llu,\n",
+                (unsigned long long)timing->memory.allocations);
+            fprintf(fd, "          \"reallocations\": %llu,\n",
+                (unsigned long long)timing->memory.reallocations);
+            fprintf(fd, "          \"frees\": %llu,\n",
+                (unsigned long long)timing->memory.frees);
+            fprintf(fd, "          \"peak_rss_mb\": %.2f\n",
+                timing->peak_rss / (1024.0 * 1024.0));
+            fprintf(fd, "        }");
+        }
+
+        fprintf(fd, "\n      ],\n");
+        fprintf(fd, "      \"total_min_ms\": %.3f\n    }", total_ms);
+    }
+
+    fprintf(fd, "\n  ],\n");
+    if (math->nodes > 0) {
+        write_math_report(fd, math);
+    }
+
+    fprintf(fd, "  \"peak_rss_mb\": %.2f\n", peak_rss_bytes() / (1024.0 * 1024.0));
+    fprintf(fd, "}\n");
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc) {
+        .argc = argc,
+        .argv = argv
+    });
+
+    if (!sargs_isvalid()) {
+        LOG_ERROR("ERROR: Invalid command line\n");
+        return EXIT_FAILURE;
+    }
+
+    stm_setup();
+    sg_setup(&(sg_desc){0});
+    jobs_init(&jobs, (uint32_t)atoi(sargs_value_def("workers", "0")));
+
+    geometry_pass.jobs = &jobs;
+    geometry_pass_init(&geometry_pass);
+
+    int32_t repeat = atoi(sargs_value_def("repeat", "3"));
+    repeat = (repeat > 0) ? repeat : 1;
+
+    static bench_input_t inputs[BENCH_MAX_INPUTS];
+    uint32_t num_inputs = 0;
+
+    const char* obj = sargs_value_def("obj", "models/cyberpunk_bar/cyberpunk_bar.obj");
+    bench_input_t* bundled = &inputs[num_inputs++];
+    snprintf(bundled->filename, WAVEFRONT_MAX_PATH, "%s", obj);
+    path_pop(obj, NULL, bundled->name);
+
+    const char* gltf = sargs_value_def("gltf", "models/cyberpunk_bar/scene.gltf");
+    if (*gltf) {
+        bench_input_t* input = &inputs[num_inputs++];
+        input->gltf = true;
+        snprintf(input->filename, WAVEFRONT_MAX_PATH, "%s", gltf);
+        path_pop(gltf, NULL, input->name);
+    }
+
+    // synthetic objects are generated before any measurement
+    const char* tmp_dir = sargs_value_def("tmp_dir", ".");
+    const char* scales = sargs_value_def("synthetic", "1,4,16");
+    while (*scales && num_inputs < BENCH_MAX_INPUTS) {
+        char* next = NULL;
+        long scale = strtol(scales, &next, 10);
+        if (next == scales) {
+            break;
+        }
+
+        scales = (*next == ',') ? next + 1 : next;
+        if (scale <= 0) {
+            continue;
+        }
+
+        bench_input_t* input = &inputs[num_inputs++];
+        input->synthetic = true;
+        snprintf(input->name, WAVEFRONT_MAX_PATH, "synthetic_%ldx", scale);
+        snprintf(input->filename, WAVEFRONT_MAX_PATH,
+            "%s/viewer-bench-%s.obj", tmp_dir, input->name);
+
+        if (!write_synthetic_obj(input->filename,
+            (uint32_t)scale * BENCH_SYNTHETIC_TRIANGLES)) {
+            input->error = "synthetic object not written";
+        }
+    }
+
+    for (uint32_t i = 0; i < num_inputs; ++i) {
+        bench_input_t* input = &inputs[i];
+        for (int32_t r = 0; r < repeat && !input->error; ++r) {
+            if (input->gltf) {
+                run_gltf_input(input, (uint32_t)r);
+            }
+            else {
+                run_input(input, (uint32_t)r);
+            }
+        }
+
+        if (input->synthetic) {
+            remove(input->filename);
+        }
+    }
+
+    bench_math_t math = {
+        .nodes = (uint32_t)atoi(sargs_value_def("nodes", "65536"))
+    };
+
+    if (math.nodes > 0) {
+        check_scene_math(&math);
+    }
+
+    const char* out = sargs_value_def("out", "");
+    FILE* fd = (*out) ? fopen(out, "w") : stdout;
+    if (!fd) {
+        LOG_ERROR("ERROR: Cannot write report to %s\n", out);
+        fd = stdout;
+    }
+
+    write_report(fd, inputs, num_inputs, &math, (uint32_t)repeat);
+    if (fd != stdout) {
+        fclose(fd);
+    }
+
+    geometry_pass_cleanup(&geometry_pass);
+    jobs_cleanup(&jobs);
+    sg_shutdown();
+    sargs_shutdown();
+
+    bool failed = math.error != NULL;
+    for (uint32_t i = 0; i < num_inputs; ++i) {
+        failed = failed || inputs[i].error;
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,315 @@
+/**
+ * Offline conversion of wavefront objects into binary models.
+ *
+ * All the objects found in a directory, and its sub-directories, are
+ * converted concurrently, each on a job of its own: parsed, welded and
+ * optimised for the vertex cache, built into quantised meshes with their
+ * levels of detail and clusters, while their textures are given their
+ * mip chains, and are block compressed. Models are written as they are
+ * going to be uploaded, so that the viewer, which loads them instead of
+ * the objects when they are found next to them, pays neither parsing
+ * nor processing at startup. No window, nor device, is needed.
+ *
+ * Arguments:
+ *  in=<dir>            directory of the objects to convert
+ *  out=<dir>           where models are written, next to the objects
+ *                      by default, which is where the viewer looks for
+ *  workers=0           job workers, 0 for one per core but the main one
+ *  atlas=1024          size of the atlas materials are packed into
+ *  compress=1          block compress textures, which the viewer
+ *                      decompresses if the backend cannot sample them
+ */
+
+#include "../viewer_asset.h"
+#include "../viewer_compress.h"
+#include "../viewer_file.h"
+#include "../viewer_image.h"
+#include "../viewer_memory.h"
+#include "../viewer_jobs.h"
+#include "../viewer_wavefront.h"
+#include "../viewer_log.h"
+
+#include "sokol_args.h"
+#include "sokol_time.h"
+#include "cute_files.h"
+#include "cute_path.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char filename[WAVEFRONT_MAX_PATH];
+    char model_filename[WAVEFRONT_MAX_PATH];
+    uint64_t obj_bytes;
+    uint32_t vertices;
+    uint32_t triangles;
+    double ms;
+    const char* error;
+} convert_file_t;
+
+typedef struct {
+    convert_file_t* files;
+    uint32_t num_files;
+    uint32_t capacity;
+    const char* out_dir;
+    int32_t atlas_size;
+    bool compress;
+} convert_t;
+
+static jobs_t jobs;
+
+static void gather_file(cf_file_t* file, void* user_data) {
+    convert_t* convert = (convert_t*)user_data;
+    if (!file->is_reg || !cf_match_ext(file, ".obj")) {
+        return;
+    }
+
+    if (convert->num_files == convert->capacity) {
+        uint32_t capacity = convert->capacity ? convert->capacity * 2 : 64;
+        convert_file_t* files = memory_realloc(convert->files,
+            sizeof(convert_file_t) * capacity);
+        if (!files) {
+            LOG_WARN("WARN: Not enough memory to convert (%s)\n", file->path);
+            return;
+        }
+
+        convert->files = files;
+        convert->capacity = capacity;
+    }
+
+    convert_file_t* convert_file = &convert->files[convert->num_files++];
+    memset(convert_file, 0, sizeof(convert_file_t));
+    snprintf(convert_file->filename, WAVEFRONT_MAX_PATH, "%s", file->path);
+
+    // models have the name of the object, and the extension of theirs
+    char name[WAVEFRONT_MAX_PATH];
+    char dir[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(file->path, dir, name);
+    path_pop_ext(name, name, NULL);
+    snprintf(convert_file->model_filename, WAVEFRONT_MAX_PATH, "%s/%s%s",
+        convert->out_dir ? convert->out_dir : dir, name, ASSET_FILE_EXTENSION);
+}
+
+// replace the level 0 only image with its whole mip chain,
+// compressed into blocks if it can be, and it is asked to
+static bool prepare_image(const convert_t* convert, image_desc_t* image) {
+    if (!image->pixels) {
+        return true;
+    }
+
+    uint32_t width = image->width;
+    uint32_t height = image->height;
+    uint32_t layers = image->layers;
+    uint32_t num_mipmaps = image_num_mipmaps(width, height);
+    uint32_t* mipmaps = memory_malloc(sizeof(uint32_t)
+        * image_mipmaps_pixels(width, height, layers, num_mipmaps));
+    if (!mipmaps) {
+        return false;
+    }
+
+    memcpy(mipmaps, image->pixels, sizeof(uint32_t) * width * height * layers);
+    image_generate_mipmaps(&jobs, mipmaps, width, height, layers, num_mipmaps);
+
+    image->pixels = mipmaps;
+    image->num_mipmaps = (uint16_t)num_mipmaps;
+    if (!convert->compress || !compress_can_compress(width, height)) {
+        return true;
+    }
+
+    image_format_t format = compress_pick_format(mipmaps,
+        (size_t)width * height * layers);
+    uint32_t* blocks = memory_malloc(image_mipmaps_size(format,
+        width, height, layers, num_mipmaps));
+    if (!blocks) {
+        return true;
+    }
+
+    compress_image(&jobs, format, mipmaps, width, height,
+        layers, num_mipmaps, blocks);
+    memory_free(mipmaps);
+
+    image->pixels = blocks;
+    image->format = format;
+    return true;
+}
+
+static bool make_asset_materials(const convert_t* convert,
+    const wavefront_model_t* wf_model, asset_model_t* model) {
+    if (wf_model->num_materials <= 0) {
+        return true;
+    }
+
+    model->materials = memory_calloc((size_t)wf_model->num_materials,
+        sizeof(asset_material_t));
+    if (!model->materials) {
+        return false;
+    }
+
+    model->num_materials = (uint32_t)wf_model->num_materials;
+    for (int32_t m = 0; m < wf_model->num_materials; ++m) {
+        const wavefront_image_t* albedo = &wf_model->diffuseRGB_alphaA[m];
+        const wavefront_image_t* emissive = &wf_model->emissiveXYZ_specularW[m];
+        if (!albedo->pixels || !emissive->pixels) {
+            continue;
+        }
+
+        asset_material_t* material = &model->materials[m];
+        material->albedo = (image_desc_t){
+            .width = albedo->width,
+            .height = albedo->height,
+            .layers = albedo->layers,
+            .pixels = albedo->pixels
+        };
+
+        material->emissive = (image_desc_t){
+            .width = emissive->width,
+            .height = emissive->height,
+            .layers = emissive->layers,
+            .pixels = emissive->pixels
+        };
+
+        // the object images are not owned by the model
+        bool albedo_prepared = prepare_image(convert, &material->albedo);
+        bool emissive_prepared = prepare_image(convert, &material->emissive);
+        if (!albedo_prepared || !emissive_prepared) {
+            if (albedo_prepared) memory_free(material->albedo.pixels);
+            if (emissive_prepared) memory_free(material->emissive.pixels);
+            *material = (asset_material_t){0};
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void convert_file(const convert_t* convert, convert_file_t* file) {
+    file_t obj_file = file_open(file->filename, FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(obj_file)) {
+        file->error = "file not found";
+        return;
+    }
+
+    char* buffer_data = NULL;
+    size_t buffer_size = 0;
+    int32_t read_result = file_readall(obj_file, &buffer_data,
+        &buffer_size, memory_realloc);
+    file_close(obj_file);
+
+    if (read_result != FILE_READALL_OK) {
+        file->error = "file not readable";
+        return;
+    }
+
+    trace_t name;
+    char base_path[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(file->filename, base_path, name.name);
+    path_pop_ext(name.name, name.name, NULL);
+
+    wavefront_model_t wf_model = {0};
+    wavefront_result_t wf_result = wavefront_parse_obj(&(wavefront_data_t){
+        .allocator = memory_realloc,
+        .jobs = &jobs,
+        .base_path = base_path,
+        .obj_data = buffer_data,
+        .data_size = buffer_size,
+        .atlas_width = convert->atlas_size,
+        .atlas_height = convert->atlas_size,
+        .import_options = WAVEFRONT_IMPORT_DEFAULT
+            | WAVEFRONT_IMPORT_OPTIMIZE_MESH,
+        .label = name.name
+    }, &wf_model);
+    memory_realloc(buffer_data, 0);
+
+    if (wf_result != WAVEFRONT_RESULT_OK) {
+        file->error = "object not valid";
+        return;
+    }
+
+    file->obj_bytes = buffer_size;
+    file->vertices = wf_model.mesh->num_vertices;
+    file->triangles = wf_model.mesh->num_indices / 3;
+
+    // the mesh refers to the object vertices until it is written
+    asset_model_t model = {.trace = wf_model.trace};
+    if (!wavefront_build_mesh(&jobs, &wf_model, VERTEX_LAYOUT_COMPACT,
+        &model.mesh_data, model.submesh_materials, &model.num_submeshes)) {
+        file->error = "mesh not built";
+    }
+    else if (!make_asset_materials(convert, &wf_model, &model)) {
+        file->error = "not enough memory for materials";
+    }
+    else if (!asset_write(file->model_filename, &model)) {
+        file->error = "model not written";
+    }
+
+    asset_release(&model);
+    wavefront_release_obj(&wf_model);
+}
+
+static void convert_job(void* user_data, uint32_t index) {
+    const convert_t* convert = (const convert_t*)user_data;
+    convert_file_t* file = &convert->files[index];
+
+    uint64_t time = stm_now();
+    convert_file(convert, file);
+    file->ms = stm_ms(stm_since(time));
+
+    if (file->error) {
+        LOG_WARN("WARN: Cannot convert (%s), %s\n", file->filename, file->error);
+    }
+    else {
+        LOG_INFO("Converted (%s) into (%s), vertices=%u, triangles=%u, %.1fms\n",
+            file->filename, file->model_filename, file->vertices,
+            file->triangles, file->ms);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    sargs_setup(&(sargs_desc) {
+        .argc = argc,
+        .argv = argv
+    });
+
+    if (!sargs_isvalid() || !sargs_exists("in")) {
+        LOG_ERROR("ERROR: Usage: viewer-convert in=<dir> [out=<dir>]"
+            " [workers=0] [atlas=1024] [compress=1]\n");
+        return EXIT_FAILURE;
+    }
+
+    stm_setup();
+    jobs_init(&jobs, (uint32_t)atoi(sargs_value_def("workers", "0")));
+
+    convert_t convert = {
+        .out_dir = sargs_exists("out") ? sargs_value("out") : NULL,
+        .atlas_size = atoi(sargs_value_def("atlas", "1024")),
+        .compress = atoi(sargs_value_def("compress", "1")) != 0
+    };
+
+    cf_traverse(sargs_value("in"), gather_file, &convert);
+    if (convert.num_files == 0) {
+        LOG_WARN("WARN: No objects found in (%s)\n", sargs_value("in"));
+    }
+
+    // files are spread across the workers, while the jobs each
+    // of them would run in parallel run serially on the same one
+    uint64_t time = stm_now();
+    jobs_parallel_for(&jobs, convert_job, &convert, convert.num_files);
+
+    uint32_t num_failed = 0;
+    for (uint32_t f = 0; f < convert.num_files; ++f) {
+        num_failed += convert.files[f].error ? 1 : 0;
+    }
+
+    LOG_INFO("Converted %u of %u objects in %.1fms\n",
+        convert.num_files - num_failed, convert.num_files,
+        stm_ms(stm_since(time)));
+
+    if (convert.files) {
+        memory_free(convert.files);
+    }
+
+    jobs_cleanup(&jobs);
+    sargs_shutdown();
+    return num_failed > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -3,19 +3,16 @@
 @ctype vec3 vec3f_t
 @ctype vec2 vec2f_t
 
-@vs geo_vs
+@block geo_vs_instance
 layout(binding=0) uniform vs_params {
   mat4 view_proj;
 };
 
-in vec3 vertex_pos;
-in vec3 vertex_norm;
-in vec2 vertex_uv;
-
-in vec4 instance_color; // rgb: color, w: layer
-in vec4 instance_tile;  // xy:scaling, zw:panning
-in mat4 instance_pose;
-in mat4 instance_normal;
+in vec4 instance_color;   // rgb: color, w: layer / 255
+in vec4 instance_tile;    // xy: scaling, zw: panning
+in vec4 instance_pose_x;  // rows of the affine pose
+in vec4 instance_pose_y;
+in vec4 instance_pose_z;
 
 out vec3 world_position;
 out vec3 world_normal;
@@ -23,14 +20,76 @@ out vec3 world_normal;
 out vec4 color;
 out vec3 uv_layer;
 
-void main() {
-  vec4 position = vec4(vertex_pos, 1.0);
-  world_position = vec4(instance_pose * position).xyz;
-  world_normal = vec4(instance_normal * vec4(vertex_norm, 0.0)).xyz;
+void emit_vertex(vec3 pos, vec3 norm, vec2 uv, float layer) {
+  vec4 position = vec4(pos, 1.0);
+  world_position = vec3(
+    dot(instance_pose_x, position),
+    dot(instance_pose_y, position),
+    dot(instance_pose_z, position));
+
+  // the normal matrix is the inverse transpose of the pose, whose
+  // columns are the cross products of the pose ones, divided by its
+  // determinant, of which only the sign matters, as normals are
+  // normalised after interpolation anyway
+  vec3 c0 = vec3(instance_pose_x.x, instance_pose_y.x, instance_pose_z.x);
+  vec3 c1 = vec3(instance_pose_x.y, instance_pose_y.y, instance_pose_z.y);
+  vec3 c2 = vec3(instance_pose_x.z, instance_pose_y.z, instance_pose_z.z);
+  vec3 c12 = cross(c1, c2);
+  float det_sign = (dot(c0, c12) < 0.0) ? -1.0 : 1.0;
+  world_normal = mat3(c12, cross(c2, c0), cross(c0, c1)) * norm * det_sign;
+
   color = vec4(instance_color.xyz, 1.0);
-  uv_layer = vec3(vertex_uv * instance_tile.xy + instance_tile.zw,
-    instance_color.w);
-  gl_Position = view_proj * instance_pose * position;
+  uv_layer = vec3(uv * instance_tile.xy + instance_tile.zw,
+    floor(instance_color.w * 255.0 + 0.5) + layer);
+  gl_Position = view_proj * vec4(world_position, 1.0);
+}
+@end
+
+@vs geo_vs
+@include_block geo_vs_instance
+
+in vec3 vertex_pos;
+in vec3 vertex_norm;
+in vec2 vertex_uv;
+
+void main() {
+  emit_vertex(vertex_pos, vertex_norm, vertex_uv, 0.0);
+}
+@end
+
+@vs geo_compact_vs
+@include_block geo_vs_instance
+
+// dequantisation parameters of the mesh being drawn
+layout(binding=1) uniform vs_draw_params {
+  vec4 pos_scale;     // xyz: mesh bounds extents, w: 1 if u holds the layer
+  vec4 pos_offset;    // xyz: mesh bounds center
+  vec4 uv_scale_pan;  // xy: uv bounds extents, zw: uv bounds center
+};
+
+in vec4 vertex_pos;   // xyz: position normalised within mesh bounds
+in vec2 vertex_norm;  // octahedral encoded normal
+in vec2 vertex_uv;    // uv normalised within uv bounds
+
+vec3 oct_decode(vec2 e) {
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += (n.x >= 0.0) ? -t : t;
+  n.y += (n.y >= 0.0) ? -t : t;
+  return normalize(n);
+}
+
+void main() {
+  // atlases spanning more array layers encode the
+  // layer in u, as 2 * layer + 0.5 + u, with u in [0, 1]
+  vec2 uv = vertex_uv * uv_scale_pan.xy + uv_scale_pan.zw;
+  float layer = floor(uv.x * 0.5) * pos_scale.w;
+  uv.x -= (2.0 * layer + 0.5) * pos_scale.w;
+
+  emit_vertex(
+    vertex_pos.xyz * pos_scale.xyz + pos_offset.xyz,
+    oct_decode(vertex_norm),
+    uv, layer);
 }
 @end
 
@@ -82,4 +141,41 @@ void main() {
 }
 @end
 
+@vs geo_points_vs
+layout(binding=0) uniform vs_params {
+  mat4 view_proj;
+};
+
+// pose and dequantisation parameters of the point cloud being drawn
+layout(binding=1) uniform vs_point_params {
+  mat4 pose;
+  vec4 pos_scale;   // xyz: cloud bounds extents, w: point size in pixels
+  vec4 pos_offset;  // xyz: cloud bounds center
+};
+
+in vec4 point_pos;    // xyz: position normalised within cloud bounds
+in vec4 point_color;
+
+out vec4 color;
+
+void main() {
+  vec4 position = vec4(point_pos.xyz * pos_scale.xyz + pos_offset.xyz, 1.0);
+  gl_Position = view_proj * pose * position;
+  gl_PointSize = pos_scale.w;
+  color = point_color;
+}
+@end
+
+@fs geo_points_fs
+in vec4 color;
+
+out vec4 frag_color;
+
+void main() {
+  frag_color = color;
+}
+@end
+
 @program geometry_pass geo_vs geo_fs
+@program geometry_pass_compact geo_compact_vs geo_fs
+@program geometry_pass_points geo_points_vs geo_points_fs
@@ -0,0 +1,11 @@
+#define SOKOL_IMPL
+/* headless tools, resources are created without any device behind */
+#undef SOKOL_GLCORE33
+#undef SOKOL_GLES2
+#undef SOKOL_GLES3
+#undef SOKOL_D3D11
+#undef SOKOL_METAL
+#define SOKOL_DUMMY_BACKEND
+#include "sokol_args.h"
+#include "sokol_gfx.h"
+#include "sokol_time.h"
@@ -128,6 +128,16 @@ static void sa_imgui_draw_stats_content(sa_imgui_t* ctx) {
 
     ImGui::Text("Total Average: %3.1fms/%dfps", avg_time * 1000.f, fps);
 
+    if (ctx->app->stats->total_points > 0) {
+        ImGui::Text("Points: %u/%u",
+            ctx->app->stats->drawn_points, ctx->app->stats->total_points);
+    }
+
+    if (ctx->app->stats->visible_nodes + ctx->app->stats->culled_nodes > 0) {
+        ImGui::Text("Nodes: %u visible, %u culled",
+            ctx->app->stats->visible_nodes, ctx->app->stats->culled_nodes);
+    }
+
     // grab new data if animate is true,
     // otherwise use the ones from last time.
     uint32_t n_frames = ctx->stats.animate
@@ -0,0 +1,413 @@
+#include "viewer_asset.h"
+#include "viewer_file.h"
+#include "viewer_image.h"
+#include "viewer_memory.h"
+#include "viewer_log.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+// layers array textures are guaranteed to have, on every backend
+#define ASSET_MAX_IMAGE_LAYERS 256
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// sizes of the structures stored as they are, so that
+// files written by a different build are rejected
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t range_size;
+    uint32_t cluster_size;
+    uint32_t num_elements;
+    uint32_t num_ranges;
+    uint32_t num_lods;
+    uint32_t num_clusters;
+    int32_t index_type;
+    int32_t layout;
+    vertex_dequant_t dequant;
+    box_t bbox;
+    sphere_t bsphere;
+    uint32_t vertices_size;
+    uint32_t indices_size;
+    uint32_t num_submeshes;
+    uint32_t num_materials;
+    trace_t trace;
+} asset_header_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    uint16_t layers;
+    uint16_t num_mipmaps;
+    uint32_t format;
+} asset_image_header_t;
+
+static size_t image_size(const image_desc_t* image) {
+    return image_mipmaps_size(image->format, image->width, image->height,
+        image->layers, image->num_mipmaps > 1 ? image->num_mipmaps : 1);
+}
+
+static bool write_data(file_t file, const void* data, size_t size) {
+    return size == 0 || file_write(file, data, size) == size;
+}
+
+static bool read_data(file_t file, void* data, size_t size) {
+    return size == 0 || file_read(file, data, size) == size;
+}
+
+// allocate and read size bytes, NULL if size is 0 or it fails
+static void* read_alloc(file_t file, size_t size, bool* failed) {
+    if (size == 0 || *failed) {
+        return NULL;
+    }
+
+    void* data = memory_malloc(size);
+    if (!data || !read_data(file, data, size)) {
+        if (data) memory_free(data);
+        *failed = true;
+        return NULL;
+    }
+
+    return data;
+}
+
+// images which could not be loaded are stored empty
+static bool write_image(file_t file, const image_desc_t* image) {
+    asset_image_header_t header = {0};
+    if (image->pixels) {
+        header = (asset_image_header_t){
+            .width = image->width,
+            .height = image->height,
+            .layers = image->layers,
+            .num_mipmaps = image->num_mipmaps,
+            .format = (uint32_t)image->format
+        };
+    }
+
+    return write_data(file, &header, sizeof(header))
+        && write_data(file, image->pixels, image->pixels ? image_size(image) : 0);
+}
+
+// what the upload relies on: a whole mip chain no longer than the
+// backend takes, no more layers than array textures are guaranteed to
+// have, and blocks covering the top level exactly. empty images are
+// stored with a zeroed header, and have nothing else to check
+static bool image_header_is_valid(const asset_image_header_t* header) {
+    if (header->width == 0 || header->height == 0 || header->layers == 0) {
+        return header->format <= IMAGE_FORMAT_BC3;
+    }
+
+    bool blocks_fit = header->format == IMAGE_FORMAT_RGBA8
+        || (header->width % IMAGE_BLOCK_SIZE == 0
+            && header->height % IMAGE_BLOCK_SIZE == 0);
+    return header->format <= IMAGE_FORMAT_BC3
+        && blocks_fit
+        && header->layers <= ASSET_MAX_IMAGE_LAYERS
+        && header->num_mipmaps > 0
+        && header->num_mipmaps <= SG_MAX_MIPMAPS
+        && header->num_mipmaps <= image_num_mipmaps(header->width, header->height);
+}
+
+static bool read_image(file_t file, image_desc_t* image) {
+    asset_image_header_t header;
+    if (!read_data(file, &header, sizeof(header))) {
+        return false;
+    }
+
+    if (!image_header_is_valid(&header)) {
+        return false;
+    }
+
+    *image = (image_desc_t){
+        .width = header.width,
+        .height = header.height,
+        .layers = header.layers,
+        .num_mipmaps = header.num_mipmaps,
+        .format = (image_format_t)header.format
+    };
+
+    bool failed = false;
+    if (header.width > 0 && header.height > 0 && header.layers > 0) {
+        image->pixels = read_alloc(file, image_size(image), &failed);
+    }
+
+    return !failed;
+}
+
+// what the draws rely on, which a truncated or foreign file could
+// not provide, before anything else is read
+static bool header_is_valid(const asset_header_t* header) {
+    uint32_t index_size = (header->index_type == SG_INDEXTYPE_UINT16)
+        ? sizeof(uint16_t) : sizeof(uint32_t);
+    return header->magic == ASSET_MAGIC
+        && header->version == ASSET_VERSION
+        && header->range_size == sizeof(mesh_range_t)
+        && header->cluster_size == sizeof(cluster_t)
+        && header->num_ranges > 0
+        && header->num_ranges <= GEOMETRY_PASS_MAX_MESH_RANGES
+        && header->num_submeshes <= GEOMETRY_PASS_MAX_MESH_RANGES
+        && header->num_lods > 0
+        && header->num_lods <= GEOMETRY_PASS_MAX_LODS
+        && (header->index_type == SG_INDEXTYPE_UINT16
+            || header->index_type == SG_INDEXTYPE_UINT32)
+        && (header->layout == VERTEX_LAYOUT_FLOAT
+            || header->layout == VERTEX_LAYOUT_COMPACT)
+        && header->vertices_size > 0
+        && header->indices_size > 0
+        && header->indices_size % index_size == 0
+        && header->num_elements <= header->indices_size / index_size;
+}
+
+// ranges, and the clusters they are made of, within the buffers
+static bool ranges_are_valid(const asset_header_t* header, const mesh_t* mesh) {
+    uint32_t index_size = (header->index_type == SG_INDEXTYPE_UINT16)
+        ? sizeof(uint16_t) : sizeof(uint32_t);
+    int64_t num_indices = header->indices_size / index_size;
+
+    for (uint32_t r = 0; r < mesh->num_ranges; ++r) {
+        const mesh_range_t* range = &mesh->ranges[r];
+        if (range->base_element < 0 || range->num_elements < 0
+            || (int64_t)range->base_element + range->num_elements > num_indices
+            || range->lod < 0 || (uint32_t)range->lod >= header->num_lods
+            || range->vertex_buffer_offset < 0
+            || (uint32_t)range->vertex_buffer_offset >= header->vertices_size
+            || (uint64_t)range->first_cluster + range->num_clusters
+                > mesh->num_clusters) {
+            return false;
+        }
+    }
+
+    for (uint32_t c = 0; c < mesh->num_clusters; ++c) {
+        const cluster_t* cluster = &mesh->clusters[c];
+        if ((int64_t)cluster->base_element + cluster->num_elements > num_indices) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool asset_write(const char* filename, const asset_model_t* model) {
+    assert(filename && model);
+    const mesh_data_t* mesh_data = &model->mesh_data;
+    const mesh_t* mesh = &mesh_data->mesh;
+
+    file_t file = file_open(filename, FILE_OPEN_WRITE|FILE_OPEN_BINARY);
+    if (!file_is_valid(file)) {
+        LOG_WARN("WARN: Cannot write (%s)\n", filename);
+        return false;
+    }
+
+    asset_header_t header = {
+        .magic = ASSET_MAGIC,
+        .version = ASSET_VERSION,
+        .range_size = sizeof(mesh_range_t),
+        .cluster_size = sizeof(cluster_t),
+        .num_elements = mesh->num_elements,
+        .num_ranges = mesh->num_ranges,
+        .num_lods = mesh->num_lods,
+        .num_clusters = mesh->num_clusters,
+        .index_type = (int32_t)mesh->index_type,
+        .layout = (int32_t)mesh->layout,
+        .dequant = mesh->dequant,
+        .bbox = mesh->bbox,
+        .bsphere = mesh->bsphere,
+        .vertices_size = mesh_data->vertices_size,
+        .indices_size = mesh_data->indices_size,
+        .num_submeshes = model->num_submeshes,
+        .num_materials = model->num_materials,
+        .trace = model->trace
+    };
+
+    bool written = write_data(file, &header, sizeof(header))
+        && write_data(file, mesh->ranges, sizeof(mesh_range_t) * mesh->num_ranges)
+        && write_data(file, mesh->clusters, sizeof(cluster_t) * mesh->num_clusters)
+        && write_data(file, mesh_data->vertices, mesh_data->vertices_size)
+        && write_data(file, mesh_data->indices, mesh_data->indices_size)
+        && write_data(file, model->submesh_materials,
+            sizeof(int32_t) * model->num_submeshes);
+
+    for (uint32_t m = 0; written && m < model->num_materials; ++m) {
+        written = write_image(file, &model->materials[m].albedo)
+            && write_image(file, &model->materials[m].emissive);
+    }
+
+    file_close(file);
+    if (!written) {
+        LOG_WARN("WARN: Failed to write (%s)\n", filename);
+        remove(filename);
+    }
+
+    return written;
+}
+
+bool asset_read(const char* filename, asset_model_t* out_model) {
+    assert(filename && out_model);
+    memset(out_model, 0, sizeof(asset_model_t));
+
+    file_t file = file_open(filename, FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(file)) {
+        return false;
+    }
+
+    asset_header_t header;
+    bool failed = !read_data(file, &header, sizeof(header));
+    if (failed || !header_is_valid(&header)) {
+        LOG_WARN("WARN: Invalid or outdated model (%s)\n", filename);
+        file_close(file);
+        return false;
+    }
+
+    mesh_data_t* mesh_data = &out_model->mesh_data;
+    mesh_t* mesh = &mesh_data->mesh;
+    *mesh = (mesh_t){
+        .num_elements = header.num_elements,
+        .index_type = (sg_index_type)header.index_type,
+        .num_ranges = header.num_ranges,
+        .num_lods = header.num_lods,
+        .layout = (vertex_layout_t)header.layout,
+        .dequant = header.dequant,
+        .bbox = header.bbox,
+        .bsphere = header.bsphere,
+        .num_clusters = header.num_clusters,
+        .cull_model = {.id = HANDLE_INVALID_ID},
+        .trace = header.trace
+    };
+
+    failed = !read_data(file, mesh->ranges, sizeof(mesh_range_t) * mesh->num_ranges);
+    mesh->clusters = read_alloc(file,
+        sizeof(cluster_t) * mesh->num_clusters, &failed);
+    if (!failed && !ranges_are_valid(&header, mesh)) {
+        LOG_WARN("WARN: Invalid ranges in model (%s)\n", filename);
+        failed = true;
+    }
+
+    mesh_data->owned_vertices = read_alloc(file, header.vertices_size, &failed);
+    mesh_data->vertices = mesh_data->owned_vertices;
+    mesh_data->vertices_size = header.vertices_size;
+    mesh_data->indices = read_alloc(file, header.indices_size, &failed);
+    mesh_data->indices_size = header.indices_size;
+
+    // visible clusters are compacted into a copy of the indices
+    if (mesh->clusters && !failed) {
+        mesh->cull_indices = memory_malloc(header.indices_size);
+        failed = !mesh->cull_indices;
+    }
+
+    out_model->num_submeshes = header.num_submeshes;
+    failed = failed || !read_data(file, out_model->submesh_materials,
+        sizeof(int32_t) * header.num_submeshes);
+
+    if (!failed && header.num_materials > 0) {
+        out_model->materials = memory_calloc(header.num_materials,
+            sizeof(asset_material_t));
+        failed = !out_model->materials;
+    }
+
+    for (uint32_t m = 0; !failed && m < header.num_materials; ++m) {
+        out_model->num_materials = m + 1;
+        failed = !read_image(file, &out_model->materials[m].albedo)
+            || !read_image(file, &out_model->materials[m].emissive);
+    }
+
+    out_model->trace = header.trace;
+    file_close(file);
+
+    if (failed || !mesh_data->vertices || !mesh_data->indices) {
+        LOG_WARN("WARN: Failed to read model (%s)\n", filename);
+        asset_release(out_model);
+        return false;
+    }
+
+    return true;
+}
+
+model_id_t asset_make_model(geometry_pass_t* pass, asset_model_t* model) {
+    assert(pass && model);
+
+    model_id_t model_id = {.id = HANDLE_INVALID_ID};
+    mesh_id_t mesh = geometry_pass_upload_mesh(pass, &model->mesh_data);
+    if (mesh.id == HANDLE_INVALID_ID) {
+        asset_release(model);
+        return model_id;
+    }
+
+    // materials without images are drawn with the default one
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    uint32_t num_materials = model->num_materials;
+    if (num_materials > GEOMETRY_PASS_MAX_MATERIALS) {
+        LOG_WARN("WARN: Too many materials (%d) in (%s);"
+            " only %d will be created\n", num_materials,
+            model->trace.name, GEOMETRY_PASS_MAX_MATERIALS);
+        num_materials = GEOMETRY_PASS_MAX_MATERIALS;
+    }
+
+    for (uint32_t m = 0; m < num_materials; ++m) {
+        const asset_material_t* material = &model->materials[m];
+        materials[m] = default_material;
+        if (!material->albedo.pixels || !material->emissive.pixels) {
+            continue;
+        }
+
+        trace_t mat_trace;
+        trace_printf(&mat_trace, "%s-mat%d", model->trace.name, m);
+        material_id_t material_id = geometry_pass_make_material(pass,
+            &(material_desc_t){
+                .albedo = &material->albedo,
+                .emissive = &material->emissive,
+                .label = mat_trace.name
+            });
+
+        if (handle_is_valid(material_id, GEOMETRY_PASS_MAX_MATERIALS)) {
+            materials[m] = material_id;
+        }
+    }
+
+    material_id_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    for (uint32_t s = 0; s < model->num_submeshes; ++s) {
+        int32_t m = model->submesh_materials[s];
+        submesh_materials[s] = (m >= 0 && (uint32_t)m < num_materials)
+            ? materials[m] : default_material;
+    }
+
+    model_id = geometry_pass_create_model(pass, &(model_desc_t){
+        .material = default_material,
+        .mesh = mesh,
+        .submesh_materials = model->num_submeshes ? submesh_materials : NULL,
+        .num_submesh_materials = model->num_submeshes,
+        .label = model->trace.name
+    });
+
+    asset_release(model);
+    return model_id;
+}
+
+void asset_release(asset_model_t* model) {
+    assert(model);
+
+    geometry_pass_release_mesh_data(&model->mesh_data);
+    for (uint32_t m = 0; m < model->num_materials; ++m) {
+        if (model->materials[m].albedo.pixels) {
+            memory_free(model->materials[m].albedo.pixels);
+        }
+
+        if (model->materials[m].emissive.pixels) {
+            memory_free(model->materials[m].emissive.pixels);
+        }
+    }
+
+    if (model->materials) {
+        memory_free(model->materials);
+    }
+
+    memset(model, 0, sizeof(asset_model_t));
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+/**
+ * Binary models, converted offline, ready to be uploaded
+ */
+
+#include "viewer_geometry_pass.h"
+
+#define ASSET_FILE_EXTENSION ".vmodel"
+#define ASSET_MAGIC 0x4c444d56      // VMDL
+#define ASSET_VERSION 3
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct {
+    image_desc_t albedo;    // with their whole mip chains,
+    image_desc_t emissive;  // block compressed when they can be
+} asset_material_t;
+
+// a model whose mesh has already been built, and whose images have
+// their mipmaps, so that loading it is all about reading and uploading.
+// files have the layout of the structures, and the byte order, of the
+// build writing them, as they are meant to be converted at deploy time
+// by the same version of the viewer, and they are rejected otherwise.
+typedef struct {
+    mesh_data_t mesh_data;
+    int32_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES]; // -1 if none
+    uint32_t num_submeshes;
+    asset_material_t* materials;
+    uint32_t num_materials;
+    trace_t trace;
+} asset_model_t;
+
+/**
+ * Write the model into filename, replacing it if it exists.
+ */
+bool asset_write(const char* filename, const asset_model_t* model);
+
+/**
+ * Read the model from filename, whose content is allocated with
+ * memory_malloc, and must be released with asset_release, unless
+ * it is uploaded with asset_make_model.
+ */
+bool asset_read(const char* filename, asset_model_t* out_model);
+
+/**
+ * Upload the mesh, create the materials and then the model, which
+ * draws the submeshes with their own. The model is released anyway.
+ */
+model_id_t asset_make_model(geometry_pass_t* pass, asset_model_t* model);
+
+void asset_release(asset_model_t* model);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,517 @@
+#include "viewer_compress.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWER_COMPRESS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VIEWER_COMPRESS_NEON
+#endif
+
+// rows of blocks compressed, or decompressed, by each job
+#define COMPRESS_ROWS_PER_JOB 16
+
+// principal axis iterations, and the scale of its integer version
+#define COMPRESS_AXIS_ITERATIONS 4
+#define COMPRESS_AXIS_SCALE 1024.f
+
+#define BLOCK_PIXELS (IMAGE_BLOCK_SIZE * IMAGE_BLOCK_SIZE)
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// pixels are stored as bytes r,g,b,a in memory, see viewer_image.c
+#define CHANNEL(p, c) (((p) >> (8 * (c))) & 0xFF)
+
+image_format_t compress_pick_format(const uint32_t* pixels, size_t num_pixels) {
+    assert(pixels || num_pixels == 0);
+
+    size_t i = 0;
+    uint32_t alpha = 0xFFFFFFFF;
+#if defined(VIEWER_COMPRESS_SSE2)
+    __m128i alpha4 = _mm_set1_epi32(-1);
+    for (; i + 4 <= num_pixels; i += 4) {
+        alpha4 = _mm_and_si128(alpha4,
+            _mm_loadu_si128((const __m128i*)(pixels + i)));
+    }
+
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, alpha4);
+    alpha = lanes[0] & lanes[1] & lanes[2] & lanes[3];
+#elif defined(VIEWER_COMPRESS_NEON)
+    uint32x4_t alpha4 = vdupq_n_u32(0xFFFFFFFF);
+    for (; i + 4 <= num_pixels; i += 4) {
+        alpha4 = vandq_u32(alpha4, vld1q_u32(pixels + i));
+    }
+
+    alpha = vgetq_lane_u32(alpha4, 0) & vgetq_lane_u32(alpha4, 1)
+        & vgetq_lane_u32(alpha4, 2) & vgetq_lane_u32(alpha4, 3);
+#endif
+
+    for (; i < num_pixels; ++i) {
+        alpha &= pixels[i];
+    }
+
+    return (CHANNEL(alpha, 3) == 0xFF) ? IMAGE_FORMAT_BC1 : IMAGE_FORMAT_BC3;
+}
+
+bool compress_can_compress(uint32_t width, uint32_t height) {
+    return width > 0 && height > 0
+        && width % IMAGE_BLOCK_SIZE == 0 && height % IMAGE_BLOCK_SIZE == 0;
+}
+
+// dot products of the block pixel colours with the given direction
+static void block_dots(const uint32_t* pixels, int32_t dr, int32_t dg,
+    int32_t db, int32_t* out_dots) {
+#if defined(VIEWER_COMPRESS_SSE2)
+    // 2 pixels per register, widened to 16-bit, whose r*dr+g*dg
+    // and b*db+a*0 pairs are then added to each other.
+    __m128i zero = _mm_setzero_si128();
+    __m128i dir = _mm_setr_epi16((int16_t)dr, (int16_t)dg, (int16_t)db, 0,
+        (int16_t)dr, (int16_t)dg, (int16_t)db, 0);
+    for (uint32_t i = 0; i < BLOCK_PIXELS; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+        __m128 lo = _mm_castsi128_ps(_mm_madd_epi16(
+            _mm_unpacklo_epi8(p, zero), dir));
+        __m128 hi = _mm_castsi128_ps(_mm_madd_epi16(
+            _mm_unpackhi_epi8(p, zero), dir));
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i*)(out_dots + i), _mm_add_epi32(even, odd));
+    }
+#elif defined(VIEWER_COMPRESS_NEON)
+    // de-interleave the channels into planes, then
+    // widen and accumulate 4 pixels at a time.
+    uint8x16x4_t p = vld4q_u8((const uint8_t*)pixels);
+    int16x8_t planes[3][2];
+    for (uint32_t c = 0; c < 3; ++c) {
+        planes[c][0] = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(p.val[c])));
+        planes[c][1] = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(p.val[c])));
+    }
+
+    for (uint32_t h = 0; h < 2; ++h) {
+        int32x4_t lo = vmull_n_s16(vget_low_s16(planes[0][h]), (int16_t)dr);
+        lo = vmlal_n_s16(lo, vget_low_s16(planes[1][h]), (int16_t)dg);
+        lo = vmlal_n_s16(lo, vget_low_s16(planes[2][h]), (int16_t)db);
+        int32x4_t hi = vmull_n_s16(vget_high_s16(planes[0][h]), (int16_t)dr);
+        hi = vmlal_n_s16(hi, vget_high_s16(planes[1][h]), (int16_t)dg);
+        hi = vmlal_n_s16(hi, vget_high_s16(planes[2][h]), (int16_t)db);
+        vst1q_s32(out_dots + 8 * h, lo);
+        vst1q_s32(out_dots + 8 * h + 4, hi);
+    }
+#else
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        out_dots[i] = (int32_t)CHANNEL(pixels[i], 0) * dr
+            + (int32_t)CHANNEL(pixels[i], 1) * dg
+            + (int32_t)CHANNEL(pixels[i], 2) * db;
+    }
+#endif
+}
+
+static uint16_t pack_565(int32_t r, int32_t g, int32_t b) {
+    r = r < 0 ? 0 : (r > 255 ? 255 : r);
+    g = g < 0 ? 0 : (g > 255 ? 255 : g);
+    b = b < 0 ? 0 : (b > 255 ? 255 : b);
+    return (uint16_t)((((r * 31 + 127) / 255) << 11)
+        | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+static void unpack_565(uint16_t c, int32_t* out_rgb) {
+    int32_t r = (c >> 11) & 31;
+    int32_t g = (c >> 5) & 63;
+    int32_t b = c & 31;
+    out_rgb[0] = (r << 3) | (r >> 2);
+    out_rgb[1] = (g << 2) | (g >> 4);
+    out_rgb[2] = (b << 3) | (b >> 2);
+}
+
+// direction along which the colours spread the most, by power
+// iteration of their covariance, from the diagonal of their bounds
+static void principal_axis(const uint32_t* pixels, float* out_axis) {
+    float mean[3] = {0};
+    int32_t lo[3] = {255, 255, 255};
+    int32_t hi[3] = {0};
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            int32_t v = (int32_t)CHANNEL(pixels[i], c);
+            mean[c] += (float)v;
+            lo[c] = v < lo[c] ? v : lo[c];
+            hi[c] = v > hi[c] ? v : hi[c];
+        }
+    }
+
+    float cov[6] = {0};
+    for (uint32_t c = 0; c < 3; ++c) {
+        mean[c] /= BLOCK_PIXELS;
+    }
+
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        float r = (float)CHANNEL(pixels[i], 0) - mean[0];
+        float g = (float)CHANNEL(pixels[i], 1) - mean[1];
+        float b = (float)CHANNEL(pixels[i], 2) - mean[2];
+        cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+        cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+    }
+
+    float axis[3] = {
+        (float)(hi[0] - lo[0]), (float)(hi[1] - lo[1]), (float)(hi[2] - lo[2])
+    };
+
+    for (uint32_t k = 0; k < COMPRESS_AXIS_ITERATIONS; ++k) {
+        float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+        float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+        float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+        float length = fmaxf(fabsf(x), fmaxf(fabsf(y), fabsf(z)));
+        if (length < 1e-6f) {
+            break;
+        }
+
+        axis[0] = x / length;
+        axis[1] = y / length;
+        axis[2] = z / length;
+    }
+
+    float length = fmaxf(fabsf(axis[0]), fmaxf(fabsf(axis[1]), fabsf(axis[2])));
+    if (length < 1e-6f) {
+        // grey levels, or a single colour
+        axis[0] = axis[1] = axis[2] = length = 1.f;
+    }
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        out_axis[c] = axis[c] / length;
+    }
+}
+
+// the colour half of both bc1 and bc3 blocks, always in
+// the 4 colours mode, with the first endpoint the greater
+static void compress_colour(const uint32_t* pixels, uint8_t* out_block) {
+    float axis[3];
+    principal_axis(pixels, axis);
+
+    int32_t dots[BLOCK_PIXELS];
+    block_dots(pixels, (int32_t)(axis[0] * COMPRESS_AXIS_SCALE),
+        (int32_t)(axis[1] * COMPRESS_AXIS_SCALE),
+        (int32_t)(axis[2] * COMPRESS_AXIS_SCALE), dots);
+
+    uint32_t min_pixel = 0;
+    uint32_t max_pixel = 0;
+    for (uint32_t i = 1; i < BLOCK_PIXELS; ++i) {
+        min_pixel = dots[i] < dots[min_pixel] ? i : min_pixel;
+        max_pixel = dots[i] > dots[max_pixel] ? i : max_pixel;
+    }
+
+    // the extremes along the axis are inset slightly, as
+    // they are rarely the best endpoints to interpolate
+    int32_t e0[3], e1[3];
+    for (uint32_t c = 0; c < 3; ++c) {
+        int32_t hi = (int32_t)CHANNEL(pixels[max_pixel], c);
+        int32_t lo = (int32_t)CHANNEL(pixels[min_pixel], c);
+        int32_t inset = (hi - lo) / 16;
+        e0[c] = hi - inset;
+        e1[c] = lo + inset;
+    }
+
+    uint16_t c0 = pack_565(e0[0], e0[1], e0[2]);
+    uint16_t c1 = pack_565(e1[0], e1[1], e1[2]);
+    if (c0 < c1) {
+        uint16_t c = c0;
+        c0 = c1;
+        c1 = c;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int32_t p0[3], p1[3];
+        unpack_565(c0, p0);
+        unpack_565(c1, p1);
+
+        // the palette, as decoded, projected on the endpoints direction
+        int32_t dir[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+        int32_t stops[4];
+        for (uint32_t k = 0; k < 4; ++k) {
+            int32_t w0 = (k == 0) ? 3 : (k == 1) ? 0 : (k == 2) ? 2 : 1;
+            stops[k] = 0;
+            for (uint32_t c = 0; c < 3; ++c) {
+                stops[k] += dir[c] * ((w0 * p0[c] + (3 - w0) * p1[c]) / 3);
+            }
+        }
+
+        // ascending along the direction, they are 1, 3, 2, 0
+        int32_t below_3 = stops[1] + stops[3];
+        int32_t below_2 = stops[3] + stops[2];
+        int32_t below_0 = stops[2] + stops[0];
+        block_dots(pixels, dir[0], dir[1], dir[2], dots);
+        for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+            int32_t dot = 2 * dots[i];
+            uint32_t index = (dot < below_2)
+                ? ((dot < below_3) ? 1 : 3)
+                : ((dot < below_0) ? 2 : 0);
+            indices |= index << (2 * i);
+        }
+    }
+
+    out_block[0] = (uint8_t)(c0 & 0xFF);
+    out_block[1] = (uint8_t)(c0 >> 8);
+    out_block[2] = (uint8_t)(c1 & 0xFF);
+    out_block[3] = (uint8_t)(c1 >> 8);
+    for (uint32_t b = 0; b < 4; ++b) {
+        out_block[4 + b] = (uint8_t)(indices >> (8 * b));
+    }
+}
+
+// 8 interpolated alpha values, from the greatest to the
+// lowest, each pixel with the one closest to its own
+static void compress_alpha(const uint32_t* pixels, uint8_t* out_block) {
+    int32_t lo = 255;
+    int32_t hi = 0;
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        int32_t a = (int32_t)CHANNEL(pixels[i], 3);
+        lo = a < lo ? a : lo;
+        hi = a > hi ? a : hi;
+    }
+
+    uint64_t indices = 0;
+    if (hi > lo) {
+        // ramp positions from the lowest (0) to the greatest (7),
+        // whose indices are 1, 7, 6, ..., 2, 0 respectively
+        int32_t range = hi - lo;
+        for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+            int32_t a = (int32_t)CHANNEL(pixels[i], 3);
+            int32_t ramp = ((a - lo) * 14 + range) / (2 * range);
+            uint64_t index = (ramp == 7) ? 0 : (ramp == 0) ? 1 : (uint64_t)(8 - ramp);
+            indices |= index << (3 * i);
+        }
+    }
+
+    out_block[0] = (uint8_t)hi;
+    out_block[1] = (uint8_t)lo;
+    for (uint32_t b = 0; b < 6; ++b) {
+        out_block[2 + b] = (uint8_t)(indices >> (8 * b));
+    }
+}
+
+void compress_block_bc1(const uint32_t* pixels, uint8_t* out_block) {
+    assert(pixels && out_block);
+    compress_colour(pixels, out_block);
+}
+
+void compress_block_bc3(const uint32_t* pixels, uint8_t* out_block) {
+    assert(pixels && out_block);
+    compress_alpha(pixels, out_block);
+    compress_colour(pixels, out_block + 8);
+}
+
+static void decode_colour(const uint8_t* block, bool opaque_only,
+    uint32_t* out_pixels) {
+    uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+
+    int32_t p0[3], p1[3];
+    unpack_565(c0, p0);
+    unpack_565(c1, p1);
+
+    // 3 colours and transparent black, when the endpoints are swapped
+    uint32_t palette[4];
+    bool four_colours = opaque_only || c0 > c1;
+    for (uint32_t k = 0; k < 4; ++k) {
+        int32_t rgb[3];
+        for (uint32_t c = 0; c < 3; ++c) {
+            rgb[c] = (k == 0) ? p0[c] : (k == 1) ? p1[c]
+                : four_colours ? ((k == 2) ? (2 * p0[c] + p1[c]) / 3
+                    : (p0[c] + 2 * p1[c]) / 3)
+                : (k == 2) ? (p0[c] + p1[c]) / 2 : 0;
+        }
+
+        uint32_t alpha = (!four_colours && k == 3) ? 0 : 0xFF;
+        palette[k] = (uint32_t)rgb[0] | ((uint32_t)rgb[1] << 8)
+            | ((uint32_t)rgb[2] << 16) | (alpha << 24);
+    }
+
+    uint32_t indices = (uint32_t)block[4] | ((uint32_t)block[5] << 8)
+        | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        out_pixels[i] = palette[(indices >> (2 * i)) & 3];
+    }
+}
+
+static void decode_alpha(const uint8_t* block, uint32_t* pixels) {
+    int32_t a0 = block[0];
+    int32_t a1 = block[1];
+
+    uint32_t palette[8] = {(uint32_t)a0, (uint32_t)a1};
+    for (int32_t k = 2; k < 8; ++k) {
+        if (a0 > a1) {
+            palette[k] = (uint32_t)(((8 - k) * a0 + (k - 1) * a1) / 7);
+        }
+        else {
+            palette[k] = (k == 6) ? 0 : (k == 7) ? 255
+                : (uint32_t)(((6 - k) * a0 + (k - 1) * a1) / 5);
+        }
+    }
+
+    uint64_t indices = 0;
+    for (uint32_t b = 0; b < 6; ++b) {
+        indices |= (uint64_t)block[2 + b] << (8 * b);
+    }
+
+    for (uint32_t i = 0; i < BLOCK_PIXELS; ++i) {
+        uint32_t alpha = palette[(indices >> (3 * i)) & 7];
+        pixels[i] = (pixels[i] & 0x00FFFFFF) | (alpha << 24);
+    }
+}
+
+typedef struct {
+    image_format_t format;
+    const void* src;
+    void* dst;
+    uint32_t width;
+    uint32_t height;
+    uint32_t blocks_x;
+    uint32_t blocks_y;
+    uint32_t bands_per_layer;
+} compress_level_job_t;
+
+static void compress_level_job(void* user_data, uint32_t index) {
+    const compress_level_job_t* job = (const compress_level_job_t*)user_data;
+    uint32_t layer = index / job->bands_per_layer;
+    uint32_t band = index % job->bands_per_layer;
+
+    size_t block_bytes = image_level_size(job->format, 1, 1, 1);
+    const uint32_t* src = (const uint32_t*)job->src
+        + (size_t)layer * job->width * job->height;
+    uint8_t* dst = (uint8_t*)job->dst
+        + block_bytes * layer * job->blocks_x * job->blocks_y;
+
+    uint32_t first_row = band * COMPRESS_ROWS_PER_JOB;
+    uint32_t last_row = first_row + COMPRESS_ROWS_PER_JOB;
+    last_row = last_row < job->blocks_y ? last_row : job->blocks_y;
+
+    for (uint32_t by = first_row; by < last_row; ++by) {
+        for (uint32_t bx = 0; bx < job->blocks_x; ++bx) {
+            // levels smaller than a block repeat their last row and column
+            uint32_t pixels[BLOCK_PIXELS];
+            for (uint32_t y = 0; y < IMAGE_BLOCK_SIZE; ++y) {
+                uint32_t py = by * IMAGE_BLOCK_SIZE + y;
+                py = py < job->height ? py : job->height - 1;
+                for (uint32_t x = 0; x < IMAGE_BLOCK_SIZE; ++x) {
+                    uint32_t px = bx * IMAGE_BLOCK_SIZE + x;
+                    px = px < job->width ? px : job->width - 1;
+                    pixels[y * IMAGE_BLOCK_SIZE + x] = src[(size_t)py * job->width + px];
+                }
+            }
+
+            uint8_t* block = dst + block_bytes * ((size_t)by * job->blocks_x + bx);
+            if (job->format == IMAGE_FORMAT_BC1) {
+                compress_block_bc1(pixels, block);
+            }
+            else {
+                compress_block_bc3(pixels, block);
+            }
+        }
+    }
+}
+
+static void decode_level_job(void* user_data, uint32_t index) {
+    const compress_level_job_t* job = (const compress_level_job_t*)user_data;
+    uint32_t layer = index / job->bands_per_layer;
+    uint32_t band = index % job->bands_per_layer;
+
+    size_t block_bytes = image_level_size(job->format, 1, 1, 1);
+    const uint8_t* src = (const uint8_t*)job->src
+        + block_bytes * layer * job->blocks_x * job->blocks_y;
+    uint32_t* dst = (uint32_t*)job->dst
+        + (size_t)layer * job->width * job->height;
+
+    uint32_t first_row = band * COMPRESS_ROWS_PER_JOB;
+    uint32_t last_row = first_row + COMPRESS_ROWS_PER_JOB;
+    last_row = last_row < job->blocks_y ? last_row : job->blocks_y;
+
+    for (uint32_t by = first_row; by < last_row; ++by) {
+        for (uint32_t bx = 0; bx < job->blocks_x; ++bx) {
+            const uint8_t* block = src + block_bytes * ((size_t)by * job->blocks_x + bx);
+
+            uint32_t pixels[BLOCK_PIXELS];
+            if (job->format == IMAGE_FORMAT_BC1) {
+                decode_colour(block, false, pixels);
+            }
+            else {
+                decode_colour(block + 8, true, pixels);
+                decode_alpha(block, pixels);
+            }
+
+            for (uint32_t y = 0; y < IMAGE_BLOCK_SIZE; ++y) {
+                uint32_t py = by * IMAGE_BLOCK_SIZE + y;
+                for (uint32_t x = 0; x < IMAGE_BLOCK_SIZE; ++x) {
+                    uint32_t px = bx * IMAGE_BLOCK_SIZE + x;
+                    if (px < job->width && py < job->height) {
+                        dst[(size_t)py * job->width + px] = pixels[y * IMAGE_BLOCK_SIZE + x];
+                    }
+                }
+            }
+        }
+    }
+}
+
+// run the job over each level, with both its rgba8 and block
+// compressed versions moving forward a level at a time
+static void for_each_level(jobs_t* jobs, jobs_func_t func, bool compress,
+    image_format_t format, const void* src, void* dst, uint32_t width,
+    uint32_t height, uint32_t layers, uint32_t num_mipmaps) {
+    const uint8_t* src_level = (const uint8_t*)src;
+    uint8_t* dst_level = (uint8_t*)dst;
+    for (uint32_t l = 0; l < num_mipmaps; ++l) {
+        uint32_t level_width = image_mip_size(width, l);
+        uint32_t level_height = image_mip_size(height, l);
+        uint32_t blocks_y = (level_height + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE;
+
+        compress_level_job_t job = {
+            .format = format,
+            .src = src_level,
+            .dst = dst_level,
+            .width = level_width,
+            .height = level_height,
+            .blocks_x = (level_width + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE,
+            .blocks_y = blocks_y,
+            .bands_per_layer = (blocks_y + COMPRESS_ROWS_PER_JOB - 1)
+                / COMPRESS_ROWS_PER_JOB
+        };
+
+        jobs_parallel_for(jobs, func, &job, layers * job.bands_per_layer);
+
+        size_t rgba_size = image_level_size(IMAGE_FORMAT_RGBA8,
+            level_width, level_height, layers);
+        size_t blocks_size = image_level_size(format,
+            level_width, level_height, layers);
+        src_level += compress ? rgba_size : blocks_size;
+        dst_level += compress ? blocks_size : rgba_size;
+    }
+}
+
+void compress_image(jobs_t* jobs, image_format_t format,
+    const uint32_t* pixels, uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps, void* out_blocks) {
+    assert(pixels && out_blocks && width > 0 && height > 0 && layers > 0);
+    assert(format == IMAGE_FORMAT_BC1 || format == IMAGE_FORMAT_BC3);
+
+    for_each_level(jobs, compress_level_job, true, format, pixels,
+        out_blocks, width, height, layers, num_mipmaps);
+}
+
+void compress_decode_image(jobs_t* jobs, image_format_t format,
+    const void* blocks, uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps, uint32_t* out_pixels) {
+    assert(blocks && out_pixels && width > 0 && height > 0 && layers > 0);
+    assert(format == IMAGE_FORMAT_BC1 || format == IMAGE_FORMAT_BC3);
+
+    for_each_level(jobs, decode_level_job, false, format, blocks,
+        out_pixels, width, height, layers, num_mipmaps);
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+/**
+ * Block compression of RGBA8 images
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "viewer_image.h"
+#include "viewer_jobs.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * BC1 if all the pixels are opaque, so that they take half of the
+ * memory, and BC3 otherwise, keeping their alpha.
+ */
+image_format_t compress_pick_format(const uint32_t* pixels, size_t num_pixels);
+
+/**
+ * Whether an image of the given size can be compressed, which is when
+ * its top level is made of whole blocks, as some backends require.
+ */
+bool compress_can_compress(uint32_t width, uint32_t height);
+
+/**
+ * Compress 4x4 pixels, stored row after row, into an 8 bytes BC1 block.
+ * Endpoints are fitted along the principal axis of the pixel colours.
+ */
+void compress_block_bc1(const uint32_t* pixels, uint8_t* out_block);
+
+/**
+ * Compress 4x4 pixels into a 16 bytes BC3 block, the alpha block first.
+ */
+void compress_block_bc3(const uint32_t* pixels, uint8_t* out_block);
+
+/**
+ * Compress the first num_mipmaps levels of an RGBA8 image, each with
+ * all its layers, into out_blocks, which must hold image_mipmaps_size
+ * bytes. Levels are compressed one at a time, spreading layers and
+ * rows of blocks across the jobs, which can be NULL to run serially.
+ */
+void compress_image(jobs_t* jobs, image_format_t format,
+    const uint32_t* pixels, uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps, void* out_blocks);
+
+/**
+ * Decompress the first num_mipmaps levels of an image back into RGBA8,
+ * for backends which cannot sample its format. out_pixels must store
+ * image_mipmaps_pixels of them.
+ */
+void compress_decode_image(jobs_t* jobs, image_format_t format,
+    const void* blocks, uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps, uint32_t* out_pixels);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -1,9 +1,26 @@
+// file offsets are 64-bit, even on 32-bit platforms
+#ifndef _FILE_OFFSET_BITS
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "viewer_file.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
 
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 /* Size of each input chunk to be
    read and allocate for. */
 #ifndef  READALL_CHUNK
@@ -74,6 +91,130 @@ bool file_is_valid(file_t file) {
     return file.fd != NULL;
 }
 
+int64_t file_size(file_t file) {
+    FILE* fd = (FILE*)file.fd;
+    if (!fd) {
+        return -1;
+    }
+
+#if defined(_WIN32)
+    int64_t position = _ftelli64(fd);
+    if (position < 0 || _fseeki64(fd, 0, SEEK_END) != 0) {
+        return -1;
+    }
+
+    int64_t size = _ftelli64(fd);
+    _fseeki64(fd, position, SEEK_SET);
+#else
+    off_t position = ftello(fd);
+    if (position < 0 || fseeko(fd, 0, SEEK_END) != 0) {
+        return -1;
+    }
+
+    int64_t size = (int64_t)ftello(fd);
+    fseeko(fd, position, SEEK_SET);
+#endif
+
+    return size;
+}
+
+size_t file_read(file_t file, void* buffer, size_t size) {
+    if (!file.fd || !buffer) {
+        return 0;
+    }
+
+    return fread(buffer, 1, size, (FILE*)file.fd);
+}
+
+size_t file_write(file_t file, const void* buffer, size_t size) {
+    if (!file.fd || !buffer) {
+        return 0;
+    }
+
+    return fwrite(buffer, 1, size, (FILE*)file.fd);
+}
+
+bool file_map(const char* filename, file_map_t* out_map) {
+    if (!filename || !out_map) {
+        return false;
+    }
+
+    *out_map = (file_map_t){0};
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0
+        && (uint64_t)size.QuadPart <= SIZE_MAX) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+
+    // the mapping keeps the file open on its own
+    CloseHandle(file);
+    if (!mapping) {
+        return false;
+    }
+
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    *out_map = (file_map_t){
+        .data = data,
+        .size = (size_t)size.QuadPart,
+        .handle = mapping
+    };
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0
+        && (uint64_t)st.st_size <= SIZE_MAX) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    // the mapping keeps the file open on its own
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    *out_map = (file_map_t){
+        .data = data,
+        .size = (size_t)st.st_size
+    };
+#endif
+
+    return true;
+}
+
+void file_unmap(file_map_t* map) {
+    if (!map || !map->data) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(map->data);
+    CloseHandle((HANDLE)map->handle);
+#else
+    munmap((void*)map->data, map->size);
+#endif
+
+    *map = (file_map_t){0};
+}
+
 int32_t file_readall(file_t file, char **dataptr, size_t *sizeptr,
     memory_allocator_t allocator) {
     char  *data = NULL, *temp;
@@ -93,7 +234,9 @@ int32_t file_readall(file_t file, char **dataptr, size_t *sizeptr,
 
     while (1) {
         if (used + READALL_CHUNK + 1 > size) {
-            size = used + READALL_CHUNK + 1;
+            // grow geometrically, multi gigabyte files would
+            // otherwise be copied over and over again
+            size = used + (used > READALL_CHUNK ? used : READALL_CHUNK) + 1;
 
             /* Overflow check. Some ANSI C compilers
                may optimize this away, though. */
@@ -110,7 +253,7 @@ int32_t file_readall(file_t file, char **dataptr, size_t *sizeptr,
             data = temp;
         }
 
-        n = fread(data + used, 1, READALL_CHUNK, in);
+        n = fread(data + used, 1, size - used - 1, in);
         if (n == 0)
             break;
 
@@ -29,6 +29,13 @@ typedef struct {
     void* fd;
 } file_t;
 
+// read only view of a whole file, paged in as it is accessed
+typedef struct {
+    const void* data;
+    size_t size;
+    void* handle;
+} file_map_t;
+
 /**
  * Returns whether or not the filename points to an existing file.
  */
@@ -51,6 +58,40 @@ void file_close(file_t file);
  */
 bool file_is_valid(file_t file);
 
+/**
+ * Returns the size of the file in bytes, which can exceed 4GB even on
+ * 32-bit platforms, or -1 if it cannot be told. The position is kept.
+ */
+int64_t file_size(file_t file);
+
+/**
+ * Read up to size bytes into the buffer, from the current position.
+ * 
+ * @return number of bytes read, fewer than size only at the end
+ * of the file, or in case of error.
+ */
+size_t file_read(file_t file, void* buffer, size_t size);
+
+/**
+ * Write size bytes from the buffer, at the current position.
+ * 
+ * @return number of bytes written, fewer than size only in case of error.
+ */
+size_t file_write(file_t file, const void* buffer, size_t size);
+
+/**
+ * Map the whole file into memory, read only, so that its content is
+ * never copied, nor held in memory more than the system wants to.
+ * 
+ * @return false if the file cannot be mapped, or it is empty.
+ */
+bool file_map(const char* filename, file_map_t* out_map);
+
+/**
+ * Unmap the file, whose content must not be referred to anymore.
+ */
+void file_unmap(file_map_t* map);
+
 /**
  * This function returns one of the FILE_READALL_ constant.
  * If the return value is zero == READALL_OK, then:
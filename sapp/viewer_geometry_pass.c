@@ -1,15 +1,33 @@
 #include "viewer_geometry_pass.h"
+#include "viewer_memory.h"
+#include "viewer_image.h"
+#include "viewer_compress.h"
+#include "viewer_simplify.h"
 #include "viewer_log.h"
 #include "shaders/geometry_pass.glsl.h"
 
 #include <stddef.h>
 #include <assert.h>
+#include <float.h>  // FLT_MAX
+#include <stdlib.h> // qsort
 #include <string.h> // memcmp
 
 #define BUFFER_INDEX_VERTEX 0
 #define BUFFER_INDEX_INSTANCE 1
 #define RASTERIZER_MSAA_SAMPLES 1
 
+// pipelines come in pairs, 32-bit indices first, followed by the
+// 16-bit variant, which uses the same shader, therefore:
+// pipeline index = vertex layout pipeline + index type offset
+#define PIPELINE_INDEX_FLOAT 0
+#define PIPELINE_INDEX_COMPACT 2
+#define PIPELINE_OFFSET_UINT16 1
+
+// point clouds have a render pass of their own
+#define PIPELINE_INDEX_POINTS 0
+
+#define MAX_UINT16_VERTICES (UINT16_MAX + 1)
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -45,425 +63,2738 @@ static bool model_is_empty(const model_t* model) {
     return memcmp(model, &empty_model, sizeof(model_t)) == 0;
 }
 
-mesh_id_t geometry_pass_make_mesh(geometry_pass_t* pass, 
-    const mesh_desc_t* mesh_desc) {
-    assert(pass && mesh_desc);
-    assert(mesh_desc->vertices && mesh_desc->num_vertices > 0);
-    assert(mesh_desc->indices && mesh_desc->num_indices > 0);
+// each model owns a fixed block of draw calls
+static draw_call_t* model_draws(geometry_pass_t* pass, model_id_t model) {
+    assert(handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS));
+    return &pass->render.draws[model.id * GEOMETRY_PASS_MAX_MODEL_DRAWS];
+}
+
+static int16_t quantise_snorm16(mfloat_t value) {
+    value = (value < -1.f) ? -1.f : ((value > 1.f) ? 1.f : value);
+    return (int16_t)(value * 32767.f + ((value >= 0.f) ? .5f : -.5f));
+}
+
+// normalise the value within [center-extent, center+extent]
+static int16_t quantise_range(mfloat_t value,
+    mfloat_t center, mfloat_t extent) {
+    return (extent > 0.f)
+        ? quantise_snorm16((value - center) / extent)
+        : 0;
+}
+
+// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+static void encode_octahedral(vec3f_t normal, int16_t out[2]) {
+    mfloat_t l1_norm = MFABS(normal.x) + MFABS(normal.y) + MFABS(normal.z);
+
+    // zero normals, i.e. not computed yet, are encoded as +z
+    mfloat_t x = (l1_norm > 0.f) ? normal.x / l1_norm : 0.f;
+    mfloat_t y = (l1_norm > 0.f) ? normal.y / l1_norm : 0.f;
+
+    // fold the lower hemisphere over the diagonals
+    if (normal.z < 0.f) {
+        mfloat_t folded_x = (1.f - MFABS(y)) * ((x >= 0.f) ? 1.f : -1.f);
+        mfloat_t folded_y = (1.f - MFABS(x)) * ((y >= 0.f) ? 1.f : -1.f);
+        x = folded_x;
+        y = folded_y;
+    }
+
+    out[0] = quantise_snorm16(x);
+    out[1] = quantise_snorm16(y);
+}
+
+// compute positions bounding box and sphere, and uvs range of the
+// vertices. the sphere is centered on the box, which is not the
+// smallest one, but is tight enough to be culled with.
+static void compute_vertices_bounds(const vertex_t* vertices,
+    uint32_t num_vertices, box_t* bbox, sphere_t* bsphere,
+    aabb_t* uv_bounds) {
+    assert(vertices && num_vertices > 0 && bbox && bsphere && uv_bounds);
+
+    vec3f_t pos_min = vertices[0].pos;
+    vec3f_t pos_max = vertices[0].pos;
+    aabb_t uv = {.min = vertices[0].uv, .max = vertices[0].uv};
+
+    for (uint32_t v = 1; v < num_vertices; ++v) {
+        const vertex_t* vertex = &vertices[v];
+        for (int32_t c = 0; c < 3; ++c) {
+            if (vertex->pos.v[c] < pos_min.v[c]) pos_min.v[c] = vertex->pos.v[c];
+            if (vertex->pos.v[c] > pos_max.v[c]) pos_max.v[c] = vertex->pos.v[c];
+        }
+
+        for (int32_t c = 0; c < 2; ++c) {
+            if (vertex->uv.v[c] < uv.min.v[c]) uv.min.v[c] = vertex->uv.v[c];
+            if (vertex->uv.v[c] > uv.max.v[c]) uv.max.v[c] = vertex->uv.v[c];
+        }
+    }
+
+    *bbox = (box_t){
+        .center = svec3_multiply_f(svec3_add(pos_min, pos_max), .5f),
+        .extents = svec3_multiply_f(svec3_subtract(pos_max, pos_min), .5f)
+    };
+
+    mfloat_t max_distance_squared = 0.f;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        mfloat_t distance_squared = svec3_distance_squared(
+            vertices[v].pos, bbox->center);
+        if (distance_squared > max_distance_squared) {
+            max_distance_squared = distance_squared;
+        }
+    }
+
+    *bsphere = (sphere_t){
+        .center = bbox->center,
+        .radius = MSQRT(max_distance_squared)
+    };
+
+    *uv_bounds = uv;
+}
+
+// allocate and fill an array of quantised vertices, the
+// returned array must be released with memory_free.
+static vertex_compact_t* quantise_vertices(const vertex_t* vertices,
+    uint32_t num_vertices, const box_t* bbox, const aabb_t* uv_bounds,
+    vertex_dequant_t* dequant) {
     
-    mesh_id_t mesh_id = {
-        .id = HANDLE_INVALID_ID
+    vertex_compact_t* compact_vertices =
+        memory_malloc(sizeof(vertex_compact_t) * num_vertices);
+    if (!compact_vertices) {
+        return NULL;
+    }
+
+    vec2f_t uv_center = {
+        .x = (uv_bounds->max.x + uv_bounds->min.x) * .5f,
+        .y = (uv_bounds->max.y + uv_bounds->min.y) * .5f
     };
 
-    // search for an empty slot
-    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MESHES; ++i) {
+    vec2f_t uv_extents = {
+        .x = (uv_bounds->max.x - uv_bounds->min.x) * .5f,
+        .y = (uv_bounds->max.y - uv_bounds->min.y) * .5f
+    };
 
-        // if we find an empty slot, store the index and break the loop
-        if (mesh_is_empty(&pass->meshes[i])) {
-            mesh_id.id = i;
-            break;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        const vertex_t* src = &vertices[v];
+        vertex_compact_t* dst = &compact_vertices[v];
+
+        for (int32_t c = 0; c < 3; ++c) {
+            dst->pos[c] = quantise_range(src->pos.v[c],
+                bbox->center.v[c], bbox->extents.v[c]);
+        }
+
+        dst->pos[3] = 0;
+        encode_octahedral(src->norm, dst->norm);
+
+        for (int32_t c = 0; c < 2; ++c) {
+            dst->uv[c] = quantise_range(src->uv.v[c],
+                uv_center.v[c], uv_extents.v[c]);
         }
     }
 
-    // no free slot found
-    if (mesh_id.id == HANDLE_INVALID_ID) {
-        return mesh_id;
+    *dequant = (vertex_dequant_t){
+        .pos_scale = svec4(bbox->extents.x,
+            bbox->extents.y, bbox->extents.z, 0.f),
+        .pos_offset = svec4(bbox->center.x,
+            bbox->center.y, bbox->center.z, 0.f),
+        .uv_scale_pan = svec4(uv_extents.x, uv_extents.y,
+            uv_center.x, uv_center.y)
+    };
+
+    return compact_vertices;
+}
+
+typedef struct {
+    sg_index_type index_type;
+    void* indices;              // index buffer content, always allocated
+    uint8_t* vertices;          // allocated only if vertices were split
+    uint32_t num_vertices;
+    mesh_range_t ranges[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_ranges;
+} mesh_split_t;
+
+static void mesh_split_release(mesh_split_t* split) {
+    if (split->indices) {
+        memory_free(split->indices);
+    }
+
+    if (split->vertices) {
+        memory_free(split->vertices);
+    }
+
+    memset(split, 0, sizeof(mesh_split_t));
+}
+
+// the whole mesh can be addressed by 16-bit indices,
+// so, there is exactly one range for each submesh.
+static bool split_mesh_uint16(uint32_t num_vertices,
+    const uint32_t* indices, uint32_t num_indices,
+    const mesh_submesh_desc_t* submeshes, uint32_t num_submeshes,
+    mesh_split_t* split) {
+    assert(num_vertices <= MAX_UINT16_VERTICES);
+    assert(num_submeshes <= GEOMETRY_PASS_MAX_MESH_RANGES);
+
+    uint16_t* indices16 = memory_malloc(sizeof(uint16_t) * num_indices);
+    if (!indices16) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        indices16[i] = (uint16_t)indices[i];
     }
 
-    uint32_t indices_array_size = sizeof(uint32_t) * mesh_desc->num_indices;
+    split->index_type = SG_INDEXTYPE_UINT16;
+    split->indices = indices16;
+    split->num_vertices = num_vertices;
+
+    for (uint32_t s = 0; s < num_submeshes; ++s) {
+        split->ranges[s] = (mesh_range_t){
+            .base_element = (int32_t)submeshes[s].base_element,
+            .num_elements = (int32_t)submeshes[s].num_elements,
+            .vertex_buffer_offset = 0,
+            .submesh = (int32_t)s
+        };
+    }
+
+    split->num_ranges = num_submeshes;
+    return true;
+}
+
+// greedily partition the triangles into ranges, each referencing
+// at most 64k vertices. vertices are duplicated into a contiguous
+// block per range, which 16-bit indices address from its start.
+// ranges never cross submeshes boundaries.
+static bool split_mesh_ranges(const uint8_t* vertices, uint32_t vertex_size,
+    uint32_t num_vertices, const uint32_t* indices, uint32_t num_indices,
+    const mesh_submesh_desc_t* submeshes, uint32_t num_submeshes,
+    mesh_split_t* split) {
+
+    // last range each source vertex has been assigned to,
+    // and its index relative to the beginning of that range.
+    int32_t* vertex_range = memory_malloc(sizeof(int32_t) * num_vertices);
+    uint16_t* vertex_local = memory_malloc(sizeof(uint16_t) * num_vertices);
+    uint16_t* indices16 = memory_malloc(sizeof(uint16_t) * num_indices);
+
+    // ranges duplicate only their boundary vertices,
+    // therefore, a little extra storage is usually enough
+    uint32_t capacity = num_vertices + num_vertices / 8;
+    uint8_t* out_vertices = memory_malloc(capacity * vertex_size);
+
+    bool succeeded = vertex_range && vertex_local && indices16 && out_vertices;
+    if (succeeded) {
+        memset(vertex_range, 0xFF, sizeof(int32_t) * num_vertices);
+    }
+
+    int32_t range = -1;
+    uint32_t range_vertices = 0;
+    uint32_t out_num_vertices = 0;
+
+    for (uint32_t s = 0; succeeded && s < num_submeshes; ++s) {
+        const mesh_submesh_desc_t* submesh = &submeshes[s];
+        assert(submesh->num_elements % 3 == 0);
+
+        uint32_t end_element = submesh->base_element + submesh->num_elements;
+        for (uint32_t t = submesh->base_element; t < end_element; t += 3) {
+            
+            // count the vertices this triangle would add to the range
+            uint32_t new_vertices = 0;
+            for (uint32_t k = 0; k < 3; ++k) {
+                new_vertices += (vertex_range[indices[t + k]] != range) ? 1 : 0;
+            }
+
+            // open a new range at the beginning of each
+            // submesh, or when the current one is full
+            if (t == submesh->base_element
+                || range_vertices + new_vertices > MAX_UINT16_VERTICES) {
+                if (range + 1 >= GEOMETRY_PASS_MAX_MESH_RANGES) {
+                    succeeded = false;
+                    break;
+                }
+
+                // close the current range
+                if (range >= 0) {
+                    split->ranges[range].num_elements =
+                        (int32_t)t - split->ranges[range].base_element;
+                }
+
+                ++range;
+                split->ranges[range] = (mesh_range_t){
+                    .base_element = (int32_t)t,
+                    .vertex_buffer_offset = (int32_t)(out_num_vertices * vertex_size),
+                    .submesh = (int32_t)s
+                };
+
+                range_vertices = 0;
+            }
+
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[t + k];
+
+                // first time the vertex is referenced by this range
+                if (vertex_range[v] != range) {
+                    if (out_num_vertices == capacity) {
+                        capacity += capacity / 2;
+                        uint8_t* grown = memory_realloc(out_vertices,
+                            capacity * vertex_size);
+                        if (!grown) {
+                            succeeded = false;
+                            break;
+                        }
+
+                        out_vertices = grown;
+                    }
+
+                    memcpy(out_vertices + out_num_vertices * vertex_size,
+                        vertices + v * vertex_size, vertex_size);
+                    
+                    vertex_range[v] = range;
+                    vertex_local[v] = (uint16_t)range_vertices;
+                    ++range_vertices;
+                    ++out_num_vertices;
+                }
+
+                indices16[t + k] = vertex_local[v];
+            }
+
+            if (!succeeded) {
+                break;
+            }
+        }
+
+        // close the last range of the submesh
+        if (succeeded && range >= 0) {
+            split->ranges[range].num_elements =
+                (int32_t)end_element - split->ranges[range].base_element;
+        }
+    }
+
+    if (succeeded) {
+        split->index_type = SG_INDEXTYPE_UINT16;
+        split->indices = indices16;
+        split->vertices = out_vertices;
+        split->num_vertices = out_num_vertices;
+        split->num_ranges = range + 1;
+    }
+    else {
+        if (indices16) memory_free(indices16);
+        if (out_vertices) memory_free(out_vertices);
+    }
+
+    if (vertex_range) memory_free(vertex_range);
+    if (vertex_local) memory_free(vertex_local);
+    return succeeded;
+}
+
+// the mesh is drawn with 32-bit indices, one range per submesh
+static bool split_mesh_uint32(uint32_t num_vertices,
+    const uint32_t* indices, uint32_t num_indices,
+    const mesh_submesh_desc_t* submeshes, uint32_t num_submeshes,
+    mesh_split_t* split) {
+    assert(num_submeshes <= GEOMETRY_PASS_MAX_MESH_RANGES);
     
-    // create temporary buffer traces labels
-    trace_t vb_trace;
-    trace_printf(&vb_trace, "%s-%s", mesh_desc->label, "vertex-buffer");
+    uint32_t* indices32 = memory_malloc(sizeof(uint32_t) * num_indices);
+    if (!indices32) {
+        return false;
+    }
 
-    trace_t ib_trace;
-    trace_printf(&ib_trace, "%s-%s", mesh_desc->label, "index-buffer");
+    memcpy(indices32, indices, sizeof(uint32_t) * num_indices);
 
-    mesh_t mesh = {
-        .vbuf = sg_make_buffer(&(sg_buffer_desc){
-            .size = sizeof(vertex_t) * mesh_desc->num_vertices,
-            .content = mesh_desc->vertices,
-            .label = vb_trace.name
-        }),
+    split->index_type = SG_INDEXTYPE_UINT32;
+    split->indices = indices32;
+    split->num_vertices = num_vertices;
 
-        .ibuf = sg_make_buffer(&(sg_buffer_desc){
-            .type = SG_BUFFERTYPE_INDEXBUFFER,
-            .size = indices_array_size,
-            .content = mesh_desc->indices,
-            .label = ib_trace.name
-        }),
+    for (uint32_t s = 0; s < num_submeshes; ++s) {
+        split->ranges[s] = (mesh_range_t){
+            .base_element = (int32_t)submeshes[s].base_element,
+            .num_elements = (int32_t)submeshes[s].num_elements,
+            .vertex_buffer_offset = 0,
+            .submesh = (int32_t)s
+        };
+    }
 
-        .num_elements = indices_array_size / sizeof(uint32_t)
-    };
+    split->num_ranges = num_submeshes;
+    return true;
+}
 
-    trace_printf(&mesh.trace, "%s", mesh_desc->label);
+static bool split_mesh(const uint8_t* vertices, uint32_t vertex_size,
+    uint32_t num_vertices, const uint32_t* indices, uint32_t num_indices,
+    const mesh_submesh_desc_t* submeshes, uint32_t num_submeshes,
+    bool unsplit, mesh_split_t* split) {
+    memset(split, 0, sizeof(mesh_split_t));
 
-    pass->meshes[mesh_id.id] = mesh;
-    return mesh_id;
+    // small enough to be indexed by 16-bit indices as is
+    if (num_vertices <= MAX_UINT16_VERTICES) {
+        return split_mesh_uint16(num_vertices, indices, num_indices,
+            submeshes, num_submeshes, split);
+    }
+
+    // meshes whose ranges are counted by the caller
+    if (unsplit) {
+        return split_mesh_uint32(num_vertices, indices, num_indices,
+            submeshes, num_submeshes, split);
+    }
+
+    // too big meshes, which would need more ranges than those
+    // available, fall back to 32-bit indices without splitting.
+    return split_mesh_ranges(vertices, vertex_size, num_vertices,
+            indices, num_indices, submeshes, num_submeshes, split)
+        || split_mesh_uint32(num_vertices, indices, num_indices,
+            submeshes, num_submeshes, split);
 }
 
-mesh_id_t geometry_pass_make_mesh_box(geometry_pass_t* pass,
-    const mesh_box_desc_t* box) {
-    assert(pass && box);
+// coarser levels of detail of the submeshes, generated one
+// from another, each submesh simplified by a different job.
+typedef struct {
+    const mesh_desc_t* desc;
+    const mesh_submesh_desc_t* submeshes;
+    uint32_t num_submeshes;
+    uint32_t num_lods;
+    uint32_t* indices[GEOMETRY_PASS_MAX_LODS][GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_indices[GEOMETRY_PASS_MAX_LODS][GEOMETRY_PASS_MAX_MESH_RANGES];
+} mesh_lods_t;
+
+static void simplify_submesh_job(void* user_data, uint32_t s) {
+    mesh_lods_t* lods = (mesh_lods_t*)user_data;
+    const mesh_desc_t* desc = lods->desc;
+
+    const uint32_t* indices = desc->indices + lods->submeshes[s].base_element;
+    uint32_t num_indices = lods->submeshes[s].num_elements;
+
+    for (uint32_t l = 1; l < lods->num_lods; ++l) {
+        uint32_t* lod_indices = memory_malloc(sizeof(uint32_t) * num_indices);
+        if (!lod_indices) {
+            break;
+        }
 
-    mfloat_t hw = box->width * .5f;
-    mfloat_t hh = box->height * .5f;
-    mfloat_t hl = box->length* .5f;
+        uint32_t target = 3 * (num_indices / 3 / GEOMETRY_PASS_LOD_REDUCTION);
+        num_indices = simplify_mesh(&desc->vertices[0].pos, sizeof(vertex_t),
+            desc->num_vertices, indices, num_indices, target, lod_indices);
 
-    vertex_t vertices[] = {
-        //       position             normal              uv      
-        { { -hw, -hh, -hl }, { 0.0, 0.0, -1.0 }, { 0.0f, 0.0f } },
-        { {  hw, -hh, -hl }, { 0.0, 0.0, -1.0 }, { 1.0f, 0.0f } },
-        { {  hw,  hh, -hl }, { 0.0, 0.0, -1.0 }, { 1.0f, 1.0f } },
-        { { -hw,  hh, -hl }, { 0.0, 0.0, -1.0 }, { 0.0f, 1.0f } },
+        lods->indices[l][s] = lod_indices;
+        lods->num_indices[l][s] = num_indices;
+        indices = lod_indices;
+    }
+}
 
-        { { -hw, -hh,  hl }, { 0.0, 0.0,  1.0 }, { 0.0f, 0.0f } },
-        { {  hw, -hh,  hl }, { 0.0, 0.0,  1.0 }, { 1.0f, 0.0f } },
-        { {  hw,  hh,  hl }, { 0.0, 0.0,  1.0 }, { 1.0f, 1.0f } },
-        { { -hw,  hh,  hl }, { 0.0, 0.0,  1.0 }, { 0.0f, 1.0f } },
-  
-        { { -hw, -hh, -hl }, { -1.0, 0.0, 0.0 }, { 0.0f, 0.0f } },
-        { { -hw,  hh, -hl }, { -1.0, 0.0, 0.0 }, { 1.0f, 0.0f } },
-        { { -hw,  hh,  hl }, { -1.0, 0.0, 0.0 }, { 1.0f, 1.0f } },
-        { { -hw, -hh,  hl }, { -1.0, 0.0, 0.0 }, { 0.0f, 1.0f } },
-  
-        { {  hw, -hh, -hl, }, { 1.0, 0.0, 0.0 }, { 0.0f, 0.0f } },
-        { {  hw,  hh, -hl, }, { 1.0, 0.0, 0.0 }, { 1.0f, 0.0f } },
-        { {  hw,  hh,  hl, }, { 1.0, 0.0, 0.0 }, { 1.0f, 1.0f } },
-        { {  hw, -hh,  hl, }, { 1.0, 0.0, 0.0 }, { 0.0f, 1.0f } },
-  
-        { { -hw, -hh, -hl }, { 0.0, -1.0, 0.0 }, { 0.0f, 0.0f } },
-        { { -hw, -hh,  hl }, { 0.0, -1.0, 0.0 }, { 1.0f, 0.0f } },
-        { {  hw, -hh,  hl }, { 0.0, -1.0, 0.0 }, { 1.0f, 1.0f } },
-        { {  hw, -hh, -hl }, { 0.0, -1.0, 0.0 }, { 0.0f, 1.0f } },
-  
-        { { -hw,  hh, -hl }, { 0.0,  1.0, 0.0 }, { 0.0f, 0.0f } },
-        { { -hw,  hh,  hl }, { 0.0,  1.0, 0.0 }, { 1.0f, 0.0f } },
-        { {  hw,  hh,  hl }, { 0.0,  1.0, 0.0 }, { 1.0f, 1.0f } },
-        { {  hw,  hh, -hl }, { 0.0,  1.0, 0.0 }, { 0.0f, 1.0f } }
+static void mesh_lods_release(mesh_lods_t* lods) {
+    for (uint32_t l = 1; l < GEOMETRY_PASS_MAX_LODS; ++l) {
+        for (uint32_t s = 0; s < lods->num_submeshes; ++s) {
+            if (lods->indices[l][s]) {
+                memory_free(lods->indices[l][s]);
+            }
+        }
+    }
+
+    memset(lods, 0, sizeof(mesh_lods_t));
+}
+
+// append the levels of detail to the mesh indices, as further
+// submeshes, level after level. returns the number of levels,
+// 1 if none could be generated, in which case, the outputs are
+// left untouched, otherwise, they must be released.
+static uint32_t make_mesh_lods(jobs_t* jobs, const mesh_desc_t* desc,
+    const mesh_submesh_desc_t* submeshes, uint32_t num_submeshes,
+    uint32_t** out_indices, uint32_t* out_num_indices,
+    mesh_submesh_desc_t** out_submeshes) {
+
+    // all the levels of all the submeshes need their own range
+    uint32_t num_lods = desc->num_lods;
+    if (num_lods > GEOMETRY_PASS_MAX_LODS) {
+        num_lods = GEOMETRY_PASS_MAX_LODS;
+    }
+
+    if (num_lods * num_submeshes > GEOMETRY_PASS_MAX_MESH_RANGES) {
+        num_lods = GEOMETRY_PASS_MAX_MESH_RANGES / num_submeshes;
+    }
+
+    if (num_lods <= 1) {
+        return 1;
+    }
+
+    mesh_lods_t lods = {
+        .desc = desc,
+        .submeshes = submeshes,
+        .num_submeshes = num_submeshes,
+        .num_lods = num_lods
     };
-    
-    uint32_t indices[] = {
-        0, 2, 1,  0, 3, 2,
-        6, 4, 5,  7, 4, 6,
-        8, 10, 9,  8, 11, 10,
-        14, 12, 13,  15, 12, 14,
-        16, 18, 17,  16, 19, 18,
-        22, 20, 21,  23, 20, 22
+
+    jobs_parallel_for(jobs, simplify_submesh_job, &lods, num_submeshes);
+
+    // keep the levels as long as they save enough triangles
+    uint32_t total_indices = desc->num_indices;
+    uint32_t prev_indices = desc->num_indices;
+    for (uint32_t l = 1; l < num_lods; ++l) {
+        uint32_t lod_indices = 0;
+        bool complete = true;
+        for (uint32_t s = 0; s < num_submeshes; ++s) {
+            complete = complete && lods.indices[l][s];
+            lod_indices += lods.num_indices[l][s];
+        }
+
+        if (!complete || lod_indices * 5 > prev_indices * 4) {
+            num_lods = l;
+            break;
+        }
+
+        total_indices += lod_indices;
+        prev_indices = lod_indices;
+    }
+
+    uint32_t* indices = NULL;
+    mesh_submesh_desc_t* lod_submeshes = NULL;
+    if (num_lods > 1) {
+        indices = memory_malloc(sizeof(uint32_t) * total_indices);
+        lod_submeshes = memory_malloc(sizeof(mesh_submesh_desc_t)
+            * num_submeshes * num_lods);
+    }
+
+    if (!indices || !lod_submeshes) {
+        if (indices) memory_free(indices);
+        if (lod_submeshes) memory_free(lod_submeshes);
+        mesh_lods_release(&lods);
+        return 1;
+    }
+
+    memcpy(indices, desc->indices, sizeof(uint32_t) * desc->num_indices);
+    memcpy(lod_submeshes, submeshes, sizeof(mesh_submesh_desc_t) * num_submeshes);
+
+    uint32_t num_indices = desc->num_indices;
+    for (uint32_t l = 1; l < num_lods; ++l) {
+        for (uint32_t s = 0; s < num_submeshes; ++s) {
+            memcpy(indices + num_indices, lods.indices[l][s],
+                sizeof(uint32_t) * lods.num_indices[l][s]);
+
+            lod_submeshes[l * num_submeshes + s] = (mesh_submesh_desc_t){
+                .base_element = num_indices,
+                .num_elements = lods.num_indices[l][s]
+            };
+
+            num_indices += lods.num_indices[l][s];
+        }
+    }
+
+    assert(num_indices == total_indices);
+    mesh_lods_release(&lods);
+
+    *out_indices = indices;
+    *out_num_indices = num_indices;
+    *out_submeshes = lod_submeshes;
+    return num_lods;
+}
+// triangles adjacent to each vertex, and the progress of the partition
+typedef struct {
+    uint32_t* offsets;          // per vertex, first of its triangles
+    uint32_t* triangles;
+    int32_t* vertex_clusters;   // last cluster each vertex was added to
+    uint8_t* used;              // per triangle, already in a cluster
+} cluster_adjacency_t;
+
+static void cluster_adjacency_release(cluster_adjacency_t* adjacency) {
+    if (adjacency->offsets) memory_free(adjacency->offsets);
+    if (adjacency->triangles) memory_free(adjacency->triangles);
+    if (adjacency->vertex_clusters) memory_free(adjacency->vertex_clusters);
+    if (adjacency->used) memory_free(adjacency->used);
+    memset(adjacency, 0, sizeof(cluster_adjacency_t));
+}
+
+static bool cluster_adjacency_init(cluster_adjacency_t* adjacency,
+    uint32_t num_vertices, const uint32_t* indices, uint32_t num_indices) {
+    uint32_t num_triangles = num_indices / 3;
+    *adjacency = (cluster_adjacency_t){
+        .offsets = memory_calloc(num_vertices + 1, sizeof(uint32_t)),
+        .triangles = memory_malloc(sizeof(uint32_t) * num_triangles * 3),
+        .vertex_clusters = memory_malloc(sizeof(int32_t) * num_vertices),
+        .used = memory_calloc(num_triangles, sizeof(uint8_t))
     };
 
-    return geometry_pass_make_mesh(pass, &(mesh_desc_t) {
-        .vertices = vertices,
-        .num_vertices = 24,
-        .indices = indices,
-        .num_indices = 36,
-        .label = box->label
-    });
+    if (!adjacency->offsets || !adjacency->triangles
+        || !adjacency->vertex_clusters || !adjacency->used) {
+        cluster_adjacency_release(adjacency);
+        return false;
+    }
+
+    // counting sort of the triangles by vertex
+    for (uint32_t i = 0; i < num_triangles * 3; ++i) {
+        adjacency->offsets[indices[i] + 1]++;
+    }
+
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        adjacency->offsets[v + 1] += adjacency->offsets[v];
+        adjacency->vertex_clusters[v] = -1;
+    }
+
+    for (uint32_t i = 0; i < num_triangles * 3; ++i) {
+        adjacency->triangles[adjacency->offsets[indices[i]]++] = i / 3;
+    }
+
+    // filling has shifted each offset to the start of the next vertex
+    for (uint32_t v = num_vertices; v > 0; --v) {
+        adjacency->offsets[v] = adjacency->offsets[v - 1];
+    }
+
+    adjacency->offsets[0] = 0;
+    return true;
+}
+
+// vertices of the triangle, which are not part of the cluster yet
+static uint32_t cluster_new_vertices(const cluster_adjacency_t* adjacency,
+    const uint32_t* indices, uint32_t triangle, int32_t cluster) {
+    uint32_t count = 0;
+    for (uint32_t k = 0; k < 3; ++k) {
+        count += adjacency->vertex_clusters[indices[triangle * 3 + k]] != cluster;
+    }
+
+    return count;
+}
+
+// the unused triangle of [first, end), adjacent to the given one, which
+// adds the fewest vertices to the cluster, UINT32_MAX if there is none.
+static uint32_t cluster_best_neighbour(const cluster_adjacency_t* adjacency,
+    const uint32_t* indices, uint32_t triangle, uint32_t first, uint32_t end,
+    int32_t cluster, uint32_t max_new_vertices, uint32_t* out_new_vertices) {
+    uint32_t best = UINT32_MAX;
+    uint32_t best_new_vertices = max_new_vertices + 1;
+
+    for (uint32_t k = 0; k < 3 && best_new_vertices > 0; ++k) {
+        uint32_t v = indices[triangle * 3 + k];
+        for (uint32_t a = adjacency->offsets[v]; a < adjacency->offsets[v + 1]; ++a) {
+            uint32_t candidate = adjacency->triangles[a];
+            if (candidate < first || candidate >= end
+                || adjacency->used[candidate]) {
+                continue;
+            }
+
+            uint32_t new_vertices = cluster_new_vertices(
+                adjacency, indices, candidate, cluster);
+            if (new_vertices < best_new_vertices) {
+                best = candidate;
+                best_new_vertices = new_vertices;
+            }
+        }
+    }
+
+    *out_new_vertices = best_new_vertices;
+    return best;
+}
+
+// bounding sphere, and cone containing the triangles normals
+static void compute_cluster_bounds(const vertex_t* vertices,
+    const uint32_t* indices, const uint32_t* triangles,
+    uint32_t num_triangles, cluster_t* cluster) {
+    vec3f_t min_point = vertices[indices[triangles[0] * 3]].pos;
+    vec3f_t max_point = min_point;
+    vec3f_t axis = svec3_zero();
+
+    for (uint32_t t = 0; t < num_triangles; ++t) {
+        const uint32_t* tri = &indices[triangles[t] * 3];
+        vec3f_t p0 = vertices[tri[0]].pos;
+        vec3f_t p1 = vertices[tri[1]].pos;
+        vec3f_t p2 = vertices[tri[2]].pos;
+
+        min_point = svec3_min(min_point, svec3_min(p0, svec3_min(p1, p2)));
+        max_point = svec3_max(max_point, svec3_max(p0, svec3_max(p1, p2)));
+
+        // counter clockwise triangles face their normal
+        axis = svec3_add(axis, svec3_normalize(svec3_cross(
+            svec3_subtract(p1, p0), svec3_subtract(p2, p0))));
+    }
+
+    vec3f_t center = svec3_multiply_f(svec3_add(min_point, max_point), .5f);
+    mfloat_t radius = 0.f;
+    for (uint32_t t = 0; t < num_triangles; ++t) {
+        const uint32_t* tri = &indices[triangles[t] * 3];
+        for (uint32_t k = 0; k < 3; ++k) {
+            mfloat_t distance = svec3_distance(center, vertices[tri[k]].pos);
+            radius = (distance > radius) ? distance : radius;
+        }
+    }
+
+    // the cone spans the normals furthest from the average one,
+    // wider than 84 degrees, it can hardly ever be culled.
+    mfloat_t min_dot = -1.f;
+    mfloat_t axis_length = svec3_length(axis);
+    if (axis_length > 0.f) {
+        axis = svec3_divide_f(axis, axis_length);
+        min_dot = 1.f;
+        for (uint32_t t = 0; t < num_triangles; ++t) {
+            const uint32_t* tri = &indices[triangles[t] * 3];
+            vec3f_t p0 = vertices[tri[0]].pos;
+            vec3f_t normal = svec3_cross(
+                svec3_subtract(vertices[tri[1]].pos, p0),
+                svec3_subtract(vertices[tri[2]].pos, p0));
+            mfloat_t normal_length = svec3_length(normal);
+            if (normal_length > 0.f) {
+                mfloat_t d = svec3_dot(normal, axis) / normal_length;
+                min_dot = (d < min_dot) ? d : min_dot;
+            }
+        }
+    }
+
+    cluster->bounds = (sphere_t){
+        .center = center,
+        .radius = radius
+    };
+
+    cluster->cone_axis = axis;
+    cluster->cone_cutoff = (min_dot <= .1f)
+        ? 1.f : MSQRT(1.f - min_dot * min_dot);
+}
+
+// greedily grow clusters of adjacent triangles out of the range,
+// preferring those which add fewer vertices.
+// order receives the triangles of each cluster, one cluster after
+// another, while the clusters are appended to the growing table.
+static bool build_range_clusters(cluster_adjacency_t* adjacency,
+    const vertex_t* vertices, const uint32_t* indices,
+    const mesh_range_t* range, uint32_t* order,
+    cluster_t** clusters, uint32_t* num_clusters, uint32_t* capacity) {
+    uint32_t first = (uint32_t)range->base_element / 3;
+    uint32_t end = first + (uint32_t)range->num_elements / 3;
+    uint32_t num_ordered = 0;
+
+    for (uint32_t seed = first; seed < end; ++seed) {
+        if (adjacency->used[seed]) {
+            continue;
+        }
+
+        if (*num_clusters == *capacity) {
+            uint32_t new_capacity = (*capacity > 0) ? *capacity * 2 : 64;
+            cluster_t* new_clusters = memory_realloc(*clusters,
+                sizeof(cluster_t) * new_capacity);
+            if (!new_clusters) {
+                return false;
+            }
+
+            *clusters = new_clusters;
+            *capacity = new_capacity;
+        }
+
+        int32_t cluster = (int32_t)*num_clusters;
+        uint32_t cluster_begin = num_ordered;
+        uint32_t cluster_vertices = 0;
+        uint32_t frontier = cluster_begin;
+        uint32_t triangle = seed;
+
+        while (triangle != UINT32_MAX) {
+            adjacency->used[triangle] = 1;
+            order[num_ordered++] = triangle;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t v = indices[triangle * 3 + k];
+                if (adjacency->vertex_clusters[v] != cluster) {
+                    adjacency->vertex_clusters[v] = cluster;
+                    ++cluster_vertices;
+                }
+            }
+
+            if (num_ordered - cluster_begin == GEOMETRY_PASS_CLUSTER_MAX_TRIANGLES) {
+                break;
+            }
+
+            // continue from the last triangle, if it has no
+            // suitable neighbours, from the earlier ones
+            uint32_t max_new_vertices = (cluster_vertices < 
+                GEOMETRY_PASS_CLUSTER_MAX_VERTICES - 3)
+                ? 3 : GEOMETRY_PASS_CLUSTER_MAX_VERTICES - cluster_vertices;
+            uint32_t new_vertices = 0;
+            uint32_t next = cluster_best_neighbour(adjacency, indices,
+                triangle, first, end, cluster, max_new_vertices, &new_vertices);
+            
+            while (next == UINT32_MAX && frontier < num_ordered) {
+                next = cluster_best_neighbour(adjacency, indices,
+                    order[frontier], first, end, cluster,
+                    max_new_vertices, &new_vertices);
+                frontier += (next == UINT32_MAX);
+            }
+
+            triangle = next;
+        }
+
+        cluster_t* c = &(*clusters)[(*num_clusters)++];
+        c->base_element = (uint32_t)range->base_element + cluster_begin * 3;
+        c->num_elements = (num_ordered - cluster_begin) * 3;
+        compute_cluster_bounds(vertices, indices, &order[cluster_begin],
+            num_ordered - cluster_begin, c);
+    }
+
+    assert(num_ordered == end - first);
+    return true;
+}
+
+// partition each range of the mesh into clusters, and reorder the
+// range's triangles so that each cluster is contiguous. indices
+// are those the ranges have been split from, while split_indices
+// are the actual content of the index buffer, in the same order.
+static cluster_t* make_mesh_clusters(const mesh_desc_t* desc,
+    const uint32_t* indices, uint32_t num_indices,
+    void* split_indices, sg_index_type index_type,
+    mesh_range_t* ranges, uint32_t num_ranges, uint32_t* out_num_clusters) {
+    *out_num_clusters = 0;
+
+    cluster_adjacency_t adjacency;
+    if (!cluster_adjacency_init(&adjacency,
+        desc->num_vertices, indices, num_indices)) {
+        return NULL;
+    }
+
+    uint32_t capacity = 0;
+    uint32_t num_clusters = 0;
+    cluster_t* clusters = NULL;
+
+    uint32_t* order = memory_malloc(sizeof(uint32_t) * (num_indices / 3));
+    size_t index_size = (index_type == SG_INDEXTYPE_UINT16)
+        ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint8_t* range_indices = memory_malloc(index_size * num_indices);
+    bool failed = !order || !range_indices;
+
+    for (uint32_t r = 0; r < num_ranges && !failed; ++r) {
+        mesh_range_t* range = &ranges[r];
+        uint32_t num_triangles = (uint32_t)range->num_elements / 3;
+        if (range->base_element % 3 != 0 || range->num_elements % 3 != 0
+            || num_triangles == 0) {
+            continue;
+        }
+
+        uint32_t first_cluster = num_clusters;
+        if (!build_range_clusters(&adjacency, desc->vertices, indices,
+            range, order, &clusters, &num_clusters, &capacity)) {
+            failed = true;
+            break;
+        }
+
+        // move the triangles of the index buffer into cluster order
+        uint8_t* dst = (uint8_t*)split_indices + index_size * range->base_element;
+        uint32_t first = (uint32_t)range->base_element / 3;
+        memcpy(range_indices, dst, index_size * range->num_elements);
+        for (uint32_t t = 0; t < num_triangles; ++t) {
+            memcpy(dst + index_size * 3 * t,
+                range_indices + index_size * 3 * (order[t] - first),
+                index_size * 3);
+        }
+
+        range->first_cluster = first_cluster;
+        range->num_clusters = num_clusters - first_cluster;
+    }
+
+    if (order) memory_free(order);
+    if (range_indices) memory_free(range_indices);
+    cluster_adjacency_release(&adjacency);
+
+    if (failed || num_clusters == 0) {
+        if (clusters) memory_free(clusters);
+        for (uint32_t r = 0; r < num_ranges; ++r) {
+            ranges[r].first_cluster = 0;
+            ranges[r].num_clusters = 0;
+        }
+
+        return NULL;
+    }
+
+    // trim the table down to its actual size
+    cluster_t* trimmed = memory_realloc(clusters, sizeof(cluster_t) * num_clusters);
+    *out_num_clusters = num_clusters;
+    return trimmed ? trimmed : clusters;
+}
+
+bool geometry_pass_build_mesh(jobs_t* jobs, const mesh_desc_t* mesh_desc,
+    mesh_data_t* out_data) {
+    assert(mesh_desc && out_data);
+    assert(mesh_desc->vertices && mesh_desc->num_vertices > 0);
+    assert(mesh_desc->indices && mesh_desc->num_indices > 0);
+
+    memset(out_data, 0, sizeof(mesh_data_t));
+
+    box_t bbox;
+    sphere_t bsphere;
+    aabb_t uv_bounds;
+    compute_vertices_bounds(mesh_desc->vertices,
+        mesh_desc->num_vertices, &bbox, &bsphere, &uv_bounds);
+
+    // pick the vertex layout, big meshes are quantised,
+    // as for them memory and bandwidth are what matter.
+    // the array layer carried by the uvs can only be decoded by the
+    // compact vertex shader, which has per draw parameters.
+    vertex_layout_t layout = mesh_desc->uv_layers
+        ? VERTEX_LAYOUT_COMPACT : mesh_desc->layout;
+    if (layout == VERTEX_LAYOUT_DEFAULT) {
+        layout = (mesh_desc->num_vertices >= GEOMETRY_PASS_COMPACT_MIN_VERTICES)
+            ? VERTEX_LAYOUT_COMPACT
+            : VERTEX_LAYOUT_FLOAT;
+    }
+
+    const void* vertices = mesh_desc->vertices;
+    uint32_t vertex_size = sizeof(vertex_t);
+    
+    vertex_dequant_t dequant = {0};
+    vertex_compact_t* compact_vertices = NULL;
+    if (layout == VERTEX_LAYOUT_COMPACT) {
+        compact_vertices = quantise_vertices(mesh_desc->vertices,
+            mesh_desc->num_vertices, &bbox, &uv_bounds, &dequant);
+        
+        // fall back to full precision vertices if out of memory
+        if (compact_vertices) {
+            vertices = compact_vertices;
+            vertex_size = sizeof(vertex_compact_t);
+            dequant.pos_scale.w = mesh_desc->uv_layers ? 1.f : 0.f;
+        }
+        else if (mesh_desc->uv_layers) {
+            LOG_WARN("WARN: Not enough memory to create mesh (%s)\n",
+                mesh_desc->label);
+            return false;
+        }
+        else {
+            layout = VERTEX_LAYOUT_FLOAT;
+        }
+    }
+
+    // without submeshes, the whole mesh is a single submesh
+    const mesh_submesh_desc_t whole_mesh = {
+        .base_element = 0,
+        .num_elements = mesh_desc->num_indices
+    };
+
+    const mesh_submesh_desc_t* submeshes = &whole_mesh;
+    uint32_t num_submeshes = 1;
+    if (mesh_desc->submeshes && mesh_desc->num_submeshes > 0) {
+        if (mesh_desc->num_submeshes <= GEOMETRY_PASS_MAX_MESH_RANGES) {
+            submeshes = mesh_desc->submeshes;
+            num_submeshes = mesh_desc->num_submeshes;
+        }
+        else {
+            LOG_WARN("WARN: Too many submeshes (%d) for mesh (%s);"
+                " it will be drawn as a whole\n",
+                mesh_desc->num_submeshes, mesh_desc->label);
+        }
+    }
+
+    // levels of detail are further submeshes, appended to the indices
+    const uint32_t* indices = mesh_desc->indices;
+    uint32_t num_indices = mesh_desc->num_indices;
+    uint32_t* lod_indices = NULL;
+    mesh_submesh_desc_t* lod_submeshes = NULL;
+    uint32_t num_lods = make_mesh_lods(jobs, mesh_desc,
+        submeshes, num_submeshes, &lod_indices, &num_indices, &lod_submeshes);
+    if (num_lods > 1) {
+        indices = lod_indices;
+        submeshes = lod_submeshes;
+    }
+
+    // use 16-bit indices whenever possible,
+    // splitting the mesh into ranges if needed
+    mesh_split_t split;
+    bool is_split = split_mesh(vertices, vertex_size, mesh_desc->num_vertices,
+        indices, num_indices, submeshes, num_submeshes * num_lods,
+        mesh_desc->unsplit, &split);
+
+    if (lod_submeshes) {
+        memory_free(lod_submeshes);
+    }
+
+    if (!is_split) {
+        LOG_WARN("WARN: Not enough memory to create mesh (%s)\n",
+            mesh_desc->label);
+        
+        if (compact_vertices) {
+            memory_free(compact_vertices);
+        }
+
+        if (lod_indices) {
+            memory_free(lod_indices);
+        }
+
+        return false;
+    }
+
+    // the split vertices replace the compact ones, if any
+    void* owned_vertices = compact_vertices;
+    if (split.vertices) {
+        vertices = split.vertices;
+        owned_vertices = split.vertices;
+        if (compact_vertices) {
+            memory_free(compact_vertices);
+        }
+    }
+
+    uint32_t vertices_array_size = vertex_size * split.num_vertices;
+    uint32_t indices_array_size = num_indices *
+        ((split.index_type == SG_INDEXTYPE_UINT16)
+            ? sizeof(uint16_t) : sizeof(uint32_t));
+
+    // big meshes are partitioned into clusters, whose visible
+    // indices are compacted into a copy of the index buffer
+    uint32_t num_clusters = 0;
+    cluster_t* clusters = NULL;
+    void* cull_indices = NULL;
+    if (mesh_desc->num_indices / 3 >= GEOMETRY_PASS_CLUSTER_MIN_TRIANGLES) {
+        clusters = make_mesh_clusters(mesh_desc, indices, num_indices,
+            split.indices, split.index_type, split.ranges, split.num_ranges,
+            &num_clusters);
+        cull_indices = clusters ? memory_malloc(indices_array_size) : NULL;
+
+        if (clusters && !cull_indices) {
+            LOG_WARN("WARN: Not enough memory to cull the clusters"
+                " of mesh (%s)\n", mesh_desc->label);
+            memory_free(clusters);
+            clusters = NULL;
+            num_clusters = 0;
+            for (uint32_t r = 0; r < split.num_ranges; ++r) {
+                split.ranges[r].num_clusters = 0;
+            }
+        }
+    }
+    
+    mesh_t mesh = {
+        .num_elements = mesh_desc->num_indices,
+        .index_type = split.index_type,
+        .num_ranges = split.num_ranges,
+        .num_lods = num_lods,
+        .layout = layout,
+        .dequant = dequant,
+        .bbox = bbox,
+        .bsphere = bsphere,
+        .clusters = clusters,
+        .num_clusters = num_clusters,
+        .cull_indices = cull_indices,
+        .cull_model = {.id = HANDLE_INVALID_ID}
+    };
+
+    memcpy(mesh.ranges, split.ranges, sizeof(split.ranges));
+
+    // ranges bounds, to cull them independently, and the
+    // level of detail of the submesh they have been split from
+    for (uint32_t r = 0; r < mesh.num_ranges; ++r) {
+        mesh_range_t* range = &mesh.ranges[r];
+        range->bbox = box_from_indexed_points(
+            &mesh_desc->vertices[0].pos, sizeof(vertex_t),
+            indices + range->base_element,
+            (uint32_t)range->num_elements);
+        range->lod = range->submesh / (int32_t)num_submeshes;
+        range->submesh = range->submesh % (int32_t)num_submeshes;
+    }
+
+    if (lod_indices) {
+        memory_free(lod_indices);
+    }
+
+    trace_printf(&mesh.trace, "%s", mesh_desc->label);
+
+    *out_data = (mesh_data_t){
+        .mesh = mesh,
+        .vertices = vertices,
+        .vertices_size = vertices_array_size,
+        .indices = split.indices,
+        .indices_size = indices_array_size,
+        .owned_vertices = owned_vertices
+    };
+
+    return true;
+}
+
+void geometry_pass_release_mesh_data(mesh_data_t* data) {
+    assert(data);
+
+    if (data->mesh.clusters) {
+        memory_free(data->mesh.clusters);
+    }
+
+    if (data->mesh.cull_indices) {
+        memory_free(data->mesh.cull_indices);
+    }
+
+    if (data->indices) {
+        memory_free(data->indices);
+    }
+
+    if (data->owned_vertices) {
+        memory_free(data->owned_vertices);
+    }
+
+    memset(data, 0, sizeof(mesh_data_t));
+}
+
+mesh_id_t geometry_pass_upload_mesh(geometry_pass_t* pass, mesh_data_t* data) {
+    assert(pass && data && data->vertices && data->indices);
+
+    mesh_id_t mesh_id = {
+        .id = HANDLE_INVALID_ID
+    };
+
+    // search for an empty slot
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MESHES; ++i) {
+
+        // if we find an empty slot, store the index and break the loop
+        if (mesh_is_empty(&pass->meshes[i])) {
+            mesh_id.id = i;
+            break;
+        }
+    }
+
+    // no free slot found
+    if (mesh_id.id == HANDLE_INVALID_ID) {
+        geometry_pass_release_mesh_data(data);
+        return mesh_id;
+    }
+
+    mesh_t mesh = data->mesh;
+
+    // create temporary buffer traces labels
+    trace_t vb_trace;
+    trace_printf(&vb_trace, "%s-%s", mesh.trace.name, "vertex-buffer");
+
+    trace_t ib_trace;
+    trace_printf(&ib_trace, "%s-%s", mesh.trace.name, "index-buffer");
+
+    mesh.vbuf = sg_make_buffer(&(sg_buffer_desc){
+        .size = data->vertices_size,
+        .content = data->vertices,
+        .label = vb_trace.name
+    });
+
+    mesh.ibuf = sg_make_buffer(&(sg_buffer_desc){
+        .type = SG_BUFFERTYPE_INDEXBUFFER,
+        .size = data->indices_size,
+        .content = data->indices,
+        .label = ib_trace.name
+    });
+
+    // the index buffer content is kept, to copy the visible clusters from
+    if (mesh.clusters) {
+        trace_t cb_trace;
+        trace_printf(&cb_trace, "%s-%s", mesh.trace.name, "cull-index-buffer");
+
+        mesh.cull_ibuf = sg_make_buffer(&(sg_buffer_desc){
+            .type = SG_BUFFERTYPE_INDEXBUFFER,
+            .usage = SG_USAGE_STREAM,
+            .size = data->indices_size,
+            .label = cb_trace.name
+        });
+
+        mesh.indices = data->indices;
+        data->indices = NULL;
+    }
+
+    // vertices and indices have been uploaded already,
+    // while the mesh has taken over clusters and indices
+    data->mesh.clusters = NULL;
+    data->mesh.cull_indices = NULL;
+    geometry_pass_release_mesh_data(data);
+
+    pass->meshes[mesh_id.id] = mesh;
+    return mesh_id;
+}
+
+mesh_id_t geometry_pass_make_mesh(geometry_pass_t* pass, 
+    const mesh_desc_t* mesh_desc) {
+    assert(pass && mesh_desc);
+
+    mesh_data_t data;
+    if (!geometry_pass_build_mesh(pass->jobs, mesh_desc, &data)) {
+        return (mesh_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    return geometry_pass_upload_mesh(pass, &data);
+}
+
+mesh_id_t geometry_pass_make_mesh_box(geometry_pass_t* pass,
+    const mesh_box_desc_t* box) {
+    assert(pass && box);
+
+    mfloat_t hw = box->width * .5f;
+    mfloat_t hh = box->height * .5f;
+    mfloat_t hl = box->length* .5f;
+
+    vertex_t vertices[] = {
+        //       position             normal              uv      
+        { { -hw, -hh, -hl }, { 0.0, 0.0, -1.0 }, { 0.0f, 0.0f } },
+        { {  hw, -hh, -hl }, { 0.0, 0.0, -1.0 }, { 1.0f, 0.0f } },
+        { {  hw,  hh, -hl }, { 0.0, 0.0, -1.0 }, { 1.0f, 1.0f } },
+        { { -hw,  hh, -hl }, { 0.0, 0.0, -1.0 }, { 0.0f, 1.0f } },
+
+        { { -hw, -hh,  hl }, { 0.0, 0.0,  1.0 }, { 0.0f, 0.0f } },
+        { {  hw, -hh,  hl }, { 0.0, 0.0,  1.0 }, { 1.0f, 0.0f } },
+        { {  hw,  hh,  hl }, { 0.0, 0.0,  1.0 }, { 1.0f, 1.0f } },
+        { { -hw,  hh,  hl }, { 0.0, 0.0,  1.0 }, { 0.0f, 1.0f } },
+  
+        { { -hw, -hh, -hl }, { -1.0, 0.0, 0.0 }, { 0.0f, 0.0f } },
+        { { -hw,  hh, -hl }, { -1.0, 0.0, 0.0 }, { 1.0f, 0.0f } },
+        { { -hw,  hh,  hl }, { -1.0, 0.0, 0.0 }, { 1.0f, 1.0f } },
+        { { -hw, -hh,  hl }, { -1.0, 0.0, 0.0 }, { 0.0f, 1.0f } },
+  
+        { {  hw, -hh, -hl, }, { 1.0, 0.0, 0.0 }, { 0.0f, 0.0f } },
+        { {  hw,  hh, -hl, }, { 1.0, 0.0, 0.0 }, { 1.0f, 0.0f } },
+        { {  hw,  hh,  hl, }, { 1.0, 0.0, 0.0 }, { 1.0f, 1.0f } },
+        { {  hw, -hh,  hl, }, { 1.0, 0.0, 0.0 }, { 0.0f, 1.0f } },
+  
+        { { -hw, -hh, -hl }, { 0.0, -1.0, 0.0 }, { 0.0f, 0.0f } },
+        { { -hw, -hh,  hl }, { 0.0, -1.0, 0.0 }, { 1.0f, 0.0f } },
+        { {  hw, -hh,  hl }, { 0.0, -1.0, 0.0 }, { 1.0f, 1.0f } },
+        { {  hw, -hh, -hl }, { 0.0, -1.0, 0.0 }, { 0.0f, 1.0f } },
+  
+        { { -hw,  hh, -hl }, { 0.0,  1.0, 0.0 }, { 0.0f, 0.0f } },
+        { { -hw,  hh,  hl }, { 0.0,  1.0, 0.0 }, { 1.0f, 0.0f } },
+        { {  hw,  hh,  hl }, { 0.0,  1.0, 0.0 }, { 1.0f, 1.0f } },
+        { {  hw,  hh, -hl }, { 0.0,  1.0, 0.0 }, { 0.0f, 1.0f } }
+    };
+    
+    uint32_t indices[] = {
+        0, 2, 1,  0, 3, 2,
+        6, 4, 5,  7, 4, 6,
+        8, 10, 9,  8, 11, 10,
+        14, 12, 13,  15, 12, 14,
+        16, 18, 17,  16, 19, 18,
+        22, 20, 21,  23, 20, 22
+    };
+
+    return geometry_pass_make_mesh(pass, &(mesh_desc_t) {
+        .vertices = vertices,
+        .num_vertices = 24,
+        .indices = indices,
+        .num_indices = 36,
+        .layout = VERTEX_LAYOUT_FLOAT,
+        .label = box->label
+    });
+}
+
+void geometry_pass_destroy_mesh(geometry_pass_t* pass, mesh_id_t mesh) {
+    assert(pass);
+
+    // release buffers and mark the mesh slot free
+    if (handle_is_valid(mesh, GEOMETRY_PASS_MAX_MESHES)
+        && !mesh_is_empty(&pass->meshes[mesh.id])) {
+        mesh_t* mesh_ptr = &pass->meshes[mesh.id];
+        sg_destroy_buffer(mesh_ptr->vbuf);
+        sg_destroy_buffer(mesh_ptr->ibuf);
+
+        if (mesh_ptr->clusters) {
+            sg_destroy_buffer(mesh_ptr->cull_ibuf);
+            memory_free(mesh_ptr->clusters);
+            memory_free(mesh_ptr->indices);
+            memory_free(mesh_ptr->cull_indices);
+        }
+
+        pass->meshes[mesh.id] = empty_mesh;
+    }
+
+    // look up for the models, if any, which draw
+    // this mesh, appended ones too, and invalidate them.
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
+        model_t* model = &pass->models[i];
+        bool uses_mesh = model->mesh_id.id == mesh.id;
+        for (int32_t d = 0; d < model->num_draws && !uses_mesh; ++d) {
+            uses_mesh = model->draw_meshes[d].id == mesh.id;
+        }
+
+        if (uses_mesh) {
+            geometry_pass_destroy_model(pass, (model_id_t){.id=i});
+        }
+    }
+}
+
+static sg_pixel_format image_pixel_format(image_format_t format) {
+    switch (format) {
+        case IMAGE_FORMAT_BC1: return SG_PIXELFORMAT_BC1_RGBA;
+        case IMAGE_FORMAT_BC3: return SG_PIXELFORMAT_BC3_RGBA;
+        default: return SG_PIXELFORMAT_RGBA8;
+    }
+}
+
+static bool can_sample_format(image_format_t format) {
+    return sg_query_pixelformat(image_pixel_format(format)).sample;
+}
+
+// upload all the mip levels of the image, generating
+// them first, if only the top level of rgba8 pixels has been
+// provided, and compressing them, if the backend can sample them.
+static sg_image make_material_image(geometry_pass_t* pass,
+    const image_desc_t* image, const char* label) {
+    uint32_t width = image->width;
+    uint32_t height = image->height;
+    uint32_t layers = image->layers;
+    image_format_t format = image->format;
+
+    const void* data = image->pixels;
+    uint32_t* mipmaps = NULL;
+    void* blocks = NULL;
+
+    // levels past the ones the backend takes are left out,
+    // they follow the kept ones and are never read
+    uint32_t num_mipmaps = image->num_mipmaps;
+    if (num_mipmaps > SG_MAX_MIPMAPS) {
+        LOG_WARN("WARN: Too many mipmaps, keeping %d (%s)\n",
+            SG_MAX_MIPMAPS, label);
+        num_mipmaps = SG_MAX_MIPMAPS;
+    }
+
+    if (format != IMAGE_FORMAT_RGBA8 && !can_sample_format(format)) {
+        num_mipmaps = num_mipmaps > 1 ? num_mipmaps : 1;
+        mipmaps = memory_malloc(sizeof(uint32_t)
+            * image_mipmaps_pixels(width, height, layers, num_mipmaps));
+        if (!mipmaps) {
+            LOG_WARN("WARN: Not enough memory to decompress (%s)\n", label);
+            return (sg_image){.id = SG_INVALID_ID};
+        }
+
+        compress_decode_image(pass->jobs, format, image->pixels,
+            width, height, layers, num_mipmaps, mipmaps);
+        format = IMAGE_FORMAT_RGBA8;
+        data = mipmaps;
+    }
+    else if (num_mipmaps <= 1 && format == IMAGE_FORMAT_RGBA8) {
+        num_mipmaps = image_num_mipmaps(width, height);
+        mipmaps = (num_mipmaps > 1) ? memory_malloc(sizeof(uint32_t)
+            * image_mipmaps_pixels(width, height, layers, num_mipmaps)) : NULL;
+
+        if (mipmaps) {
+            memcpy(mipmaps, image->pixels,
+                sizeof(uint32_t) * width * height * layers);
+            image_generate_mipmaps(pass->jobs, mipmaps,
+                width, height, layers, num_mipmaps);
+            data = mipmaps;
+        }
+        else {
+            // without memory for them, go with level 0 only
+            num_mipmaps = 1;
+        }
+    }
+
+    // block compressed images sampled as they are keep
+    // their levels, or only the top one, if they have none
+    num_mipmaps = num_mipmaps > 0 ? num_mipmaps : 1;
+
+    // images which cannot be compressed, or sampled once
+    // compressed, and those without memory to, stay rgba8
+    if (pass->compress_images && format == IMAGE_FORMAT_RGBA8
+        && compress_can_compress(width, height)) {
+        image_format_t block_format = compress_pick_format(
+            (const uint32_t*)data, (size_t)width * height * layers);
+        blocks = can_sample_format(block_format) ? memory_malloc(
+            image_mipmaps_size(block_format, width, height,
+                layers, num_mipmaps)) : NULL;
+
+        if (blocks) {
+            compress_image(pass->jobs, block_format, (const uint32_t*)data,
+                width, height, layers, num_mipmaps, blocks);
+            format = block_format;
+            data = blocks;
+        }
+    }
+
+    sg_image_desc desc = {
+        .type = SG_IMAGETYPE_ARRAY,
+        .width = width,
+        .height = height,
+        .layers = layers,
+        .num_mipmaps = num_mipmaps,
+        .pixel_format = image_pixel_format(format),
+        .min_filter = (num_mipmaps > 1)
+            ? SG_FILTER_LINEAR_MIPMAP_LINEAR : SG_FILTER_NEAREST,
+        .label = label
+    };
+
+    // each level holds all of its layers
+    const uint8_t* level_data = (const uint8_t*)data;
+    for (uint32_t l = 0; l < num_mipmaps; ++l) {
+        size_t level_size = image_level_size(format, image_mip_size(width, l),
+            image_mip_size(height, l), layers);
+        desc.content.subimage[0][l] = (sg_subimage_content){
+            .ptr = level_data,
+            .size = (int)level_size
+        };
+
+        level_data += level_size;
+    }
+
+    sg_image result = sg_make_image(&desc);
+    if (mipmaps) {
+        memory_free(mipmaps);
+    }
+
+    if (blocks) {
+        memory_free(blocks);
+    }
+
+    return result;
+}
+
+material_id_t geometry_pass_make_material(geometry_pass_t* pass,
+    const material_desc_t* material_desc) {
+    assert(pass && material_desc);
+    assert(material_desc->albedo);
+    assert(material_desc->albedo->width > 0);
+    assert(material_desc->albedo->height > 0);
+    assert(material_desc->albedo->layers > 0);
+    assert(material_desc->emissive);
+    assert(material_desc->emissive->width > 0);
+    assert(material_desc->emissive->height > 0);
+    assert(material_desc->emissive->layers > 0);
+    
+    material_id_t mat_id = {
+        .id = HANDLE_INVALID_ID
+    };
+
+    // search for an empty slot
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MATERIALS; ++i) {
+        // if we find an empty slot, store the index and break the loop
+        if (material_is_empty(&pass->materials[i])) {
+            mat_id.id = i;
+            break;
+        }
+    }
+
+    // no free slot found
+    if (mat_id.id == HANDLE_INVALID_ID) {
+        return mat_id;
+    }
+
+    // create temporary trace for image label
+    trace_t im_albedo_trace;
+    trace_printf(&im_albedo_trace,
+        "%s-%s", material_desc->label, "image-at");
+
+    trace_t im_emissive_trace;
+    trace_printf(&im_emissive_trace,
+        "%s-%s", material_desc->label, "image-es");
+
+    // create graphics image resource
+    material_t mat = {
+        .albedo_transparency = make_material_image(pass,
+            material_desc->albedo, im_albedo_trace.name),
+        .emissive_specular = make_material_image(pass,
+            material_desc->emissive, im_emissive_trace.name)
+    };
+
+    // store the label into the material's trace name
+    trace_printf(&mat.trace, "%s", material_desc->label);
+
+    // assign the material to the free slot
+    pass->materials[mat_id.id] = mat;
+    return mat_id;
+}
+
+static material_id_t __geometry_pass_make_material_default(geometry_pass_t* pass) {
+    assert(pass);
+    static uint32_t color_alpha[4*4*4] = {
+        // checkboard
+        0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        // horizontal lines
+        0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+        0x00000000, 0x00000000, 0x00000000, 0x00000000,
+        0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
+        0x00000000, 0x00000000, 0x00000000, 0x00000000,
+        // vertical lines
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        // v-zag
+        0xFFFFFFFF, 0x00000000, 0x00000000, 0x00000000,
+        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
+        0x00000000, 0x00000000, 0xFFFFFFFF, 0x00000000,
+        0x00000000, 0x00000000, 0x00000000, 0x00000000,
+    };
+
+    static uint32_t emissive_specular[4*4*1] = {
+        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
+    };
+
+    return geometry_pass_make_material(pass, &(material_desc_t) {
+        .albedo = &(image_desc_t) {
+            .width = 4,
+            .height = 4,
+            .layers = 4,
+            .pixels = color_alpha
+        },
+        .emissive = &(image_desc_t) {
+            .width = 4,
+            .height = 4,
+            .layers = 1,
+            .pixels = emissive_specular
+        },
+        .label = "default-material"
+    });
+}
+
+material_id_t geometry_pass_get_default_material(geometry_pass_t* pass) {
+    assert(pass);
+
+    // if the following fails, check the
+    // geometry pass has been initialised
+    assert(!material_is_empty(&pass->materials[0]));
+    return(material_id_t){.id = 0};
+}
+
+void geometry_pass_destroy_material(geometry_pass_t* pass, material_id_t mat) {
+    assert(pass);
+    
+    // mark the material slot free
+    if (handle_is_valid(mat, GEOMETRY_PASS_MAX_MATERIALS)) {
+        pass->materials[mat.id] = empty_material;
+    }
+
+    // find the relative models to invalidate,
+    // including those drawing any submesh with it
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
+        model_t* model = &pass->models[i];
+        bool uses_material = model->material_id.id == mat.id;
+        for (int32_t d = 0; d < model->num_draws && !uses_material; ++d) {
+            uses_material = model->draw_materials[d].id == mat.id;
+        }
+
+        if (uses_material) {
+            geometry_pass_destroy_model(pass, (model_id_t){.id=i});
+        }
+    }
+}
+
+// append a draw call for each of the mesh ranges to the model,
+// all sharing the same instance buffer. returns false if the
+// model has not enough draw calls left for all the ranges.
+static bool model_add_mesh_draws(geometry_pass_t* pass, model_id_t model_id,
+    const model_desc_t* model_desc, sg_buffer instance_buffer) {
+    model_t* model = &pass->models[model_id.id];
+    const mesh_t* mesh = &pass->meshes[model_desc->mesh.id];
+    if (model->num_draws + (int32_t)mesh->num_ranges > GEOMETRY_PASS_MAX_MODEL_DRAWS) {
+        return false;
+    }
+
+    // quantised meshes need their own pipeline, and
+    // the parameters to restore vertices in mesh space
+    int32_t pipeline_index = PIPELINE_INDEX_FLOAT;
+    ubo_t vs_ubo = {0};
+    if (mesh->layout == VERTEX_LAYOUT_COMPACT) {
+        pipeline_index = PIPELINE_INDEX_COMPACT;
+        vs_ubo = (ubo_t){
+            .data = (const uint8_t*)&mesh->dequant,
+            .size = sizeof(vs_draw_params_t),
+            .index = SLOT_vs_draw_params
+        };
+    }
+
+    if (mesh->index_type == SG_INDEXTYPE_UINT16) {
+        pipeline_index += PIPELINE_OFFSET_UINT16;
+    }
+
+    // new draws have as many instances as the existing ones, all
+    // at the finest level, until levels are selected per instance
+    draw_call_t* draws = model_draws(pass, model_id);
+    int32_t num_instances = (model->num_draws > 0) ? draws[0].num_instances : 0;
+    model->bbox = (model->num_draws > 0)
+        ? box_merge(model->bbox, mesh->bbox) : mesh->bbox;
+    model->bsphere = (model->num_draws > 0)
+        ? sphere_merge(model->bsphere, mesh->bsphere) : mesh->bsphere;
+
+    for (uint32_t r = 0; r < mesh->num_ranges; ++r) {
+        const mesh_range_t* range = &mesh->ranges[r];
+        int32_t d = model->num_draws++;
+        draw_call_t* draw = &draws[d];
+
+        // ranges are drawn with their submesh's material, if any
+        material_id_t draw_material = model_desc->material;
+        if (model_desc->submesh_materials && range->submesh >= 0
+            && (uint32_t)range->submesh < model_desc->num_submesh_materials
+            && handle_is_valid(model_desc->submesh_materials[range->submesh],
+                GEOMETRY_PASS_MAX_MATERIALS)) {
+            draw_material = model_desc->submesh_materials[range->submesh];
+        }
+
+        const material_t* mat = &pass->materials[draw_material.id];
+        model->draw_materials[d] = draw_material;
+        model->draw_meshes[d] = model_desc->mesh;
+        model->draw_lods[d] = range->lod;
+        model->draw_ranges[d] = (int32_t)r;
+
+        draw->indices_offset = range->base_element;
+        draw->num_indices = range->num_elements;
+        draw->num_instances = (range->lod == 0) ? num_instances : 0;
+        draw->pipeline_index = pipeline_index;
+        draw->vs_ubo = vs_ubo;
+
+        // update draw bindings
+        draw->bindings.index_buffer = mesh->ibuf;
+        draw->bindings.vertex_buffers[BUFFER_INDEX_VERTEX] = mesh->vbuf;
+        draw->bindings.vertex_buffer_offsets[BUFFER_INDEX_VERTEX] =
+            range->vertex_buffer_offset;
+        draw->bindings.vertex_buffers[BUFFER_INDEX_INSTANCE] = instance_buffer;
+        draw->bindings.fs_images[SLOT_albedo_transparency] = mat->albedo_transparency;
+        draw->bindings.fs_images[SLOT_emissive_specular] = mat->emissive_specular;
+    }
+
+    model->revision = ++pass->revision;
+    return true;
+}
+
+model_id_t geometry_pass_create_model(geometry_pass_t* pass,
+    const model_desc_t* model_desc) {
+    assert(pass && model_desc);
+    assert(model_desc->mesh.id != HANDLE_INVALID_ID);
+    assert(model_desc->material.id != HANDLE_INVALID_ID);
+
+    model_id_t model_id = {
+        .id = HANDLE_INVALID_ID
+    };
+
+    // search for an empty slot
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
+        // if we find an empty slot, store the index and break the loop
+        if (model_is_empty(&pass->models[i])) {
+            model_id.id = i;
+            break;
+        }
+    }
+
+    // no free slot found
+    if (model_id.id == HANDLE_INVALID_ID) {
+        return model_id;
+    }
+
+    model_t model = {
+        .mesh_id = model_desc->mesh,
+        .material_id = model_desc->material
+    };
+
+    // store the label into the model's trace name
+    trace_printf(&model.trace, "%s", model_desc->label);
+
+    // store model into the array
+    pass->models[model_id.id] = model;
+
+    trace_t id_trace;
+    trace_printf(&id_trace, "%s-%s", model_desc->label, "instance-buffer");
+
+    // instance data is shared among all model's draw calls
+    sg_buffer instance_buffer = sg_make_buffer(&(sg_buffer_desc) {
+        .size = GEOMETRY_PASS_MAX_INSTANCES * sizeof(instance_t),
+        .usage = SG_USAGE_STREAM,
+        .label = id_trace.name
+    });
+
+    // create a drawcall for each of the mesh ranges
+    bool added = model_add_mesh_draws(pass, model_id,
+        model_desc, instance_buffer);
+    assert(added);
+    (void)added;
+
+    return model_id;
+}
+
+bool geometry_pass_append_model_mesh(geometry_pass_t* pass,
+    model_id_t model, const model_desc_t* model_desc) {
+    assert(pass && model_desc);
+    assert(model_desc->mesh.id != HANDLE_INVALID_ID);
+    assert(model_desc->material.id != HANDLE_INVALID_ID);
+
+    if (!handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)
+        || model_is_empty(&pass->models[model.id])) {
+        return false;
+    }
+
+    model_t* model_ptr = &pass->models[model.id];
+    draw_call_t* draws = model_draws(pass, model);
+    assert(model_ptr->num_draws > 0);
+
+    if (!model_add_mesh_draws(pass, model, model_desc,
+        draws[0].bindings.vertex_buffers[BUFFER_INDEX_INSTANCE])) {
+        LOG_WARN("WARN: Too many draws for model (%s:%d);"
+            " mesh (%d) will not be drawn\n", model_ptr->trace.name,
+            model.id, model_desc->mesh.id);
+        return false;
+    }
+
+    return true;
+}
+
+bool geometry_pass_set_model_draw_material(geometry_pass_t* pass,
+    model_id_t model, int32_t draw, material_id_t material) {
+    assert(pass);
+
+    if (!handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)
+        || !handle_is_valid(material, GEOMETRY_PASS_MAX_MATERIALS)
+        || model_is_empty(&pass->models[model.id])
+        || material_is_empty(&pass->materials[material.id])) {
+        return false;
+    }
+
+    model_t* model_ptr = &pass->models[model.id];
+    if (draw < 0 || draw >= model_ptr->num_draws) {
+        return false;
+    }
+
+    const material_t* mat = &pass->materials[material.id];
+    draw_call_t* draw_call = &model_draws(pass, model)[draw];
+    draw_call->bindings.fs_images[SLOT_albedo_transparency] = mat->albedo_transparency;
+    draw_call->bindings.fs_images[SLOT_emissive_specular] = mat->emissive_specular;
+    model_ptr->draw_materials[draw] = material;
+
+    return true;
+}
+
+void geometry_pass_destroy_model(geometry_pass_t* pass, model_id_t model) {
+    assert(pass);
+    
+    // mark the model slot free
+    if (handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)) {
+        model_t* model_ptr = &pass->models[model.id];
+        if (!model_is_empty(model_ptr)) {
+            draw_call_t* draws = model_draws(pass, model);
+
+            // the only buffer initialised by the model logic 
+            // is the instance buffer, therfore, is the only 
+            // we need to destroy here manually, and, because
+            // it is shared by all draws, only once.
+            if (model_ptr->num_draws > 0) {
+                sg_destroy_buffer(
+                    draws[0].bindings.vertex_buffers[BUFFER_INDEX_INSTANCE]);
+            }
+
+            // reset draw call settings and set the slots free,
+            // leaving the clusters to be culled by other models
+            for (int32_t d = 0; d < model_ptr->num_draws; ++d) {
+                mesh_t* mesh = &pass->meshes[model_ptr->draw_meshes[d].id];
+                if (mesh->clusters && mesh->cull_model.id == model.id) {
+                    mesh->cull_model.id = HANDLE_INVALID_ID;
+                }
+
+                draw_call_reset(&draws[d]);
+            }
+
+            *model_ptr = empty_model;
+
+            // models sharing its meshes may now cull their clusters
+            for (int32_t m = 0; m < GEOMETRY_PASS_MAX_MODELS; ++m) {
+                if (!model_is_empty(&pass->models[m])) {
+                    pass->models[m].revision = ++pass->revision;
+                }
+            }
+        }
+    }
+}
+
+// an instance as seen by the clusters, in mesh space
+typedef struct {
+    frustum_t frustum;
+    vec3f_t eye;
+    bool mirrored;  // flipped winding, facing is reversed
+} cluster_view_t;
+
+static cluster_view_t make_cluster_view(const globals_t* globals,
+    const instance_t* instance) {
+    // the inverse of the linear part is made of the cross products
+    // of its columns, divided by its determinant, which is the eye
+    // relative to the pose translation is multiplied by
+    const vec4f_t* rows = instance->pose;
+    vec3f_t c0 = svec3(rows[0].x, rows[1].x, rows[2].x);
+    vec3f_t c1 = svec3(rows[0].y, rows[1].y, rows[2].y);
+    vec3f_t c2 = svec3(rows[0].z, rows[1].z, rows[2].z);
+    vec3f_t c12 = svec3_cross(c1, c2);
+    mfloat_t det = svec3_dot(c0, c12);
+
+    vec3f_t eye = svec3_subtract(globals->eye_pos,
+        svec3(rows[0].w, rows[1].w, rows[2].w));
+    mfloat_t inv_det = (det != 0.f) ? 1.f / det : 0.f;
+
+    return (cluster_view_t){
+        .frustum = frustum_from_matrix(smat4_multiply(globals->view_proj,
+            geometry_pass_instance_pose(instance))),
+        .eye = svec3_multiply_f(svec3(
+            svec3_dot(c12, eye),
+            svec3_dot(svec3_cross(c2, c0), eye),
+            svec3_dot(svec3_cross(c0, c1), eye)), inv_det),
+        // degenerate poses have no facing, and are never culled by it
+        .mirrored = det <= 0.f
+    };
+}
+
+// visible if in the frustum, with some triangle facing the eye
+static bool cluster_is_visible(const cluster_t* cluster,
+    const cluster_view_t* view) {
+    if (!frustum_test_sphere(&view->frustum, cluster->bounds)) {
+        return false;
+    }
+
+    if (cluster->cone_cutoff >= 1.f || view->mirrored) {
+        return true;
+    }
+
+    vec3f_t to_center = svec3_subtract(cluster->bounds.center, view->eye);
+    return svec3_dot(to_center, cluster->cone_axis)
+        < cluster->cone_cutoff * svec3_length(to_center) + cluster->bounds.radius;
+}
+
+// compact the indices of the clusters visible from any of the draw's
+// instances, draws drawing none of them are skipped altogether.
+static uint32_t cull_draw_clusters(const mesh_t* mesh,
+    const mesh_range_t* range, const cluster_view_t* views,
+    uint32_t num_views, uint32_t offset, draw_call_t* draw) {
+    size_t index_size = (mesh->index_type == SG_INDEXTYPE_UINT16)
+        ? sizeof(uint16_t) : sizeof(uint32_t);
+    uint32_t num_indices = 0;
+
+    for (uint32_t c = 0; c < range->num_clusters; ++c) {
+        const cluster_t* cluster = &mesh->clusters[range->first_cluster + c];
+        bool visible = false;
+        for (uint32_t v = 0; v < num_views && !visible; ++v) {
+            visible = cluster_is_visible(cluster, &views[v]);
+        }
+
+        if (!visible) {
+            continue;
+        }
+
+        // adjacent visible clusters are contiguous in the source too
+        memcpy((uint8_t*)mesh->cull_indices + index_size * (offset + num_indices),
+            (const uint8_t*)mesh->indices + index_size * cluster->base_element,
+            index_size * cluster->num_elements);
+        num_indices += cluster->num_elements;
+    }
+
+    draw->indices_offset = (int32_t)offset;
+    draw->num_indices = (int32_t)num_indices;
+    draw->bindings.index_buffer = mesh->cull_ibuf;
+    if (num_indices == 0) {
+        draw->num_instances = 0;
+    }
+
+    return num_indices;
+}
+
+// cull the clusters of the model's meshes against its instances, for
+// those meshes which are not culled for another model already, whose
+// draws keep the whole ranges. draws of the same mesh are contiguous,
+// as they are added all together.
+static void cull_model_clusters(geometry_pass_t* pass, model_id_t model,
+    const instance_t* instances, uint32_t count) {
+    model_t* model_ptr = &pass->models[model.id];
+    draw_call_t* draws = model_draws(pass, model);
+
+    cluster_view_t views[GEOMETRY_PASS_MAX_INSTANCES];
+    bool has_views = false;
+
+    int32_t d = 0;
+    while (d < model_ptr->num_draws) {
+        mesh_t* mesh = &pass->meshes[model_ptr->draw_meshes[d].id];
+        int32_t end = d + 1;
+        while (end < model_ptr->num_draws
+            && model_ptr->draw_meshes[end].id == model_ptr->draw_meshes[d].id) {
+            ++end;
+        }
+
+        if (mesh->clusters && mesh->cull_model.id == HANDLE_INVALID_ID) {
+            mesh->cull_model = model;
+        }
+
+        if (!mesh->clusters || mesh->cull_model.id != model.id) {
+            d = end;
+            continue;
+        }
+
+        if (!has_views) {
+            for (uint32_t i = 0; i < count; ++i) {
+                views[i] = make_cluster_view(&pass->globals, &instances[i]);
+            }
+
+            has_views = true;
+        }
+
+        uint32_t num_indices = 0;
+        for (; d < end; ++d) {
+            const mesh_range_t* range = &mesh->ranges[model_ptr->draw_ranges[d]];
+            draw_call_t* draw = &draws[d];
+            if (draw->num_instances == 0) {
+                continue;
+            }
+
+            if (range->num_clusters == 0) {
+                // not clustered, drawn as it is
+                draw->indices_offset = range->base_element;
+                draw->num_indices = range->num_elements;
+                draw->bindings.index_buffer = mesh->ibuf;
+                continue;
+            }
+
+            uint32_t first = (uint32_t)draw->bindings.vertex_buffer_offsets[
+                BUFFER_INDEX_INSTANCE] / sizeof(instance_t);
+            num_indices += cull_draw_clusters(mesh, range, &views[first],
+                (uint32_t)draw->num_instances, num_indices, draw);
+        }
+
+        // buffers can be updated only once per frame,
+        // and there must be something to update them with
+        if (num_indices > 0) {
+            size_t index_size = (mesh->index_type == SG_INDEXTYPE_UINT16)
+                ? sizeof(uint16_t) : sizeof(uint32_t);
+            sg_update_buffer(mesh->cull_ibuf, mesh->cull_indices,
+                (int)(index_size * num_indices));
+        }
+    }
+}
+
+instance_t geometry_pass_pack_instance(const mat4f_t* pose,
+    vec4f_t color, vec4f_t uv_scale_pan) {
+    assert(pose);
+    const mfloat_t* m = pose->v;
+    instance_t instance = {
+        .pose = {
+            svec4(m[0], m[4], m[8], m[12]),
+            svec4(m[1], m[5], m[9], m[13]),
+            svec4(m[2], m[6], m[10], m[14])
+        },
+        .tile = uv_scale_pan
+    };
+
+    for (int32_t c = 0; c < 4; ++c) {
+        // colors are clamped, and the layer is a whole number
+        mfloat_t value = (c < 3) ? color.v[c] * 255.f : color.v[c];
+        value = (value < 0.f) ? 0.f : (value > 255.f) ? 255.f : value;
+        instance.color[c] = (uint8_t)(value + .5f);
+    }
+
+    return instance;
+}
+
+mat4f_t geometry_pass_instance_pose(const instance_t* instance) {
+    assert(instance);
+    const vec4f_t* rows = instance->pose;
+    return (mat4f_t){.v = {
+        rows[0].x, rows[1].x, rows[2].x, 0.f,
+        rows[0].y, rows[1].y, rows[2].y, 0.f,
+        rows[0].z, rows[1].z, rows[2].z, 0.f,
+        rows[0].w, rows[1].w, rows[2].w, 1.f
+    }};
+}
+
+void geometry_pass_update_model_instances(geometry_pass_t* pass,
+    model_id_t model, const instance_t* instances, uint32_t count) {
+    assert(pass && instances && count > 0);
+
+    geometry_pass_update_model_lod_instances(pass, model, instances,
+        (uint32_t[GEOMETRY_PASS_MAX_LODS]){count});
+}
+
+void geometry_pass_update_model_lod_instances(geometry_pass_t* pass,
+    model_id_t model, const instance_t* instances,
+    const uint32_t lod_counts[GEOMETRY_PASS_MAX_LODS]) {
+    assert(pass && instances && lod_counts);
+
+    if (handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)) {
+        model_t* model_ptr = &pass->models[model.id];
+
+        // check whether the model is valid,
+        // skip and emit a warning otherwise
+        if (!handle_is_valid(model_ptr->mesh_id, GEOMETRY_PASS_MAX_MESHES) ||
+            !handle_is_valid(model_ptr->material_id, GEOMETRY_PASS_MAX_MATERIALS)) {
+            LOG_WARN("WARN: Group (%s:%d) is not valid\n",
+                model_ptr->trace.name, model.id);
+            return;
+        }
+
+        // first instance of each level
+        uint32_t lod_offsets[GEOMETRY_PASS_MAX_LODS + 1] = {0};
+        for (int32_t l = 0; l < GEOMETRY_PASS_MAX_LODS; ++l) {
+            lod_offsets[l + 1] = lod_offsets[l] + lod_counts[l];
+        }
+
+        // if too many instances in the array,
+        // then trim them off and issue a warn
+        uint32_t count = lod_offsets[GEOMETRY_PASS_MAX_LODS];
+        if (count > GEOMETRY_PASS_MAX_INSTANCES) {
+            LOG_WARN("WARN: Too many instances (%d) for model (%s:%d);"
+                "only %d will be updated\n", count, model_ptr->trace.name,
+                model.id, GEOMETRY_PASS_MAX_INSTANCES);
+            count = GEOMETRY_PASS_MAX_INSTANCES;
+        }
+
+        // models left without instances are not drawn at all
+        draw_call_t* draws = model_draws(pass, model);
+        if (count == 0) {
+            for (int32_t d = 0; d < model_ptr->num_draws; ++d) {
+                draws[d].num_instances = 0;
+            }
+
+            return;
+        }
+
+        // upload instance data to render device, the
+        // buffer is shared among all model's draw calls
+        const sg_bindings* bindings = &draws[0].bindings;
+        sg_update_buffer(bindings->vertex_buffers[BUFFER_INDEX_INSTANCE],
+            instances, count * sizeof(instance_t));
+
+        // each draw starts at the first instance of its level, while
+        // the coarsest level of a mesh draws all the coarser ones too
+        for (int32_t d = 0; d < model_ptr->num_draws; ++d) {
+            const mesh_t* mesh = &pass->meshes[model_ptr->draw_meshes[d].id];
+            int32_t lod = model_ptr->draw_lods[d];
+            int32_t last_lod = (mesh->num_lods > 0) ? (int32_t)mesh->num_lods - 1 : 0;
+
+            uint32_t first = lod_offsets[lod];
+            uint32_t end = (lod == last_lod)
+                ? lod_offsets[GEOMETRY_PASS_MAX_LODS]
+                : lod_offsets[lod + 1];
+
+            first = (first < count) ? first : count;
+            end = (end < count) ? end : count;
+
+            draws[d].num_instances = (int32_t)(end - first);
+            draws[d].bindings.vertex_buffer_offsets[BUFFER_INDEX_INSTANCE] =
+                (int32_t)(first * sizeof(instance_t));
+        }
+
+        // clusters out of the view, or facing away, are not drawn
+        cull_model_clusters(pass, model, instances, count);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Point clouds
+// -----------------------------------------------------------------------------
+
+#define POINT_BLOCK_SIZE 65536  // points per job
+#define POINT_RADIX_BITS 10     // of the Morton keys, sorted per pass
+#define POINT_KEY_BITS (3 * GEOMETRY_PASS_POINT_MAX_DEPTH)
+
+// the whole cloud is a single vertex buffer, whose size is an int
+#define POINT_MAX_POINTS ((uint32_t)(INT32_MAX / sizeof(point_vertex_t)))
+
+static bool point_cloud_is_empty(const point_cloud_t* cloud) {
+    return cloud->chunks == NULL;
+}
+
+// each point cloud owns a fixed block of draw calls
+static draw_call_t* point_cloud_draws(geometry_pass_t* pass,
+    point_cloud_id_t cloud) {
+    assert(handle_is_valid(cloud, GEOMETRY_PASS_MAX_POINT_CLOUDS));
+    return &pass->points.draws[cloud.id * GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS];
+}
+
+static vec3f_t point_position(const point_cloud_desc_t* desc, uint32_t p) {
+    float xyz[3];
+    memcpy(xyz, (const uint8_t*)desc->positions
+        + (size_t)p * desc->position_stride, sizeof(xyz));
+    return svec3(xyz[0], xyz[1], xyz[2]);
+}
+
+// 10 bits, each followed by two zeros
+static uint32_t point_spread_bits(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x030000ff;
+    x = (x | (x << 8)) & 0x0300f00f;
+    x = (x | (x << 4)) & 0x030c30c3;
+    x = (x | (x << 2)) & 0x09249249;
+    return x;
+}
+
+// cell of the finest octree level, non finite values go to the first
+static uint32_t point_cell(mfloat_t value, mfloat_t origin,
+    mfloat_t cells_per_unit) {
+    const uint32_t max_cell = (1u << GEOMETRY_PASS_POINT_MAX_DEPTH) - 1;
+    mfloat_t cell = (value - origin) * cells_per_unit;
+    return (cell >= 0.f)
+        ? ((cell < (mfloat_t)max_cell) ? (uint32_t)cell : max_cell)
+        : 0;
+}
+
+typedef struct {
+    const point_cloud_desc_t* desc;
+    uint32_t num_blocks;
+    vec3f_t* block_min;
+    vec3f_t* block_max;
+    vec3f_t origin;             // of the octree cube
+    mfloat_t cells_per_unit;    // at the finest level
+    uint32_t* keys;
+    uint32_t* order;            // points, by key once sorted
+    uint32_t* sort_keys;        // radix sort scratch
+    uint32_t* sort_order;
+    uint32_t* chunk_order;      // points, by chunk
+    point_chunk_t* chunks;
+    uint32_t num_chunks;
+    uint32_t capacity;
+    uint32_t num_ordered;
+    mfloat_t root_size;         // side of the octree cube
+    box_t bbox;                 // of the whole cloud
+    point_vertex_t* vertices;
+} point_build_t;
+
+static void point_build_release(point_build_t* build) {
+    if (build->block_min) memory_free(build->block_min);
+    if (build->keys) memory_free(build->keys);
+    if (build->order) memory_free(build->order);
+    if (build->sort_keys) memory_free(build->sort_keys);
+    if (build->sort_order) memory_free(build->sort_order);
+    if (build->chunk_order) memory_free(build->chunk_order);
+    if (build->chunks) memory_free(build->chunks);
+    if (build->vertices) memory_free(build->vertices);
+    memset(build, 0, sizeof(point_build_t));
+}
+
+static void point_bounds_job(void* user_data, uint32_t block) {
+    point_build_t* build = (point_build_t*)user_data;
+    uint32_t begin = block * POINT_BLOCK_SIZE;
+    uint32_t end = build->desc->num_points - begin > POINT_BLOCK_SIZE
+        ? begin + POINT_BLOCK_SIZE : build->desc->num_points;
+
+    vec3f_t lo = svec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3f_t hi = svec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32_t p = begin; p < end; ++p) {
+        vec3f_t pos = point_position(build->desc, p);
+        for (int32_t c = 0; c < 3; ++c) {
+            if (pos.v[c] < lo.v[c]) lo.v[c] = pos.v[c];
+            if (pos.v[c] > hi.v[c]) hi.v[c] = pos.v[c];
+        }
+    }
+
+    build->block_min[block] = lo;
+    build->block_max[block] = hi;
+}
+
+static void point_keys_job(void* user_data, uint32_t block) {
+    point_build_t* build = (point_build_t*)user_data;
+    uint32_t begin = block * POINT_BLOCK_SIZE;
+    uint32_t end = build->desc->num_points - begin > POINT_BLOCK_SIZE
+        ? begin + POINT_BLOCK_SIZE : build->desc->num_points;
+
+    for (uint32_t p = begin; p < end; ++p) {
+        vec3f_t pos = point_position(build->desc, p);
+        uint32_t x = point_cell(pos.x, build->origin.x, build->cells_per_unit);
+        uint32_t y = point_cell(pos.y, build->origin.y, build->cells_per_unit);
+        uint32_t z = point_cell(pos.z, build->origin.z, build->cells_per_unit);
+        build->keys[p] = (point_spread_bits(x) << 2)
+            | (point_spread_bits(y) << 1) | point_spread_bits(z);
+        build->order[p] = p;
+    }
+}
+
+// least significant digit first, keys and order end up sorted in place
+static void point_sort_keys(point_build_t* build) {
+    uint32_t num_points = build->desc->num_points;
+    uint32_t counts[1 << POINT_RADIX_BITS];
+    const uint32_t mask = (1u << POINT_RADIX_BITS) - 1;
+
+    for (uint32_t shift = 0; shift < POINT_KEY_BITS; shift += POINT_RADIX_BITS) {
+        memset(counts, 0, sizeof(counts));
+        for (uint32_t p = 0; p < num_points; ++p) {
+            ++counts[(build->keys[p] >> shift) & mask];
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t d = 0; d <= mask; ++d) {
+            uint32_t count = counts[d];
+            counts[d] = offset;
+            offset += count;
+        }
+
+        for (uint32_t p = 0; p < num_points; ++p) {
+            uint32_t dst = counts[(build->keys[p] >> shift) & mask]++;
+            build->sort_keys[dst] = build->keys[p];
+            build->sort_order[dst] = build->order[p];
+        }
+
+        uint32_t* keys = build->keys;
+        build->keys = build->sort_keys;
+        build->sort_keys = keys;
+
+        uint32_t* order = build->order;
+        build->order = build->sort_order;
+        build->sort_order = order;
+    }
+}
+
+static bool point_add_chunks(point_build_t* build, uint32_t count) {
+    if (build->num_chunks + count > build->capacity) {
+        uint32_t capacity = build->capacity ? build->capacity * 2 : 64;
+        while (capacity < build->num_chunks + count) {
+            capacity *= 2;
+        }
+
+        point_chunk_t* chunks = memory_realloc(build->chunks,
+            sizeof(point_chunk_t) * capacity);
+        if (!chunks) {
+            return false;
+        }
+
+        build->chunks = chunks;
+        build->capacity = capacity;
+    }
+
+    build->num_chunks += count;
+    return true;
+}
+
+// the points of the chunk are those of its cell, from begin to end,
+// sorted by key. those it does not pick are left to its children,
+// each taking the ones within its octant, contiguous as well.
+static bool point_build_chunk(point_build_t* build, uint32_t chunk_index,
+    uint32_t begin, uint32_t end, uint32_t depth) {
+    uint32_t count = end - begin;
+    mfloat_t cell_size = build->root_size / (mfloat_t)(1u << depth);
+    point_chunk_t chunk = {.first_point = build->num_ordered};
+
+    if (count <= GEOMETRY_PASS_POINT_CHUNK_SIZE
+        || depth == GEOMETRY_PASS_POINT_MAX_DEPTH) {
+        memcpy(&build->chunk_order[build->num_ordered],
+            &build->order[begin], sizeof(uint32_t) * count);
+        build->num_ordered += count;
+
+        chunk.num_points = count;
+        chunk.spacing = cell_size / MSQRT((mfloat_t)count);
+        build->chunks[chunk_index] = chunk;
+        return true;
+    }
+
+    // points evenly spaced along the curve are evenly spread
+    // within the cell, the others are compacted, keeping their order
+    uint32_t step = count / GEOMETRY_PASS_POINT_CHUNK_SIZE;
+    uint32_t next_pick = step / 2;
+    uint32_t num_picked = 0;
+    uint32_t num_left = 0;
+    for (uint32_t p = 0; p < count; ++p) {
+        if (num_picked < GEOMETRY_PASS_POINT_CHUNK_SIZE && p == next_pick) {
+            build->chunk_order[build->num_ordered++] = build->order[begin + p];
+            ++num_picked;
+            next_pick = (uint32_t)(((uint64_t)num_picked * count)
+                / GEOMETRY_PASS_POINT_CHUNK_SIZE) + step / 2;
+            continue;
+        }
+
+        build->keys[begin + num_left] = build->keys[begin + p];
+        build->order[begin + num_left] = build->order[begin + p];
+        ++num_left;
+    }
+
+    chunk.num_points = num_picked;
+    chunk.spacing = cell_size / MSQRT((mfloat_t)num_picked);
+
+    // octants of the cell, by the key digit of the next level
+    uint32_t shift = 3 * (GEOMETRY_PASS_POINT_MAX_DEPTH - 1 - depth);
+    uint32_t children_begin[9];
+    uint32_t num_children = 0;
+    for (uint32_t p = begin; p < begin + num_left; ++p) {
+        if (p == begin || ((build->keys[p] ^ build->keys[p - 1]) >> shift) & 7) {
+            children_begin[num_children++] = p;
+        }
+    }
+
+    children_begin[num_children] = begin + num_left;
+    chunk.first_child = build->num_chunks;
+    chunk.num_children = num_children;
+    if (!point_add_chunks(build, num_children)) {
+        return false;
+    }
+
+    build->chunks[chunk_index] = chunk;
+    for (uint32_t c = 0; c < num_children; ++c) {
+        if (!point_build_chunk(build, chunk.first_child + c,
+            children_begin[c], children_begin[c + 1], depth + 1)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// quantise the points of the chunk, and bound them
+static void point_vertices_job(void* user_data, uint32_t chunk_index) {
+    point_build_t* build = (point_build_t*)user_data;
+    const point_cloud_desc_t* desc = build->desc;
+    point_chunk_t* chunk = &build->chunks[chunk_index];
+    const box_t* bbox = &build->bbox;
+
+    vec3f_t lo = svec3(FLT_MAX, FLT_MAX, FLT_MAX);
+    vec3f_t hi = svec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    for (uint32_t p = chunk->first_point;
+        p < chunk->first_point + chunk->num_points; ++p) {
+        uint32_t src = build->chunk_order[p];
+        point_vertex_t* dst = &build->vertices[p];
+
+        vec3f_t pos = point_position(desc, src);
+        for (int32_t c = 0; c < 3; ++c) {
+            if (pos.v[c] < lo.v[c]) lo.v[c] = pos.v[c];
+            if (pos.v[c] > hi.v[c]) hi.v[c] = pos.v[c];
+            dst->pos[c] = quantise_range(pos.v[c],
+                bbox->center.v[c], bbox->extents.v[c]);
+        }
+
+        dst->pos[3] = 0;
+        if (desc->colors) {
+            const uint8_t* color = desc->colors + (size_t)src * desc->color_stride;
+            dst->color[0] = color[0];
+            dst->color[1] = color[1];
+            dst->color[2] = color[2];
+            dst->color[3] = (desc->color_components > 3) ? color[3] : 0xff;
+        }
+        else {
+            memset(dst->color, 0xff, sizeof(dst->color));
+        }
+    }
+
+    chunk->bbox = (box_t){
+        .center = svec3_multiply_f(svec3_add(lo, hi), .5f),
+        .extents = svec3_multiply_f(svec3_subtract(hi, lo), .5f)
+    };
+}
+
+bool geometry_pass_build_point_cloud(jobs_t* jobs,
+    const point_cloud_desc_t* desc, point_cloud_data_t* out_data) {
+    assert(desc && desc->positions && out_data);
+    assert(!desc->colors || desc->color_components >= 3);
+
+    memset(out_data, 0, sizeof(point_cloud_data_t));
+    uint32_t num_points = desc->num_points;
+    if (num_points == 0) {
+        return false;
+    }
+
+    if (num_points > POINT_MAX_POINTS) {
+        LOG_WARN("WARN: Too many points (%u) for point cloud (%s);"
+            " at most %u fit a buffer\n", num_points, desc->label,
+            POINT_MAX_POINTS);
+        return false;
+    }
+
+    point_build_t build = {
+        .desc = desc,
+        .num_blocks = (num_points + POINT_BLOCK_SIZE - 1) / POINT_BLOCK_SIZE
+    };
+
+    build.block_min = memory_malloc(sizeof(vec3f_t) * build.num_blocks * 2);
+    build.keys = memory_malloc(sizeof(uint32_t) * num_points);
+    build.order = memory_malloc(sizeof(uint32_t) * num_points);
+    build.sort_keys = memory_malloc(sizeof(uint32_t) * num_points);
+    build.sort_order = memory_malloc(sizeof(uint32_t) * num_points);
+    if (!build.block_min || !build.keys || !build.order
+        || !build.sort_keys || !build.sort_order) {
+        LOG_WARN("WARN: Not enough memory to create point cloud (%s)\n",
+            desc->label);
+        point_build_release(&build);
+        return false;
+    }
+
+    // the octree is a cube around the points
+    build.block_max = build.block_min + build.num_blocks;
+    jobs_parallel_for(jobs, point_bounds_job, &build, build.num_blocks);
+
+    vec3f_t lo = build.block_min[0];
+    vec3f_t hi = build.block_max[0];
+    for (uint32_t b = 1; b < build.num_blocks; ++b) {
+        for (int32_t c = 0; c < 3; ++c) {
+            if (build.block_min[b].v[c] < lo.v[c]) lo.v[c] = build.block_min[b].v[c];
+            if (build.block_max[b].v[c] > hi.v[c]) hi.v[c] = build.block_max[b].v[c];
+        }
+    }
+
+    // no finite point at all
+    if (lo.x > hi.x || lo.y > hi.y || lo.z > hi.z) {
+        lo = hi = svec3_zero();
+    }
+
+    build.bbox = (box_t){
+        .center = svec3_multiply_f(svec3_add(lo, hi), .5f),
+        .extents = svec3_multiply_f(svec3_subtract(hi, lo), .5f)
+    };
+
+    mfloat_t size = hi.x - lo.x;
+    size = (hi.y - lo.y > size) ? hi.y - lo.y : size;
+    size = (hi.z - lo.z > size) ? hi.z - lo.z : size;
+    build.origin = lo;
+    build.root_size = (size > 0.f) ? size : 1.f;
+    build.cells_per_unit = (mfloat_t)(1u << GEOMETRY_PASS_POINT_MAX_DEPTH)
+        / build.root_size;
+
+    jobs_parallel_for(jobs, point_keys_job, &build, build.num_blocks);
+    point_sort_keys(&build);
+
+    // the sort scratch is no longer needed, and the chunk order takes it
+    memory_free(build.sort_keys);
+    build.sort_keys = NULL;
+    build.chunk_order = build.sort_order;
+    build.sort_order = NULL;
+
+    if (!point_add_chunks(&build, 1)
+        || !point_build_chunk(&build, 0, 0, num_points, 0)) {
+        LOG_WARN("WARN: Not enough memory to create point cloud (%s)\n",
+            desc->label);
+        point_build_release(&build);
+        return false;
+    }
+
+    memory_free(build.keys);
+    memory_free(build.order);
+    build.keys = NULL;
+    build.order = NULL;
+
+    build.vertices = memory_malloc(sizeof(point_vertex_t) * num_points);
+    point_chunk_ref_t* queue = memory_malloc(
+        sizeof(point_chunk_ref_t) * build.num_chunks);
+    if (!build.vertices || !queue) {
+        LOG_WARN("WARN: Not enough memory to create point cloud (%s)\n",
+            desc->label);
+        if (queue) memory_free(queue);
+        point_build_release(&build);
+        return false;
+    }
+
+    jobs_parallel_for(jobs, point_vertices_job, &build, build.num_chunks);
+
+    // children come after their parent, whose bounds they extend
+    for (uint32_t c = build.num_chunks; c-- > 0;) {
+        point_chunk_t* chunk = &build.chunks[c];
+        for (uint32_t i = 0; i < chunk->num_children; ++i) {
+            chunk->bbox = box_merge(chunk->bbox,
+                build.chunks[chunk->first_child + i].bbox);
+        }
+    }
+
+    point_cloud_t cloud = {
+        .num_points = num_points,
+        .chunks = build.chunks,
+        .num_chunks = build.num_chunks,
+        .bbox = build.bbox,
+        .params = {
+            .pose = smat4_identity(),
+            .pos_scale = svec4(build.bbox.extents.x,
+                build.bbox.extents.y, build.bbox.extents.z, 1.f),
+            .pos_offset = svec4(build.bbox.center.x,
+                build.bbox.center.y, build.bbox.center.z, 0.f)
+        },
+        .queue = queue
+    };
+
+    trace_printf(&cloud.trace, "%s", desc->label);
+
+    *out_data = (point_cloud_data_t){
+        .cloud = cloud,
+        .vertices = build.vertices
+    };
+
+    // chunks and vertices have been handed over
+    build.chunks = NULL;
+    build.vertices = NULL;
+    point_build_release(&build);
+    return true;
 }
 
-void geometry_pass_destroy_mesh(geometry_pass_t* pass, mesh_id_t mesh) {
-    assert(pass);
+void geometry_pass_release_point_cloud_data(point_cloud_data_t* data) {
+    assert(data);
 
-    // mark the mesh slot free
-    if (handle_is_valid(mesh, GEOMETRY_PASS_MAX_MESHES)) {
-        pass->meshes[mesh.id] = empty_mesh;
+    if (data->cloud.chunks) {
+        memory_free(data->cloud.chunks);
     }
 
-    // look up for the model, if exists, which
-    // points to this mesh and invalidate it.
-    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
-        model_t* model = &pass->models[i];
-        if (model->mesh_id.id == mesh.id) {
-            geometry_pass_destroy_model(pass, (model_id_t){.id=i});
-        }
+    if (data->cloud.queue) {
+        memory_free(data->cloud.queue);
     }
+
+    if (data->vertices) {
+        memory_free(data->vertices);
+    }
+
+    memset(data, 0, sizeof(point_cloud_data_t));
 }
 
-material_id_t geometry_pass_make_material(geometry_pass_t* pass,
-    const material_desc_t* material_desc) {
-    assert(pass && material_desc);
-    assert(material_desc->albedo);
-    assert(material_desc->albedo->width > 0);
-    assert(material_desc->albedo->height > 0);
-    assert(material_desc->albedo->layers > 0);
-    assert(material_desc->emissive);
-    assert(material_desc->emissive->width > 0);
-    assert(material_desc->emissive->height > 0);
-    assert(material_desc->emissive->layers > 0);
-    
-    material_id_t mat_id = {
+point_cloud_id_t geometry_pass_upload_point_cloud(geometry_pass_t* pass,
+    point_cloud_data_t* data) {
+    assert(pass && data && data->vertices && data->cloud.chunks);
+
+    point_cloud_id_t cloud_id = {
         .id = HANDLE_INVALID_ID
     };
 
-    // search for an empty slot
-    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MATERIALS; ++i) {
-        // if we find an empty slot, store the index and break the loop
-        if (material_is_empty(&pass->materials[i])) {
-            mat_id.id = i;
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_POINT_CLOUDS; ++i) {
+        if (point_cloud_is_empty(&pass->point_clouds[i])) {
+            cloud_id.id = i;
             break;
         }
     }
 
-    // no free slot found
-    if (mat_id.id == HANDLE_INVALID_ID) {
-        return mat_id;
+    if (cloud_id.id == HANDLE_INVALID_ID) {
+        LOG_WARN("WARN: No room for point cloud (%s)\n",
+            data->cloud.trace.name);
+        geometry_pass_release_point_cloud_data(data);
+        return cloud_id;
     }
 
-    // create temporary trace for image label
-    trace_t im_albedo_trace;
-    trace_printf(&im_albedo_trace,
-        "%s-%s", material_desc->label, "image-at");
+    point_cloud_t cloud = data->cloud;
 
-    trace_t im_emissive_trace;
-    trace_printf(&im_emissive_trace,
-        "%s-%s", material_desc->label, "image-es");
+    trace_t vb_trace;
+    trace_printf(&vb_trace, "%s-%s", cloud.trace.name, "vertex-buffer");
 
-    // create graphics image resource
-    material_t mat = {
-        .albedo_transparency = sg_make_image(&(sg_image_desc){
-            .type = SG_IMAGETYPE_ARRAY,
-            .width = material_desc->albedo->width,
-            .height = material_desc->albedo->height,
-            .layers = material_desc->albedo->layers,
-            .pixel_format = SG_PIXELFORMAT_RGBA8,
-            .content.subimage[0][0] = {
-                .ptr = material_desc->albedo->pixels,
-                .size = sizeof(uint32_t) *
-                    material_desc->albedo->width *
-                    material_desc->albedo->height *
-                    material_desc->albedo->layers
-            },
-            .label = im_albedo_trace.name
-        }),
-        .emissive_specular = sg_make_image(&(sg_image_desc){
-            .type = SG_IMAGETYPE_ARRAY,
-            .width = material_desc->emissive->width,
-            .height = material_desc->emissive->height,
-            .layers = material_desc->emissive->layers,
-            .pixel_format = SG_PIXELFORMAT_RGBA8,
-            .content.subimage[0][0] = {
-                .ptr = material_desc->emissive->pixels,
-                .size = sizeof(uint32_t) *
-                    material_desc->emissive->width *
-                    material_desc->emissive->height *
-                    material_desc->emissive->layers
-            },
-            .label = im_emissive_trace.name
-        })
-    };
+    cloud.vbuf = sg_make_buffer(&(sg_buffer_desc){
+        .size = (int)(sizeof(point_vertex_t) * cloud.num_points),
+        .content = data->vertices,
+        .label = vb_trace.name
+    });
 
-    // store the label into the material's trace name
-    trace_printf(&mat.trace, "%s", material_desc->label);
+    // the cloud has taken over chunks and queue
+    data->cloud.chunks = NULL;
+    data->cloud.queue = NULL;
+    geometry_pass_release_point_cloud_data(data);
 
-    // assign the material to the free slot
-    pass->materials[mat_id.id] = mat;
-    return mat_id;
-}
+    pass->point_clouds[cloud_id.id] = cloud;
 
-static material_id_t __geometry_pass_make_material_default(geometry_pass_t* pass) {
-    assert(pass);
-    static uint32_t color_alpha[4*4*4] = {
-        // checkboard
-        0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        0xFFFFFFFF, 0x00000000, 0xFFFFFFFF, 0x00000000,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        // horizontal lines
-        0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
-        0x00000000, 0x00000000, 0x00000000, 0x00000000,
-        0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF,
-        0x00000000, 0x00000000, 0x00000000, 0x00000000,
-        // vertical lines
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        // v-zag
-        0xFFFFFFFF, 0x00000000, 0x00000000, 0x00000000,
-        0x00000000, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF,
-        0x00000000, 0x00000000, 0xFFFFFFFF, 0x00000000,
-        0x00000000, 0x00000000, 0x00000000, 0x00000000,
-    };
+    draw_call_t* draws = point_cloud_draws(pass, cloud_id);
+    for (int32_t d = 0; d < GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS; ++d) {
+        draw_call_reset(&draws[d]);
+    }
 
-    static uint32_t emissive_specular[4*4*1] = {
-        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
-        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
-        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
-        0xFF000000, 0xFF000000, 0xFF000000, 0xFF000000,
-    };
+    LOG_INFO("INFO: Point cloud (%s) created: points=%u, chunks=%u\n",
+        cloud.trace.name, cloud.num_points, cloud.num_chunks);
 
-    return geometry_pass_make_material(pass, &(material_desc_t) {
-        .albedo = &(image_desc_t) {
-            .width = 4,
-            .height = 4,
-            .layers = 4,
-            .pixels = color_alpha
-        },
-        .emissive = &(image_desc_t) {
-            .width = 4,
-            .height = 4,
-            .layers = 1,
-            .pixels = emissive_specular
-        },
-        .label = "default-material"
-    });
+    return cloud_id;
 }
 
-material_id_t geometry_pass_get_default_material(geometry_pass_t* pass) {
-    assert(pass);
+point_cloud_id_t geometry_pass_make_point_cloud(geometry_pass_t* pass,
+    const point_cloud_desc_t* desc) {
+    assert(pass && desc);
 
-    // if the following fails, check the
-    // geometry pass has been initialised
-    assert(!material_is_empty(&pass->materials[0]));
-    return(material_id_t){.id = 0};
+    point_cloud_data_t data;
+    if (!geometry_pass_build_point_cloud(pass->jobs, desc, &data)) {
+        return (point_cloud_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    return geometry_pass_upload_point_cloud(pass, &data);
 }
 
-void geometry_pass_destroy_material(geometry_pass_t* pass, material_id_t mat) {
+void geometry_pass_destroy_point_cloud(geometry_pass_t* pass,
+    point_cloud_id_t cloud) {
     assert(pass);
-    
-    // mark the material slot free
-    if (handle_is_valid(mat, GEOMETRY_PASS_MAX_MATERIALS)) {
-        pass->materials[mat.id] = empty_material;
+
+    if (!handle_is_valid(cloud, GEOMETRY_PASS_MAX_POINT_CLOUDS)
+        || point_cloud_is_empty(&pass->point_clouds[cloud.id])) {
+        return;
     }
 
-    // find the relative model to invalidate
-    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
-        model_t* model = &pass->models[i];
-        if (model->material_id.id == mat.id) {
-            geometry_pass_destroy_model(pass, (model_id_t){.id=i});
-        }
+    point_cloud_t* cloud_ptr = &pass->point_clouds[cloud.id];
+    sg_destroy_buffer(cloud_ptr->vbuf);
+    memory_free(cloud_ptr->chunks);
+    memory_free(cloud_ptr->queue);
+    memset(cloud_ptr, 0, sizeof(point_cloud_t));
+
+    draw_call_t* draws = point_cloud_draws(pass, cloud);
+    for (int32_t d = 0; d < GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS; ++d) {
+        draw_call_reset(&draws[d]);
     }
 }
 
-model_id_t geometry_pass_create_model(geometry_pass_t* pass,
-    const model_desc_t* model_desc) {
-    assert(pass && model_desc);
-    assert(model_desc->mesh.id != HANDLE_INVALID_ID);
-    assert(model_desc->material.id != HANDLE_INVALID_ID);
+// max heap of the chunks, by their size on screen
+static void point_queue_push(point_chunk_ref_t* queue, uint32_t* count,
+    point_chunk_ref_t ref) {
+    uint32_t i = (*count)++;
+    while (i > 0 && queue[(i - 1) / 2].size < ref.size) {
+        queue[i] = queue[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
 
-    model_id_t model_id = {
-        .id = HANDLE_INVALID_ID
-    };
+    queue[i] = ref;
+}
 
-    // search for an empty slot
-    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MODELS; ++i) {
-        // if we find an empty slot, store the index and break the loop
-        if (model_is_empty(&pass->models[i])) {
-            model_id.id = i;
+static point_chunk_ref_t point_queue_pop(point_chunk_ref_t* queue,
+    uint32_t* count) {
+    point_chunk_ref_t top = queue[0];
+    point_chunk_ref_t last = queue[--(*count)];
+    uint32_t i = 0;
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= *count) {
+            break;
+        }
+
+        if (child + 1 < *count && queue[child + 1].size > queue[child].size) {
+            ++child;
+        }
+
+        if (queue[child].size <= last.size) {
             break;
         }
+
+        queue[i] = queue[child];
+        i = child;
     }
 
-    // no free slot found
-    if (model_id.id == HANDLE_INVALID_ID) {
-        return model_id;
+    if (*count > 0) {
+        queue[i] = last;
     }
 
-    model_t model = {
-        .mesh_id = model_desc->mesh,
-        .material_id = model_desc->material
-    };
+    return top;
+}
 
-    // store the label into the model's trace name
-    trace_printf(&model.trace, "%s", model_desc->label);
+// how the chunks of a cloud are seen, in world space
+typedef struct {
+    frustum_t frustum;      // in cloud space
+    mat4f_t pose;
+    mfloat_t pose_scale;    // largest axis scale of the pose
+    vec3f_t eye;
+    mfloat_t proj_scale;    // of lengths, to half the viewport, at unit distance
+    bool ortho;
+} point_view_t;
+
+// radius of the chunk bounds, relative to half the viewport
+static mfloat_t point_chunk_size(const point_view_t* view,
+    const point_chunk_t* chunk, mfloat_t* out_distance) {
+    const mfloat_t* m = view->pose.v;
+    vec3f_t c = chunk->bbox.center;
+    vec3f_t center = svec3(
+        m[0] * c.x + m[4] * c.y + m[8] * c.z + m[12],
+        m[1] * c.x + m[5] * c.y + m[9] * c.z + m[13],
+        m[2] * c.x + m[6] * c.y + m[10] * c.z + m[14]);
+
+    mfloat_t radius = svec3_length(chunk->bbox.extents) * view->pose_scale;
+    mfloat_t distance = view->ortho ? 1.f : svec3_distance(center, view->eye);
+    *out_distance = distance;
+    return (view->ortho || distance > radius)
+        ? radius * view->proj_scale / distance
+        : FLT_MAX;
+}
 
-    // store model into the array
-    pass->models[model_id.id] = model;
+static int point_range_compare(const void* a, const void* b) {
+    uint32_t a_first = ((const draw_call_t*)a)->indices_offset;
+    uint32_t b_first = ((const draw_call_t*)b)->indices_offset;
+    return (a_first > b_first) - (a_first < b_first);
+}
 
-    // create a drawcall
-    draw_call_t* draw = &pass->render.draws[model_id.id];
-    
-    // zero initialise draw params
-    draw->indices_offset = 0;
-    draw->num_instances = 0;
+uint32_t geometry_pass_update_point_cloud(geometry_pass_t* pass,
+    point_cloud_id_t cloud, const point_cloud_view_t* view) {
+    assert(pass && view);
 
-    const mesh_t* mesh = &pass->meshes[model.mesh_id.id];
+    if (!handle_is_valid(cloud, GEOMETRY_PASS_MAX_POINT_CLOUDS)
+        || point_cloud_is_empty(&pass->point_clouds[cloud.id])) {
+        return 0;
+    }
 
-    draw->num_indices = mesh->num_elements;
+    point_cloud_t* cloud_ptr = &pass->point_clouds[cloud.id];
+    cloud_ptr->params.pose = view->pose;
+    cloud_ptr->params.pos_scale.w = view->point_size;
+
+    // the y row of the view projection scales lengths by the
+    // projection alone, which perspective divides by the distance
+    const mfloat_t* vp = pass->globals.view_proj.v;
+    point_view_t point_view = {
+        .frustum = frustum_from_matrix(
+            smat4_multiply(pass->globals.view_proj, view->pose)),
+        .pose = view->pose,
+        .eye = pass->globals.eye_pos,
+        .proj_scale = svec3_length(svec3(vp[1], vp[5], vp[9])),
+        .ortho = vp[3] == 0.f && vp[7] == 0.f && vp[11] == 0.f
+    };
 
-    trace_t id_trace;
-    trace_printf(&id_trace, "%s-%s", model_desc->label, "instance-buffer");
-    
-    // update draw bindings
-    draw->bindings.index_buffer = mesh->ibuf;
-    draw->bindings.vertex_buffers[BUFFER_INDEX_VERTEX] = mesh->vbuf;
-    draw->bindings.vertex_buffers[BUFFER_INDEX_INSTANCE] =
-        sg_make_buffer(&(sg_buffer_desc) {
-            .size = GEOMETRY_PASS_MAX_INSTANCES * sizeof(instance_t),
-            .usage = SG_USAGE_STREAM,
-            .label = id_trace.name
-        });
+    const mfloat_t* m = view->pose.v;
+    for (int32_t c = 0; c < 3; ++c) {
+        mfloat_t axis = svec3_length(svec3(m[4 * c], m[4 * c + 1], m[4 * c + 2]));
+        point_view.pose_scale = (axis > point_view.pose_scale)
+            ? axis : point_view.pose_scale;
+    }
 
-    const material_t* mat = &pass->materials[model.material_id.id];
-    draw->bindings.fs_images[SLOT_albedo_transparency] = mat->albedo_transparency;
-    draw->bindings.fs_images[SLOT_emissive_specular] = mat->emissive_specular;
+    // a chunk is refined while its points are farther apart than their size
+    mfloat_t half_viewport = view->viewport_height * .5f;
+    mfloat_t point_size = (view->point_size > 1.f) ? view->point_size : 1.f;
 
-    return model_id;
-}
+    draw_call_t* draws = point_cloud_draws(pass, cloud);
+    uint32_t num_draws = 0;
+    uint32_t num_points = 0;
 
-void geometry_pass_destroy_model(geometry_pass_t* pass, model_id_t model) {
-    assert(pass);
-    
-    // mark the model slot free
-    if (handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)) {
-        model_t* model_ptr = &pass->models[model.id];
-        if (!model_is_empty(model_ptr)) {
-            *model_ptr = empty_model;
+    uint32_t queue_count = 0;
+    mfloat_t distance;
+    point_queue_push(cloud_ptr->queue, &queue_count, (point_chunk_ref_t){
+        .size = point_chunk_size(&point_view, &cloud_ptr->chunks[0], &distance),
+        .chunk = 0
+    });
 
-            // destroy the drawcall and set the slot free
-            draw_call_t* draw = &pass->render.draws[model.id];
+    while (queue_count > 0 && num_draws < GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS) {
+        point_chunk_ref_t ref = point_queue_pop(cloud_ptr->queue, &queue_count);
+        const point_chunk_t* chunk = &cloud_ptr->chunks[ref.chunk];
+        sphere_t bounds = {
+            .center = chunk->bbox.center,
+            .radius = svec3_length(chunk->bbox.extents)
+        };
 
-            // the only buffer initialised by the model logic 
-            // is the instance buffer, therfore, is the only 
-            // we need to destroy here manually
-            sg_destroy_buffer(
-                draw->bindings.vertex_buffers[BUFFER_INDEX_INSTANCE]);
-            
-            // reset draw call settings
-            draw_call_reset(draw);
+        if (!frustum_test_sphere(&point_view.frustum, bounds)) {
+            continue;
         }
-    }
-}
 
-void geometry_pass_update_model_instances(geometry_pass_t* pass,
-    model_id_t model, const instance_t* instances, uint32_t count) {
-    assert(pass && instances && count > 0);
+        // chunks come by decreasing size, the rest matter less. the
+        // root is drawn anyway, so that the cloud does not vanish
+        if (num_draws > 0 && (uint64_t)num_points + chunk->num_points
+            > view->point_budget) {
+            break;
+        }
 
-    if (handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)) {
-        model_t* model_ptr = &pass->models[model.id];
+        draws[num_draws++] = (draw_call_t){
+            .indices_offset = (int32_t)chunk->first_point,
+            .num_indices = (int32_t)chunk->num_points,
+            .num_instances = 1
+        };
+        num_points += chunk->num_points;
+
+        point_chunk_size(&point_view, chunk, &distance);
+        mfloat_t spacing = chunk->spacing * point_view.pose_scale
+            * point_view.proj_scale * half_viewport
+            / ((distance > 0.f) ? distance : MFLT_EPSILON);
+        if (spacing <= point_size) {
+            continue;
+        }
 
-        // check whether the model is valid,
-        // skip and emit a warning otherwise
-        if (!handle_is_valid(model_ptr->mesh_id, GEOMETRY_PASS_MAX_MESHES) ||
-            !handle_is_valid(model_ptr->material_id, GEOMETRY_PASS_MAX_MATERIALS)) {
-            LOG_WARN("WARN: Group (%s:%d) is not valid\n",
-                model_ptr->trace.name, model.id);
-            return;
+        for (uint32_t c = 0; c < chunk->num_children; ++c) {
+            uint32_t child = chunk->first_child + c;
+            point_queue_push(cloud_ptr->queue, &queue_count, (point_chunk_ref_t){
+                .size = point_chunk_size(&point_view,
+                    &cloud_ptr->chunks[child], &distance),
+                .chunk = child
+            });
         }
+    }
 
-        // if too many instances in the array,
-        // then trim them off and issue a warn
-        if (count > GEOMETRY_PASS_MAX_INSTANCES) {
-            LOG_WARN("WARN: Too many instances (%d) for model (%s:%d);"
-                "only %d will be updated\n", count, model_ptr->trace.name,
-                model.id, GEOMETRY_PASS_MAX_INSTANCES);
-            count = GEOMETRY_PASS_MAX_INSTANCES;
+    // chunks contiguous in the buffer, e.g. a chunk
+    // and its first child, are drawn at once
+    qsort(draws, num_draws, sizeof(draw_call_t), point_range_compare);
+
+    uint32_t num_ranges = 0;
+    for (uint32_t d = 0; d < num_draws; ++d) {
+        if (num_ranges > 0 && draws[num_ranges - 1].indices_offset
+            + draws[num_ranges - 1].num_indices == draws[d].indices_offset) {
+            draws[num_ranges - 1].num_indices += draws[d].num_indices;
+            continue;
         }
 
-        // upload instance data to render device
-        draw_call_t* draw_call = &pass->render.draws[model.id];
-        const sg_bindings* bindings = &draw_call->bindings;
-        sg_update_buffer(bindings->vertex_buffers[BUFFER_INDEX_INSTANCE],
-            instances, count * sizeof(instance_t));
+        draws[num_ranges++] = draws[d];
+    }
+
+    for (uint32_t d = 0; d < GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS; ++d) {
+        if (d >= num_ranges) {
+            draw_call_reset(&draws[d]);
+            continue;
+        }
+
+        draws[d].bindings.vertex_buffers[BUFFER_INDEX_VERTEX] = cloud_ptr->vbuf;
+        draws[d].vs_ubo = (ubo_t){
+            .data = (const uint8_t*)&cloud_ptr->params,
+            .size = sizeof(point_params_t),
+            .index = SLOT_vs_point_params
+        };
+    }
+
+    cloud_ptr->num_drawn_points = num_points;
+    return num_points;
+}
+
+// instance attributes are common to all vertex layouts
+static void layout_instance_attrs(sg_layout_desc* layout,
+    int32_t attr_color, int32_t attr_tile, const int32_t attr_pose[3]) {
+    layout->buffers[BUFFER_INDEX_INSTANCE].step_func = SG_VERTEXSTEP_PER_INSTANCE;
+    layout->attrs[attr_color] = (sg_vertex_attr_desc){.offset = offsetof(instance_t, color),.format = SG_VERTEXFORMAT_UBYTE4N,.buffer_index = BUFFER_INDEX_INSTANCE};
+    layout->attrs[attr_tile] = (sg_vertex_attr_desc){.offset = offsetof(instance_t, tile),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE};
 
-        // update draw calls instances count
-        draw_call->num_instances = count;
+    // one attribute per row of the pose
+    for (int32_t r = 0; r < 3; ++r) {
+        layout->attrs[attr_pose[r]] = (sg_vertex_attr_desc){.offset = offsetof(instance_t, pose) + (sizeof(vec4f_t) * r),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE};
     }
 }
 
 static void renderer_pass_setup(const geometry_pass_t* geometry_pass,
     render_pass_t* render_pass) {
     
+    // vertex stage draw parameters must match the dequantisation struct
+    assert(sizeof(vs_draw_params_t) == sizeof(vertex_dequant_t));
+
     // init uniforms
     render_pass->uniforms.vs_ubo.index = SLOT_vs_params;
     render_pass->uniforms.vs_ubo.data = (uint8_t*)&geometry_pass->globals;
@@ -475,32 +2806,13 @@ static void renderer_pass_setup(const geometry_pass_t* geometry_pass,
     render_pass->uniforms.fs_ubo.size = sizeof(fs_params_t);
 
     // init shaders
-    render_pass->shader = sg_make_shader(geometry_pass_shader_desc());
-
-    // init pipeline
-    render_pass->pipeline = sg_make_pipeline(&(sg_pipeline_desc) {
-        .shader = render_pass->shader,
-        .layout = {
-            .buffers[BUFFER_INDEX_VERTEX].step_func = SG_VERTEXSTEP_PER_VERTEX,
-            .buffers[BUFFER_INDEX_INSTANCE].step_func = SG_VERTEXSTEP_PER_INSTANCE,
-            .attrs = {
-                [ATTR_geo_vs_vertex_pos] = {.offset = offsetof(vertex_t, pos),.format = SG_VERTEXFORMAT_FLOAT3,.buffer_index = BUFFER_INDEX_VERTEX},
-                [ATTR_geo_vs_vertex_norm] = {.offset = offsetof(vertex_t, norm),.format = SG_VERTEXFORMAT_FLOAT3,.buffer_index = BUFFER_INDEX_VERTEX},
-                [ATTR_geo_vs_vertex_uv] = {.offset = offsetof(vertex_t, uv),.format = SG_VERTEXFORMAT_FLOAT2,.buffer_index = BUFFER_INDEX_VERTEX},
-                [ATTR_geo_vs_instance_color] = {.offset = offsetof(instance_t, color),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_tile] = {.offset = offsetof(instance_t, uv_scale_pan),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                // 4x4 matrices will span 4 attribute slots
-                [ATTR_geo_vs_instance_pose] = {.offset = offsetof(instance_t, pose),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_pose+1] = {.offset = offsetof(instance_t, pose) + (sizeof(mfloat_t) * 4),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_pose+2] = {.offset = offsetof(instance_t, pose) + (sizeof(mfloat_t) * 8),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_pose+3] = {.offset = offsetof(instance_t, pose) + (sizeof(mfloat_t) * 12),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                // 4x4 matrices will span 4 attribute slots
-                [ATTR_geo_vs_instance_normal] = {.offset = offsetof(instance_t, normal),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_normal+1] = {.offset = offsetof(instance_t, normal) + (sizeof(mfloat_t) * 4),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_normal+2] = {.offset = offsetof(instance_t, normal) + (sizeof(mfloat_t) * 8),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE},
-                [ATTR_geo_vs_instance_normal+3] = {.offset = offsetof(instance_t, normal) + (sizeof(mfloat_t) * 12),.format = SG_VERTEXFORMAT_FLOAT4,.buffer_index = BUFFER_INDEX_INSTANCE}
-            }
-        },
+    render_pass->shaders[PIPELINE_INDEX_FLOAT] =
+        sg_make_shader(geometry_pass_shader_desc());
+    render_pass->shaders[PIPELINE_INDEX_COMPACT] =
+        sg_make_shader(geometry_pass_compact_shader_desc());
+
+    // pipeline state shared among all vertex layouts
+    const sg_pipeline_desc pipeline_desc = {
         .index_type = SG_INDEXTYPE_UINT32,
         .depth_stencil = {
             .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
@@ -518,13 +2830,113 @@ static void renderer_pass_setup(const geometry_pass_t* geometry_pass,
             .face_winding = SG_FACEWINDING_CCW,
             .cull_mode = SG_CULLMODE_BACK,
             .sample_count = RASTERIZER_MSAA_SAMPLES
-        },
-        .label = "geometry-pass-pipeline"
-    });
+        }
+    };
+
+    // init full precision vertices pipeline
+    sg_pipeline_desc float_desc = pipeline_desc;
+    float_desc.shader = render_pass->shaders[PIPELINE_INDEX_FLOAT];
+    float_desc.layout = (sg_layout_desc){
+        .buffers[BUFFER_INDEX_VERTEX].step_func = SG_VERTEXSTEP_PER_VERTEX,
+        .attrs = {
+            [ATTR_geo_vs_vertex_pos] = {.offset = offsetof(vertex_t, pos),.format = SG_VERTEXFORMAT_FLOAT3,.buffer_index = BUFFER_INDEX_VERTEX},
+            [ATTR_geo_vs_vertex_norm] = {.offset = offsetof(vertex_t, norm),.format = SG_VERTEXFORMAT_FLOAT3,.buffer_index = BUFFER_INDEX_VERTEX},
+            [ATTR_geo_vs_vertex_uv] = {.offset = offsetof(vertex_t, uv),.format = SG_VERTEXFORMAT_FLOAT2,.buffer_index = BUFFER_INDEX_VERTEX},
+        }
+    };
+    layout_instance_attrs(&float_desc.layout,
+        ATTR_geo_vs_instance_color, ATTR_geo_vs_instance_tile,
+        (int32_t[3]){ATTR_geo_vs_instance_pose_x,
+            ATTR_geo_vs_instance_pose_y, ATTR_geo_vs_instance_pose_z});
+    float_desc.label = "geometry-pass-pipeline";
+
+    render_pass->pipelines[PIPELINE_INDEX_FLOAT] = sg_make_pipeline(&float_desc);
+
+    float_desc.index_type = SG_INDEXTYPE_UINT16;
+    float_desc.label = "geometry-pass-uint16-pipeline";
+    render_pass->pipelines[PIPELINE_INDEX_FLOAT + PIPELINE_OFFSET_UINT16] =
+        sg_make_pipeline(&float_desc);
+
+    // init quantised vertices pipeline
+    sg_pipeline_desc compact_desc = pipeline_desc;
+    compact_desc.shader = render_pass->shaders[PIPELINE_INDEX_COMPACT];
+    compact_desc.layout = (sg_layout_desc){
+        .buffers[BUFFER_INDEX_VERTEX].step_func = SG_VERTEXSTEP_PER_VERTEX,
+        .attrs = {
+            [ATTR_geo_compact_vs_vertex_pos] = {.offset = offsetof(vertex_compact_t, pos),.format = SG_VERTEXFORMAT_SHORT4N,.buffer_index = BUFFER_INDEX_VERTEX},
+            [ATTR_geo_compact_vs_vertex_norm] = {.offset = offsetof(vertex_compact_t, norm),.format = SG_VERTEXFORMAT_SHORT2N,.buffer_index = BUFFER_INDEX_VERTEX},
+            [ATTR_geo_compact_vs_vertex_uv] = {.offset = offsetof(vertex_compact_t, uv),.format = SG_VERTEXFORMAT_SHORT2N,.buffer_index = BUFFER_INDEX_VERTEX},
+        }
+    };
+    layout_instance_attrs(&compact_desc.layout,
+        ATTR_geo_compact_vs_instance_color, ATTR_geo_compact_vs_instance_tile,
+        (int32_t[3]){ATTR_geo_compact_vs_instance_pose_x,
+            ATTR_geo_compact_vs_instance_pose_y, ATTR_geo_compact_vs_instance_pose_z});
+    compact_desc.label = "geometry-pass-compact-pipeline";
+
+    render_pass->pipelines[PIPELINE_INDEX_COMPACT] =
+        sg_make_pipeline(&compact_desc);
+
+    compact_desc.index_type = SG_INDEXTYPE_UINT16;
+    compact_desc.label = "geometry-pass-compact-uint16-pipeline";
+    render_pass->pipelines[PIPELINE_INDEX_COMPACT + PIPELINE_OFFSET_UINT16] =
+        sg_make_pipeline(&compact_desc);
 
     trace_printf(&render_pass->trace, "geometry-pass");
 }
 
+static void points_pass_setup(const geometry_pass_t* geometry_pass,
+    render_pass_t* render_pass) {
+
+    // vertex stage draw parameters must match the point cloud ones
+    assert(sizeof(vs_point_params_t) == sizeof(point_params_t));
+
+    // points are not lit, there are no fragment stage uniforms
+    render_pass->uniforms.vs_ubo.index = SLOT_vs_params;
+    render_pass->uniforms.vs_ubo.data = (uint8_t*)&geometry_pass->globals;
+    render_pass->uniforms.vs_ubo.size = sizeof(vs_params_t);
+
+    render_pass->shaders[PIPELINE_INDEX_POINTS] =
+        sg_make_shader(geometry_pass_points_shader_desc());
+
+    render_pass->pipelines[PIPELINE_INDEX_POINTS] = sg_make_pipeline(
+        &(sg_pipeline_desc){
+            .shader = render_pass->shaders[PIPELINE_INDEX_POINTS],
+            .primitive_type = SG_PRIMITIVETYPE_POINTS,
+            .layout = {
+                .buffers[BUFFER_INDEX_VERTEX].step_func = SG_VERTEXSTEP_PER_VERTEX,
+                .attrs = {
+                    [ATTR_geo_points_vs_point_pos] = {.offset = offsetof(point_vertex_t, pos),.format = SG_VERTEXFORMAT_SHORT4N,.buffer_index = BUFFER_INDEX_VERTEX},
+                    [ATTR_geo_points_vs_point_color] = {.offset = offsetof(point_vertex_t, color),.format = SG_VERTEXFORMAT_UBYTE4N,.buffer_index = BUFFER_INDEX_VERTEX},
+                }
+            },
+            .depth_stencil = {
+                .depth_compare_func = SG_COMPAREFUNC_LESS_EQUAL,
+                .depth_write_enabled = true,
+            },
+            .rasterizer = {
+                .sample_count = RASTERIZER_MSAA_SAMPLES
+            },
+            .label = "geometry-pass-points-pipeline"
+        });
+
+    trace_printf(&render_pass->trace, "geometry-pass-points");
+}
+
+static void release_render_pass(render_pass_t* render_pass) {
+    for (int32_t p = 0; p < RENDER_PASS_MAX_PIPELINES; ++p) {
+        if (render_pass->pipelines[p].id != SG_INVALID_ID) {
+            sg_destroy_pipeline(render_pass->pipelines[p]);
+        }
+
+        if (render_pass->shaders[p].id != SG_INVALID_ID) {
+            sg_destroy_shader(render_pass->shaders[p]);
+        }
+    }
+
+    memset(render_pass, 0, sizeof(render_pass_t));
+}
+
 void geometry_pass_init(geometry_pass_t* pass) {
     assert(pass);
 
@@ -543,8 +2955,12 @@ void geometry_pass_init(geometry_pass_t* pass) {
         memcpy(&pass->models[i], &empty_model, sizeof(model_t));
     }
 
-    // setup the render pass
+    // mark all point cloud slots empty
+    memset(pass->point_clouds, 0, sizeof(pass->point_clouds));
+
+    // setup the render passes
     renderer_pass_setup(pass, &pass->render);
+    points_pass_setup(pass, &pass->points);
     material_id_t default_mat_id = __geometry_pass_make_material_default(pass);
     assert(default_mat_id.id == 0);
 }
@@ -569,11 +2985,13 @@ void geometry_pass_cleanup(geometry_pass_t* pass) {
     // models will be destroyed automatically when either
     // the corresponding mesh, or material, get destoried.
 
-    // release render resources
-    sg_destroy_shader(pass->render.shader);
-    sg_destroy_pipeline(pass->render.pipeline);
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_POINT_CLOUDS; ++i) {
+        geometry_pass_destroy_point_cloud(pass, (point_cloud_id_t){.id=i});
+    }
 
-    memset(&pass->render, 0, sizeof(render_pass_t));
+    // release render resources
+    release_render_pass(&pass->render);
+    release_render_pass(&pass->points);
 }
 
 #if defined(__cplusplus)
@@ -7,11 +7,46 @@
 #include "viewer_math.h"
 #include "viewer_handle.h"
 #include "viewer_render.h"
+#include "viewer_jobs.h"
+#include "viewer_image.h"
 
 #define GEOMETRY_PASS_MAX_MESHES 32     // max number of meshes per pass
 #define GEOMETRY_PASS_MAX_MATERIALS 16  // max number of materials per pass
 #define GEOMETRY_PASS_MAX_INSTANCES 64  // max number of instances per group
-#define GEOMETRY_PASS_MAX_MODELS RENDER_PASS_MAX_DRAW_CALLS
+#define GEOMETRY_PASS_MAX_MODELS 16      // max number of models per pass
+#define GEOMETRY_PASS_MAX_MESH_RANGES 32  // max number of draw ranges per mesh
+#define GEOMETRY_PASS_MAX_LODS 4        // max number of levels of detail per mesh
+
+// each level of detail has this many times fewer triangles than
+// the previous one, which matches the screen area shrinking when
+// levels are selected every time the projected size halves.
+#define GEOMETRY_PASS_LOD_REDUCTION 4
+
+// draw calls available to each model
+#define GEOMETRY_PASS_MAX_MODEL_DRAWS \
+    (RENDER_PASS_MAX_DRAW_CALLS / GEOMETRY_PASS_MAX_MODELS)
+
+// meshes with at least this many vertices are stored
+// quantised, when no explicit vertex layout is requested
+#define GEOMETRY_PASS_COMPACT_MIN_VERTICES 1024
+
+// meshes with at least this many triangles are partitioned into
+// clusters, which are culled one by one, each of them referencing
+// up to a maximum number of vertices and triangles.
+#define GEOMETRY_PASS_CLUSTER_MIN_TRIANGLES 1024
+#define GEOMETRY_PASS_CLUSTER_MAX_VERTICES 96
+#define GEOMETRY_PASS_CLUSTER_MAX_TRIANGLES 128
+
+// point clouds are split into an octree of chunks, each holding up to
+// this many points, a subsample of all those within its bounds, down
+// to a maximum depth, whose leaves hold all the points left.
+#define GEOMETRY_PASS_MAX_POINT_CLOUDS 4
+#define GEOMETRY_PASS_POINT_CHUNK_SIZE 32768
+#define GEOMETRY_PASS_POINT_MAX_DEPTH 10
+
+// draw calls available to each point cloud, in the points render pass
+#define GEOMETRY_PASS_MAX_POINT_CLOUD_DRAWS \
+    (RENDER_PASS_MAX_DRAW_CALLS / GEOMETRY_PASS_MAX_POINT_CLOUDS)
 
 #if defined(__cplusplus)
 extern "C" {
@@ -21,6 +56,7 @@ typedef struct handle_t mesh_id_t;
 typedef struct handle_t material_id_t;
 typedef struct handle_t model_id_t;
 typedef struct handle_t cluster_id_t;
+typedef struct handle_t point_cloud_id_t;
 
 // -----------------------------------------------------------------------------
 // Structures
@@ -33,25 +69,82 @@ typedef struct {
     vec2f_t uv;
 } vertex_t;
 
+// quantised vertex, 16 bytes instead of the 32 of vertex_t.
+// positions and uvs are normalised within the mesh bounds,
+// while normals are stored with octahedral encoding.
+typedef struct {
+    int16_t pos[4];     // xyz: position, w: padding
+    int16_t norm[2];    // octahedral normal
+    int16_t uv[2];
+} vertex_compact_t;
+
+typedef enum {
+    VERTEX_LAYOUT_DEFAULT,  // let the geometry pass choose per mesh
+    VERTEX_LAYOUT_FLOAT,    // full precision vertex_t
+    VERTEX_LAYOUT_COMPACT   // quantised vertex_compact_t
+} vertex_layout_t;
+
+// parameters to restore compact vertices into mesh space,
+// layout must match the vs_draw_params shader uniform block
+typedef struct {
+    vec4f_t pos_scale;      // xyz: bounds extents, w: 1 if u holds the layer
+    vec4f_t pos_offset;     // xyz: bounds center
+    vec4f_t uv_scale_pan;   // xy: uv extents, zw: uv center
+} vertex_dequant_t;
+
+ // contiguous portion of the index buffer, whose indices are
+ // relative to the vertex buffer offset. 16-bit indices can
+ // address meshes of any size this way, one range at a time.
+typedef struct {
+    int32_t base_element;
+    int32_t num_elements;
+    int32_t vertex_buffer_offset; // in bytes
+    int32_t submesh;              // submesh the range belongs to
+    int32_t lod;                  // level of detail of the submesh
+    uint32_t first_cluster;
+    uint32_t num_clusters;        // 0 if the range is not clustered
+    box_t bbox;
+} mesh_range_t;
+
+// contiguous triangles of a mesh range, culled as a whole. the
+// cone contains the normals of all the triangles, and if the eye
+// is within its back side, none of them can be facing it.
+typedef struct {
+    sphere_t bounds;        // in mesh space
+    vec3f_t cone_axis;
+    mfloat_t cone_cutoff;   // sine of the cone half angle, 1 never culls
+    uint32_t base_element;
+    uint32_t num_elements;
+} cluster_t;
+
  // a mesh consists of a vertex- and index-buffer  
 typedef struct {
     uint32_t num_elements;
     sg_buffer vbuf;
     sg_buffer ibuf;
+    sg_index_type index_type;
+    mesh_range_t ranges[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_ranges;
+    uint32_t num_lods;  // ranges of coarser levels follow the finer ones
+    vertex_layout_t layout;
+    vertex_dequant_t dequant;
+    box_t bbox;
+    sphere_t bsphere;
+    // clusters of all the ranges, and what is needed to compact the
+    // indices of the visible ones, every frame, into a stream buffer.
+    // as the buffer can be updated only once per frame, the clusters
+    // are culled for the instances of a single model, the first one
+    // updated, until it is destroyed. other models drawing the mesh
+    // draw all of its clusters.
+    cluster_t* clusters;
+    uint32_t num_clusters;
+    void* indices;          // copy of the index buffer content
+    void* cull_indices;
+    sg_buffer cull_ibuf;
+    model_id_t cull_model;  // model whose instances the clusters are culled for
     trace_t trace;
 } mesh_t;
 
-typedef struct {
-    // @note:
-    // this info may be part of the vertex properties
-    // although the information can be repeated for
-    // each vertex, while it is not needed butfor the
-    // cluster, it is also true, that never changes
-    // over time, therefore we don't need to compute
-    // them and transfer to texture data.
-    vec4f_t uv_tile;
-    vec4f_t uv_scale_pan;
-} cluster_t;
 
 typedef struct {
     sg_image albedo_transparency;  // rgb: albedo, a: transparency
@@ -59,19 +152,75 @@ typedef struct {
     trace_t trace;
 } material_t;
 
+// affine pose, of which only the first 3 rows are stored, as the last
+// one is always 0 0 0 1, while the normal matrix is derived from it in
+// the vertex shader. the tile stays in floats, as there is no portable
+// way to fetch the bits of half floats without a half vertex format.
 typedef struct {
-    vec4f_t color;
-    vec4f_t uv_scale_pan;
-    mat4f_t pose;
-    mat4f_t normal;
+    vec4f_t pose[3];        // rows of the pose
+    vec4f_t tile;           // xy: uv scaling, zw: uv panning
+    uint8_t color[4];       // rgb: color, a: uv layer
 } instance_t;
 
 typedef struct {
     mesh_id_t mesh_id;
     material_id_t material_id;
+    material_id_t draw_materials[GEOMETRY_PASS_MAX_MODEL_DRAWS];
+    mesh_id_t draw_meshes[GEOMETRY_PASS_MAX_MODEL_DRAWS];
+    int32_t draw_lods[GEOMETRY_PASS_MAX_MODEL_DRAWS];
+    int32_t draw_ranges[GEOMETRY_PASS_MAX_MODEL_DRAWS];
+    int32_t num_draws;  // one draw call per mesh range
+    box_t bbox;         // bounds of all the model's meshes
+    sphere_t bsphere;
+    uint32_t revision;  // changes whenever its draws do
     trace_t trace;
 } model_t;
 
+// quantised point, whose position is normalised within the cloud bounds
+typedef struct {
+    int16_t pos[4];     // xyz: position, w: padding
+    uint8_t color[4];   // rgba
+} point_vertex_t;
+
+// node of a point cloud octree. its points are a subsample of all
+// those within its bounds, which its children refine with the others.
+// points of a chunk come right before those of its subtree, and
+// children of the same chunk are contiguous in the chunks array.
+typedef struct {
+    box_t bbox;             // of the subtree points, in cloud space
+    mfloat_t spacing;       // average distance between its points
+    uint32_t first_point;
+    uint32_t num_points;
+    uint32_t first_child;
+    uint32_t num_children;  // 0 for leaves
+} point_chunk_t;
+
+// parameters of the point cloud draws, layout
+// must match the vs_point_params shader uniform block
+typedef struct {
+    mat4f_t pose;
+    vec4f_t pos_scale;      // xyz: bounds extents, w: point size in pixels
+    vec4f_t pos_offset;     // xyz: bounds center
+} point_params_t;
+
+// chunk waiting to be selected, by its size on screen
+typedef struct {
+    mfloat_t size;
+    uint32_t chunk;
+} point_chunk_ref_t;
+
+typedef struct {
+    sg_buffer vbuf;
+    uint32_t num_points;
+    point_chunk_t* chunks;  // the root first, NULL if the slot is empty
+    uint32_t num_chunks;
+    box_t bbox;
+    point_params_t params;
+    point_chunk_ref_t* queue;   // selection scratch, num_chunks entries
+    uint32_t num_drawn_points;  // by the last update
+    trace_t trace;
+} point_cloud_t;
+
 typedef struct {
     mat4f_t view_proj;
     vec4f_t ambient;
@@ -83,25 +232,71 @@ typedef struct {
     mesh_t meshes[GEOMETRY_PASS_MAX_MESHES];
     material_t materials[GEOMETRY_PASS_MAX_MATERIALS];
     model_t models[GEOMETRY_PASS_MAX_MODELS];
+    point_cloud_t point_clouds[GEOMETRY_PASS_MAX_POINT_CLOUDS];
     globals_t globals;
     render_pass_t render;
+    render_pass_t points;   // point clouds, drawn after the meshes
+    jobs_t* jobs;   // optional, to generate mipmaps in parallel
+    bool compress_images;   // block compress rgba8 images, if supported
+    uint32_t revision;  // of the last model change
 } geometry_pass_t;
 
 // -----------------------------------------------------------------------------
 // Intrface
 // -----------------------------------------------------------------------------
 
+// indexed sub-range of a mesh, e.g. an object shape,
+// which can be drawn with its own material. submeshes
+// of the same mesh must not overlap each other.
+typedef struct {
+    uint32_t base_element;
+    uint32_t num_elements;
+} mesh_submesh_desc_t;
+
 typedef struct {
     const vertex_t* vertices;
     uint32_t num_vertices;
     const uint32_t* indices;
     uint32_t num_indices;
+    const mesh_submesh_desc_t* submeshes; // optional
+    uint32_t num_submeshes;
+    vertex_layout_t layout;
+    uint32_t num_lods;  // levels of detail, including the mesh itself
+    bool uv_layers;     // u holds 2 * layer + 0.5 + u, compact layout only
+    bool unsplit;       // one range per submesh and level, 32-bit if need be
     const char* label;
 } mesh_desc_t;
 
+// coarser levels of detail are generated by quadric error
+// simplification of each submesh, and they share the vertices of
+// the mesh. levels which would not save enough triangles, or would
+// not fit the available ranges, are dropped.
+
 mesh_id_t geometry_pass_make_mesh(geometry_pass_t* pass, 
     const mesh_desc_t* mesh_desc);
 
+// content of a mesh, whose buffers are yet to be created
+typedef struct {
+    mesh_t mesh;            // all but the buffers
+    const void* vertices;   // vertex buffer content
+    uint32_t vertices_size;
+    void* indices;          // index buffer content
+    uint32_t indices_size;
+    void* owned_vertices;   // NULL if vertices are the descriptor's
+} mesh_data_t;
+
+// making a mesh is split in two steps, so that the former, which
+// does all the processing, can run on any thread, while the latter,
+// which creates the buffers, only on the one owning the pass. the
+// descriptor vertices might be referred to until the mesh is uploaded.
+bool geometry_pass_build_mesh(jobs_t* jobs, const mesh_desc_t* mesh_desc,
+    mesh_data_t* out_data);
+
+// the data is released whether or not the mesh could be made
+mesh_id_t geometry_pass_upload_mesh(geometry_pass_t* pass, mesh_data_t* data);
+
+void geometry_pass_release_mesh_data(mesh_data_t* data);
+
 typedef struct {
     mfloat_t width;
     mfloat_t height;
@@ -114,14 +309,23 @@ mesh_id_t geometry_pass_make_mesh_box(geometry_pass_t* pass,
 
 void geometry_pass_destroy_mesh(geometry_pass_t* pass, mesh_id_t mesh);
 
-// pixel format is assumed RGBA8
+// pixel format is RGBA8, unless told otherwise
 // the size will be computed as:
 // width*height*sizeof(uint32_t)
+// per layer and mip level. levels are stored one after
+// another, each with all its layers. if only level 0 of an
+// RGBA8 image is given, the full mip chain is generated from it.
+// block compressed images come with their whole mip chain, or
+// are drawn without one, and are decompressed if the backend
+// cannot sample them,
+// while RGBA8 ones are compressed, if the pass is told to.
 typedef struct {
     uint16_t width;
     uint16_t height;
     uint16_t layers;
-    uint32_t* pixels;
+    uint16_t num_mipmaps;   // 0 or 1: level 0 only
+    uint32_t* pixels;       // or blocks, see image_level_size
+    image_format_t format;
 } image_desc_t;
 
 typedef struct {
@@ -139,18 +343,106 @@ void geometry_pass_destroy_material(geometry_pass_t* pass, material_id_t mat);
 
 typedef struct {
     mesh_id_t mesh;
-    material_id_t material;
+    material_id_t material;     // used by submeshes without a material
+    const material_id_t* submesh_materials; // optional, one per submesh
+    uint32_t num_submesh_materials;
     const char* label;
 } model_desc_t;
 
 model_id_t geometry_pass_create_model(geometry_pass_t* pass,
     const model_desc_t* desc);
 
+// add the mesh of the description to an existing model, which draws
+// it along with its other meshes, sharing the same instances. it is
+// meant for models built piece by piece, e.g. while streaming.
+bool geometry_pass_append_model_mesh(geometry_pass_t* pass,
+    model_id_t model, const model_desc_t* desc);
+
+// replace the material of one of the model's draws, which are
+// numbered in the same order their mesh ranges have been added.
+bool geometry_pass_set_model_draw_material(geometry_pass_t* pass,
+    model_id_t model, int32_t draw, material_id_t material);
+
 void geometry_pass_destroy_model(geometry_pass_t* pass, model_id_t model);
 
+// pack a pose, which must be affine, the color of the instance, whose
+// w is the uv layer, and the uv scaling and panning of its tile
+instance_t geometry_pass_pack_instance(const mat4f_t* pose,
+    vec4f_t color, vec4f_t uv_scale_pan);
+
+// pose of the instance, with its last row
+mat4f_t geometry_pass_instance_pose(const instance_t* instance);
+
+// all the instances are drawn with the finest level of detail
 void geometry_pass_update_model_instances(geometry_pass_t* pass,
     model_id_t model, const instance_t* instances, uint32_t count);
 
+// instances are sorted by level of detail, the first lod_counts[0]
+// drawn at the finest level, the next lod_counts[1] at the next one,
+// and so on. meshes with fewer levels draw the rest with the coarsest.
+// clusters of the meshes are culled against the instances, using the
+// globals of the pass, which must have been updated for the frame.
+void geometry_pass_update_model_lod_instances(geometry_pass_t* pass,
+    model_id_t model, const instance_t* instances,
+    const uint32_t lod_counts[GEOMETRY_PASS_MAX_LODS]);
+
+// points are read 3 floats at a time, which need not be aligned,
+// so that they can be taken straight from a mapped file.
+typedef struct {
+    const void* positions;
+    uint32_t position_stride;   // in bytes
+    const uint8_t* colors;      // optional, white if missing
+    uint32_t color_stride;
+    uint32_t color_components;  // 3: rgb, 4: rgba
+    uint32_t num_points;
+    const char* label;
+} point_cloud_desc_t;
+
+// content of a point cloud, whose buffer is yet to be created
+typedef struct {
+    point_cloud_t cloud;        // all but the buffer
+    point_vertex_t* vertices;   // ordered by chunk
+} point_cloud_data_t;
+
+// the octree is built by sorting the points along a Morton curve, so
+// that each chunk picks its subsample evenly spaced along it. as for
+// meshes, building can run on any thread, and uploading only on the
+// one owning the pass. the descriptor is not referred to afterwards.
+bool geometry_pass_build_point_cloud(jobs_t* jobs,
+    const point_cloud_desc_t* desc, point_cloud_data_t* out_data);
+
+// the data is released whether or not the point cloud could be made
+point_cloud_id_t geometry_pass_upload_point_cloud(geometry_pass_t* pass,
+    point_cloud_data_t* data);
+
+void geometry_pass_release_point_cloud_data(point_cloud_data_t* data);
+
+point_cloud_id_t geometry_pass_make_point_cloud(geometry_pass_t* pass,
+    const point_cloud_desc_t* desc);
+
+void geometry_pass_destroy_point_cloud(geometry_pass_t* pass,
+    point_cloud_id_t cloud);
+
+typedef struct {
+    mat4f_t pose;
+    uint32_t point_budget;      // points drawn at most
+    mfloat_t viewport_height;   // in pixels
+    mfloat_t point_size;        // in pixels, where the backend allows
+} point_cloud_view_t;
+
+/**
+ * Select the chunks of the cloud to draw, the largest on screen first,
+ * within the frustum, refining a chunk with its children until its
+ * points are no farther apart on screen than they are large, or the
+ * budget is spent, though the root chunk is drawn whatever the budget,
+ * if it is within the frustum. The globals of the pass must have been updated
+ * for the frame.
+ *
+ * @return the number of points drawn.
+ */
+uint32_t geometry_pass_update_point_cloud(geometry_pass_t* pass,
+    point_cloud_id_t cloud, const point_cloud_view_t* view);
+
 void geometry_pass_init(geometry_pass_t* pass);
 
 void geometry_pass_cleanup(geometry_pass_t* pass);
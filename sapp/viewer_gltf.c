@@ -0,0 +1,1708 @@
+#include "viewer_gltf.h"
+#include "viewer_json.h"
+#include "viewer_log.h"
+#include "viewer_memory.h"
+
+#include "stb_image.h"
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWER_GLTF_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VIEWER_GLTF_NEON
+#endif
+
+#define GLTF_GLB_MAGIC 0x46546C67       // glTF
+#define GLTF_GLB_VERSION 2
+#define GLTF_GLB_CHUNK_JSON 0x4E4F534A  // JSON
+#define GLTF_GLB_CHUNK_BIN 0x004E4942   // BIN
+#define GLTF_MODE_TRIANGLES 4
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef enum {
+    GLTF_BYTE = 5120,
+    GLTF_UNSIGNED_BYTE = 5121,
+    GLTF_SHORT = 5122,
+    GLTF_UNSIGNED_SHORT = 5123,
+    GLTF_UNSIGNED_INT = 5125,
+    GLTF_FLOAT = 5126
+} __gltf_component_t;
+
+// elements of an accessor, within the bounds of its buffer
+typedef struct {
+    const uint8_t* data;    // NULL if the attribute is missing
+    uint32_t count;
+    uint32_t stride;
+    uint32_t component_type;
+    uint32_t num_components;
+} __gltf_accessor_t;
+
+// a primitive, as placed by one of the nodes referencing its mesh
+typedef struct {
+    mat4f_t world;
+    __gltf_accessor_t positions;
+    __gltf_accessor_t normals;
+    __gltf_accessor_t uvs;
+    __gltf_accessor_t indices;
+    int32_t material_id;
+    int32_t mesh;       // model mesh, when the hierarchy is kept
+    uint32_t order;     // of the nodes, to keep it among the same material
+    uint32_t base_vertex;
+    uint32_t index_base;    // base vertex, within the mesh ones
+    uint32_t base_element;
+    uint32_t num_elements;
+    bool failed;
+} __gltf_instance_t;
+
+typedef struct {
+    const gltf_data_t* data;
+    gltf_model_t* model;
+    json_t json;
+    const uint8_t* buffers[GLTF_MAX_BUFFERS];
+    size_t buffer_sizes[GLTF_MAX_BUFFERS];
+    uint32_t num_buffers;
+    // tokens of the top level arrays, as elements are reached by index
+    int32_t* buffer_views;
+    uint32_t num_buffer_views;
+    int32_t* accessors;
+    uint32_t num_accessors;
+    int32_t* meshes;
+    uint32_t num_meshes;
+    int32_t* nodes;
+    uint32_t num_nodes;
+    int32_t* materials;
+    uint32_t num_materials;
+    int32_t* textures;
+    uint32_t num_textures;
+    int32_t* images;
+    uint32_t num_images;
+    __gltf_instance_t* instances;
+    uint32_t num_instances;
+    uint32_t capacity;
+    int32_t* mesh_indices;  // model mesh of each glTF one, -1 if unused
+    uint32_t nodes_capacity;
+} __gltf_t;
+
+static gltf_result_t __gltf_collect(__gltf_t* g, const char* key,
+    int32_t** out_tokens, uint32_t* out_count) {
+    int32_t array = json_find(&g->json, 0, key);
+    if (array < 0) {
+        return GLTF_RESULT_OK;
+    }
+
+    if (g->json.tokens[array].type != JSON_ARRAY) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    uint32_t count = g->json.tokens[array].size;
+    if (count == 0) {
+        return GLTF_RESULT_OK;
+    }
+
+    int32_t* tokens = memory_malloc(sizeof(int32_t) * count);
+    if (!tokens) {
+        return GLTF_RESULT_OUT_OF_MEMORY;
+    }
+
+    uint32_t t = (uint32_t)array + 1;
+    for (uint32_t e = 0; e < count; ++e) {
+        tokens[e] = (int32_t)t;
+        t = g->json.tokens[t].next;
+    }
+
+    *out_tokens = tokens;
+    *out_count = count;
+    return GLTF_RESULT_OK;
+}
+
+// element of one of the top level arrays, -1 if out of range
+static int32_t __gltf_token(const int32_t* tokens, uint32_t count,
+    int32_t token_index, const json_t* json) {
+    double index = json_number(json, token_index, -1.);
+    return (index >= 0. && index < (double)count) ? tokens[(uint32_t)index] : -1;
+}
+
+static uint32_t __gltf_uint(const json_t* json, int32_t object,
+    const char* key, uint32_t def) {
+    double value = json_number(json, json_find(json, object, key), (double)def);
+    return (value >= 0. && value <= (double)UINT32_MAX) ? (uint32_t)value : def;
+}
+
+static void __gltf_floats(const json_t* json, int32_t array,
+    float* out, uint32_t count) {
+    if (array < 0 || json->tokens[array].type != JSON_ARRAY
+        || json->tokens[array].size < count) {
+        return;
+    }
+
+    uint32_t t = (uint32_t)array + 1;
+    for (uint32_t e = 0; e < count; ++e) {
+        out[e] = (float)json_number(json, (int32_t)t, (double)out[e]);
+        t = json->tokens[t].next;
+    }
+}
+
+static void __gltf_make_path(const gltf_data_t* data, const char* uri,
+    char* out_path) {
+    if (data->base_path && data->base_path[0]) {
+        snprintf(out_path, GLTF_MAX_PATH, "%s/%s", data->base_path, uri);
+    }
+    else {
+        snprintf(out_path, GLTF_MAX_PATH, "%s", uri);
+    }
+}
+
+// the first chunk of GLB containers is the JSON document,
+// which can be followed by the binary one, the first buffer.
+static gltf_result_t __gltf_read_container(__gltf_t* g,
+    const char** out_json, size_t* out_size,
+    const uint8_t** out_bin, size_t* out_bin_size) {
+    const uint8_t* bytes = (const uint8_t*)g->data->gltf_data;
+    size_t size = g->data->data_size;
+    uint32_t header[3];
+    if (size < sizeof(header)) {
+        *out_json = (const char*)bytes;
+        *out_size = size;
+        return GLTF_RESULT_OK;
+    }
+
+    memcpy(header, bytes, sizeof(header));
+    if (header[0] != GLTF_GLB_MAGIC) {
+        *out_json = (const char*)bytes;
+        *out_size = size;
+        return GLTF_RESULT_OK;
+    }
+
+    if (header[1] != GLTF_GLB_VERSION) {
+        return GLTF_RESULT_UNSUPPORTED;
+    }
+
+    size = header[2] < size ? header[2] : size;
+    size_t offset = sizeof(header);
+    while (offset + 2 * sizeof(uint32_t) <= size) {
+        uint32_t chunk[2];
+        memcpy(chunk, bytes + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > size - offset) {
+            return GLTF_RESULT_INVALID_FILE;
+        }
+
+        if (chunk[1] == GLTF_GLB_CHUNK_JSON && !*out_json) {
+            *out_json = (const char*)(bytes + offset);
+            *out_size = chunk[0];
+        }
+        else if (chunk[1] == GLTF_GLB_CHUNK_BIN && !*out_bin) {
+            *out_bin = bytes + offset;
+            *out_bin_size = chunk[0];
+        }
+
+        offset += chunk[0];
+    }
+
+    return *out_json ? GLTF_RESULT_OK : GLTF_RESULT_INVALID_FILE;
+}
+
+// external buffers are mapped, so that only the pages
+// which are accessed, if any, are ever read from disk.
+static gltf_result_t __gltf_map_buffers(__gltf_t* g,
+    const uint8_t* bin, size_t bin_size) {
+    int32_t* buffers = NULL;
+    uint32_t num_buffers = 0;
+    gltf_result_t result = __gltf_collect(g, "buffers", &buffers, &num_buffers);
+    if (result != GLTF_RESULT_OK) {
+        return result;
+    }
+
+    if (num_buffers > GLTF_MAX_BUFFERS) {
+        LOG_WARN("WARN: Too many buffers (%u) in (%s)\n",
+            num_buffers, g->model->trace.name);
+        result = GLTF_RESULT_UNSUPPORTED;
+    }
+
+    for (uint32_t b = 0; b < num_buffers && result == GLTF_RESULT_OK; ++b) {
+        uint32_t byte_length = __gltf_uint(&g->json, buffers[b], "byteLength", 0);
+        int32_t uri = json_find(&g->json, buffers[b], "uri");
+        if (uri < 0) {
+            // only the first buffer can be the binary chunk
+            g->buffers[b] = (b == 0) ? bin : NULL;
+            g->buffer_sizes[b] = (b == 0) ? bin_size : 0;
+        }
+        else {
+            char uri_path[GLTF_MAX_PATH];
+            char path[GLTF_MAX_PATH];
+            json_copy_string(&g->json, uri, uri_path, GLTF_MAX_PATH);
+            if (strncmp(uri_path, "data:", 5) == 0) {
+                LOG_WARN("WARN: Embedded buffers are not supported (%s)\n",
+                    g->model->trace.name);
+                result = GLTF_RESULT_UNSUPPORTED;
+                break;
+            }
+
+            __gltf_make_path(g->data, uri_path, path);
+            file_map_t* map = &g->model->buffers[g->model->num_buffers];
+            if (file_map(path, map)) {
+                ++g->model->num_buffers;
+                g->buffers[b] = (const uint8_t*)map->data;
+                g->buffer_sizes[b] = map->size;
+            }
+            else {
+                LOG_WARN("WARN: Cannot map buffer (%s)\n", path);
+            }
+        }
+
+        if (!g->buffers[b] || g->buffer_sizes[b] < byte_length) {
+            result = GLTF_RESULT_MISSING_BUFFER;
+        }
+    }
+
+    g->num_buffers = num_buffers;
+    if (buffers) {
+        memory_free(buffers);
+    }
+
+    return result;
+}
+
+static uint32_t __gltf_component_size(uint32_t component_type) {
+    switch (component_type) {
+        case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: return 1;
+        case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: return 2;
+        case GLTF_UNSIGNED_INT: case GLTF_FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+static uint32_t __gltf_num_components(const json_t* json, int32_t type) {
+    return json_equals(json, type, "SCALAR") ? 1
+        : json_equals(json, type, "VEC2") ? 2
+        : json_equals(json, type, "VEC3") ? 3
+        : json_equals(json, type, "VEC4") ? 4 : 0;
+}
+
+// resolve the accessor into its buffer, checking that all of its
+// elements are within the view, and the view within the buffer
+static gltf_result_t __gltf_accessor(const __gltf_t* g, int32_t index_token,
+    __gltf_accessor_t* out) {
+    const json_t* json = &g->json;
+    int32_t accessor = __gltf_token(g->accessors, g->num_accessors,
+        index_token, json);
+    if (accessor < 0) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    int32_t view = __gltf_token(g->buffer_views, g->num_buffer_views,
+        json_find(json, accessor, "bufferView"), json);
+    if (view < 0 || json_find(json, accessor, "sparse") >= 0) {
+        LOG_WARN("WARN: Sparse accessors are not supported (%s)\n",
+            g->model->trace.name);
+        return GLTF_RESULT_UNSUPPORTED;
+    }
+
+    uint32_t component_type = __gltf_uint(json, accessor, "componentType", 0);
+    uint32_t num_components = __gltf_num_components(json,
+        json_find(json, accessor, "type"));
+    uint32_t element_size = __gltf_component_size(component_type) * num_components;
+    uint32_t buffer = __gltf_uint(json, view, "buffer", UINT32_MAX);
+    if (element_size == 0 || buffer >= g->num_buffers) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    uint64_t view_offset = __gltf_uint(json, view, "byteOffset", 0);
+    uint64_t view_length = __gltf_uint(json, view, "byteLength", 0);
+    uint64_t offset = __gltf_uint(json, accessor, "byteOffset", 0);
+    uint32_t stride = __gltf_uint(json, view, "byteStride", element_size);
+    uint32_t count = __gltf_uint(json, accessor, "count", 0);
+    if (view_offset + view_length > g->buffer_sizes[buffer]
+        || (count > 0 && offset + (uint64_t)(count - 1) * stride
+            + element_size > view_length)) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    *out = (__gltf_accessor_t){
+        .data = g->buffers[buffer] + view_offset + offset,
+        .count = count,
+        .stride = stride,
+        .component_type = component_type,
+        .num_components = num_components
+    };
+
+    return GLTF_RESULT_OK;
+}
+
+// translation, scale without shear, and rotation of an affine matrix,
+// whose mirroring, if any, is kept by the x scale
+static transform_t __gltf_decompose(const mat4f_t* matrix) {
+    const mfloat_t* m = matrix->v;
+    vec3f_t axes[3] = {
+        svec3(m[0], m[1], m[2]),
+        svec3(m[4], m[5], m[6]),
+        svec3(m[8], m[9], m[10])
+    };
+
+    vec3f_t scale = svec3(svec3_length(axes[0]),
+        svec3_length(axes[1]), svec3_length(axes[2]));
+    if (svec3_dot(svec3_cross(axes[0], axes[1]), axes[2]) < 0.f) {
+        scale.x = -scale.x;
+    }
+
+    for (int32_t a = 0; a < 3; ++a) {
+        if (scale.v[a] == 0.f) {
+            return (transform_t){
+                .position = svec3(m[12], m[13], m[14]),
+                .scale = svec3_zero(),
+                .rotation = squat_null()
+            };
+        }
+
+        axes[a] = svec3_multiply_f(axes[a], 1.f / scale.v[a]);
+    }
+
+    return (transform_t){
+        .position = svec3(m[12], m[13], m[14]),
+        .scale = scale,
+        .rotation = squat_from_axes(axes[0], axes[1], axes[2])
+    };
+}
+
+static transform_t __gltf_local_transform(const json_t* json, int32_t node) {
+    int32_t matrix = json_find(json, node, "matrix");
+    if (matrix >= 0) {
+        // both column major
+        mat4f_t local = smat4_identity();
+        __gltf_floats(json, matrix, local.v, 16);
+        return __gltf_decompose(&local);
+    }
+
+    float translation[3] = {0.f, 0.f, 0.f};
+    float scale[3] = {1.f, 1.f, 1.f};
+    float rotation[4] = {0.f, 0.f, 0.f, 1.f};
+    __gltf_floats(json, json_find(json, node, "translation"), translation, 3);
+    __gltf_floats(json, json_find(json, node, "scale"), scale, 3);
+    __gltf_floats(json, json_find(json, node, "rotation"), rotation, 4);
+
+    return (transform_t){
+        .position = {.x = translation[0], .y = translation[1], .z = translation[2]},
+        .scale = {.x = scale[0], .y = scale[1], .z = scale[2]},
+        .rotation = {.x = rotation[0], .y = rotation[1],
+            .z = rotation[2], .w = rotation[3]}
+    };
+}
+
+static mat4f_t __gltf_local_matrix(const json_t* json, int32_t node) {
+    int32_t matrix = json_find(json, node, "matrix");
+    mat4f_t local = smat4_identity();
+    if (matrix >= 0) {
+        __gltf_floats(json, matrix, local.v, 16);
+        return local;
+    }
+
+    return transform_to_mat4(__gltf_local_transform(json, node));
+}
+
+static void __gltf_copy_name(const json_t* json, int32_t object,
+    trace_t* out_trace, const char* label, const char* kind, uint32_t index) {
+    if (!json_copy_string(json, json_find(json, object, "name"),
+        out_trace->name, TRACE_MAX_NAME_CHARS) || !out_trace->name[0]) {
+        trace_printf(out_trace, "%s-%s%u", label, kind, index);
+    }
+}
+
+static gltf_result_t __gltf_add_primitive(__gltf_t* g, int32_t primitive,
+    const mat4f_t* world, int32_t mesh) {
+    const json_t* json = &g->json;
+    if (__gltf_uint(json, primitive, "mode", GLTF_MODE_TRIANGLES)
+        != GLTF_MODE_TRIANGLES) {
+        return GLTF_RESULT_OK;
+    }
+
+    if (g->num_instances == g->capacity) {
+        uint32_t capacity = g->capacity ? 2 * g->capacity : 64;
+        __gltf_instance_t* instances = memory_realloc(g->instances,
+            sizeof(__gltf_instance_t) * capacity);
+        if (!instances) {
+            return GLTF_RESULT_OUT_OF_MEMORY;
+        }
+
+        g->instances = instances;
+        g->capacity = capacity;
+    }
+
+    __gltf_instance_t instance = {
+        .world = *world,
+        .material_id = -1,
+        .mesh = mesh,
+        .order = g->num_instances
+    };
+
+    double material = json_number(json, json_find(json, primitive, "material"), -1.);
+    if (material >= 0. && material < (double)g->num_materials) {
+        instance.material_id = (int32_t)material;
+    }
+
+    int32_t attributes = json_find(json, primitive, "attributes");
+    int32_t position = json_find(json, attributes, "POSITION");
+    int32_t normal = json_find(json, attributes, "NORMAL");
+    int32_t uv = json_find(json, attributes, "TEXCOORD_0");
+    int32_t indices = json_find(json, primitive, "indices");
+
+    gltf_result_t result = __gltf_accessor(g, position, &instance.positions);
+    if (result == GLTF_RESULT_OK && normal >= 0) {
+        result = __gltf_accessor(g, normal, &instance.normals);
+    }
+
+    if (result == GLTF_RESULT_OK && uv >= 0) {
+        result = __gltf_accessor(g, uv, &instance.uvs);
+    }
+
+    if (result == GLTF_RESULT_OK && indices >= 0) {
+        result = __gltf_accessor(g, indices, &instance.indices);
+    }
+
+    if (result != GLTF_RESULT_OK) {
+        return result;
+    }
+
+    uint32_t num_vertices = instance.positions.count;
+    if (instance.positions.component_type != GLTF_FLOAT
+        || instance.positions.num_components != 3
+        || (instance.normals.data && (instance.normals.count != num_vertices
+            || instance.normals.component_type != GLTF_FLOAT
+            || instance.normals.num_components != 3))
+        || (instance.uvs.data && (instance.uvs.count != num_vertices
+            || instance.uvs.num_components != 2
+            || instance.uvs.component_type == GLTF_UNSIGNED_INT))
+        || (instance.indices.data && (instance.indices.num_components != 1
+            || instance.indices.component_type == GLTF_BYTE
+            || instance.indices.component_type == GLTF_SHORT
+            || instance.indices.component_type == GLTF_FLOAT))) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    uint32_t num_elements = instance.indices.data
+        ? instance.indices.count : num_vertices;
+    instance.num_elements = num_elements - num_elements % 3;
+    if (num_vertices > 0 && instance.num_elements > 0) {
+        g->instances[g->num_instances++] = instance;
+    }
+
+    return GLTF_RESULT_OK;
+}
+
+static gltf_result_t __gltf_add_primitives(__gltf_t* g, int32_t mesh,
+    const mat4f_t* world, int32_t model_mesh) {
+    const json_t* json = &g->json;
+    int32_t primitives = json_find(json, mesh, "primitives");
+    if (primitives < 0 || json->tokens[primitives].type != JSON_ARRAY) {
+        return GLTF_RESULT_OK;
+    }
+
+    uint32_t t = (uint32_t)primitives + 1;
+    for (uint32_t p = 0; p < json->tokens[primitives].size; ++p) {
+        gltf_result_t result = __gltf_add_primitive(g, (int32_t)t,
+            world, model_mesh);
+        if (result != GLTF_RESULT_OK) {
+            return result;
+        }
+
+        t = json->tokens[t].next;
+    }
+
+    return GLTF_RESULT_OK;
+}
+
+// list the node, after its parent, along with the mesh it references
+static gltf_result_t __gltf_list_node(__gltf_t* g, int32_t node,
+    int32_t parent, int32_t* out_index) {
+    const json_t* json = &g->json;
+    gltf_model_t* model = g->model;
+    if (model->num_nodes == g->nodes_capacity) {
+        uint32_t capacity = g->nodes_capacity ? 2 * g->nodes_capacity : 64;
+        gltf_node_t* nodes = memory_realloc(model->nodes,
+            sizeof(gltf_node_t) * capacity);
+        if (!nodes) {
+            return GLTF_RESULT_OUT_OF_MEMORY;
+        }
+
+        model->nodes = nodes;
+        g->nodes_capacity = capacity;
+    }
+
+    double mesh = json_number(json, json_find(json, node, "mesh"), -1.);
+    int32_t mesh_index = (mesh >= 0. && mesh < (double)g->num_meshes)
+        ? (int32_t)mesh : -1;
+
+    // meshes are numbered later on, in the order of the file
+    if (mesh_index >= 0) {
+        g->mesh_indices[mesh_index] = 0;
+    }
+
+    *out_index = (int32_t)model->num_nodes;
+    gltf_node_t* out_node = &model->nodes[model->num_nodes++];
+    *out_node = (gltf_node_t){
+        .transform = __gltf_local_transform(json, node),
+        .parent = parent,
+        .mesh = mesh_index
+    };
+
+    __gltf_copy_name(json, node, &out_node->trace, model->trace.name,
+        "node", (uint32_t)*out_index);
+    return GLTF_RESULT_OK;
+}
+
+// either flatten the node primitives into scene space,
+// or list the node, whose mesh is loaded only once.
+static gltf_result_t __gltf_add_node(__gltf_t* g, int32_t node_index,
+    const mat4f_t* parent, int32_t parent_index, uint32_t depth) {
+    const json_t* json = &g->json;
+    int32_t node = __gltf_token(g->nodes, g->num_nodes, node_index, json);
+    if (node < 0 || depth == GLTF_MAX_NODE_DEPTH) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    mat4f_t world = smat4_identity();
+    int32_t index = -1;
+    gltf_result_t result = GLTF_RESULT_OK;
+    if (g->data->keep_hierarchy) {
+        result = __gltf_list_node(g, node, parent_index, &index);
+    }
+    else {
+        world = smat4_multiply(*parent, __gltf_local_matrix(json, node));
+        int32_t mesh = __gltf_token(g->meshes, g->num_meshes,
+            json_find(json, node, "mesh"), json);
+        result = __gltf_add_primitives(g, mesh, &world, -1);
+    }
+
+    int32_t children = json_find(json, node, "children");
+    if (children >= 0 && json->tokens[children].type == JSON_ARRAY) {
+        uint32_t t = (uint32_t)children + 1;
+        for (uint32_t c = 0; c < json->tokens[children].size
+            && result == GLTF_RESULT_OK; ++c) {
+            result = __gltf_add_node(g, (int32_t)t, &world, index, depth + 1);
+            t = json->tokens[t].next;
+        }
+    }
+
+    return result;
+}
+
+// the meshes referenced by the nodes, each in its own space
+static gltf_result_t __gltf_add_meshes(__gltf_t* g) {
+    gltf_model_t* model = g->model;
+    uint32_t num_meshes = 0;
+    for (uint32_t m = 0; m < g->num_meshes; ++m) {
+        num_meshes += (g->mesh_indices[m] >= 0) ? 1 : 0;
+    }
+
+    if (num_meshes > 0) {
+        model->meshes = memory_calloc(num_meshes, sizeof(gltf_mesh_t));
+        if (!model->meshes) {
+            return GLTF_RESULT_OUT_OF_MEMORY;
+        }
+    }
+
+    mat4f_t identity = smat4_identity();
+    for (uint32_t m = 0; m < g->num_meshes; ++m) {
+        if (g->mesh_indices[m] < 0) {
+            continue;
+        }
+
+        int32_t model_mesh = (int32_t)model->num_meshes++;
+        g->mesh_indices[m] = model_mesh;
+        __gltf_copy_name(&g->json, g->meshes[m], &model->meshes[model_mesh].trace,
+            model->trace.name, "mesh", m);
+
+        gltf_result_t result = __gltf_add_primitives(g, g->meshes[m],
+            &identity, model_mesh);
+        if (result != GLTF_RESULT_OK) {
+            return result;
+        }
+    }
+
+    for (uint32_t n = 0; n < model->num_nodes; ++n) {
+        gltf_node_t* node = &model->nodes[n];
+        node->mesh = (node->mesh >= 0) ? g->mesh_indices[node->mesh] : -1;
+    }
+
+    return GLTF_RESULT_OK;
+}
+
+static gltf_result_t __gltf_add_scene(__gltf_t* g) {
+    const json_t* json = &g->json;
+    int32_t scenes = json_find(json, 0, "scenes");
+    uint32_t scene_index = __gltf_uint(json, 0, "scene", 0);
+    int32_t scene = json_element(json, scenes, scene_index);
+    int32_t roots = json_find(json, scene, "nodes");
+    if (roots < 0 || json->tokens[roots].type != JSON_ARRAY) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    if (g->data->keep_hierarchy && g->num_meshes > 0) {
+        g->mesh_indices = memory_malloc(sizeof(int32_t) * g->num_meshes);
+        if (!g->mesh_indices) {
+            return GLTF_RESULT_OUT_OF_MEMORY;
+        }
+
+        memset(g->mesh_indices, 0xFF, sizeof(int32_t) * g->num_meshes);
+    }
+
+    mat4f_t identity = smat4_identity();
+    uint32_t t = (uint32_t)roots + 1;
+    for (uint32_t r = 0; r < json->tokens[roots].size; ++r) {
+        gltf_result_t result = __gltf_add_node(g, (int32_t)t, &identity, -1, 0);
+        if (result != GLTF_RESULT_OK) {
+            return result;
+        }
+
+        t = json->tokens[t].next;
+    }
+
+    return (g->data->keep_hierarchy && g->mesh_indices)
+        ? __gltf_add_meshes(g) : GLTF_RESULT_OK;
+}
+
+static int __gltf_compare_instances(const void* a, const void* b) {
+    const __gltf_instance_t* lhs = (const __gltf_instance_t*)a;
+    const __gltf_instance_t* rhs = (const __gltf_instance_t*)b;
+    if (lhs->mesh != rhs->mesh) {
+        return lhs->mesh < rhs->mesh ? -1 : 1;
+    }
+
+    if (lhs->material_id != rhs->material_id) {
+        return lhs->material_id < rhs->material_id ? -1 : 1;
+    }
+
+    return lhs->order < rhs->order ? -1 : (lhs->order > rhs->order ? 1 : 0);
+}
+
+static bool __gltf_is_identity(const mat4f_t* m) {
+    for (uint32_t i = 0; i < 16; ++i) {
+        if (m->v[i] != ((i % 5 == 0) ? 1.f : 0.f)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// whether the primitive can be drawn straight from the buffers: in place,
+// with its attributes interleaved exactly as vertex_t, and 32-bit indices.
+static bool __gltf_is_mesh_layout(const __gltf_instance_t* instance) {
+    const __gltf_accessor_t* positions = &instance->positions;
+    const __gltf_accessor_t* normals = &instance->normals;
+    const __gltf_accessor_t* uvs = &instance->uvs;
+    const __gltf_accessor_t* indices = &instance->indices;
+    return __gltf_is_identity(&instance->world)
+        && positions->stride == sizeof(vertex_t)
+        && ((uintptr_t)positions->data % sizeof(float)) == 0
+        && normals->data == positions->data + offsetof(vertex_t, norm)
+        && normals->stride == sizeof(vertex_t)
+        && uvs->data == positions->data + offsetof(vertex_t, uv)
+        && uvs->stride == sizeof(vertex_t)
+        && uvs->component_type == GLTF_FLOAT
+        && indices->data
+        && indices->component_type == GLTF_UNSIGNED_INT
+        && indices->stride == sizeof(uint32_t)
+        && ((uintptr_t)indices->data % sizeof(uint32_t)) == 0;
+}
+
+// normals are moved by the cofactors of the upper 3x3 of the transform,
+// which are its inverse transpose scaled by its determinant, whose sign
+// is kept, so that they are not flipped when normalised afterwards.
+static float __gltf_normal_matrix(const float* m, float* out_columns) {
+    const float* a = &m[0];
+    const float* b = &m[4];
+    const float* c = &m[8];
+    float columns[12] = {
+        b[1] * c[2] - b[2] * c[1], b[2] * c[0] - b[0] * c[2], b[0] * c[1] - b[1] * c[0], 0.f,
+        c[1] * a[2] - c[2] * a[1], c[2] * a[0] - c[0] * a[2], c[0] * a[1] - c[1] * a[0], 0.f,
+        a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0], 0.f
+    };
+
+    float det = a[0] * columns[0] + a[1] * columns[1] + a[2] * columns[2];
+    float sign = det < 0.f ? -1.f : 1.f;
+    for (uint32_t i = 0; i < 12; ++i) {
+        out_columns[i] = sign * columns[i];
+    }
+
+    return det;
+}
+
+// positions and normals into scene space, one vertex per iteration, 4 wide.
+// the positions store spills over the normal x, and the normals one over
+// the u, both written right after, but all within the same vertex_t.
+static void __gltf_transform_vertices(const mat4f_t* world,
+    const float* normal_matrix, const __gltf_accessor_t* positions,
+    const __gltf_accessor_t* normals, vertex_t* out_vertices) {
+    const float* m = world->v;
+    const float* n = normal_matrix;
+    uint32_t count = positions->count;
+    uint32_t v = 0;
+
+#if defined(VIEWER_GLTF_SSE2)
+    __m128 c0 = _mm_loadu_ps(&m[0]);
+    __m128 c1 = _mm_loadu_ps(&m[4]);
+    __m128 c2 = _mm_loadu_ps(&m[8]);
+    __m128 c3 = _mm_loadu_ps(&m[12]);
+    __m128 n0 = _mm_loadu_ps(&n[0]);
+    __m128 n1 = _mm_loadu_ps(&n[4]);
+    __m128 n2 = _mm_loadu_ps(&n[8]);
+    __m128 min_length = _mm_set1_ps(FLT_MIN);
+    for (; v < count; ++v) {
+        const float* p = (const float*)(positions->data + (size_t)v * positions->stride);
+        __m128 pos = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+            _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+        _mm_storeu_ps(&out_vertices[v].pos.x, pos);
+
+        __m128 norm = _mm_setzero_ps();
+        if (normals->data) {
+            const float* q = (const float*)(normals->data + (size_t)v * normals->stride);
+            norm = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(n0, _mm_set1_ps(q[0])), _mm_mul_ps(n1, _mm_set1_ps(q[1]))),
+                _mm_mul_ps(n2, _mm_set1_ps(q[2])));
+
+            __m128 sq = _mm_mul_ps(norm, norm);
+            __m128 length = _mm_add_ps(_mm_add_ps(
+                _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(0, 0, 0, 0)),
+                _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))),
+                _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+            norm = _mm_and_ps(_mm_div_ps(norm, _mm_sqrt_ps(length)),
+                _mm_cmpgt_ps(length, min_length));
+        }
+
+        _mm_storeu_ps(&out_vertices[v].norm.x, norm);
+    }
+#elif defined(VIEWER_GLTF_NEON)
+    float32x4_t c0 = vld1q_f32(&m[0]);
+    float32x4_t c1 = vld1q_f32(&m[4]);
+    float32x4_t c2 = vld1q_f32(&m[8]);
+    float32x4_t c3 = vld1q_f32(&m[12]);
+    float32x4_t n0 = vld1q_f32(&n[0]);
+    float32x4_t n1 = vld1q_f32(&n[4]);
+    float32x4_t n2 = vld1q_f32(&n[8]);
+    for (; v < count; ++v) {
+        const float* p = (const float*)(positions->data + (size_t)v * positions->stride);
+        float32x4_t pos = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(c3,
+            c0, p[0]), c1, p[1]), c2, p[2]);
+        vst1q_f32(&out_vertices[v].pos.x, pos);
+
+        float32x4_t norm = vdupq_n_f32(0.f);
+        if (normals->data) {
+            const float* q = (const float*)(normals->data + (size_t)v * normals->stride);
+            norm = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(n0, q[0]), n1, q[1]), n2, q[2]);
+
+            float32x4_t sq = vmulq_f32(norm, norm);
+            float length = vgetq_lane_f32(sq, 0) + vgetq_lane_f32(sq, 1)
+                + vgetq_lane_f32(sq, 2);
+            norm = (length > FLT_MIN)
+                ? vmulq_n_f32(norm, 1.f / sqrtf(length)) : vdupq_n_f32(0.f);
+        }
+
+        vst1q_f32(&out_vertices[v].norm.x, norm);
+    }
+#endif
+
+    for (; v < count; ++v) {
+        const float* p = (const float*)(positions->data + (size_t)v * positions->stride);
+        vertex_t* vertex = &out_vertices[v];
+        vertex->pos = (vec3f_t){
+            .x = m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12],
+            .y = m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13],
+            .z = m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]
+        };
+
+        vertex->norm = (vec3f_t){0};
+        if (normals->data) {
+            const float* q = (const float*)(normals->data + (size_t)v * normals->stride);
+            vec3f_t norm = {
+                .x = n[0] * q[0] + n[4] * q[1] + n[8] * q[2],
+                .y = n[1] * q[0] + n[5] * q[1] + n[9] * q[2],
+                .z = n[2] * q[0] + n[6] * q[1] + n[10] * q[2]
+            };
+
+            float length = norm.x * norm.x + norm.y * norm.y + norm.z * norm.z;
+            if (length > FLT_MIN) {
+                vertex->norm = svec3_multiply_f(norm, 1.f / sqrtf(length));
+            }
+        }
+    }
+}
+
+static float __gltf_read_component(const uint8_t* p, uint32_t component_type) {
+    switch (component_type) {
+        case GLTF_UNSIGNED_BYTE: return (float)p[0] / 255.f;
+        case GLTF_UNSIGNED_SHORT: {
+            uint16_t value;
+            memcpy(&value, p, sizeof(value));
+            return (float)value / 65535.f;
+        }
+        case GLTF_BYTE: {
+            float value = (float)(int8_t)p[0] / 127.f;
+            return value < -1.f ? -1.f : value;
+        }
+        case GLTF_SHORT: {
+            int16_t value;
+            memcpy(&value, p, sizeof(value));
+            return value < -32767 ? -1.f : (float)value / 32767.f;
+        }
+        default: {
+            float value;
+            memcpy(&value, p, sizeof(value));
+            return value;
+        }
+    }
+}
+
+static void __gltf_copy_uvs(const __gltf_accessor_t* uvs,
+    vertex_t* out_vertices, uint32_t count) {
+    if (!uvs->data) {
+        for (uint32_t v = 0; v < count; ++v) {
+            out_vertices[v].uv = (vec2f_t){0};
+        }
+        return;
+    }
+
+    uint32_t size = __gltf_component_size(uvs->component_type);
+    for (uint32_t v = 0; v < count; ++v) {
+        const uint8_t* p = uvs->data + (size_t)v * uvs->stride;
+        out_vertices[v].uv = (vec2f_t){
+            .x = __gltf_read_component(p, uvs->component_type),
+            .y = __gltf_read_component(p + size, uvs->component_type)
+        };
+    }
+}
+
+static uint32_t __gltf_read_index(const __gltf_accessor_t* indices, uint32_t i) {
+    const uint8_t* p = indices->data + (size_t)i * indices->stride;
+    switch (indices->component_type) {
+        case GLTF_UNSIGNED_BYTE: return p[0];
+        case GLTF_UNSIGNED_SHORT: {
+            uint16_t index;
+            memcpy(&index, p, sizeof(index));
+            return index;
+        }
+        default: {
+            uint32_t index;
+            memcpy(&index, p, sizeof(index));
+            return index;
+        }
+    }
+}
+
+// widen the indices to 32-bit, and offset them to the primitive vertices
+// within the mesh, 4 at a time when they are packed, checking that all
+// of them refer to the primitive vertices.
+static bool __gltf_copy_indices(const __gltf_accessor_t* indices,
+    uint32_t num_indices, uint32_t num_vertices, uint32_t base_vertex,
+    uint32_t* out_indices) {
+    if (!indices->data) {
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            out_indices[i] = base_vertex + i;
+        }
+        return true;
+    }
+
+    uint32_t i = 0;
+    bool invalid = false;
+    bool packed = indices->stride == __gltf_component_size(indices->component_type);
+
+#if defined(VIEWER_GLTF_SSE2)
+    // there are no unsigned comparisons, they are made signed by biasing
+    __m128i base = _mm_set1_epi32((int32_t)base_vertex);
+    __m128i bias = _mm_set1_epi32(INT32_MIN);
+    __m128i limit = _mm_set1_epi32((int32_t)((num_vertices - 1) ^ 0x80000000u));
+    __m128i out_of_range = _mm_setzero_si128();
+    if (packed && indices->component_type == GLTF_UNSIGNED_INT) {
+        for (; i + 4 <= num_indices; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(indices->data + 4 * i));
+            out_of_range = _mm_or_si128(out_of_range,
+                _mm_cmpgt_epi32(_mm_xor_si128(x, bias), limit));
+            _mm_storeu_si128((__m128i*)&out_indices[i], _mm_add_epi32(x, base));
+        }
+    }
+    else if (packed && indices->component_type == GLTF_UNSIGNED_SHORT) {
+        __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= num_indices; i += 8) {
+            __m128i x = _mm_loadu_si128((const __m128i*)(indices->data + 2 * i));
+            __m128i lo = _mm_unpacklo_epi16(x, zero);
+            __m128i hi = _mm_unpackhi_epi16(x, zero);
+            out_of_range = _mm_or_si128(out_of_range, _mm_or_si128(
+                _mm_cmpgt_epi32(_mm_xor_si128(lo, bias), limit),
+                _mm_cmpgt_epi32(_mm_xor_si128(hi, bias), limit)));
+            _mm_storeu_si128((__m128i*)&out_indices[i], _mm_add_epi32(lo, base));
+            _mm_storeu_si128((__m128i*)&out_indices[i + 4], _mm_add_epi32(hi, base));
+        }
+    }
+    invalid = _mm_movemask_epi8(out_of_range) != 0;
+#elif defined(VIEWER_GLTF_NEON)
+    uint32x4_t base = vdupq_n_u32(base_vertex);
+    uint32x4_t limit = vdupq_n_u32(num_vertices - 1);
+    uint32x4_t out_of_range = vdupq_n_u32(0);
+    if (packed && indices->component_type == GLTF_UNSIGNED_INT) {
+        for (; i + 4 <= num_indices; i += 4) {
+            uint32x4_t x = vld1q_u32((const uint32_t*)(indices->data + 4 * i));
+            out_of_range = vorrq_u32(out_of_range, vcgtq_u32(x, limit));
+            vst1q_u32(&out_indices[i], vaddq_u32(x, base));
+        }
+    }
+    else if (packed && indices->component_type == GLTF_UNSIGNED_SHORT) {
+        for (; i + 8 <= num_indices; i += 8) {
+            uint16x8_t x = vld1q_u16((const uint16_t*)(indices->data + 2 * i));
+            uint32x4_t lo = vmovl_u16(vget_low_u16(x));
+            uint32x4_t hi = vmovl_u16(vget_high_u16(x));
+            out_of_range = vorrq_u32(out_of_range, vorrq_u32(
+                vcgtq_u32(lo, limit), vcgtq_u32(hi, limit)));
+            vst1q_u32(&out_indices[i], vaddq_u32(lo, base));
+            vst1q_u32(&out_indices[i + 4], vaddq_u32(hi, base));
+        }
+    }
+    invalid = (vgetq_lane_u32(out_of_range, 0) | vgetq_lane_u32(out_of_range, 1)
+        | vgetq_lane_u32(out_of_range, 2) | vgetq_lane_u32(out_of_range, 3)) != 0;
+#else
+    (void)packed;
+#endif
+
+    for (; i < num_indices; ++i) {
+        uint32_t index = __gltf_read_index(indices, i);
+        invalid |= index >= num_vertices;
+        out_indices[i] = base_vertex + index;
+    }
+
+    return !invalid;
+}
+
+// area weighted face normals, for primitives without any
+static void __gltf_compute_normals(const uint32_t* indices,
+    uint32_t num_indices, uint32_t base_vertex,
+    vertex_t* vertices, uint32_t num_vertices) {
+    for (uint32_t i = 0; i < num_indices; i += 3) {
+        vertex_t* v0 = &vertices[indices[i + 0] - base_vertex];
+        vertex_t* v1 = &vertices[indices[i + 1] - base_vertex];
+        vertex_t* v2 = &vertices[indices[i + 2] - base_vertex];
+        vec3f_t normal = svec3_cross(svec3_subtract(v1->pos, v0->pos),
+            svec3_subtract(v2->pos, v0->pos));
+        v0->norm = svec3_add(v0->norm, normal);
+        v1->norm = svec3_add(v1->norm, normal);
+        v2->norm = svec3_add(v2->norm, normal);
+    }
+
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        vec3f_t norm = vertices[v].norm;
+        float length = norm.x * norm.x + norm.y * norm.y + norm.z * norm.z;
+        vertices[v].norm = (length > FLT_MIN)
+            ? svec3_multiply_f(norm, 1.f / sqrtf(length)) : (vec3f_t){0};
+    }
+}
+
+static void __gltf_convert_job(void* user_data, uint32_t index) {
+    __gltf_t* g = (__gltf_t*)user_data;
+    __gltf_instance_t* instance = &g->instances[index];
+    gltf_model_t* model = g->model;
+    uint32_t num_vertices = instance->positions.count;
+    vertex_t* vertices = model->owned_vertices + instance->base_vertex;
+    uint32_t* indices = model->owned_indices + instance->base_element;
+    uint32_t num_indices = instance->num_elements;
+
+    float normal_matrix[12];
+    float det = __gltf_normal_matrix(instance->world.v, normal_matrix);
+    __gltf_transform_vertices(&instance->world, normal_matrix,
+        &instance->positions, &instance->normals, vertices);
+    __gltf_copy_uvs(&instance->uvs, vertices, num_vertices);
+
+    if (!__gltf_copy_indices(&instance->indices, num_indices, num_vertices,
+        instance->index_base, indices)) {
+        instance->failed = true;
+        return;
+    }
+
+    // mirroring transforms turn the faces inside out
+    if (det < 0.f) {
+        for (uint32_t i = 0; i < num_indices; i += 3) {
+            uint32_t index = indices[i + 1];
+            indices[i + 1] = indices[i + 2];
+            indices[i + 2] = index;
+        }
+    }
+
+    if (!instance->normals.data) {
+        __gltf_compute_normals(indices, num_indices, instance->index_base,
+            vertices, num_vertices);
+    }
+}
+
+// texels of the texture referenced by a material texture info, NULL if
+// none, or if it cannot be decoded, in which case only factors are used
+static stbi_uc* __gltf_load_texture(const __gltf_t* g, int32_t texture_info,
+    int* out_width, int* out_height) {
+    const json_t* json = &g->json;
+    int32_t texture = __gltf_token(g->textures, g->num_textures,
+        json_find(json, texture_info, "index"), json);
+    int32_t image = __gltf_token(g->images, g->num_images,
+        json_find(json, texture, "source"), json);
+    if (image < 0) {
+        return NULL;
+    }
+
+    int components = 0;
+    stbi_uc* texels = NULL;
+    int32_t uri = json_find(json, image, "uri");
+    char uri_path[GLTF_MAX_PATH];
+    char path[GLTF_MAX_PATH];
+    if (uri >= 0) {
+        json_copy_string(json, uri, uri_path, GLTF_MAX_PATH);
+        if (strncmp(uri_path, "data:", 5) == 0) {
+            LOG_WARN("WARN: Embedded images are not supported (%s)\n",
+                g->model->trace.name);
+            return NULL;
+        }
+
+        __gltf_make_path(g->data, uri_path, path);
+        texels = stbi_load(path, out_width, out_height, &components, 4);
+    }
+    else {
+        int32_t view = __gltf_token(g->buffer_views, g->num_buffer_views,
+            json_find(json, image, "bufferView"), json);
+        uint32_t buffer = __gltf_uint(json, view, "buffer", UINT32_MAX);
+        uint64_t offset = __gltf_uint(json, view, "byteOffset", 0);
+        uint64_t length = __gltf_uint(json, view, "byteLength", 0);
+        snprintf(path, GLTF_MAX_PATH, "%s-image", g->model->trace.name);
+        if (buffer < g->num_buffers && length <= INT32_MAX
+            && offset + length <= g->buffer_sizes[buffer]) {
+            texels = stbi_load_from_memory(g->buffers[buffer] + offset,
+                (int)length, out_width, out_height, &components, 4);
+        }
+    }
+
+    if (!texels) {
+        LOG_WARN("WARN: Cannot load image (%s)\n", path);
+    }
+    else if (*out_width > UINT16_MAX || *out_height > UINT16_MAX) {
+        LOG_WARN("WARN: Image too large (%s)\n", path);
+        stbi_image_free(texels);
+        texels = NULL;
+    }
+
+    return texels;
+}
+
+// the texture, if any, multiplied by the factor, or the factor alone
+static bool __gltf_make_image(const __gltf_t* g, int32_t texture_info,
+    const float* factor, image_desc_t* out_image) {
+    int width = 1;
+    int height = 1;
+    stbi_uc* texels = __gltf_load_texture(g, texture_info, &width, &height);
+    if (!texels) {
+        width = height = 1;
+    }
+
+    size_t num_pixels = (size_t)width * height;
+    uint32_t* pixels = memory_malloc(sizeof(uint32_t) * num_pixels);
+    if (!pixels) {
+        if (texels) stbi_image_free(texels);
+        return false;
+    }
+
+    if (texels) {
+        for (size_t p = 0; p < num_pixels; ++p) {
+            const stbi_uc* texel = &texels[4 * p];
+            pixels[p] = image_pack_rgba(
+                factor[0] * texel[0] / 255.f, factor[1] * texel[1] / 255.f,
+                factor[2] * texel[2] / 255.f, factor[3] * texel[3] / 255.f);
+        }
+
+        stbi_image_free(texels);
+    }
+    else {
+        pixels[0] = image_pack_rgba(factor[0], factor[1], factor[2], factor[3]);
+    }
+
+    *out_image = (image_desc_t){
+        .width = (uint16_t)width,
+        .height = (uint16_t)height,
+        .layers = 1,
+        .pixels = pixels
+    };
+
+    return true;
+}
+
+static void __gltf_material_job(void* user_data, uint32_t index) {
+    __gltf_t* g = (__gltf_t*)user_data;
+    const json_t* json = &g->json;
+    int32_t material = g->materials[index];
+    gltf_material_t* out = &g->model->materials[index];
+
+    int32_t pbr = json_find(json, material, "pbrMetallicRoughness");
+    float base_color[4] = {1.f, 1.f, 1.f, 1.f};
+    __gltf_floats(json, json_find(json, pbr, "baseColorFactor"), base_color, 4);
+    int32_t alpha_mode = json_find(json, material, "alphaMode");
+    bool opaque = alpha_mode < 0 || json_equals(json, alpha_mode, "OPAQUE");
+
+    // specular exponent matching the roughness, normalised
+    // within [0, 1000], as the wavefront shininess is
+    float roughness = (float)json_number(json,
+        json_find(json, pbr, "roughnessFactor"), 1.);
+    float r4 = roughness * roughness * roughness * roughness;
+    float shininess = (r4 > 2.f / 1002.f) ? 2.f / r4 - 2.f : 1000.f;
+    float emissive[4] = {0.f, 0.f, 0.f, 0.f};
+    __gltf_floats(json, json_find(json, material, "emissiveFactor"), emissive, 3);
+    emissive[3] = shininess < 0.f ? 0.f : shininess / 1000.f;
+
+    bool albedo_made = __gltf_make_image(g,
+        json_find(json, pbr, "baseColorTexture"), base_color, &out->albedo);
+    bool emissive_made = __gltf_make_image(g,
+        json_find(json, material, "emissiveTexture"), emissive, &out->emissive);
+    if (albedo_made && opaque) {
+        image_fill_channel(out->albedo.pixels,
+            (uint32_t)out->albedo.width * out->albedo.height, 3, 0xFF);
+    }
+
+    if (!albedo_made || !emissive_made) {
+        if (albedo_made) memory_free(out->albedo.pixels);
+        if (emissive_made) memory_free(out->emissive.pixels);
+        *out = (gltf_material_t){0};
+    }
+}
+
+static gltf_result_t __gltf_build_geometry(__gltf_t* g) {
+    gltf_model_t* model = g->model;
+    uint64_t num_vertices = 0;
+    uint64_t num_indices = 0;
+    for (uint32_t i = 0; i < g->num_instances; ++i) {
+        __gltf_instance_t* instance = &g->instances[i];
+        instance->base_vertex = (uint32_t)num_vertices;
+        instance->index_base = (uint32_t)num_vertices;
+        instance->base_element = (uint32_t)num_indices;
+        num_vertices += instance->positions.count;
+        num_indices += instance->num_elements;
+
+        // meshes are made of their own vertices
+        if (instance->mesh >= 0) {
+            gltf_mesh_t* mesh = &model->meshes[instance->mesh];
+            if (mesh->num_primitives++ == 0) {
+                mesh->first_primitive = i;
+                mesh->base_vertex = instance->base_vertex;
+            }
+
+            instance->index_base = instance->base_vertex - mesh->base_vertex;
+            mesh->num_vertices += instance->positions.count;
+        }
+    }
+
+    if (num_indices == 0) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    if (num_vertices > UINT32_MAX || num_indices > UINT32_MAX) {
+        return GLTF_RESULT_UNSUPPORTED;
+    }
+
+    model->num_vertices = (uint32_t)num_vertices;
+    model->num_indices = (uint32_t)num_indices;
+
+    const __gltf_instance_t* first = &g->instances[0];
+    if (g->num_instances == 1 && __gltf_is_mesh_layout(first)) {
+        // only indices are read, and paged in, to check them
+        const uint32_t* indices = (const uint32_t*)first->indices.data;
+        uint32_t max_index = 0;
+        for (uint32_t i = 0; i < model->num_indices; ++i) {
+            max_index = indices[i] > max_index ? indices[i] : max_index;
+        }
+
+        if (max_index >= model->num_vertices) {
+            return GLTF_RESULT_INVALID_FILE;
+        }
+
+        model->vertices = (const vertex_t*)first->positions.data;
+        model->indices = indices;
+        return GLTF_RESULT_OK;
+    }
+
+    model->owned_vertices = memory_malloc(sizeof(vertex_t) * model->num_vertices);
+    model->owned_indices = memory_malloc(sizeof(uint32_t) * model->num_indices);
+    if (!model->owned_vertices || !model->owned_indices) {
+        return GLTF_RESULT_OUT_OF_MEMORY;
+    }
+
+    jobs_parallel_for(g->data->jobs, __gltf_convert_job, g, g->num_instances);
+    for (uint32_t i = 0; i < g->num_instances; ++i) {
+        if (g->instances[i].failed) {
+            return GLTF_RESULT_INVALID_FILE;
+        }
+    }
+
+    model->vertices = model->owned_vertices;
+    model->indices = model->owned_indices;
+    return GLTF_RESULT_OK;
+}
+
+static gltf_result_t __gltf_load(__gltf_t* g) {
+    const char* json_text = NULL;
+    size_t json_size = 0;
+    const uint8_t* bin = NULL;
+    size_t bin_size = 0;
+    gltf_result_t result = __gltf_read_container(g, &json_text, &json_size,
+        &bin, &bin_size);
+    if (result != GLTF_RESULT_OK) {
+        return result;
+    }
+
+    if (!json_parse(json_text, json_size, &g->json)
+        || g->json.tokens[0].type != JSON_OBJECT) {
+        return GLTF_RESULT_INVALID_FILE;
+    }
+
+    int32_t required = json_find(&g->json, 0, "extensionsRequired");
+    if (required >= 0 && g->json.tokens[required].size > 0) {
+        LOG_WARN("WARN: Required extensions are not supported (%s)\n",
+            g->model->trace.name);
+        return GLTF_RESULT_UNSUPPORTED;
+    }
+
+    result = __gltf_map_buffers(g, bin, bin_size);
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "bufferViews", &g->buffer_views, &g->num_buffer_views);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "accessors", &g->accessors, &g->num_accessors);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "meshes", &g->meshes, &g->num_meshes);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "nodes", &g->nodes, &g->num_nodes);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "materials", &g->materials, &g->num_materials);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "textures", &g->textures, &g->num_textures);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_collect(g, "images", &g->images, &g->num_images);
+    }
+
+    if (result == GLTF_RESULT_OK) {
+        result = __gltf_add_scene(g);
+    }
+
+    if (result != GLTF_RESULT_OK || g->num_instances == 0) {
+        return result != GLTF_RESULT_OK ? result : GLTF_RESULT_INVALID_FILE;
+    }
+
+    qsort(g->instances, g->num_instances, sizeof(__gltf_instance_t),
+        __gltf_compare_instances);
+
+    result = __gltf_build_geometry(g);
+    if (result != GLTF_RESULT_OK) {
+        return result;
+    }
+
+    gltf_model_t* model = g->model;
+    model->primitives = memory_malloc(sizeof(gltf_primitive_t) * g->num_instances);
+    if (!model->primitives) {
+        return GLTF_RESULT_OUT_OF_MEMORY;
+    }
+
+    model->num_primitives = g->num_instances;
+    for (uint32_t i = 0; i < g->num_instances; ++i) {
+        model->primitives[i] = (gltf_primitive_t){
+            .base_element = g->instances[i].base_element,
+            .num_elements = g->instances[i].num_elements,
+            .material_id = g->instances[i].material_id
+        };
+    }
+
+    if (g->num_materials > 0) {
+        model->materials = memory_calloc(g->num_materials, sizeof(gltf_material_t));
+        if (!model->materials) {
+            return GLTF_RESULT_OUT_OF_MEMORY;
+        }
+
+        model->num_materials = g->num_materials;
+        jobs_parallel_for(g->data->jobs, __gltf_material_job, g, g->num_materials);
+    }
+
+    return GLTF_RESULT_OK;
+}
+
+gltf_result_t gltf_load(const gltf_data_t* data, gltf_model_t* out_model) {
+    assert(data && data->gltf_data && out_model);
+    memset(out_model, 0, sizeof(gltf_model_t));
+    trace_printf(&out_model->trace, "%s", data->label ? data->label : "gltf");
+    out_model->num_lods = data->num_lods;
+
+    __gltf_t g = {
+        .data = data,
+        .model = out_model
+    };
+
+    gltf_result_t result = __gltf_load(&g);
+    if (result == GLTF_RESULT_OK) {
+        LOG_INFO("glTF model loaded (%s): vertices=%u, triangles=%u,"
+            " primitives=%u, materials=%u%s\n", out_model->trace.name,
+            out_model->num_vertices, out_model->num_indices / 3,
+            out_model->num_primitives, out_model->num_materials,
+            out_model->owned_vertices ? "" : ", mapped");
+    }
+    else {
+        LOG_WARN("WARN: Cannot load glTF model (%s), error %d\n",
+            out_model->trace.name, result);
+    }
+
+    json_release(&g.json);
+    if (g.buffer_views) memory_free(g.buffer_views);
+    if (g.accessors) memory_free(g.accessors);
+    if (g.meshes) memory_free(g.meshes);
+    if (g.nodes) memory_free(g.nodes);
+    if (g.materials) memory_free(g.materials);
+    if (g.textures) memory_free(g.textures);
+    if (g.images) memory_free(g.images);
+    if (g.instances) memory_free(g.instances);
+    if (g.mesh_indices) memory_free(g.mesh_indices);
+
+    return result;
+}
+
+void gltf_release(gltf_model_t* model) {
+    assert(model);
+
+    for (uint32_t m = 0; m < model->num_materials; ++m) {
+        if (model->materials[m].albedo.pixels) {
+            memory_free(model->materials[m].albedo.pixels);
+        }
+
+        if (model->materials[m].emissive.pixels) {
+            memory_free(model->materials[m].emissive.pixels);
+        }
+    }
+
+    if (model->materials) {
+        memory_free(model->materials);
+    }
+
+    if (model->primitives) {
+        memory_free(model->primitives);
+    }
+
+    if (model->meshes) {
+        memory_free(model->meshes);
+    }
+
+    if (model->nodes) {
+        memory_free(model->nodes);
+    }
+
+    if (model->owned_vertices) {
+        memory_free(model->owned_vertices);
+    }
+
+    if (model->owned_indices) {
+        memory_free(model->owned_indices);
+    }
+
+    for (uint32_t b = 0; b < model->num_buffers; ++b) {
+        file_unmap(&model->buffers[b]);
+    }
+
+    memset(model, 0, sizeof(gltf_model_t));
+}
+
+// build the mesh of a run of primitives, whose indices
+// are relative to the vertices from base_vertex on
+static bool __gltf_build_mesh(jobs_t* jobs, const gltf_model_t* model,
+    uint32_t first_primitive, uint32_t num_primitives,
+    uint32_t base_vertex, uint32_t num_vertices, const char* label,
+    vertex_layout_t layout, mesh_data_t* out_data,
+    int32_t* out_submesh_materials, uint32_t* out_num_submeshes) {
+    const gltf_primitive_t* primitives = &model->primitives[first_primitive];
+    uint32_t base_element = num_primitives ? primitives[0].base_element : 0;
+    uint32_t num_indices = 0;
+
+    mesh_submesh_desc_t submeshes[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes = 0;
+    bool too_many_submeshes = false;
+    for (uint32_t p = 0; p < num_primitives; ++p) {
+        const gltf_primitive_t* primitive = &primitives[p];
+        num_indices += primitive->num_elements;
+        if (too_many_submeshes) {
+            continue;
+        }
+
+        if (num_submeshes > 0
+            && out_submesh_materials[num_submeshes - 1] == primitive->material_id) {
+            submeshes[num_submeshes - 1].num_elements += primitive->num_elements;
+            continue;
+        }
+
+        if (num_submeshes == GEOMETRY_PASS_MAX_MESH_RANGES) {
+            LOG_WARN("WARN: Too many materials in (%s), drawn as a whole\n",
+                label);
+            too_many_submeshes = true;
+            num_submeshes = 0;
+            continue;
+        }
+
+        out_submesh_materials[num_submeshes] = primitive->material_id;
+        submeshes[num_submeshes++] = (mesh_submesh_desc_t){
+            .base_element = primitive->base_element - base_element,
+            .num_elements = primitive->num_elements
+        };
+    }
+
+    *out_num_submeshes = num_submeshes;
+    if (num_indices == 0) {
+        return false;
+    }
+
+    // each level of detail of each submesh is drawn separately
+    uint32_t num_lods = GEOMETRY_PASS_MAX_MODEL_DRAWS
+        / (num_submeshes ? num_submeshes : 1);
+    if (num_lods > model->num_lods) {
+        num_lods = model->num_lods;
+    }
+
+    return geometry_pass_build_mesh(jobs, &(mesh_desc_t){
+        .vertices = model->vertices + base_vertex,
+        .num_vertices = num_vertices,
+        .indices = model->indices + base_element,
+        .num_indices = num_indices,
+        .submeshes = num_submeshes ? submeshes : NULL,
+        .num_submeshes = num_submeshes,
+        .num_lods = num_lods > 0 ? num_lods : 1,
+        .layout = layout,
+        .label = label
+    }, out_data);
+}
+
+bool gltf_build_mesh(jobs_t* jobs, const gltf_model_t* model,
+    vertex_layout_t layout, mesh_data_t* out_data,
+    int32_t* out_submesh_materials, uint32_t* out_num_submeshes) {
+    assert(model && out_data);
+    assert(out_submesh_materials && out_num_submeshes);
+    return __gltf_build_mesh(jobs, model, 0, model->num_primitives,
+        0, model->num_vertices, model->trace.name, layout, out_data,
+        out_submesh_materials, out_num_submeshes);
+}
+
+// materials which could not be made are drawn with the default one
+static uint32_t __gltf_make_materials(geometry_pass_t* pass,
+    const gltf_model_t* model, material_id_t* out_materials) {
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+    uint32_t num_materials = model->num_materials;
+    if (num_materials > GEOMETRY_PASS_MAX_MATERIALS) {
+        LOG_WARN("WARN: Too many materials (%u) in (%s);"
+            " only %d will be created\n", num_materials,
+            model->trace.name, GEOMETRY_PASS_MAX_MATERIALS);
+        num_materials = GEOMETRY_PASS_MAX_MATERIALS;
+    }
+
+    for (uint32_t m = 0; m < num_materials; ++m) {
+        const gltf_material_t* material = &model->materials[m];
+        out_materials[m] = default_material;
+        if (!material->albedo.pixels || !material->emissive.pixels) {
+            continue;
+        }
+
+        trace_t mat_trace;
+        trace_printf(&mat_trace, "%s-mat%u", model->trace.name, m);
+        material_id_t material_id = geometry_pass_make_material(pass,
+            &(material_desc_t){
+                .albedo = &material->albedo,
+                .emissive = &material->emissive,
+                .label = mat_trace.name
+            });
+
+        if (handle_is_valid(material_id, GEOMETRY_PASS_MAX_MATERIALS)) {
+            out_materials[m] = material_id;
+        }
+    }
+
+    return num_materials;
+}
+
+static model_id_t __gltf_create_model(geometry_pass_t* pass,
+    const gltf_model_t* model, const gltf_mesh_t* mesh,
+    const material_id_t* materials, uint32_t num_materials) {
+    model_id_t model_id = {.id = HANDLE_INVALID_ID};
+    mesh_data_t mesh_data;
+    int32_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes = 0;
+    if (!__gltf_build_mesh(pass->jobs, model, mesh->first_primitive,
+        mesh->num_primitives, mesh->base_vertex, mesh->num_vertices,
+        mesh->trace.name, VERTEX_LAYOUT_DEFAULT, &mesh_data,
+        submesh_materials, &num_submeshes)) {
+        return model_id;
+    }
+
+    mesh_id_t mesh_id = geometry_pass_upload_mesh(pass, &mesh_data);
+    if (mesh_id.id == HANDLE_INVALID_ID) {
+        return model_id;
+    }
+
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+    material_id_t draw_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    for (uint32_t s = 0; s < num_submeshes; ++s) {
+        int32_t m = submesh_materials[s];
+        draw_materials[s] = (m >= 0 && (uint32_t)m < num_materials)
+            ? materials[m] : default_material;
+    }
+
+    model_id = geometry_pass_create_model(pass, &(model_desc_t){
+        .material = default_material,
+        .mesh = mesh_id,
+        .submesh_materials = num_submeshes ? draw_materials : NULL,
+        .num_submesh_materials = num_submeshes,
+        .label = mesh->trace.name
+    });
+
+    // the mesh would be left behind otherwise
+    if (!handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)) {
+        geometry_pass_destroy_mesh(pass, mesh_id);
+    }
+
+    return model_id;
+}
+
+model_id_t gltf_make_model(geometry_pass_t* pass, const gltf_model_t* model) {
+    assert(pass && model);
+
+    // the whole model, as a single mesh
+    gltf_mesh_t mesh = {
+        .num_primitives = model->num_primitives,
+        .num_vertices = model->num_vertices,
+        .trace = model->trace
+    };
+
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    uint32_t num_materials = __gltf_make_materials(pass, model, materials);
+    return __gltf_create_model(pass, model, &mesh, materials, num_materials);
+}
+
+uint32_t gltf_make_mesh_models(geometry_pass_t* pass, const gltf_model_t* model,
+    model_id_t* out_mesh_models) {
+    assert(pass && model && (out_mesh_models || model->num_meshes == 0));
+
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    uint32_t num_materials = __gltf_make_materials(pass, model, materials);
+    uint32_t num_models = 0;
+    for (uint32_t m = 0; m < model->num_meshes; ++m) {
+        out_mesh_models[m] = __gltf_create_model(pass, model,
+            &model->meshes[m], materials, num_materials);
+        if (handle_is_valid(out_mesh_models[m], GEOMETRY_PASS_MAX_MODELS)) {
+            ++num_models;
+        }
+    }
+
+    if (num_models < model->num_meshes) {
+        LOG_WARN("WARN: Only %u of %u meshes of (%s) have a model\n",
+            num_models, model->num_meshes, model->trace.name);
+    }
+
+    return num_models;
+}
+
+void gltf_destroy_mesh_models(geometry_pass_t* pass, const gltf_model_t* model,
+    model_id_t* mesh_models) {
+    assert(pass && model && (mesh_models || model->num_meshes == 0));
+
+    // the materials are shared by the models, so they are
+    // gathered first, and destroyed once the models are gone
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+    bool used_materials[GEOMETRY_PASS_MAX_MATERIALS] = {0};
+    for (uint32_t m = 0; m < model->num_meshes; ++m) {
+        if (!handle_is_valid(mesh_models[m], GEOMETRY_PASS_MAX_MODELS)) {
+            continue;
+        }
+
+        const model_t* model_ptr = &pass->models[mesh_models[m].id];
+        for (int32_t d = 0; d < model_ptr->num_draws; ++d) {
+            material_id_t mat = model_ptr->draw_materials[d];
+            if (handle_is_valid(mat, GEOMETRY_PASS_MAX_MATERIALS)
+                && mat.id != default_material.id) {
+                used_materials[mat.id] = true;
+            }
+        }
+
+        mesh_id_t mesh_id = model_ptr->mesh_id;
+        geometry_pass_destroy_model(pass, mesh_models[m]);
+        geometry_pass_destroy_mesh(pass, mesh_id);
+        mesh_models[m].id = HANDLE_INVALID_ID;
+    }
+
+    for (int32_t i = 0; i < GEOMETRY_PASS_MAX_MATERIALS; ++i) {
+        if (used_materials[i]) {
+            geometry_pass_destroy_material(pass, (material_id_t){.id=i});
+        }
+    }
+}
+
+node_id_t gltf_add_scene_nodes(scene_t* scene, const gltf_model_t* model,
+    const model_id_t* mesh_models, const node_desc_t* root) {
+    assert(scene && model && root);
+    assert(mesh_models || model->num_meshes == 0);
+
+    node_id_t root_id = {.id = HANDLE_INVALID_ID};
+    uint32_t count = model->num_nodes + 1;
+    node_desc_t* descs = memory_malloc(sizeof(node_desc_t) * count);
+    int32_t* parents = memory_malloc(sizeof(int32_t) * count);
+    node_id_t* nodes = memory_malloc(sizeof(node_id_t) * count);
+    if (!descs || !parents || !nodes) {
+        if (descs) memory_free(descs);
+        if (parents) memory_free(parents);
+        if (nodes) memory_free(nodes);
+        return root_id;
+    }
+
+    // the root first, then the nodes, which all come after their parent
+    descs[0] = *root;
+    parents[0] = -1;
+    for (uint32_t n = 0; n < model->num_nodes; ++n) {
+        const gltf_node_t* node = &model->nodes[n];
+        descs[n + 1] = (node_desc_t){
+            .transform = node->transform,
+            .color = root->color,
+            .tile = root->tile,
+            .model = (node->mesh >= 0)
+                ? mesh_models[node->mesh]
+                : (model_id_t){.id = HANDLE_INVALID_ID},
+            .label = node->trace.name
+        };
+
+        parents[n + 1] = node->parent + 1;
+    }
+
+    if (scene_add_nodes(scene, descs, parents, count, nodes)) {
+        root_id = nodes[0];
+    }
+    else {
+        LOG_WARN("WARN: No room in the scene for the %u nodes of (%s)\n",
+            model->num_nodes, model->trace.name);
+    }
+
+    memory_free(descs);
+    memory_free(parents);
+    memory_free(nodes);
+    return root_id;
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
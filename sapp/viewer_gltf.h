@@ -0,0 +1,164 @@
+#pragma once
+ /**
+  * glTF 2.0 loader
+  */
+
+#include "viewer_geometry_pass.h"
+#include "viewer_file.h"
+#include "viewer_jobs.h"
+#include "viewer_scene.h"
+
+#define GLTF_MAX_PATH 1024
+#define GLTF_MAX_BUFFERS 16         // external buffers per file
+#define GLTF_MAX_NODE_DEPTH 64      // of the node hierarchy
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// triangles of a mesh primitive, placed by one of the nodes
+// referencing its mesh, and drawn with the primitive material
+typedef struct {
+    uint32_t base_element;
+    uint32_t num_elements;
+    int32_t material_id;    // glTF material index, -1 if none
+} gltf_primitive_t;
+
+// images are made of the material factors, multiplied by their
+// textures, if any, so that they can always be drawn with their own.
+typedef struct {
+    image_desc_t albedo;    // rgb: base colour, a: opacity
+    image_desc_t emissive;  // rgb: emissive, a: specular from roughness
+} gltf_material_t;
+
+// primitives of a glTF mesh, in mesh space, which are drawn as a
+// model of its own, whose vertices are the mesh ones, and only them.
+typedef struct {
+    uint32_t first_primitive;
+    uint32_t num_primitives;
+    uint32_t base_vertex;
+    uint32_t num_vertices;
+    trace_t trace;
+} gltf_mesh_t;
+
+// node of the scene hierarchy, listed after its parent
+typedef struct {
+    transform_t transform;  // relative to the parent, without shear
+    int32_t parent;         // index of the parent node, -1 for roots
+    int32_t mesh;           // index of the model mesh, -1 if none
+    trace_t trace;
+} gltf_node_t;
+
+// the primitives of all the nodes, in scene space, sorted by material,
+// or, if the hierarchy is kept, of all the meshes, sorted by mesh first,
+// whose indices are then relative to the mesh vertices.
+// vertices and indices are the mapped buffers themselves when their
+// layout is already that of the mesh, and converted copies otherwise.
+typedef struct {
+    const vertex_t* vertices;
+    uint32_t num_vertices;
+    const uint32_t* indices;
+    uint32_t num_indices;
+    gltf_primitive_t* primitives;
+    uint32_t num_primitives;
+    gltf_material_t* materials;
+    uint32_t num_materials;
+    gltf_mesh_t* meshes;        // hierarchy only
+    uint32_t num_meshes;
+    gltf_node_t* nodes;         // hierarchy only
+    uint32_t num_nodes;
+    vertex_t* owned_vertices;   // NULL if the vertices are mapped
+    uint32_t* owned_indices;    // NULL if the indices are mapped
+    file_map_t buffers[GLTF_MAX_BUFFERS];
+    uint32_t num_buffers;
+    uint32_t num_lods;  // levels of detail to generate for the mesh
+    trace_t trace;
+} gltf_model_t;
+
+// gltf_data is either the JSON document, or a binary GLB container,
+// whose chunk is the first buffer. it is not copied, and it must be
+// kept alive until the model is released, as the mesh can refer to it.
+// external buffers, and images, are relative to base_path; buffers are
+// mapped rather than read, and data URIs are not supported.
+// with keep_hierarchy, the meshes referenced by the scene are loaded
+// once each, and the nodes are listed, instead of being flattened.
+typedef struct {
+    jobs_t* jobs;               // optional
+    const char* base_path;      // optional
+    const void* gltf_data;
+    size_t data_size;
+    uint32_t num_lods;          // levels of detail, 1 for the mesh only
+    bool keep_hierarchy;
+    const char* label;
+} gltf_data_t;
+
+typedef enum {
+    GLTF_RESULT_OK,
+    GLTF_RESULT_INVALID_FILE,
+    GLTF_RESULT_UNSUPPORTED,
+    GLTF_RESULT_MISSING_BUFFER,
+    GLTF_RESULT_OUT_OF_MEMORY
+} gltf_result_t;
+
+/**
+ * Load the triangles of the default scene, or the first one. Each
+ * primitive is converted into vertex_t on a job of its own, moving it
+ * into scene space, or keeping it in mesh space if the hierarchy is
+ * kept, unless there is a single one, in place, whose
+ * attributes are already interleaved as vertex_t, and whose indices are
+ * 32-bit, as the mesh is then built straight from the mapped buffers.
+ * The model must be released with gltf_release, even if it fails.
+ */
+gltf_result_t gltf_load(const gltf_data_t* data, gltf_model_t* out_model);
+
+void gltf_release(gltf_model_t* model);
+
+/**
+ * Build the model mesh, without creating any resource, therefore,
+ * from any thread. Consecutive primitives of the same material are
+ * drawn as a single submesh, whose glTF material is returned in
+ * out_submesh_materials, which must have GEOMETRY_PASS_MAX_MESH_RANGES.
+ * The model must be kept alive until the mesh data is uploaded.
+ */
+bool gltf_build_mesh(jobs_t* jobs, const gltf_model_t* model,
+    vertex_layout_t layout, mesh_data_t* out_data,
+    int32_t* out_submesh_materials, uint32_t* out_num_submeshes);
+
+/**
+ * Build and upload the mesh, create the materials and then the model.
+ */
+model_id_t gltf_make_model(geometry_pass_t* pass, const gltf_model_t* model);
+
+/**
+ * Make a model for each mesh of a model loaded with its hierarchy, all
+ * of them sharing the same materials, into out_mesh_models, which must
+ * have num_meshes entries. Meshes whose model cannot be made, e.g. for
+ * lack of room in the pass, are given an invalid one.
+ *
+ * @return the number of models made.
+ */
+uint32_t gltf_make_mesh_models(geometry_pass_t* pass, const gltf_model_t* model,
+    model_id_t* out_mesh_models);
+
+/**
+ * Destroy the models made by gltf_make_mesh_models, along with their
+ * meshes and the materials they draw with, except the default one.
+ * Invalid models are skipped, and every entry is left invalid.
+ */
+void gltf_destroy_mesh_models(geometry_pass_t* pass, const gltf_model_t* model,
+    model_id_t* mesh_models);
+
+/**
+ * Add the nodes of a model loaded with its hierarchy to the scene, at
+ * once, below a new node made from root, whose color and tile they take
+ * too. Nodes are drawn with the model of their mesh, and nodes sharing
+ * a mesh are therefore instances of the same model.
+ *
+ * @return the root node, invalid if there is no room for all the nodes.
+ */
+node_id_t gltf_add_scene_nodes(scene_t* scene, const gltf_model_t* model,
+    const model_id_t* mesh_models, const node_desc_t* root);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
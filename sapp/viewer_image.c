@@ -0,0 +1,332 @@
+#include "viewer_image.h"
+
+#include <assert.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIEWER_IMAGE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VIEWER_IMAGE_NEON
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// pixels are stored as bytes r,g,b,a in memory, which
+// is what a uint32_t holds on little endian targets.
+#define CHANNEL_SHIFT(c) (8 * (c))
+#define CHANNEL_MASK(c) (0xFFu << CHANNEL_SHIFT(c))
+
+static uint8_t unorm8(float v) {
+    v = v < 0.f ? 0.f : (v > 1.f ? 1.f : v);
+    return (uint8_t)(v * 255.f + .5f);
+}
+
+uint32_t image_pack_rgba(float r, float g, float b, float a) {
+    return (uint32_t)unorm8(r)
+        | ((uint32_t)unorm8(g) << 8)
+        | ((uint32_t)unorm8(b) << 16)
+        | ((uint32_t)unorm8(a) << 24);
+}
+
+void image_fill(uint32_t* pixels, uint32_t num_pixels, uint32_t rgba) {
+    assert(pixels || num_pixels == 0);
+
+    uint32_t i = 0;
+#if defined(VIEWER_IMAGE_SSE2)
+    __m128i value = _mm_set1_epi32((int)rgba);
+    for (; i + 4 <= num_pixels; i += 4) {
+        _mm_storeu_si128((__m128i*)(pixels + i), value);
+    }
+#elif defined(VIEWER_IMAGE_NEON)
+    uint32x4_t value = vdupq_n_u32(rgba);
+    for (; i + 4 <= num_pixels; i += 4) {
+        vst1q_u32(pixels + i, value);
+    }
+#endif
+
+    for (; i < num_pixels; ++i) {
+        pixels[i] = rgba;
+    }
+}
+
+void image_fill_channel(uint32_t* pixels, uint32_t num_pixels,
+    uint32_t channel, uint8_t value) {
+    assert(pixels || num_pixels == 0);
+    assert(channel < 4);
+
+    uint32_t keep = ~CHANNEL_MASK(channel);
+    uint32_t bits = (uint32_t)value << CHANNEL_SHIFT(channel);
+
+    uint32_t i = 0;
+#if defined(VIEWER_IMAGE_SSE2)
+    __m128i keep4 = _mm_set1_epi32((int)keep);
+    __m128i bits4 = _mm_set1_epi32((int)bits);
+    for (; i + 4 <= num_pixels; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(pixels + i));
+        p = _mm_or_si128(_mm_and_si128(p, keep4), bits4);
+        _mm_storeu_si128((__m128i*)(pixels + i), p);
+    }
+#elif defined(VIEWER_IMAGE_NEON)
+    uint32x4_t keep4 = vdupq_n_u32(keep);
+    uint32x4_t bits4 = vdupq_n_u32(bits);
+    for (; i + 4 <= num_pixels; i += 4) {
+        uint32x4_t p = vld1q_u32(pixels + i);
+        vst1q_u32(pixels + i, vorrq_u32(vandq_u32(p, keep4), bits4));
+    }
+#endif
+
+    for (; i < num_pixels; ++i) {
+        pixels[i] = (pixels[i] & keep) | bits;
+    }
+}
+
+void image_pack_channel(uint32_t* pixels, uint32_t num_pixels,
+    uint32_t channel, const uint8_t* src) {
+    assert((pixels && src) || num_pixels == 0);
+    assert(channel < 4);
+
+    uint32_t keep = ~CHANNEL_MASK(channel);
+    uint32_t shift = CHANNEL_SHIFT(channel);
+
+    uint32_t i = 0;
+#if defined(VIEWER_IMAGE_SSE2)
+    // widen 16 source bytes into 4x4 32-bit lanes,
+    // then move them into place within each pixel.
+    __m128i zero = _mm_setzero_si128();
+    __m128i keep4 = _mm_set1_epi32((int)keep);
+    __m128i shift4 = _mm_cvtsi32_si128((int)shift);
+    for (; i + 16 <= num_pixels; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(s, zero);
+        __m128i hi = _mm_unpackhi_epi8(s, zero);
+        __m128i s4[4] = {
+            _mm_unpacklo_epi16(lo, zero),
+            _mm_unpackhi_epi16(lo, zero),
+            _mm_unpacklo_epi16(hi, zero),
+            _mm_unpackhi_epi16(hi, zero)
+        };
+
+        for (uint32_t k = 0; k < 4; ++k) {
+            __m128i* dst = (__m128i*)(pixels + i + 4 * k);
+            __m128i p = _mm_and_si128(_mm_loadu_si128(dst), keep4);
+            p = _mm_or_si128(p, _mm_sll_epi32(s4[k], shift4));
+            _mm_storeu_si128(dst, p);
+        }
+    }
+#elif defined(VIEWER_IMAGE_NEON)
+    // de-interleave 16 pixels into planes, swap
+    // the plane of the channel, and interleave back.
+    for (; i + 16 <= num_pixels; i += 16) {
+        uint8_t* dst = (uint8_t*)(pixels + i);
+        uint8x16x4_t p = vld4q_u8(dst);
+        p.val[channel] = vld1q_u8(src + i);
+        vst4q_u8(dst, p);
+    }
+#endif
+
+    for (; i < num_pixels; ++i) {
+        pixels[i] = (pixels[i] & keep) | ((uint32_t)src[i] << shift);
+    }
+}
+
+uint32_t image_num_mipmaps(uint32_t width, uint32_t height) {
+    uint32_t size = width > height ? width : height;
+    uint32_t levels = 1;
+    while (size > 1 && levels < IMAGE_MAX_MIPMAPS) {
+        size >>= 1;
+        ++levels;
+    }
+
+    return levels;
+}
+
+uint32_t image_mip_size(uint32_t size, uint32_t level) {
+    size >>= level;
+    return size > 0 ? size : 1;
+}
+
+size_t image_mipmaps_pixels(uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps) {
+    size_t num_pixels = 0;
+    for (uint32_t l = 0; l < num_mipmaps; ++l) {
+        num_pixels += (size_t)image_mip_size(width, l)
+            * image_mip_size(height, l) * layers;
+    }
+
+    return num_pixels;
+}
+
+size_t image_level_size(image_format_t format, uint32_t width,
+    uint32_t height, uint32_t layers) {
+    if (format == IMAGE_FORMAT_RGBA8) {
+        return sizeof(uint32_t) * width * height * layers;
+    }
+
+    size_t block_bytes = (format == IMAGE_FORMAT_BC1) ? 8 : 16;
+    return block_bytes * layers
+        * ((width + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE)
+        * ((height + IMAGE_BLOCK_SIZE - 1) / IMAGE_BLOCK_SIZE);
+}
+
+size_t image_mipmaps_size(image_format_t format, uint32_t width,
+    uint32_t height, uint32_t layers, uint32_t num_mipmaps) {
+    size_t size = 0;
+    for (uint32_t l = 0; l < num_mipmaps; ++l) {
+        size += image_level_size(format, image_mip_size(width, l),
+            image_mip_size(height, l), layers);
+    }
+
+    return size;
+}
+
+static uint32_t average4(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+        uint32_t sum = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF)
+            + ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+        result |= ((sum + 2) >> 2) << shift;
+    }
+
+    return result;
+}
+
+void image_downsample(const uint32_t* src, uint32_t src_width,
+    uint32_t src_height, uint32_t* dst, uint32_t first_row, uint32_t num_rows) {
+    assert(src && dst);
+
+    uint32_t dst_width = image_mip_size(src_width, 1);
+    for (uint32_t y = first_row; y < first_row + num_rows; ++y) {
+
+        // odd sizes clamp to the last row or column
+        uint32_t y0 = 2 * y < src_height ? 2 * y : src_height - 1;
+        uint32_t y1 = 2 * y + 1 < src_height ? 2 * y + 1 : src_height - 1;
+        const uint32_t* row0 = src + (size_t)y0 * src_width;
+        const uint32_t* row1 = src + (size_t)y1 * src_width;
+        uint32_t* out = dst + (size_t)y * dst_width;
+
+        uint32_t x = 0;
+    #if defined(VIEWER_IMAGE_SSE2)
+        // 4 destination pixels from 2 rows of 8 source pixels,
+        // splitting even and odd columns, summed at 16-bit.
+        __m128i zero = _mm_setzero_si128();
+        __m128i round = _mm_set1_epi16(2);
+        for (; x + 4 <= dst_width && 2 * x + 8 <= src_width; x += 4) {
+            __m128 a0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + 2 * x)));
+            __m128 b0 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row0 + 2 * x + 4)));
+            __m128 a1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + 2 * x)));
+            __m128 b1 = _mm_castsi128_ps(_mm_loadu_si128((const __m128i*)(row1 + 2 * x + 4)));
+
+            __m128i e0 = _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i o0 = _mm_castps_si128(_mm_shuffle_ps(a0, b0, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i e1 = _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i o1 = _mm_castps_si128(_mm_shuffle_ps(a1, b1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+            __m128i lo = _mm_add_epi16(
+                _mm_add_epi16(_mm_unpacklo_epi8(e0, zero), _mm_unpacklo_epi8(o0, zero)),
+                _mm_add_epi16(_mm_unpacklo_epi8(e1, zero), _mm_unpacklo_epi8(o1, zero)));
+            __m128i hi = _mm_add_epi16(
+                _mm_add_epi16(_mm_unpackhi_epi8(e0, zero), _mm_unpackhi_epi8(o0, zero)),
+                _mm_add_epi16(_mm_unpackhi_epi8(e1, zero), _mm_unpackhi_epi8(o1, zero)));
+
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, round), 2);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, round), 2);
+            _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(lo, hi));
+        }
+    #elif defined(VIEWER_IMAGE_NEON)
+        // 4 destination pixels from 2 rows of 8 source pixels,
+        // de-interleaving even and odd columns while loading.
+        for (; x + 4 <= dst_width && 2 * x + 8 <= src_width; x += 4) {
+            uint32x4x2_t r0 = vld2q_u32(row0 + 2 * x);
+            uint32x4x2_t r1 = vld2q_u32(row1 + 2 * x);
+            uint8x16_t e0 = vreinterpretq_u8_u32(r0.val[0]);
+            uint8x16_t o0 = vreinterpretq_u8_u32(r0.val[1]);
+            uint8x16_t e1 = vreinterpretq_u8_u32(r1.val[0]);
+            uint8x16_t o1 = vreinterpretq_u8_u32(r1.val[1]);
+
+            uint16x8_t lo = vaddq_u16(
+                vaddl_u8(vget_low_u8(e0), vget_low_u8(o0)),
+                vaddl_u8(vget_low_u8(e1), vget_low_u8(o1)));
+            uint16x8_t hi = vaddq_u16(
+                vaddl_u8(vget_high_u8(e0), vget_high_u8(o0)),
+                vaddl_u8(vget_high_u8(e1), vget_high_u8(o1)));
+
+            // rounding shift: (sum + 2) >> 2
+            uint8x16_t avg = vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2));
+            vst1q_u32(out + x, vreinterpretq_u32_u8(avg));
+        }
+    #endif
+
+        for (; x < dst_width; ++x) {
+            uint32_t x0 = 2 * x < src_width ? 2 * x : src_width - 1;
+            uint32_t x1 = 2 * x + 1 < src_width ? 2 * x + 1 : src_width - 1;
+            out[x] = average4(row0[x0], row0[x1], row1[x0], row1[x1]);
+        }
+    }
+}
+
+// destination rows downsampled by each job
+#define MIPMAP_ROWS_PER_JOB 64
+
+typedef struct {
+    const uint32_t* src;
+    uint32_t* dst;
+    uint32_t src_width;
+    uint32_t src_height;
+    uint32_t dst_height;
+    uint32_t bands_per_layer;
+} mipmap_level_job_t;
+
+static void mipmap_level_job(void* user_data, uint32_t index) {
+    const mipmap_level_job_t* job = (const mipmap_level_job_t*)user_data;
+    uint32_t layer = index / job->bands_per_layer;
+    uint32_t band = index % job->bands_per_layer;
+
+    size_t src_layer_size = (size_t)job->src_width * job->src_height;
+    size_t dst_layer_size = (size_t)image_mip_size(job->src_width, 1)
+        * job->dst_height;
+
+    uint32_t first_row = band * MIPMAP_ROWS_PER_JOB;
+    uint32_t num_rows = job->dst_height - first_row;
+    if (num_rows > MIPMAP_ROWS_PER_JOB) {
+        num_rows = MIPMAP_ROWS_PER_JOB;
+    }
+
+    image_downsample(job->src + layer * src_layer_size,
+        job->src_width, job->src_height,
+        job->dst + layer * dst_layer_size,
+        first_row, num_rows);
+}
+
+void image_generate_mipmaps(jobs_t* jobs, uint32_t* pixels, uint32_t width,
+    uint32_t height, uint32_t layers, uint32_t num_mipmaps) {
+    assert(pixels && width > 0 && height > 0 && layers > 0);
+
+    uint32_t* src = pixels;
+    for (uint32_t l = 1; l < num_mipmaps; ++l) {
+        uint32_t src_width = image_mip_size(width, l - 1);
+        uint32_t src_height = image_mip_size(height, l - 1);
+        uint32_t dst_height = image_mip_size(height, l);
+        uint32_t* dst = src + (size_t)src_width * src_height * layers;
+
+        mipmap_level_job_t job = {
+            .src = src,
+            .dst = dst,
+            .src_width = src_width,
+            .src_height = src_height,
+            .dst_height = dst_height,
+            .bands_per_layer = (dst_height + MIPMAP_ROWS_PER_JOB - 1)
+                / MIPMAP_ROWS_PER_JOB
+        };
+
+        jobs_parallel_for(jobs, mipmap_level_job, &job,
+            layers * job.bands_per_layer);
+        src = dst;
+    }
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,97 @@
+#pragma once
+/**
+ * RGBA8 image utilities
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "viewer_jobs.h"
+
+#define IMAGE_MAX_MIPMAPS 16
+#define IMAGE_BLOCK_SIZE 4          // pixels per side of compressed blocks
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// block compressed formats store 4x4 pixel blocks, of 8 bytes for bc1,
+// whose pixels are opaque, and of 16 bytes for bc3, with their alpha.
+// levels smaller than a block still take a whole one.
+typedef enum {
+    IMAGE_FORMAT_RGBA8 = 0,
+    IMAGE_FORMAT_BC1,
+    IMAGE_FORMAT_BC3
+} image_format_t;
+
+/**
+ * Pack 4 normalised [0,1] values into an RGBA8 pixel.
+ */
+uint32_t image_pack_rgba(float r, float g, float b, float a);
+
+/**
+ * Set all the pixels to the given RGBA8 value.
+ */
+void image_fill(uint32_t* pixels, uint32_t num_pixels, uint32_t rgba);
+
+/**
+ * Set one channel (0:r, 1:g, 2:b, 3:a) of all the pixels to value.
+ */
+void image_fill_channel(uint32_t* pixels, uint32_t num_pixels,
+    uint32_t channel, uint8_t value);
+
+/**
+ * Replace one channel (0:r, 1:g, 2:b, 3:a) of the pixels with
+ * the single channel source, which must store num_pixels bytes.
+ */
+void image_pack_channel(uint32_t* pixels, uint32_t num_pixels,
+    uint32_t channel, const uint8_t* src);
+
+/**
+ * Number of levels of a full mip chain, down to 1x1.
+ */
+uint32_t image_num_mipmaps(uint32_t width, uint32_t height);
+
+/**
+ * Width or height of the given mip level.
+ */
+uint32_t image_mip_size(uint32_t size, uint32_t level);
+
+/**
+ * Number of pixels of the first num_mipmaps levels of an image.
+ */
+size_t image_mipmaps_pixels(uint32_t width, uint32_t height,
+    uint32_t layers, uint32_t num_mipmaps);
+
+/**
+ * Size in bytes of a level of width x height pixels, with all its layers.
+ */
+size_t image_level_size(image_format_t format, uint32_t width,
+    uint32_t height, uint32_t layers);
+
+/**
+ * Size in bytes of the first num_mipmaps levels of an image.
+ */
+size_t image_mipmaps_size(image_format_t format, uint32_t width,
+    uint32_t height, uint32_t layers, uint32_t num_mipmaps);
+
+/**
+ * Halve the size of an image with a 2x2 box filter,
+ * only the dst rows in [first_row, first_row + num_rows).
+ */
+void image_downsample(const uint32_t* src, uint32_t src_width,
+    uint32_t src_height, uint32_t* dst, uint32_t first_row, uint32_t num_rows);
+
+/**
+ * Generate levels [1, num_mipmaps) from level 0, which must be at the
+ * beginning of pixels, followed by enough room for the other levels.
+ * Each level stores all its layers contiguously, one after another.
+ * Levels are generated one at a time, spreading layers and rows
+ * across the jobs, which can be NULL to run them serially.
+ */
+void image_generate_mipmaps(jobs_t* jobs, uint32_t* pixels, uint32_t width,
+    uint32_t height, uint32_t layers, uint32_t num_mipmaps);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,469 @@
+#include "viewer_jobs.h"
+#include "viewer_memory.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__EMSCRIPTEN__)
+#define JOBS_NO_THREADS
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#if !defined(JOBS_NO_THREADS)
+
+#if defined(_WIN32)
+typedef HANDLE platform_thread_t;
+typedef CRITICAL_SECTION platform_mutex_t;
+typedef CONDITION_VARIABLE platform_cond_t;
+
+#define platform_mutex_init(m) InitializeCriticalSection(m)
+#define platform_mutex_destroy(m) DeleteCriticalSection(m)
+#define platform_mutex_lock(m) EnterCriticalSection(m)
+#define platform_mutex_unlock(m) LeaveCriticalSection(m)
+#define platform_cond_init(c) InitializeConditionVariable(c)
+#define platform_cond_destroy(c) ((void)(c))
+#define platform_cond_wait(c, m) SleepConditionVariableCS(c, m, INFINITE)
+#define platform_cond_broadcast(c) WakeAllConditionVariable(c)
+#else
+typedef pthread_t platform_thread_t;
+typedef pthread_mutex_t platform_mutex_t;
+typedef pthread_cond_t platform_cond_t;
+
+#define platform_mutex_init(m) pthread_mutex_init(m, NULL)
+#define platform_mutex_destroy(m) pthread_mutex_destroy(m)
+#define platform_mutex_lock(m) pthread_mutex_lock(m)
+#define platform_mutex_unlock(m) pthread_mutex_unlock(m)
+#define platform_cond_init(c) pthread_cond_init(c, NULL)
+#define platform_cond_destroy(c) pthread_cond_destroy(c)
+#define platform_cond_wait(c, m) pthread_cond_wait(c, m)
+#define platform_cond_broadcast(c) pthread_cond_broadcast(c)
+#endif
+
+typedef struct {
+    platform_thread_t threads[JOBS_MAX_WORKERS];
+    uint32_t num_workers;
+
+    platform_mutex_t mutex;
+    platform_cond_t work_cond;  // signaled when new batches or tasks are available
+    platform_cond_t done_cond;  // signaled when batches or tasks are completed
+
+    // asynchronous tasks, protected by the mutex
+    struct {
+        jobs_func_t func;
+        void* user_data;
+        uint32_t id;    // 0 for free slots
+        bool running;
+    } tasks[JOBS_MAX_TASKS];
+    uint32_t next_task_id;
+
+    // current batch, all protected by the mutex
+    jobs_func_t func;
+    void* user_data;
+    uint32_t count;
+    uint32_t next;
+    uint32_t completed;
+    uint32_t generation;
+    bool busy;
+    bool quit;
+} jobs_impl_t;
+
+// run indices of the current batch until there are none left,
+// the mutex must be locked on enter, and it is locked on exit.
+static void jobs_run_batch(jobs_impl_t* impl) {
+    while (impl->next < impl->count) {
+        uint32_t index = impl->next++;
+        jobs_func_t func = impl->func;
+        void* user_data = impl->user_data;
+
+        platform_mutex_unlock(&impl->mutex);
+        func(user_data, index);
+        platform_mutex_lock(&impl->mutex);
+
+        if (++impl->completed == impl->count) {
+            platform_cond_broadcast(&impl->done_cond);
+        }
+    }
+}
+
+// oldest queued task, or -1 if none, the mutex must be locked
+static int32_t jobs_next_task(const jobs_impl_t* impl) {
+    int32_t next = -1;
+    for (int32_t t = 0; t < JOBS_MAX_TASKS; ++t) {
+        if (impl->tasks[t].id && !impl->tasks[t].running
+            && (next < 0 || impl->tasks[t].id < impl->tasks[next].id)) {
+            next = t;
+        }
+    }
+
+    return next;
+}
+
+static void jobs_worker_loop(jobs_impl_t* impl) {
+    uint32_t generation = 0;
+
+    platform_mutex_lock(&impl->mutex);
+    while (!impl->quit) {
+
+        // parallel fors take precedence, as their caller is waiting
+        if (generation != impl->generation) {
+            generation = impl->generation;
+            jobs_run_batch(impl);
+            continue;
+        }
+
+        int32_t t = jobs_next_task(impl);
+        if (t >= 0) {
+            impl->tasks[t].running = true;
+            jobs_func_t func = impl->tasks[t].func;
+            void* user_data = impl->tasks[t].user_data;
+
+            platform_mutex_unlock(&impl->mutex);
+            func(user_data, 0);
+            platform_mutex_lock(&impl->mutex);
+
+            // free the slot, and wake up who is waiting for it
+            memset(&impl->tasks[t], 0, sizeof(impl->tasks[t]));
+            platform_cond_broadcast(&impl->done_cond);
+            continue;
+        }
+
+        platform_cond_wait(&impl->work_cond, &impl->mutex);
+    }
+    platform_mutex_unlock(&impl->mutex);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI jobs_worker_main(LPVOID arg) {
+    jobs_worker_loop((jobs_impl_t*)arg);
+    return 0;
+}
+#else
+static void* jobs_worker_main(void* arg) {
+    jobs_worker_loop((jobs_impl_t*)arg);
+    return NULL;
+}
+#endif
+
+static uint32_t jobs_num_cores() {
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (uint32_t)cores : 1;
+#endif
+}
+
+bool jobs_init(jobs_t* jobs, uint32_t num_workers) {
+    assert(jobs);
+    jobs->impl = NULL;
+
+    if (num_workers == 0) {
+        num_workers = jobs_num_cores() - 1;
+    }
+
+    if (num_workers > JOBS_MAX_WORKERS) {
+        num_workers = JOBS_MAX_WORKERS;
+    }
+
+    // single core, nothing to run in parallel
+    if (num_workers == 0) {
+        return false;
+    }
+
+    jobs_impl_t* impl = memory_calloc(1, sizeof(jobs_impl_t));
+    if (!impl) {
+        return false;
+    }
+
+    platform_mutex_init(&impl->mutex);
+    platform_cond_init(&impl->work_cond);
+    platform_cond_init(&impl->done_cond);
+
+    for (uint32_t w = 0; w < num_workers; ++w) {
+    #if defined(_WIN32)
+        impl->threads[w] = CreateThread(NULL, 0, jobs_worker_main, impl, 0, NULL);
+        bool created = impl->threads[w] != NULL;
+    #else
+        bool created = pthread_create(
+            &impl->threads[w], NULL, jobs_worker_main, impl) == 0;
+    #endif
+
+        // go ahead with the workers created so far
+        if (!created) {
+            break;
+        }
+
+        impl->num_workers++;
+    }
+
+    jobs->impl = impl;
+    if (impl->num_workers == 0) {
+        jobs_cleanup(jobs);
+        return false;
+    }
+
+    return true;
+}
+
+void jobs_cleanup(jobs_t* jobs) {
+    assert(jobs);
+
+    jobs_impl_t* impl = (jobs_impl_t*)jobs->impl;
+    if (!impl) {
+        return;
+    }
+
+    platform_mutex_lock(&impl->mutex);
+    impl->quit = true;
+    platform_cond_broadcast(&impl->work_cond);
+    platform_mutex_unlock(&impl->mutex);
+
+    for (uint32_t w = 0; w < impl->num_workers; ++w) {
+    #if defined(_WIN32)
+        WaitForSingleObject(impl->threads[w], INFINITE);
+        CloseHandle(impl->threads[w]);
+    #else
+        pthread_join(impl->threads[w], NULL);
+    #endif
+    }
+
+    platform_cond_destroy(&impl->done_cond);
+    platform_cond_destroy(&impl->work_cond);
+    platform_mutex_destroy(&impl->mutex);
+
+    memory_free(impl);
+    jobs->impl = NULL;
+}
+
+uint32_t jobs_num_workers(const jobs_t* jobs) {
+    const jobs_impl_t* impl = jobs ? (const jobs_impl_t*)jobs->impl : NULL;
+    return impl ? impl->num_workers : 0;
+}
+
+void jobs_parallel_for(jobs_t* jobs, jobs_func_t func,
+    void* user_data, uint32_t count) {
+    assert(func);
+
+    jobs_impl_t* impl = jobs ? (jobs_impl_t*)jobs->impl : NULL;
+
+    bool parallel = false;
+    if (impl && count > 1) {
+        platform_mutex_lock(&impl->mutex);
+        if (!impl->busy) {
+            impl->busy = true;
+            impl->func = func;
+            impl->user_data = user_data;
+            impl->count = count;
+            impl->next = 0;
+            impl->completed = 0;
+            impl->generation++;
+            platform_cond_broadcast(&impl->work_cond);
+            parallel = true;
+        }
+        else {
+            platform_mutex_unlock(&impl->mutex);
+        }
+    }
+
+    if (!parallel) {
+        for (uint32_t i = 0; i < count; ++i) {
+            func(user_data, i);
+        }
+
+        return;
+    }
+
+    // the calling thread takes part to the batch too
+    jobs_run_batch(impl);
+    while (impl->completed < impl->count) {
+        platform_cond_wait(&impl->done_cond, &impl->mutex);
+    }
+
+    impl->busy = false;
+    impl->func = NULL;
+    impl->user_data = NULL;
+    platform_mutex_unlock(&impl->mutex);
+}
+
+jobs_task_t jobs_run_async(jobs_t* jobs, jobs_func_t func, void* user_data) {
+    assert(func);
+
+    jobs_impl_t* impl = jobs ? (jobs_impl_t*)jobs->impl : NULL;
+    if (impl) {
+        platform_mutex_lock(&impl->mutex);
+        for (int32_t t = 0; t < JOBS_MAX_TASKS; ++t) {
+            if (impl->tasks[t].id == 0) {
+                // ids never wrap to 0, which marks completed tasks
+                if (++impl->next_task_id == 0) {
+                    ++impl->next_task_id;
+                }
+
+                impl->tasks[t].func = func;
+                impl->tasks[t].user_data = user_data;
+                impl->tasks[t].id = impl->next_task_id;
+
+                jobs_task_t task = {.id = impl->next_task_id};
+                platform_cond_broadcast(&impl->work_cond);
+                platform_mutex_unlock(&impl->mutex);
+                return task;
+            }
+        }
+        platform_mutex_unlock(&impl->mutex);
+    }
+
+    // no worker to run it, then do it now
+    func(user_data, 0);
+    return (jobs_task_t){.id = 0};
+}
+
+// the mutex must be locked
+static bool jobs_task_is_pending(const jobs_impl_t* impl, jobs_task_t task) {
+    for (int32_t t = 0; t < JOBS_MAX_TASKS && task.id; ++t) {
+        if (impl->tasks[t].id == task.id) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool jobs_is_done(jobs_t* jobs, jobs_task_t task) {
+    jobs_impl_t* impl = jobs ? (jobs_impl_t*)jobs->impl : NULL;
+    if (!impl || task.id == 0) {
+        return true;
+    }
+
+    platform_mutex_lock(&impl->mutex);
+    bool pending = jobs_task_is_pending(impl, task);
+    platform_mutex_unlock(&impl->mutex);
+    return !pending;
+}
+
+void jobs_wait(jobs_t* jobs, jobs_task_t task) {
+    jobs_impl_t* impl = jobs ? (jobs_impl_t*)jobs->impl : NULL;
+    if (!impl || task.id == 0) {
+        return;
+    }
+
+    platform_mutex_lock(&impl->mutex);
+    while (jobs_task_is_pending(impl, task)) {
+        platform_cond_wait(&impl->done_cond, &impl->mutex);
+    }
+    platform_mutex_unlock(&impl->mutex);
+}
+
+bool jobs_mutex_init(jobs_mutex_t* mutex) {
+    assert(mutex);
+
+    platform_mutex_t* impl = memory_malloc(sizeof(platform_mutex_t));
+    if (impl) {
+        platform_mutex_init(impl);
+    }
+
+    mutex->impl = impl;
+    return impl != NULL;
+}
+
+void jobs_mutex_cleanup(jobs_mutex_t* mutex) {
+    assert(mutex);
+
+    if (mutex->impl) {
+        platform_mutex_destroy((platform_mutex_t*)mutex->impl);
+        memory_free(mutex->impl);
+        mutex->impl = NULL;
+    }
+}
+
+void jobs_mutex_lock(jobs_mutex_t* mutex) {
+    assert(mutex && mutex->impl);
+    platform_mutex_lock((platform_mutex_t*)mutex->impl);
+}
+
+void jobs_mutex_unlock(jobs_mutex_t* mutex) {
+    assert(mutex && mutex->impl);
+    platform_mutex_unlock((platform_mutex_t*)mutex->impl);
+}
+
+#else // JOBS_NO_THREADS
+
+bool jobs_init(jobs_t* jobs, uint32_t num_workers) {
+    assert(jobs);
+    (void)num_workers;
+    jobs->impl = NULL;
+    return false;
+}
+
+void jobs_cleanup(jobs_t* jobs) {
+    assert(jobs);
+    jobs->impl = NULL;
+}
+
+uint32_t jobs_num_workers(const jobs_t* jobs) {
+    (void)jobs;
+    return 0;
+}
+
+void jobs_parallel_for(jobs_t* jobs, jobs_func_t func,
+    void* user_data, uint32_t count) {
+    assert(func);
+    (void)jobs;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        func(user_data, i);
+    }
+}
+
+jobs_task_t jobs_run_async(jobs_t* jobs, jobs_func_t func, void* user_data) {
+    assert(func);
+    (void)jobs;
+
+    func(user_data, 0);
+    return (jobs_task_t){.id = 0};
+}
+
+bool jobs_is_done(jobs_t* jobs, jobs_task_t task) {
+    (void)jobs;
+    (void)task;
+    return true;
+}
+
+void jobs_wait(jobs_t* jobs, jobs_task_t task) {
+    (void)jobs;
+    (void)task;
+}
+
+bool jobs_mutex_init(jobs_mutex_t* mutex) {
+    assert(mutex);
+    mutex->impl = NULL;
+    return true;
+}
+
+void jobs_mutex_cleanup(jobs_mutex_t* mutex) {
+    assert(mutex);
+    mutex->impl = NULL;
+}
+
+void jobs_mutex_lock(jobs_mutex_t* mutex) {
+    (void)mutex;
+}
+
+void jobs_mutex_unlock(jobs_mutex_t* mutex) {
+    (void)mutex;
+}
+
+#endif // JOBS_NO_THREADS
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
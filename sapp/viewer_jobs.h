@@ -0,0 +1,96 @@
+#pragma once
+/**
+ * Minimal worker pool, to run data parallel, and asynchronous jobs
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define JOBS_MAX_WORKERS 32
+#define JOBS_MAX_TASKS 32   // max number of pending asynchronous tasks
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Function executed for each index of a parallel for.
+ * It can be called concurrently from different threads.
+ */
+typedef void (*jobs_func_t)(void* user_data, uint32_t index);
+
+typedef struct {
+    void* impl;
+} jobs_t;
+
+// asynchronous task ticket, 0 for tasks already completed
+typedef struct {
+    uint32_t id;
+} jobs_task_t;
+
+typedef struct {
+    void* impl;
+} jobs_mutex_t;
+
+/**
+ * Spawn the worker threads.
+ *
+ * @param num_workers The number of worker threads, if 0, then one
+ *  for each logical core, except the one of the calling thread.
+ * @return false if threads are not available, in which case,
+ *  jobs will be executed serially by the calling thread.
+ */
+bool jobs_init(jobs_t* jobs, uint32_t num_workers);
+
+/**
+ * Wait for the workers to terminate and release them.
+ */
+void jobs_cleanup(jobs_t* jobs);
+
+/**
+ * Returns the number of worker threads,
+ * not counting the calling thread.
+ */
+uint32_t jobs_num_workers(const jobs_t* jobs);
+
+/**
+ * Execute func for each index in [0, count) across the workers, and
+ * the calling thread, returning once all of them have completed.
+ * If jobs is NULL, not initialised, or already busy with another
+ * parallel for (e.g. when called from within a job), then, the
+ * indices are executed serially by the calling thread.
+ */
+void jobs_parallel_for(jobs_t* jobs, jobs_func_t func,
+    void* user_data, uint32_t count);
+
+/**
+ * Queue func(user_data, 0) to be executed by the first available
+ * worker, and return immediately. If there are no workers, or too
+ * many tasks are pending, then, it is executed by the calling thread
+ * before returning. Tasks can run parallel fors themselves, and they
+ * must have completed before the jobs are cleaned up.
+ */
+jobs_task_t jobs_run_async(jobs_t* jobs, jobs_func_t func, void* user_data);
+
+/**
+ * Returns whether the asynchronous task has completed.
+ */
+bool jobs_is_done(jobs_t* jobs, jobs_task_t task);
+
+/**
+ * Block the calling thread until the asynchronous task has completed.
+ */
+void jobs_wait(jobs_t* jobs, jobs_task_t task);
+
+/**
+ * Mutex to protect data shared between tasks and other threads.
+ * Without threads support, these are no-ops.
+ */
+bool jobs_mutex_init(jobs_mutex_t* mutex);
+void jobs_mutex_cleanup(jobs_mutex_t* mutex);
+void jobs_mutex_lock(jobs_mutex_t* mutex);
+void jobs_mutex_unlock(jobs_mutex_t* mutex);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
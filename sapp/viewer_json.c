@@ -0,0 +1,301 @@
+#include "viewer_json.h"
+#include "viewer_memory.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_MIN_TOKENS 256
+#define JSON_MAX_NUMBER 64  // characters of numbers
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t token;
+    bool key_expected;      // objects only, members are keys and values
+    bool value_expected;    // after a key, until its value
+} json_level_t;
+
+static bool push_token(json_t* json, uint32_t* capacity,
+    json_type_t type, uint32_t start, uint32_t end) {
+    if (json->num_tokens == *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity * 2 : JSON_MIN_TOKENS;
+        json_token_t* tokens = memory_realloc(json->tokens,
+            sizeof(json_token_t) * new_capacity);
+        if (!tokens) {
+            return false;
+        }
+
+        json->tokens = tokens;
+        *capacity = new_capacity;
+    }
+
+    uint32_t index = json->num_tokens++;
+    json->tokens[index] = (json_token_t){
+        .type = type,
+        .start = start,
+        .end = end,
+        .next = index + 1
+    };
+
+    return true;
+}
+
+// account the value, or the key, about to be pushed, for its parent
+static bool add_child(json_t* json, json_level_t* levels, uint32_t depth,
+    bool is_string) {
+    if (depth == 0) {
+        // only one value at the root
+        return json->num_tokens == 0;
+    }
+
+    json_level_t* level = &levels[depth - 1];
+    json_token_t* parent = &json->tokens[level->token];
+    if (parent->type == JSON_ARRAY) {
+        ++parent->size;
+        return true;
+    }
+
+    if (level->key_expected) {
+        level->key_expected = false;
+        level->value_expected = true;
+        ++parent->size;
+        return is_string;
+    }
+
+    // values follow their key, one each
+    if (!level->value_expected) {
+        return false;
+    }
+
+    level->value_expected = false;
+    return true;
+}
+
+bool json_parse(const char* text, size_t size, json_t* out_json) {
+    assert(text && out_json);
+    *out_json = (json_t){.text = text};
+    if (size > UINT32_MAX) {
+        return false;
+    }
+
+    json_level_t levels[JSON_MAX_DEPTH];
+    uint32_t depth = 0;
+    uint32_t capacity = 0;
+
+    for (uint32_t pos = 0; pos < (uint32_t)size; ++pos) {
+        char c = text[pos];
+        switch (c) {
+            case ' ': case '\t': case '\r': case '\n':
+                break;
+
+            case '{': case '[': {
+                if (depth == JSON_MAX_DEPTH
+                    || !add_child(out_json, levels, depth, false)
+                    || !push_token(out_json, &capacity,
+                        (c == '{') ? JSON_OBJECT : JSON_ARRAY, pos, pos)) {
+                    return false;
+                }
+
+                levels[depth++] = (json_level_t){
+                    .token = out_json->num_tokens - 1,
+                    .key_expected = (c == '{'),
+                    .value_expected = false
+                };
+                break;
+            }
+
+            case '}': case ']': {
+                json_type_t type = (c == '}') ? JSON_OBJECT : JSON_ARRAY;
+                if (depth == 0 || levels[depth - 1].value_expected
+                    || out_json->tokens[levels[depth - 1].token].type != type) {
+                    return false;
+                }
+
+                json_token_t* token = &out_json->tokens[levels[--depth].token];
+                token->end = pos + 1;
+                token->next = out_json->num_tokens;
+                break;
+            }
+
+            case ':':
+                break;
+
+            case ',':
+                if (depth > 0 && levels[depth - 1].value_expected) {
+                    return false;
+                }
+
+                if (depth > 0 && out_json->tokens[levels[depth - 1].token].type
+                    == JSON_OBJECT) {
+                    levels[depth - 1].key_expected = true;
+                }
+                break;
+
+            case '"': {
+                uint32_t start = pos + 1;
+                for (++pos; pos < (uint32_t)size && text[pos] != '"'; ++pos) {
+                    if (text[pos] == '\\') {
+                        ++pos;
+                    }
+                }
+
+                if (pos >= (uint32_t)size
+                    || !add_child(out_json, levels, depth, true)
+                    || !push_token(out_json, &capacity, JSON_STRING, start, pos)) {
+                    return false;
+                }
+                break;
+            }
+
+            default: {
+                if (!strchr("-0123456789tfn", c)) {
+                    return false;
+                }
+
+                uint32_t start = pos;
+                while (pos + 1 < (uint32_t)size
+                    && !strchr(" \t\r\n,]}", text[pos + 1])) {
+                    ++pos;
+                }
+
+                if (!add_child(out_json, levels, depth, false)
+                    || !push_token(out_json, &capacity, JSON_PRIMITIVE,
+                        start, pos + 1)) {
+                    return false;
+                }
+                break;
+            }
+        }
+    }
+
+    return depth == 0 && out_json->num_tokens > 0;
+}
+
+void json_release(json_t* json) {
+    assert(json);
+    if (json->tokens) {
+        memory_free(json->tokens);
+    }
+
+    *json = (json_t){0};
+}
+
+int32_t json_find(const json_t* json, int32_t object, const char* key) {
+    assert(json && key);
+    if (object < 0 || json->tokens[object].type != JSON_OBJECT) {
+        return -1;
+    }
+
+    uint32_t t = (uint32_t)object + 1;
+    for (uint32_t m = 0; m < json->tokens[object].size; ++m) {
+        uint32_t value = t + 1;
+        if (json_equals(json, (int32_t)t, key)) {
+            return (int32_t)value;
+        }
+
+        t = json->tokens[value].next;
+    }
+
+    return -1;
+}
+
+int32_t json_element(const json_t* json, int32_t array, uint32_t index) {
+    assert(json);
+    if (array < 0 || json->tokens[array].type != JSON_ARRAY
+        || index >= json->tokens[array].size) {
+        return -1;
+    }
+
+    uint32_t t = (uint32_t)array + 1;
+    for (uint32_t e = 0; e < index; ++e) {
+        t = json->tokens[t].next;
+    }
+
+    return (int32_t)t;
+}
+
+double json_number(const json_t* json, int32_t token, double def) {
+    assert(json);
+    if (token < 0 || json->tokens[token].type != JSON_PRIMITIVE) {
+        return def;
+    }
+
+    // numbers are not terminated within the text
+    const json_token_t* t = &json->tokens[token];
+    char number[JSON_MAX_NUMBER];
+    uint32_t length = t->end - t->start;
+    if (length >= JSON_MAX_NUMBER || !strchr("-0123456789", json->text[t->start])) {
+        return def;
+    }
+
+    memcpy(number, json->text + t->start, length);
+    number[length] = '\0';
+    return strtod(number, NULL);
+}
+
+bool json_equals(const json_t* json, int32_t token, const char* string) {
+    assert(json && string);
+    if (token < 0 || json->tokens[token].type != JSON_STRING) {
+        return false;
+    }
+
+    const json_token_t* t = &json->tokens[token];
+    size_t length = t->end - t->start;
+    return strlen(string) == length
+        && memcmp(json->text + t->start, string, length) == 0;
+}
+
+static int32_t hex_digit(char c) {
+    return (c >= '0' && c <= '9') ? c - '0'
+        : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+        : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+}
+
+bool json_copy_string(const json_t* json, int32_t token,
+    char* out, size_t size) {
+    assert(json && out && size > 0);
+    out[0] = '\0';
+    if (token < 0 || json->tokens[token].type != JSON_STRING) {
+        return false;
+    }
+
+    const json_token_t* t = &json->tokens[token];
+    const char* text = json->text;
+    size_t length = 0;
+    for (uint32_t p = t->start; p < t->end && length + 1 < size; ++p) {
+        char c = text[p];
+        if (c == '\\' && p + 1 < t->end) {
+            c = text[++p];
+            switch (c) {
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u': {
+                    int32_t code = 0;
+                    for (uint32_t d = 0; d < 4 && p + 1 < t->end; ++d) {
+                        int32_t digit = hex_digit(text[++p]);
+                        code = (code << 4) | (digit >= 0 ? digit : 0);
+                    }
+
+                    c = (code > 0 && code < 0x80) ? (char)code : '?';
+                    break;
+                }
+                default: break; // quotes, slashes
+            }
+        }
+
+        out[length++] = c;
+    }
+
+    out[length] = '\0';
+    return true;
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
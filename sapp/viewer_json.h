@@ -0,0 +1,87 @@
+#pragma once
+/**
+ * Minimal JSON tokenizer
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_MAX_DEPTH 64   // of nested objects and arrays
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef enum {
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_STRING,
+    JSON_PRIMITIVE  // number, true, false or null
+} json_type_t;
+
+// tokens refer to the text, which is never copied nor modified,
+// strings without their quotes, and are stored in document order,
+// each value right after its key, and children right after their
+// parent, so that next skips a token along with all of them.
+typedef struct {
+    json_type_t type;
+    uint32_t start;
+    uint32_t end;
+    uint32_t size;  // members of objects, elements of arrays
+    uint32_t next;  // index of the token following all the children
+} json_token_t;
+
+typedef struct {
+    const char* text;
+    json_token_t* tokens;
+    uint32_t num_tokens;
+} json_t;
+
+/**
+ * Tokenize the text, whose tokens are allocated with memory_realloc,
+ * and must be released with json_release, even if it fails.
+ *
+ * @return false if the text is not valid JSON, or there is not
+ *  enough memory to tokenize it.
+ */
+bool json_parse(const char* text, size_t size, json_t* out_json);
+
+void json_release(json_t* json);
+
+/**
+ * Token of the value of the object member with the given key,
+ * -1 if the token is not an object, or there is no such member.
+ */
+int32_t json_find(const json_t* json, int32_t object, const char* key);
+
+/**
+ * Token of the element at index of the array, -1 if the token is not
+ * an array, or it is out of range. Elements are reached one after the
+ * other, so that iterating an array is better done with next.
+ */
+int32_t json_element(const json_t* json, int32_t array, uint32_t index);
+
+/**
+ * Value of a number, def if the token is not a number, or it is -1.
+ */
+double json_number(const json_t* json, int32_t token, double def);
+
+/**
+ * Whether the token is the string given, escapes are not resolved.
+ */
+bool json_equals(const json_t* json, int32_t token, const char* string);
+
+/**
+ * Copy the string into out, resolving its escapes, and truncating it
+ * to size, terminator included. Only ASCII characters are resolved
+ * out of unicode escapes, others are replaced with '?'.
+ *
+ * @return false if the token is not a string, and out is left empty.
+ */
+bool json_copy_string(const json_t* json, int32_t token,
+    char* out, size_t size);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -1,6 +1,7 @@
 //------------------------------------------------------------------------------
 //  viewer-sapp.c
 //------------------------------------------------------------------------------
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -11,6 +12,7 @@
 #include "sokol_time.h"
 
 #include "cute_path.h"
+#include "cute_files.h"
 
 #include "ui/sgui.h"
 #include "ui/sgui_gfx.h"
@@ -25,6 +27,10 @@
 #include "viewer_geometry_pass.h"
 #include "viewer_memory.h"
 #include "viewer_wavefront.h"
+#include "viewer_asset.h"
+#include "viewer_gltf.h"
+#include "viewer_ply.h"
+#include "viewer_jobs.h"
 
 #define MSAA_SAMPLES 1
 #define SWAP_INTERVAL 0
@@ -54,6 +60,7 @@ static inline float rnd(float min_val, float max_val) {
 
 static geometry_pass_t geometry_pass = {0};
 static scene_t scene = {0};
+static jobs_t jobs = {0};
 
 static material_id_t default_mat_id = {HANDLE_INVALID_ID};
 
@@ -63,6 +70,30 @@ static node_id_t box_node_ids[MAX_BOXES];
 
 static model_id_t wf_model_id = {HANDLE_INVALID_ID};
 static node_id_t wf_node_id = {HANDLE_INVALID_ID};
+static point_cloud_id_t wf_cloud_id = {HANDLE_INVALID_ID};
+
+// shapes repeated within the object imported at once, drawn as
+// instances of their own models, are added to the scene along with it
+typedef struct {
+    model_id_t model;
+    transform_t transform;
+} wf_instance_t;
+
+static wf_instance_t wf_instances[WAVEFRONT_MAX_INSTANCES];
+static uint32_t wf_num_instances = 0;
+
+// progressive import, uploading the model across frames
+static wavefront_stream_t wf_stream = {0};
+static uint32_t wf_stream_upload_bytes = 0;
+
+// concurrent import of all the objects found in a directory,
+// the batch is kept until the scene is reset, not to import it twice
+#define WF_BATCH_MAX_FILES 256
+static wavefront_batch_t wf_batch = {0};
+static node_id_t wf_batch_node_ids[WF_BATCH_MAX_FILES];
+static uint32_t wf_batch_num_files = 0;
+static uint32_t wf_batch_num_pending = 0;
+static uint32_t wf_batch_models_per_frame = 0;
 
 static stats_t stats = {
     .max_frames = STATS_FRAMES
@@ -84,6 +115,8 @@ static app_t app = {
 };
 
 static void setup_render() {
+    geometry_pass.jobs = &jobs;
+    geometry_pass.compress_images = atoi(sargs_value_def("compress", "1")) != 0;
     geometry_pass_init(&geometry_pass);
 
     default_mat_id = geometry_pass_get_default_material(&geometry_pass);
@@ -104,6 +137,8 @@ static void setup_render() {
         });
 
     wf_model_id = (model_id_t) {HANDLE_INVALID_ID};
+    wf_cloud_id = (point_cloud_id_t) {HANDLE_INVALID_ID};
+    wf_num_instances = 0;
 }
 
 static void setup_camera() {
@@ -145,10 +180,35 @@ static void setup_scene() {
 
 static void update_scene() {
     scene_update_geometry_pass(&scene, &geometry_pass);
+    app.stats->visible_nodes = scene.nodes.num_visible;
+    app.stats->culled_nodes = scene.nodes.num_culled;
+    app.stats->dropped_nodes = scene.nodes.num_dropped;
+}
+
+// the cloud is drawn in scene space, and only its chunks
+// dense enough on screen, up to the budget of points
+static void update_point_cloud() {
+    if (!handle_is_valid(wf_cloud_id, GEOMETRY_PASS_MAX_POINT_CLOUDS)) {
+        app.stats->drawn_points = app.stats->total_points = 0;
+        return;
+    }
+
+    app.stats->drawn_points = geometry_pass_update_point_cloud(&geometry_pass,
+        wf_cloud_id, &(point_cloud_view_t){
+            .pose = scene.root,
+            .point_budget = (uint32_t)atoi(
+                sargs_value_def("point_budget", "4000000")),
+            .viewport_height = (mfloat_t)sapp_height(),
+            .point_size = (mfloat_t)atof(sargs_value_def("point_size", "2"))
+        });
+
+    app.stats->total_points =
+        geometry_pass.point_clouds[wf_cloud_id.id].num_points;
 }
 
 static void draw_scene() {
     render_pass_draw(&geometry_pass.render);
+    render_pass_draw(&geometry_pass.points);
 }
 
 static void clear_scene() {
@@ -161,7 +221,23 @@ static void clear_render() {
     memset(&geometry_pass, 0, sizeof(geometry_pass));
 }
 
+static void end_wavefront_stream() {
+    if (wf_stream.impl) {
+        wavefront_stream_end(&wf_stream);
+    }
+}
+
+static void end_wavefront_batch() {
+    if (wf_batch.impl) {
+        wavefront_batch_end(&wf_batch);
+        wf_batch_num_files = 0;
+        wf_batch_num_pending = 0;
+    }
+}
+
 static void reset_app() {
+    end_wavefront_stream();
+    end_wavefront_batch();
     clear_scene();
     clear_render();
     setup_render();
@@ -269,6 +345,44 @@ static int32_t destroy_box(int32_t box_id, bool recursive) {
     return alive_boxes;
 }
 
+// make the object model, and the models of its instanced shapes,
+// whose instances are kept to be added to the scene with the object.
+static model_id_t make_wavefront_models(const wavefront_model_t* wf_model) {
+    model_id_t* shape_models = memory_malloc(
+        sizeof(model_id_t) * wf_model->num_shapes);
+    if (!shape_models) {
+        return wavefront_make_model(&geometry_pass, wf_model);
+    }
+
+    model_id_t model_id = wavefront_make_models(
+        &geometry_pass, wf_model, shape_models);
+
+    wf_num_instances = 0;
+    for (int32_t i = 0; i < wf_model->num_instances; ++i) {
+        const wavefront_instance_t* instance = &wf_model->instances[i];
+        model_id_t shape_model = shape_models[instance->shape_id];
+        if (handle_is_valid(shape_model, GEOMETRY_PASS_MAX_MODELS)) {
+            wf_instances[wf_num_instances++] = (wf_instance_t){
+                .model = shape_model,
+                .transform = instance->transform
+            };
+        }
+    }
+
+    memory_free(shape_models);
+
+    // the first instance, which is where its shape is, stands
+    // for the object, when all of the object shapes are instanced
+    if (!handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)
+        && wf_num_instances > 0) {
+        model_id = wf_instances[0].model;
+        memmove(wf_instances, wf_instances + 1,
+            sizeof(wf_instance_t) * --wf_num_instances);
+    }
+
+    return model_id;
+}
+
 model_id_t load_wavefront_model(const char* filename) {
     assert(filename);
 
@@ -285,30 +399,35 @@ model_id_t load_wavefront_model(const char* filename) {
     // load file content into a memory buffer
     if (FILE_READALL_OK == file_readall(
         file_model, &buffer_data, &buffer_size, memory_realloc)) {
-        assert(buffer_size < INT32_MAX);
 
         trace_t wf_name;
         path_pop(filename, NULL, wf_name.name);
         path_pop_ext(wf_name.name, wf_name.name, NULL);
 
+        // textures are relative to the object file
+        char wf_dir[WAVEFRONT_MAX_PATH] = {0};
+        path_pop(filename, wf_dir, NULL);
+
         // load wavefront model from memory buffer
         wavefront_model_t wf_model = {0};
         wavefront_result_t wf_result = wavefront_parse_obj(&(wavefront_data_t){
             .allocator = memory_realloc,
+            .jobs = &jobs,
+            .base_path = wf_dir,
             .obj_data = buffer_data,
-            .data_size = (int32_t)buffer_size,
+            .data_size = buffer_size,
             .atlas_width = 1024,
             .atlas_height = 1024,
             .import_options = 
                     //WAVEFRONT_IMPORT_REWIND_FACES
-                    WAVEFRONT_IMPORT_DEFAULT,
+                    WAVEFRONT_IMPORT_DEFAULT |
+                    WAVEFRONT_IMPORT_DETECT_INSTANCES,
             .label = wf_name.name
         }, &wf_model);
 
         // accommodate for render model resources
         if (WAVEFRONT_RESULT_OK == wf_result) {
-            result_model_id = wavefront_make_model(
-                &geometry_pass, &wf_model);
+            result_model_id = make_wavefront_models(&wf_model);
             wavefront_release_obj(&wf_model);
         }
     }
@@ -319,14 +438,261 @@ model_id_t load_wavefront_model(const char* filename) {
     return result_model_id;
 }
 
-node_id_t add_wavefront_to_scene(model_id_t model_id) {
+// objects converted offline have their model next to them,
+// with the same name, which is loaded instead, if it exists
+static bool find_asset_model(const char* filename, char* out_filename) {
+    char asset_name[WAVEFRONT_MAX_PATH] = {0};
+    char asset_dir[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(filename, asset_dir, asset_name);
+    path_pop_ext(asset_name, asset_name, NULL);
+    snprintf(out_filename, WAVEFRONT_MAX_PATH, "%s/%s%s",
+        asset_dir, asset_name, ASSET_FILE_EXTENSION);
+    return file_exists(out_filename);
+}
+
+// the mesh is uploaded as it has been built, without parsing it
+model_id_t load_asset_model(const char* filename) {
+    assert(filename);
+
+    asset_model_t asset = {0};
+    if (!asset_read(filename, &asset)) {
+        return (model_id_t){.id=HANDLE_INVALID_ID};
+    }
+
+    return asset_make_model(&geometry_pass, &asset);
+}
+
+static bool is_gltf_file(const char* filename) {
+    const char* ext = strrchr(filename, '.');
+    return ext && (strcmp(ext, ".gltf") == 0 || strcmp(ext, ".glb") == 0);
+}
+
+// the file, and its buffers, are mapped rather than read. each mesh
+// becomes a model of its own, shared by the nodes referencing it, and
+// the node tree is added to the scene below a single node, returned.
+static node_id_t load_gltf_scene(const char* filename) {
+    assert(filename);
+
+    file_map_t map;
+    if (!file_map(filename, &map)) {
+        return (node_id_t){.id=HANDLE_INVALID_ID};
+    }
+
+    trace_t gltf_name;
+    path_pop(filename, NULL, gltf_name.name);
+    path_pop_ext(gltf_name.name, gltf_name.name, NULL);
+
+    // buffers and images are relative to the file
+    char gltf_dir[GLTF_MAX_PATH] = {0};
+    path_pop(filename, gltf_dir, NULL);
+
+    node_id_t result_node_id = {.id=HANDLE_INVALID_ID};
+    gltf_model_t gltf_model;
+    gltf_result_t gltf_result = gltf_load(&(gltf_data_t){
+        .jobs = &jobs,
+        .base_path = gltf_dir,
+        .gltf_data = map.data,
+        .data_size = map.size,
+        .num_lods = GEOMETRY_PASS_MAX_LODS,
+        .keep_hierarchy = true,
+        .label = gltf_name.name
+    }, &gltf_model);
+
+    model_id_t* mesh_models = NULL;
+    if (GLTF_RESULT_OK == gltf_result && gltf_model.num_meshes > 0) {
+        mesh_models = memory_malloc(sizeof(model_id_t) * gltf_model.num_meshes);
+    }
+
+    if (mesh_models
+        && gltf_make_mesh_models(&geometry_pass, &gltf_model, mesh_models) > 0) {
+        result_node_id = gltf_add_scene_nodes(&scene, &gltf_model, mesh_models,
+            &(node_desc_t){
+                .transform = {
+                    .position = svec3_zero(),
+                    .scale = svec3_one(),
+                    .rotation = squat_null()
+                },
+                // colors come from the materials
+                .color = svec4(1.0f, 1.0f, 1.0f, 0.0f),
+                .tile = svec4(1.0f, 1.0f, 0.0f, 0.0f),
+                .model = {.id=HANDLE_INVALID_ID},
+                .parent = {.id=HANDLE_INVALID_ID},
+                .label = "gltf_node"
+            });
+
+        // without the nodes, nothing would ever draw the models
+        if (!handle_is_valid(result_node_id, SCENE_MAX_NODES)) {
+            gltf_destroy_mesh_models(&geometry_pass, &gltf_model, mesh_models);
+        }
+    }
+
+    if (mesh_models) {
+        memory_free(mesh_models);
+    }
+
+    gltf_release(&gltf_model);
+    file_unmap(&map);
+    return result_node_id;
+}
+
+static bool is_ply_file(const char* filename) {
+    const char* ext = strrchr(filename, '.');
+    return ext && strcmp(ext, ".ply") == 0;
+}
+
+// the file is mapped, so that the vertices are read in place when
+// their layout allows it. files with faces are meshes, returned as a
+// model, and the others point clouds, made into out_cloud_id.
+static model_id_t load_ply(const char* filename,
+    point_cloud_id_t* out_cloud_id) {
+    assert(filename && out_cloud_id);
+
+    model_id_t model_id = {.id=HANDLE_INVALID_ID};
+    *out_cloud_id = (point_cloud_id_t){.id=HANDLE_INVALID_ID};
+
+    file_map_t map;
+    if (!file_map(filename, &map)) {
+        return model_id;
+    }
+
+    trace_t ply_name;
+    path_pop(filename, NULL, ply_name.name);
+    path_pop_ext(ply_name.name, ply_name.name, NULL);
+
+    ply_model_t ply_model;
+    ply_result_t ply_result = ply_load(&(ply_data_t){
+        .jobs = &jobs,
+        .ply_data = map.data,
+        .data_size = map.size,
+        .num_lods = GEOMETRY_PASS_MAX_LODS,
+        .label = ply_name.name
+    }, &ply_model);
+
+    if (PLY_RESULT_OK == ply_result) {
+        if (ply_model.vertices) {
+            model_id = ply_make_model(&geometry_pass, &ply_model);
+        }
+        else {
+            *out_cloud_id = ply_make_point_cloud(&geometry_pass, &ply_model);
+        }
+    }
+
+    ply_release(&ply_model);
+    file_unmap(&map);
+    return model_id;
+}
+
+// objects small enough are imported at once, by default, as only
+// then are their instances detected, and their materials packed,
+// while larger ones are streamed, to be drawn as soon as possible.
+static bool is_blocking_import(const char* filename) {
+    const char* mode = sargs_value_def("wf_import", "auto");
+    if (strcmp(mode, "auto") != 0) {
+        return strcmp(mode, "blocking") == 0;
+    }
+
+    file_t file = file_open(filename, FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(file)) {
+        return false;
+    }
+
+    int64_t size = file_size(file);
+    file_close(file);
+
+    int64_t max_size = (int64_t)atoi(
+        sargs_value_def("wf_blocking_mb", "64")) * 1024 * 1024;
+    return size >= 0 && size <= max_size;
+}
+
+// the file is read by the stream itself, a block at a time
+static bool begin_wavefront_stream(const char* filename) {
+    assert(filename && !wf_stream.impl);
+
+    if (!file_exists(filename)) {
+        return false;
+    }
+
+    trace_t wf_name;
+    path_pop(filename, NULL, wf_name.name);
+    path_pop_ext(wf_name.name, wf_name.name, NULL);
+
+    char wf_dir[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(filename, wf_dir, NULL);
+
+    return wavefront_stream_begin(&wf_stream, &(wavefront_data_t){
+        .allocator = memory_realloc,
+        .jobs = &jobs,
+        .base_path = wf_dir,
+        .obj_filename = filename,
+        .import_options = WAVEFRONT_IMPORT_DEFAULT
+            & ~WAVEFRONT_IMPORT_PACK_ATLAS,
+        .label = wf_name.name
+    });
+}
+
+static void gather_wavefront_file(cf_file_t* file, void* user_data) {
+    const char** filenames = (const char**)user_data;
+    if (file->is_reg && cf_match_ext(file, ".obj")
+        && wf_batch_num_files < WF_BATCH_MAX_FILES) {
+        size_t size = strlen(file->path) + 1;
+        char* filename = memory_malloc(size);
+        if (filename) {
+            memcpy(filename, file->path, size);
+            filenames[wf_batch_num_files++] = filename;
+        }
+    }
+}
+
+// import all the objects of the directory, and its sub-directories,
+// concurrently, models are added to the scene as they get made.
+static bool begin_wavefront_batch(const char* dirname) {
+    assert(dirname && !wf_batch.impl);
+
+    const char* filenames[WF_BATCH_MAX_FILES];
+    wf_batch_num_files = 0;
+    cf_traverse(dirname, gather_wavefront_file, filenames);
+    if (wf_batch_num_files == 0) {
+        LOG_WARN("WARN: No objects found in (%s)\n", dirname);
+        return false;
+    }
+
+    LOG_INFO("INFO: Importing %d objects from (%s)\n",
+        wf_batch_num_files, dirname);
+
+    for (uint32_t f = 0; f < WF_BATCH_MAX_FILES; ++f) {
+        wf_batch_node_ids[f] = (node_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    bool began = wavefront_batch_begin(&wf_batch, &(wavefront_batch_desc_t){
+        .allocator = memory_realloc,
+        .jobs = &jobs,
+        .filenames = filenames,
+        .num_files = wf_batch_num_files,
+        .atlas_width = 1024,
+        .atlas_height = 1024,
+        .import_options = WAVEFRONT_IMPORT_DEFAULT
+    });
+
+    // the batch keeps its own copy of the names
+    for (uint32_t f = 0; f < wf_batch_num_files; ++f) {
+        memory_free((void*)filenames[f]);
+    }
+
+    wf_batch_num_pending = began ? wf_batch_num_files : 0;
+    if (!began) {
+        wf_batch_num_files = 0;
+    }
+
+    return began;
+}
+
+static node_id_t add_wavefront_node(model_id_t model_id,
+    transform_t transform, node_id_t parent, const char* label) {
     return scene_add_node(&scene, &(node_desc_t){
-        .transform = (transform_t){
-            .position = svec3_zero(),
-            .scale = svec3_one(),
-            .rotation = squat_null()
-        },
-        .color = svec4(0.6f, 0.6f, 0.6f, 1.0f),
+        .transform = transform,
+        // colors come from the materials,
+        // whose textures have a single layer
+        .color = svec4(1.0f, 1.0f, 1.0f, 0.0f),
         .tile = (vec4f_t){
             .x = 1.0f,  // scaling u
             .y = 1.0f,  // scaling v
@@ -334,11 +700,36 @@ node_id_t add_wavefront_to_scene(model_id_t model_id) {
             .w = 0.0f   // panning v
         },
         .model = model_id,
-        .parent = (node_id_t){.id=HANDLE_INVALID_ID},
-        .label = "wavefront_node"
+        .parent = parent,
+        .label = label
     });
 }
 
+node_id_t add_wavefront_to_scene(model_id_t model_id, vec3f_t position) {
+    return add_wavefront_node(model_id, (transform_t){
+            .position = position,
+            .scale = svec3_one(),
+            .rotation = squat_null()
+        },
+        (node_id_t){.id=HANDLE_INVALID_ID},
+        "wavefront_node");
+}
+
+// instances are placed relative to the object node
+static void add_wavefront_instances(node_id_t parent) {
+    for (uint32_t i = 0; i < wf_num_instances; ++i) {
+        node_id_t node = add_wavefront_node(wf_instances[i].model,
+            wf_instances[i].transform, parent, "wavefront_instance");
+        if (!handle_is_valid(node, SCENE_MAX_NODES)) {
+            LOG_WARN("WARN: No room in the scene for %d instances\n",
+                wf_num_instances - i);
+            break;
+        }
+    }
+
+    wf_num_instances = 0;
+}
+
 void init(void) {
     sg_setup(&(sg_desc) {
         .gl_force_gles2 = false,
@@ -363,6 +754,9 @@ void init(void) {
     // setup stats
     stats_init(app.stats, STATS_FRAMES);
 
+    // worker threads for import jobs
+    jobs_init(&jobs, 0);
+
     // it is important to initialise the gui BEFORE the graphics 
     sgui_setup(app.msaa_samples, sapp_dpi_scale(), sgui_descs);
 
@@ -373,9 +767,61 @@ void init(void) {
     stm_setup();
 }
 
+// upload what the stream has ready, within the frame
+// budget, adding the model as soon as it can be drawn.
+static void update_wavefront_stream() {
+    if (!wf_stream.impl) {
+        return;
+    }
+
+    wavefront_stream_status_t status = wavefront_stream_update(
+        &wf_stream, &geometry_pass, wf_stream_upload_bytes);
+
+    wf_model_id = wavefront_stream_model(&wf_stream);
+    if (handle_is_valid(wf_model_id, GEOMETRY_PASS_MAX_MODELS)
+        && !handle_is_valid(wf_node_id, SCENE_MAX_NODES)) {
+        wf_node_id = add_wavefront_to_scene(wf_model_id, svec3_zero());
+    }
+
+    if (status != WAVEFRONT_STREAM_PENDING) {
+        end_wavefront_stream();
+    }
+}
+
+// make the models imported so far, as many per frame as allowed,
+// and lay them out on a grid, in the same order as their files.
+static void update_wavefront_batch() {
+    if (!wf_batch.impl || wf_batch_num_pending == 0) {
+        return;
+    }
+
+    wf_batch_num_pending = wavefront_batch_update(&wf_batch,
+        &geometry_pass, wf_batch_models_per_frame);
+
+    uint32_t columns = 1;
+    while (columns * columns < wf_batch_num_files) {
+        ++columns;
+    }
+
+    mfloat_t spacing = (mfloat_t)atof(sargs_value_def("wf_spacing", "4"));
+    for (uint32_t f = 0; f < wf_batch_num_files; ++f) {
+        model_id_t model_id = wavefront_batch_model(&wf_batch, f);
+        if (handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)
+            && !handle_is_valid(wf_batch_node_ids[f], SCENE_MAX_NODES)) {
+            wf_batch_node_ids[f] = add_wavefront_to_scene(model_id, svec3(
+                ((mfloat_t)(f % columns) - .5f * (columns - 1)) * spacing,
+                0.f,
+                ((mfloat_t)(f / columns) - .5f * (columns - 1)) * spacing));
+        }
+    }
+}
+
 void update() {
+    update_wavefront_stream();
+    update_wavefront_batch();
     update_lights();
     update_scene();
+    update_point_cloud();
 }
 
 void render() {
@@ -418,12 +864,15 @@ void frame(void) {
 }
 
 void cleanup(void) {
+    end_wavefront_stream();
+    end_wavefront_batch();
     clear_scene();
     clear_render();
 
     sgui_shutdown();
 
     stats_clean(app.stats);
+    jobs_cleanup(&jobs);
 
     sg_shutdown();
     sargs_shutdown();
@@ -623,16 +1072,51 @@ void event(const sapp_event* ev) {
     if ((ev->key_code == SAPP_KEYCODE_W)
         && (ev->type == SAPP_EVENTTYPE_KEY_DOWN)) {
 
-        // create model render resource
-        if (!handle_is_valid(wf_model_id, GEOMETRY_PASS_MAX_MODELS)) {
-            wf_model_id = load_wavefront_model(sargs_value_def("wf",
-                "models/cyberpunk_bar/cyberpunk_bar.obj"));
+        // create model render resource, either at once, or
+        // progressively, in which case, the node is added
+        // once the first part of the model has been uploaded.
+        // materials are only packed into an atlas by blocking
+        // imports, and batch ones, as the streamed geometry is
+        // drawn before textures are decoded, and instances are
+        // only detected by blocking ones. wf_import is either
+        // blocking, progressive, or auto, the default, which
+        // imports objects of up to wf_blocking_mb at once.
+        const char* wf_filename = sargs_value_def("wf",
+            "models/cyberpunk_bar/cyberpunk_bar.obj");
+        char asset_filename[WAVEFRONT_MAX_PATH];
+        if (!handle_is_valid(wf_model_id, GEOMETRY_PASS_MAX_MODELS)
+            && !handle_is_valid(wf_node_id, SCENE_MAX_NODES)
+            && !handle_is_valid(wf_cloud_id, GEOMETRY_PASS_MAX_POINT_CLOUDS)
+            && !wf_stream.impl && !wf_batch.impl) {
+            if (sargs_exists("wf_dir")) {
+                wf_batch_models_per_frame = (uint32_t)atoi(
+                    sargs_value_def("wf_batch_models", "1"));
+                begin_wavefront_batch(sargs_value("wf_dir"));
+            }
+            else if (is_gltf_file(wf_filename)) {
+                wf_node_id = load_gltf_scene(wf_filename);
+            }
+            else if (is_ply_file(wf_filename)) {
+                wf_model_id = load_ply(wf_filename, &wf_cloud_id);
+            }
+            else if (find_asset_model(wf_filename, asset_filename)) {
+                wf_model_id = load_asset_model(asset_filename);
+            }
+            else if (is_blocking_import(wf_filename)) {
+                wf_model_id = load_wavefront_model(wf_filename);
+            }
+            else {
+                wf_stream_upload_bytes = 1024 * (uint32_t)atoi(
+                    sargs_value_def("wf_upload_kb", "4096"));
+                begin_wavefront_stream(wf_filename);
+            }
         }
 
-        // add the model to the scene
+        // add the model, and its instances, to the scene
         if (handle_is_valid(wf_model_id, GEOMETRY_PASS_MAX_MODELS)
             && !handle_is_valid(wf_node_id, SCENE_MAX_NODES)) {
-            wf_node_id = add_wavefront_to_scene(wf_model_id);
+            wf_node_id = add_wavefront_to_scene(wf_model_id, svec3_zero());
+            add_wavefront_instances(wf_node_id);
         }
     }
 
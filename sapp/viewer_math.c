@@ -2,6 +2,33 @@
 
 #include "math.h"
 
+#include <assert.h>
+#include <string.h> // memcpy
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VIEWER_MATH_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VIEWER_MATH_NEON
+#endif
+
+// AVX2 functions are compiled for it whatever the build flags, and
+// only called if the CPU supports it, as detected at runtime
+#if defined(VIEWER_MATH_SSE) && (defined(__x86_64__) || defined(_M_X64) \
+    || defined(__i386__) || defined(_M_IX86))
+#include <immintrin.h>
+#define VIEWER_MATH_AVX2
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__GNUC__) || defined(__clang__)
+#define VIEWER_MATH_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VIEWER_MATH_TARGET_AVX2
+#endif
+#endif
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -80,6 +107,48 @@ vec3f_t squat_rotate_vec3(quat_t r, vec3f_t v) {
         );
 }
 
+// https://www.euclideanspace.com/maths/geometry/rotations/conversions/matrixToQuaternion/
+quat_t squat_from_axes(vec3f_t x, vec3f_t y, vec3f_t z) {
+    mfloat_t trace = x.x + y.y + z.z;
+    if (trace > 0.f) {
+        mfloat_t s = MSQRT(trace + 1.f) * 2.f;
+        return (quat_t){
+            .w = .25f * s,
+            .x = (y.z - z.y) / s,
+            .y = (z.x - x.z) / s,
+            .z = (x.y - y.x) / s
+        };
+    }
+
+    if (x.x > y.y && x.x > z.z) {
+        mfloat_t s = MSQRT(1.f + x.x - y.y - z.z) * 2.f;
+        return (quat_t){
+            .w = (y.z - z.y) / s,
+            .x = .25f * s,
+            .y = (y.x + x.y) / s,
+            .z = (z.x + x.z) / s
+        };
+    }
+
+    if (y.y > z.z) {
+        mfloat_t s = MSQRT(1.f + y.y - x.x - z.z) * 2.f;
+        return (quat_t){
+            .w = (z.x - x.z) / s,
+            .x = (y.x + x.y) / s,
+            .y = .25f * s,
+            .z = (z.y + y.z) / s
+        };
+    }
+
+    mfloat_t s = MSQRT(1.f + z.z - x.x - y.y) * 2.f;
+    return (quat_t){
+        .w = (x.y - y.x) / s,
+        .x = (z.x + x.z) / s,
+        .y = (z.y + y.z) / s,
+        .z = .25f * s
+    };
+}
+
 mat4f_t transform_to_mat4(transform_t transform) {
     return smat4_translate(smat4_multiply(
         smat4_rotation_quat(
@@ -89,6 +158,703 @@ mat4f_t transform_to_mat4(transform_t transform) {
     ), transform.position);
 }
 
+// transforms and matrices of the batches, gathered by index
+#define BATCH_TRANSFORM(transforms, indices, i) \
+    ((const float*)&(transforms)[(indices) ? (indices)[i] : (int32_t)(i)])
+#define BATCH_PARENT(parents, parent_indices, root, i) \
+    (((parent_indices)[i] < 0) ? (root)->v : (parents)[(parent_indices)[i]].v)
+
+// the quaternion is not normalized, as the rotation terms are all
+// products of two of its components, scaled by 2 / |q|^2 instead
+void mat4s_from_transforms_scalar(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* t = BATCH_TRANSFORM(transforms, indices, i);
+        float x = t[6], y = t[7], z = t[8], w = t[9];
+        float length2 = x * x + y * y + z * z + w * w;
+        float s = (length2 > 0.f) ? 2.f / length2 : 0.f;
+
+        float xx = x * x * s, yy = y * y * s, zz = z * z * s;
+        float xy = x * y * s, xz = x * z * s, yz = y * z * s;
+        float wx = w * x * s, wy = w * y * s, wz = w * z * s;
+
+        float* m = out_poses[i].v;
+        m[0] = (1.f - (yy + zz)) * t[3];
+        m[1] = (xy + wz) * t[3];
+        m[2] = (xz - wy) * t[3];
+        m[3] = 0.f;
+        m[4] = (xy - wz) * t[4];
+        m[5] = (1.f - (xx + zz)) * t[4];
+        m[6] = (yz + wx) * t[4];
+        m[7] = 0.f;
+        m[8] = (xz + wy) * t[5];
+        m[9] = (yz - wx) * t[5];
+        m[10] = (1.f - (xx + yy)) * t[5];
+        m[11] = 0.f;
+        m[12] = t[0];
+        m[13] = t[1];
+        m[14] = t[2];
+        m[15] = 1.f;
+    }
+}
+
+void mat4s_multiply_parents_scalar(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const float* p = BATCH_PARENT(parents, parent_indices, root, i);
+        const float* l = locals[i].v;
+        float m[16];
+        for (int32_t c = 0; c < 4; ++c) {
+            for (int32_t r = 0; r < 3; ++r) {
+                m[c * 4 + r] = p[r] * l[c * 4] + p[4 + r] * l[c * 4 + 1]
+                    + p[8 + r] * l[c * 4 + 2] + ((c == 3) ? p[12 + r] : 0.f);
+            }
+
+            m[c * 4 + 3] = (c == 3) ? 1.f : 0.f;
+        }
+
+        // locals may be the output
+        memcpy(out_poses[i].v, m, sizeof(m));
+    }
+}
+
+// lanes hold the same element of each matrix of the batch, the
+// columns of the matrices being transposed into rows when loaded,
+// and back when stored. the last row of affine matrices is constant.
+#if defined(VIEWER_MATH_SSE)
+static void load_transforms_sse(const transform_t* transforms,
+    const int32_t* indices, uint32_t i, __m128 lanes[10]) {
+    const float* t[4];
+    for (uint32_t j = 0; j < 4; ++j) {
+        t[j] = BATCH_TRANSFORM(transforms, indices, i + j);
+    }
+
+    // position and scale x, scale y and z, then
+    // the rotation, overlapping the scale load
+    __m128 a[4] = {_mm_loadu_ps(t[0]), _mm_loadu_ps(t[1]),
+        _mm_loadu_ps(t[2]), _mm_loadu_ps(t[3])};
+    __m128 b[4] = {_mm_loadu_ps(t[0] + 4), _mm_loadu_ps(t[1] + 4),
+        _mm_loadu_ps(t[2] + 4), _mm_loadu_ps(t[3] + 4)};
+    __m128 q[4] = {_mm_loadu_ps(t[0] + 6), _mm_loadu_ps(t[1] + 6),
+        _mm_loadu_ps(t[2] + 6), _mm_loadu_ps(t[3] + 6)};
+    _MM_TRANSPOSE4_PS(a[0], a[1], a[2], a[3]);
+    _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+    _MM_TRANSPOSE4_PS(q[0], q[1], q[2], q[3]);
+
+    lanes[0] = a[0]; lanes[1] = a[1]; lanes[2] = a[2];
+    lanes[3] = a[3]; lanes[4] = b[0]; lanes[5] = b[1];
+    lanes[6] = q[0]; lanes[7] = q[1]; lanes[8] = q[2]; lanes[9] = q[3];
+}
+
+static void load_matrices_sse(const float* matrices[4], __m128 m[16]) {
+    for (int32_t c = 0; c < 4; ++c) {
+        __m128* column = &m[c * 4];
+        for (int32_t j = 0; j < 4; ++j) {
+            column[j] = _mm_loadu_ps(matrices[j] + c * 4);
+        }
+
+        _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+    }
+}
+
+static void store_matrices_sse(__m128 m[16], mat4f_t* out) {
+    m[3] = m[7] = m[11] = _mm_setzero_ps();
+    m[15] = _mm_set1_ps(1.f);
+    for (int32_t c = 0; c < 4; ++c) {
+        __m128* column = &m[c * 4];
+        _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+        for (int32_t j = 0; j < 4; ++j) {
+            _mm_storeu_ps(out[j].v + c * 4, column[j]);
+        }
+    }
+}
+
+static uint32_t mat4s_from_transforms_sse(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 t[10];
+        load_transforms_sse(transforms, indices, i, t);
+
+        __m128 x = t[6], y = t[7], z = t[8], w = t[9];
+        __m128 length2 = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+            _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        __m128 s = _mm_and_ps(_mm_cmpgt_ps(length2, _mm_setzero_ps()),
+            _mm_div_ps(_mm_set1_ps(2.f), length2));
+
+        __m128 xs = _mm_mul_ps(x, s), ys = _mm_mul_ps(y, s);
+        __m128 zs = _mm_mul_ps(z, s);
+        __m128 xx = _mm_mul_ps(x, xs), yy = _mm_mul_ps(y, ys);
+        __m128 zz = _mm_mul_ps(z, zs);
+        __m128 xy = _mm_mul_ps(x, ys), xz = _mm_mul_ps(x, zs);
+        __m128 yz = _mm_mul_ps(y, zs);
+        __m128 wx = _mm_mul_ps(w, xs), wy = _mm_mul_ps(w, ys);
+        __m128 wz = _mm_mul_ps(w, zs);
+        __m128 one = _mm_set1_ps(1.f);
+
+        __m128 m[16];
+        m[0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), t[3]);
+        m[1] = _mm_mul_ps(_mm_add_ps(xy, wz), t[3]);
+        m[2] = _mm_mul_ps(_mm_sub_ps(xz, wy), t[3]);
+        m[4] = _mm_mul_ps(_mm_sub_ps(xy, wz), t[4]);
+        m[5] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), t[4]);
+        m[6] = _mm_mul_ps(_mm_add_ps(yz, wx), t[4]);
+        m[8] = _mm_mul_ps(_mm_add_ps(xz, wy), t[5]);
+        m[9] = _mm_mul_ps(_mm_sub_ps(yz, wx), t[5]);
+        m[10] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), t[5]);
+        m[12] = t[0];
+        m[13] = t[1];
+        m[14] = t[2];
+        store_matrices_sse(m, &out_poses[i]);
+    }
+
+    return i;
+}
+
+static uint32_t mat4s_multiply_parents_sse(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* matrices[4];
+        __m128 p[16];
+        for (uint32_t j = 0; j < 4; ++j) {
+            matrices[j] = BATCH_PARENT(parents, parent_indices, root, i + j);
+        }
+        load_matrices_sse(matrices, p);
+
+        __m128 l[16];
+        for (uint32_t j = 0; j < 4; ++j) {
+            matrices[j] = locals[i + j].v;
+        }
+        load_matrices_sse(matrices, l);
+
+        __m128 m[16];
+        for (int32_t c = 0; c < 4; ++c) {
+            for (int32_t r = 0; r < 3; ++r) {
+                __m128 e = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(p[r], l[c * 4]),
+                        _mm_mul_ps(p[4 + r], l[c * 4 + 1])),
+                    _mm_mul_ps(p[8 + r], l[c * 4 + 2]));
+                m[c * 4 + r] = (c == 3) ? _mm_add_ps(e, p[12 + r]) : e;
+            }
+        }
+
+        store_matrices_sse(m, &out_poses[i]);
+    }
+
+    return i;
+}
+#elif defined(VIEWER_MATH_NEON)
+static void transpose_neon(float32x4_t* r0, float32x4_t* r1,
+    float32x4_t* r2, float32x4_t* r3) {
+    float32x4x2_t t01 = vtrnq_f32(*r0, *r1);
+    float32x4x2_t t23 = vtrnq_f32(*r2, *r3);
+    *r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    *r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    *r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    *r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+static void load_transforms_neon(const transform_t* transforms,
+    const int32_t* indices, uint32_t i, float32x4_t lanes[10]) {
+    const float* t[4];
+    for (uint32_t j = 0; j < 4; ++j) {
+        t[j] = BATCH_TRANSFORM(transforms, indices, i + j);
+    }
+
+    // position and scale x, scale y and z, then
+    // the rotation, overlapping the scale load
+    float32x4_t a[4] = {vld1q_f32(t[0]), vld1q_f32(t[1]),
+        vld1q_f32(t[2]), vld1q_f32(t[3])};
+    float32x4_t b[4] = {vld1q_f32(t[0] + 4), vld1q_f32(t[1] + 4),
+        vld1q_f32(t[2] + 4), vld1q_f32(t[3] + 4)};
+    float32x4_t q[4] = {vld1q_f32(t[0] + 6), vld1q_f32(t[1] + 6),
+        vld1q_f32(t[2] + 6), vld1q_f32(t[3] + 6)};
+    transpose_neon(&a[0], &a[1], &a[2], &a[3]);
+    transpose_neon(&b[0], &b[1], &b[2], &b[3]);
+    transpose_neon(&q[0], &q[1], &q[2], &q[3]);
+
+    lanes[0] = a[0]; lanes[1] = a[1]; lanes[2] = a[2];
+    lanes[3] = a[3]; lanes[4] = b[0]; lanes[5] = b[1];
+    lanes[6] = q[0]; lanes[7] = q[1]; lanes[8] = q[2]; lanes[9] = q[3];
+}
+
+static void load_matrices_neon(const float* matrices[4], float32x4_t m[16]) {
+    for (int32_t c = 0; c < 4; ++c) {
+        float32x4_t* column = &m[c * 4];
+        for (int32_t j = 0; j < 4; ++j) {
+            column[j] = vld1q_f32(matrices[j] + c * 4);
+        }
+
+        transpose_neon(&column[0], &column[1], &column[2], &column[3]);
+    }
+}
+
+static void store_matrices_neon(float32x4_t m[16], mat4f_t* out) {
+    m[3] = m[7] = m[11] = vdupq_n_f32(0.f);
+    m[15] = vdupq_n_f32(1.f);
+    for (int32_t c = 0; c < 4; ++c) {
+        float32x4_t* column = &m[c * 4];
+        transpose_neon(&column[0], &column[1], &column[2], &column[3]);
+        for (int32_t j = 0; j < 4; ++j) {
+            vst1q_f32(out[j].v + c * 4, column[j]);
+        }
+    }
+}
+
+static uint32_t mat4s_from_transforms_neon(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t t[10];
+        load_transforms_neon(transforms, indices, i, t);
+
+        float32x4_t x = t[6], y = t[7], z = t[8], w = t[9];
+        float32x4_t length2 = vaddq_f32(
+            vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)),
+            vaddq_f32(vmulq_f32(z, z), vmulq_f32(w, w)));
+#if defined(__aarch64__) || defined(_M_ARM64)
+        float32x4_t s = vdivq_f32(vdupq_n_f32(2.f), length2);
+#else
+        // no division on ARMv7, the estimate is refined twice
+        float32x4_t s = vrecpeq_f32(length2);
+        s = vmulq_f32(s, vrecpsq_f32(length2, s));
+        s = vmulq_f32(s, vrecpsq_f32(length2, s));
+        s = vaddq_f32(s, s);
+#endif
+        s = vbslq_f32(vcgtq_f32(length2, vdupq_n_f32(0.f)),
+            s, vdupq_n_f32(0.f));
+
+        float32x4_t xs = vmulq_f32(x, s), ys = vmulq_f32(y, s);
+        float32x4_t zs = vmulq_f32(z, s);
+        float32x4_t xx = vmulq_f32(x, xs), yy = vmulq_f32(y, ys);
+        float32x4_t zz = vmulq_f32(z, zs);
+        float32x4_t xy = vmulq_f32(x, ys), xz = vmulq_f32(x, zs);
+        float32x4_t yz = vmulq_f32(y, zs);
+        float32x4_t wx = vmulq_f32(w, xs), wy = vmulq_f32(w, ys);
+        float32x4_t wz = vmulq_f32(w, zs);
+        float32x4_t one = vdupq_n_f32(1.f);
+
+        float32x4_t m[16];
+        m[0] = vmulq_f32(vsubq_f32(one, vaddq_f32(yy, zz)), t[3]);
+        m[1] = vmulq_f32(vaddq_f32(xy, wz), t[3]);
+        m[2] = vmulq_f32(vsubq_f32(xz, wy), t[3]);
+        m[4] = vmulq_f32(vsubq_f32(xy, wz), t[4]);
+        m[5] = vmulq_f32(vsubq_f32(one, vaddq_f32(xx, zz)), t[4]);
+        m[6] = vmulq_f32(vaddq_f32(yz, wx), t[4]);
+        m[8] = vmulq_f32(vaddq_f32(xz, wy), t[5]);
+        m[9] = vmulq_f32(vsubq_f32(yz, wx), t[5]);
+        m[10] = vmulq_f32(vsubq_f32(one, vaddq_f32(xx, yy)), t[5]);
+        m[12] = t[0];
+        m[13] = t[1];
+        m[14] = t[2];
+        store_matrices_neon(m, &out_poses[i]);
+    }
+
+    return i;
+}
+
+static uint32_t mat4s_multiply_parents_neon(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const float* matrices[4];
+        float32x4_t p[16];
+        for (uint32_t j = 0; j < 4; ++j) {
+            matrices[j] = BATCH_PARENT(parents, parent_indices, root, i + j);
+        }
+        load_matrices_neon(matrices, p);
+
+        float32x4_t l[16];
+        for (uint32_t j = 0; j < 4; ++j) {
+            matrices[j] = locals[i + j].v;
+        }
+        load_matrices_neon(matrices, l);
+
+        float32x4_t m[16];
+        for (int32_t c = 0; c < 4; ++c) {
+            for (int32_t r = 0; r < 3; ++r) {
+                float32x4_t e = vaddq_f32(
+                    vaddq_f32(vmulq_f32(p[r], l[c * 4]),
+                        vmulq_f32(p[4 + r], l[c * 4 + 1])),
+                    vmulq_f32(p[8 + r], l[c * 4 + 2]));
+                m[c * 4 + r] = (c == 3) ? vaddq_f32(e, p[12 + r]) : e;
+            }
+        }
+
+        store_matrices_neon(m, &out_poses[i]);
+    }
+
+    return i;
+}
+#endif
+
+// 8 lanes, the low halves holding the first 4 matrices of the
+// batch, and the high ones the last 4, transposed separately
+#if defined(VIEWER_MATH_AVX2)
+static bool cpu_has_avx2(void) {
+    // detected once, every thread finding the same
+    static int32_t has_avx2 = -1;
+    if (has_avx2 < 0) {
+#if defined(_MSC_VER)
+        // the OS must also save the ymm registers
+        int info[4];
+        __cpuid(info, 0);
+        bool avx2 = false;
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            if ((info[2] & (1 << 27)) && (info[2] & (1 << 28))
+                && (_xgetbv(0) & 6) == 6) {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+        }
+
+        has_avx2 = avx2;
+#else
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+    }
+
+    return has_avx2 != 0;
+}
+
+VIEWER_MATH_TARGET_AVX2
+static void transpose_avx2(__m256* r0, __m256* r1, __m256* r2, __m256* r3) {
+    __m256 t0 = _mm256_unpacklo_ps(*r0, *r1);
+    __m256 t1 = _mm256_unpackhi_ps(*r0, *r1);
+    __m256 t2 = _mm256_unpacklo_ps(*r2, *r3);
+    __m256 t3 = _mm256_unpackhi_ps(*r2, *r3);
+    *r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    *r1 = _mm256_shuffle_ps(t0, t2, 0xee);
+    *r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    *r3 = _mm256_shuffle_ps(t1, t3, 0xee);
+}
+
+VIEWER_MATH_TARGET_AVX2
+static __m256 load_halves_avx2(const float* low, const float* high) {
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(
+        _mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+}
+
+VIEWER_MATH_TARGET_AVX2
+static void load_transforms_avx2(const transform_t* transforms,
+    const int32_t* indices, uint32_t i, __m256 lanes[10]) {
+    const float* t[8];
+    for (uint32_t j = 0; j < 8; ++j) {
+        t[j] = BATCH_TRANSFORM(transforms, indices, i + j);
+    }
+
+    __m256 a[4];
+    __m256 b[4];
+    __m256 q[4];
+    for (uint32_t j = 0; j < 4; ++j) {
+        a[j] = load_halves_avx2(t[j], t[j + 4]);
+        b[j] = load_halves_avx2(t[j] + 4, t[j + 4] + 4);
+        q[j] = load_halves_avx2(t[j] + 6, t[j + 4] + 6);
+    }
+
+    transpose_avx2(&a[0], &a[1], &a[2], &a[3]);
+    transpose_avx2(&b[0], &b[1], &b[2], &b[3]);
+    transpose_avx2(&q[0], &q[1], &q[2], &q[3]);
+
+    lanes[0] = a[0]; lanes[1] = a[1]; lanes[2] = a[2];
+    lanes[3] = a[3]; lanes[4] = b[0]; lanes[5] = b[1];
+    lanes[6] = q[0]; lanes[7] = q[1]; lanes[8] = q[2]; lanes[9] = q[3];
+}
+
+VIEWER_MATH_TARGET_AVX2
+static void load_matrices_avx2(const float* matrices[8], __m256 m[16]) {
+    for (int32_t c = 0; c < 4; ++c) {
+        __m256* column = &m[c * 4];
+        for (int32_t j = 0; j < 4; ++j) {
+            column[j] = load_halves_avx2(matrices[j] + c * 4,
+                matrices[j + 4] + c * 4);
+        }
+
+        transpose_avx2(&column[0], &column[1], &column[2], &column[3]);
+    }
+}
+
+VIEWER_MATH_TARGET_AVX2
+static void store_matrices_avx2(__m256 m[16], mat4f_t* out) {
+    m[3] = m[7] = m[11] = _mm256_setzero_ps();
+    m[15] = _mm256_set1_ps(1.f);
+    for (int32_t c = 0; c < 4; ++c) {
+        __m256* column = &m[c * 4];
+        transpose_avx2(&column[0], &column[1], &column[2], &column[3]);
+        for (int32_t j = 0; j < 4; ++j) {
+            _mm_storeu_ps(out[j].v + c * 4, _mm256_castps256_ps128(column[j]));
+            _mm_storeu_ps(out[j + 4].v + c * 4,
+                _mm256_extractf128_ps(column[j], 1));
+        }
+    }
+}
+
+VIEWER_MATH_TARGET_AVX2
+static uint32_t mat4s_from_transforms_avx2(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 t[10];
+        load_transforms_avx2(transforms, indices, i, t);
+
+        __m256 x = t[6], y = t[7], z = t[8], w = t[9];
+        __m256 length2 = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+            _mm256_add_ps(_mm256_mul_ps(z, z), _mm256_mul_ps(w, w)));
+        __m256 s = _mm256_and_ps(
+            _mm256_cmp_ps(length2, _mm256_setzero_ps(), _CMP_GT_OQ),
+            _mm256_div_ps(_mm256_set1_ps(2.f), length2));
+
+        __m256 xs = _mm256_mul_ps(x, s), ys = _mm256_mul_ps(y, s);
+        __m256 zs = _mm256_mul_ps(z, s);
+        __m256 xx = _mm256_mul_ps(x, xs), yy = _mm256_mul_ps(y, ys);
+        __m256 zz = _mm256_mul_ps(z, zs);
+        __m256 xy = _mm256_mul_ps(x, ys), xz = _mm256_mul_ps(x, zs);
+        __m256 yz = _mm256_mul_ps(y, zs);
+        __m256 wx = _mm256_mul_ps(w, xs), wy = _mm256_mul_ps(w, ys);
+        __m256 wz = _mm256_mul_ps(w, zs);
+        __m256 one = _mm256_set1_ps(1.f);
+
+        __m256 m[16];
+        m[0] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), t[3]);
+        m[1] = _mm256_mul_ps(_mm256_add_ps(xy, wz), t[3]);
+        m[2] = _mm256_mul_ps(_mm256_sub_ps(xz, wy), t[3]);
+        m[4] = _mm256_mul_ps(_mm256_sub_ps(xy, wz), t[4]);
+        m[5] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), t[4]);
+        m[6] = _mm256_mul_ps(_mm256_add_ps(yz, wx), t[4]);
+        m[8] = _mm256_mul_ps(_mm256_add_ps(xz, wy), t[5]);
+        m[9] = _mm256_mul_ps(_mm256_sub_ps(yz, wx), t[5]);
+        m[10] = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), t[5]);
+        m[12] = t[0];
+        m[13] = t[1];
+        m[14] = t[2];
+        store_matrices_avx2(m, &out_poses[i]);
+    }
+
+    return i;
+}
+
+VIEWER_MATH_TARGET_AVX2
+static uint32_t mat4s_multiply_parents_avx2(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const float* matrices[8];
+        __m256 p[16];
+        for (uint32_t j = 0; j < 8; ++j) {
+            matrices[j] = BATCH_PARENT(parents, parent_indices, root, i + j);
+        }
+        load_matrices_avx2(matrices, p);
+
+        __m256 l[16];
+        for (uint32_t j = 0; j < 8; ++j) {
+            matrices[j] = locals[i + j].v;
+        }
+        load_matrices_avx2(matrices, l);
+
+        __m256 m[16];
+        for (int32_t c = 0; c < 4; ++c) {
+            for (int32_t r = 0; r < 3; ++r) {
+                __m256 e = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(p[r], l[c * 4]),
+                        _mm256_mul_ps(p[4 + r], l[c * 4 + 1])),
+                    _mm256_mul_ps(p[8 + r], l[c * 4 + 2]));
+                m[c * 4 + r] = (c == 3) ? _mm256_add_ps(e, p[12 + r]) : e;
+            }
+        }
+
+        store_matrices_avx2(m, &out_poses[i]);
+    }
+
+    return i;
+}
+#endif
+
+void mat4s_from_transforms(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses) {
+    assert(transforms && (out_poses || count == 0));
+    uint32_t done = 0;
+
+    // the widest lanes first, then the narrower ones for what is left
+#if defined(VIEWER_MATH_AVX2)
+    if (cpu_has_avx2()) {
+        done = mat4s_from_transforms_avx2(transforms, indices,
+            count, out_poses);
+    }
+#endif
+#if defined(VIEWER_MATH_SSE)
+    done += mat4s_from_transforms_sse(indices ? transforms : transforms + done,
+        indices ? indices + done : NULL, count - done, out_poses + done);
+#elif defined(VIEWER_MATH_NEON)
+    done += mat4s_from_transforms_neon(indices ? transforms : transforms + done,
+        indices ? indices + done : NULL, count - done, out_poses + done);
+#endif
+
+    mat4s_from_transforms_scalar(indices ? transforms : transforms + done,
+        indices ? indices + done : NULL, count - done, out_poses + done);
+}
+
+void mat4s_multiply_parents(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses) {
+    assert(parent_indices && root && ((locals && out_poses) || count == 0));
+    uint32_t done = 0;
+
+#if defined(VIEWER_MATH_AVX2)
+    if (cpu_has_avx2()) {
+        done = mat4s_multiply_parents_avx2(parents, parent_indices, root,
+            locals, count, out_poses);
+    }
+#endif
+#if defined(VIEWER_MATH_SSE)
+    done += mat4s_multiply_parents_sse(parents, parent_indices + done, root,
+        locals + done, count - done, out_poses + done);
+#elif defined(VIEWER_MATH_NEON)
+    done += mat4s_multiply_parents_neon(parents, parent_indices + done, root,
+        locals + done, count - done, out_poses + done);
+#endif
+
+    mat4s_multiply_parents_scalar(parents, parent_indices + done, root,
+        locals + done, count - done, out_poses + done);
+}
+
+#define STRIDED_POINT(points, stride, index) \
+    ((const float*)((const uint8_t*)(points) + (size_t)(index) * (stride)))
+
+box_t box_from_indexed_points(const vec3f_t* points, size_t stride,
+    const uint32_t* indices, uint32_t num_indices) {
+    if (!points || !indices || num_indices == 0) {
+        return (box_t){0};
+    }
+
+    vec3f_t min_point;
+    vec3f_t max_point;
+
+#if defined(VIEWER_MATH_SSE) || defined(VIEWER_MATH_NEON)
+    if (stride >= 4 * sizeof(float)) {
+        // the 4th lane carries whatever follows the point,
+        // it gets dropped at the end, so, it doesn't matter.
+        // two pairs of accumulators hide min/max latencies.
+#if defined(VIEWER_MATH_SSE)
+        __m128 min0 = _mm_loadu_ps(STRIDED_POINT(points, stride, indices[0]));
+        __m128 max0 = min0;
+        __m128 min1 = min0;
+        __m128 max1 = min0;
+
+        uint32_t i = 1;
+        for (; i + 1 < num_indices; i += 2) {
+            __m128 p0 = _mm_loadu_ps(STRIDED_POINT(points, stride, indices[i]));
+            __m128 p1 = _mm_loadu_ps(STRIDED_POINT(points, stride, indices[i + 1]));
+            min0 = _mm_min_ps(min0, p0);
+            max0 = _mm_max_ps(max0, p0);
+            min1 = _mm_min_ps(min1, p1);
+            max1 = _mm_max_ps(max1, p1);
+        }
+
+        if (i < num_indices) {
+            __m128 p0 = _mm_loadu_ps(STRIDED_POINT(points, stride, indices[i]));
+            min0 = _mm_min_ps(min0, p0);
+            max0 = _mm_max_ps(max0, p0);
+        }
+
+        float min_lanes[4];
+        float max_lanes[4];
+        _mm_storeu_ps(min_lanes, _mm_min_ps(min0, min1));
+        _mm_storeu_ps(max_lanes, _mm_max_ps(max0, max1));
+#else
+        float32x4_t min0 = vld1q_f32(STRIDED_POINT(points, stride, indices[0]));
+        float32x4_t max0 = min0;
+        float32x4_t min1 = min0;
+        float32x4_t max1 = min0;
+
+        uint32_t i = 1;
+        for (; i + 1 < num_indices; i += 2) {
+            float32x4_t p0 = vld1q_f32(STRIDED_POINT(points, stride, indices[i]));
+            float32x4_t p1 = vld1q_f32(STRIDED_POINT(points, stride, indices[i + 1]));
+            min0 = vminq_f32(min0, p0);
+            max0 = vmaxq_f32(max0, p0);
+            min1 = vminq_f32(min1, p1);
+            max1 = vmaxq_f32(max1, p1);
+        }
+
+        if (i < num_indices) {
+            float32x4_t p0 = vld1q_f32(STRIDED_POINT(points, stride, indices[i]));
+            min0 = vminq_f32(min0, p0);
+            max0 = vmaxq_f32(max0, p0);
+        }
+
+        float min_lanes[4];
+        float max_lanes[4];
+        vst1q_f32(min_lanes, vminq_f32(min0, min1));
+        vst1q_f32(max_lanes, vmaxq_f32(max0, max1));
+#endif
+        min_point = svec3(min_lanes[0], min_lanes[1], min_lanes[2]);
+        max_point = svec3(max_lanes[0], max_lanes[1], max_lanes[2]);
+    }
+    else
+#endif
+    {
+        const float* p = STRIDED_POINT(points, stride, indices[0]);
+        min_point = svec3(p[0], p[1], p[2]);
+        max_point = min_point;
+
+        for (uint32_t i = 1; i < num_indices; ++i) {
+            p = STRIDED_POINT(points, stride, indices[i]);
+            for (int32_t c = 0; c < 3; ++c) {
+                if (p[c] < min_point.v[c]) min_point.v[c] = p[c];
+                if (p[c] > max_point.v[c]) max_point.v[c] = p[c];
+            }
+        }
+    }
+
+    return (box_t){
+        .center = svec3_multiply_f(svec3_add(min_point, max_point), .5f),
+        .extents = svec3_multiply_f(svec3_subtract(max_point, min_point), .5f)
+    };
+}
+
+box_t box_merge(box_t a, box_t b) {
+    vec3f_t min_point = svec3_min(
+        svec3_subtract(a.center, a.extents),
+        svec3_subtract(b.center, b.extents));
+    vec3f_t max_point = svec3_max(
+        svec3_add(a.center, a.extents),
+        svec3_add(b.center, b.extents));
+
+    return (box_t){
+        .center = svec3_multiply_f(svec3_add(min_point, max_point), .5f),
+        .extents = svec3_multiply_f(svec3_subtract(max_point, min_point), .5f)
+    };
+}
+
+sphere_t sphere_merge(sphere_t a, sphere_t b) {
+    vec3f_t offset = svec3_subtract(b.center, a.center);
+    mfloat_t distance = svec3_length(offset);
+    if (distance + b.radius <= a.radius) {
+        return a;
+    }
+
+    if (distance + a.radius <= b.radius) {
+        return b;
+    }
+
+    // from the far side of a, to the far side of b
+    mfloat_t radius = (distance + a.radius + b.radius) * .5f;
+    return (sphere_t){
+        .center = svec3_add(a.center, svec3_multiply_f(offset,
+            (radius - a.radius) / distance)),
+        .radius = radius
+    };
+}
+
 vec3f_t plane_project_point(plane_t plane, vec3f_t point) {
     // p' = p - n * (n.p + d)
     return svec3_subtract(point, svec3_multiply_f(
@@ -97,6 +863,287 @@ vec3f_t plane_project_point(plane_t plane, vec3f_t point) {
     );
 }
 
+frustum_t frustum_from_matrix(mat4f_t view_proj) {
+    const mfloat_t* m = view_proj.v;
+    frustum_t frustum;
+
+    // clip planes are combinations of the matrix rows,
+    // e.g. the left one is x >= -w, therefore, row3 + row0
+    for (int32_t p = 0; p < 6; ++p) {
+        int32_t row = p / 2;
+        mfloat_t sign = (p % 2) ? -1.f : 1.f;
+        vec3f_t normal = svec3(
+            m[3] + sign * m[row],
+            m[7] + sign * m[4 + row],
+            m[11] + sign * m[8 + row]);
+        mfloat_t distance = m[15] + sign * m[12 + row];
+        mfloat_t length = svec3_length(normal);
+        if (length > 0.f) {
+            normal = svec3_divide_f(normal, length);
+            distance /= length;
+        }
+
+        frustum.planes[p] = (plane_t){
+            .normal = normal,
+            .distance = distance
+        };
+    }
+
+    return frustum;
+}
+
+bool frustum_test_sphere(const frustum_t* frustum, sphere_t sphere) {
+    for (int32_t p = 0; p < 6; ++p) {
+        const plane_t* plane = &frustum->planes[p];
+        if (svec3_dot(plane->normal, sphere.center) + plane->distance
+            < -sphere.radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool frustum_test_box(const frustum_t* frustum, box_t box) {
+    for (int32_t p = 0; p < 6; ++p) {
+        const plane_t* plane = &frustum->planes[p];
+        vec3f_t n = plane->normal;
+
+        // projected radius of the box on the normal
+        mfloat_t radius = MFABS(n.x) * box.extents.x
+            + MFABS(n.y) * box.extents.y + MFABS(n.z) * box.extents.z;
+        if (svec3_dot(n, box.center) + plane->distance < -radius) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void frustum_test_bounds_scalar(const frustum_t* frustum,
+    const sphere_t* spheres, const box_t* boxes, uint32_t count,
+    bool* out_visible) {
+    for (uint32_t i = 0; i < count; ++i) {
+        out_visible[i] = frustum_test_sphere(frustum, spheres[i])
+            && (!boxes || frustum_test_box(frustum, boxes[i]));
+    }
+}
+
+// planes are broadcast to all the lanes, which hold a bound each.
+// spheres are 4 floats, and boxes 6, loaded from their start and
+// from their third float, both of them within the box.
+#if defined(VIEWER_MATH_SSE)
+static uint32_t frustum_test_bounds_sse(const frustum_t* frustum,
+    const sphere_t* spheres, const box_t* boxes, uint32_t count,
+    bool* out_visible) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 s[4];
+        for (uint32_t j = 0; j < 4; ++j) {
+            s[j] = _mm_loadu_ps(spheres[i + j].center.v);
+        }
+        _MM_TRANSPOSE4_PS(s[0], s[1], s[2], s[3]);
+
+        __m128 b[4];
+        __m128 e[4];
+        if (boxes) {
+            for (uint32_t j = 0; j < 4; ++j) {
+                const float* box = boxes[i + j].center.v;
+                b[j] = _mm_loadu_ps(box);
+                e[j] = _mm_loadu_ps(box + 2);
+            }
+            _MM_TRANSPOSE4_PS(b[0], b[1], b[2], b[3]);
+            _MM_TRANSPOSE4_PS(e[0], e[1], e[2], e[3]);
+        }
+
+        __m128 zero = _mm_setzero_ps();
+        __m128 visible = _mm_cmpeq_ps(zero, zero);
+        for (int32_t p = 0; p < 6; ++p) {
+            const plane_t* plane = &frustum->planes[p];
+            __m128 nx = _mm_set1_ps(plane->normal.x);
+            __m128 ny = _mm_set1_ps(plane->normal.y);
+            __m128 nz = _mm_set1_ps(plane->normal.z);
+            __m128 d = _mm_set1_ps(plane->distance);
+
+            __m128 sphere_distance = _mm_add_ps(_mm_add_ps(
+                _mm_mul_ps(nx, s[0]), _mm_mul_ps(ny, s[1])),
+                _mm_add_ps(_mm_mul_ps(nz, s[2]), d));
+            visible = _mm_and_ps(visible, _mm_cmpge_ps(
+                _mm_add_ps(sphere_distance, s[3]), zero));
+
+            if (boxes) {
+                __m128 box_distance = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(nx, b[0]), _mm_mul_ps(ny, b[1])),
+                    _mm_add_ps(_mm_mul_ps(nz, b[2]), d));
+                __m128 radius = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(MFABS(plane->normal.x)), b[3]),
+                    _mm_mul_ps(_mm_set1_ps(MFABS(plane->normal.y)), e[2])),
+                    _mm_mul_ps(_mm_set1_ps(MFABS(plane->normal.z)), e[3]));
+                visible = _mm_and_ps(visible, _mm_cmpge_ps(
+                    _mm_add_ps(box_distance, radius), zero));
+            }
+        }
+
+        int mask = _mm_movemask_ps(visible);
+        for (uint32_t j = 0; j < 4; ++j) {
+            out_visible[i + j] = (mask >> j) & 1;
+        }
+    }
+
+    return i;
+}
+#elif defined(VIEWER_MATH_NEON)
+static uint32_t frustum_test_bounds_neon(const frustum_t* frustum,
+    const sphere_t* spheres, const box_t* boxes, uint32_t count,
+    bool* out_visible) {
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t s[4];
+        for (uint32_t j = 0; j < 4; ++j) {
+            s[j] = vld1q_f32(spheres[i + j].center.v);
+        }
+        transpose_neon(&s[0], &s[1], &s[2], &s[3]);
+
+        float32x4_t b[4];
+        float32x4_t e[4];
+        if (boxes) {
+            for (uint32_t j = 0; j < 4; ++j) {
+                const float* box = boxes[i + j].center.v;
+                b[j] = vld1q_f32(box);
+                e[j] = vld1q_f32(box + 2);
+            }
+            transpose_neon(&b[0], &b[1], &b[2], &b[3]);
+            transpose_neon(&e[0], &e[1], &e[2], &e[3]);
+        }
+
+        float32x4_t zero = vdupq_n_f32(0.f);
+        uint32x4_t visible = vdupq_n_u32(0xffffffffu);
+        for (int32_t p = 0; p < 6; ++p) {
+            const plane_t* plane = &frustum->planes[p];
+            float32x4_t nx = vdupq_n_f32(plane->normal.x);
+            float32x4_t ny = vdupq_n_f32(plane->normal.y);
+            float32x4_t nz = vdupq_n_f32(plane->normal.z);
+            float32x4_t d = vdupq_n_f32(plane->distance);
+
+            float32x4_t sphere_distance = vaddq_f32(vaddq_f32(
+                vmulq_f32(nx, s[0]), vmulq_f32(ny, s[1])),
+                vaddq_f32(vmulq_f32(nz, s[2]), d));
+            visible = vandq_u32(visible, vcgeq_f32(
+                vaddq_f32(sphere_distance, s[3]), zero));
+
+            if (boxes) {
+                float32x4_t box_distance = vaddq_f32(vaddq_f32(
+                    vmulq_f32(nx, b[0]), vmulq_f32(ny, b[1])),
+                    vaddq_f32(vmulq_f32(nz, b[2]), d));
+                float32x4_t radius = vaddq_f32(vaddq_f32(
+                    vmulq_f32(vdupq_n_f32(MFABS(plane->normal.x)), b[3]),
+                    vmulq_f32(vdupq_n_f32(MFABS(plane->normal.y)), e[2])),
+                    vmulq_f32(vdupq_n_f32(MFABS(plane->normal.z)), e[3]));
+                visible = vandq_u32(visible, vcgeq_f32(
+                    vaddq_f32(box_distance, radius), zero));
+            }
+        }
+
+        uint32_t lanes[4];
+        vst1q_u32(lanes, visible);
+        for (uint32_t j = 0; j < 4; ++j) {
+            out_visible[i + j] = lanes[j] != 0;
+        }
+    }
+
+    return i;
+}
+#endif
+
+#if defined(VIEWER_MATH_AVX2)
+VIEWER_MATH_TARGET_AVX2
+static uint32_t frustum_test_bounds_avx2(const frustum_t* frustum,
+    const sphere_t* spheres, const box_t* boxes, uint32_t count,
+    bool* out_visible) {
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 s[4];
+        for (uint32_t j = 0; j < 4; ++j) {
+            s[j] = load_halves_avx2(spheres[i + j].center.v,
+                spheres[i + j + 4].center.v);
+        }
+        transpose_avx2(&s[0], &s[1], &s[2], &s[3]);
+
+        __m256 b[4];
+        __m256 e[4];
+        if (boxes) {
+            for (uint32_t j = 0; j < 4; ++j) {
+                const float* low = boxes[i + j].center.v;
+                const float* high = boxes[i + j + 4].center.v;
+                b[j] = load_halves_avx2(low, high);
+                e[j] = load_halves_avx2(low + 2, high + 2);
+            }
+            transpose_avx2(&b[0], &b[1], &b[2], &b[3]);
+            transpose_avx2(&e[0], &e[1], &e[2], &e[3]);
+        }
+
+        __m256 zero = _mm256_setzero_ps();
+        __m256 visible = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int32_t p = 0; p < 6; ++p) {
+            const plane_t* plane = &frustum->planes[p];
+            __m256 nx = _mm256_set1_ps(plane->normal.x);
+            __m256 ny = _mm256_set1_ps(plane->normal.y);
+            __m256 nz = _mm256_set1_ps(plane->normal.z);
+            __m256 d = _mm256_set1_ps(plane->distance);
+
+            __m256 sphere_distance = _mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(nx, s[0]), _mm256_mul_ps(ny, s[1])),
+                _mm256_add_ps(_mm256_mul_ps(nz, s[2]), d));
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(
+                _mm256_add_ps(sphere_distance, s[3]), zero, _CMP_GE_OQ));
+
+            if (boxes) {
+                __m256 box_distance = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(nx, b[0]), _mm256_mul_ps(ny, b[1])),
+                    _mm256_add_ps(_mm256_mul_ps(nz, b[2]), d));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(MFABS(plane->normal.x)), b[3]),
+                    _mm256_mul_ps(_mm256_set1_ps(MFABS(plane->normal.y)), e[2])),
+                    _mm256_mul_ps(_mm256_set1_ps(MFABS(plane->normal.z)), e[3]));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(
+                    _mm256_add_ps(box_distance, radius), zero, _CMP_GE_OQ));
+            }
+        }
+
+        // low halves hold the first 4 bounds
+        int mask = _mm256_movemask_ps(visible);
+        for (uint32_t j = 0; j < 8; ++j) {
+            out_visible[i + j] = (mask >> j) & 1;
+        }
+    }
+
+    return i;
+}
+#endif
+
+void frustum_test_bounds(const frustum_t* frustum, const sphere_t* spheres,
+    const box_t* boxes, uint32_t count, bool* out_visible) {
+    assert(frustum && ((spheres && out_visible) || count == 0));
+    uint32_t done = 0;
+
+#if defined(VIEWER_MATH_AVX2)
+    if (cpu_has_avx2()) {
+        done = frustum_test_bounds_avx2(frustum, spheres, boxes,
+            count, out_visible);
+    }
+#endif
+#if defined(VIEWER_MATH_SSE)
+    done += frustum_test_bounds_sse(frustum, spheres + done,
+        boxes ? boxes + done : NULL, count - done, out_visible + done);
+#elif defined(VIEWER_MATH_NEON)
+    done += frustum_test_bounds_neon(frustum, spheres + done,
+        boxes ? boxes + done : NULL, count - done, out_visible + done);
+#endif
+
+    frustum_test_bounds_scalar(frustum, spheres + done,
+        boxes ? boxes + done : NULL, count - done, out_visible + done);
+}
+
 #if defined(__cplusplus)
 } // extern "C"
 #endif
@@ -3,6 +3,10 @@
  * Define math struct.
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "mathc.h"
 
 #if defined(__cplusplus)
@@ -30,6 +34,9 @@ quat_t squat_from_euler(vec3f_t euler);
 vec3f_t squat_to_euler(quat_t rotation);
 vec3f_t squat_rotate_vec3(quat_t rotation, vec3f_t vector);
 
+// rotation of the matrix whose columns are the given axes
+quat_t squat_from_axes(vec3f_t x_axis, vec3f_t y_axis, vec3f_t z_axis);
+
 typedef struct {
     vec3f_t position;
     vec3f_t scale;
@@ -38,6 +45,32 @@ typedef struct {
 
 mat4f_t transform_to_mat4(transform_t transform);
 
+/**
+ * Batched transform_to_mat4, out_poses[i] being the affine matrix of
+ * transforms[indices[i]], or of transforms[i] if indices is NULL.
+ * Matrices are composed 4 or 8 at a time, with the widest instructions
+ * the CPU supports, which are detected once, at the first call.
+ */
+void mat4s_from_transforms(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses);
+
+/**
+ * Batched product of affine matrices, out_poses[i] being
+ * parents[parent_indices[i]] * locals[i], or root * locals[i] if
+ * the index is negative. out_poses may be locals, but none of the
+ * matrices written may be the parent of another one of the batch.
+ */
+void mat4s_multiply_parents(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses);
+
+// one matrix at a time, the reference of the batched functions
+void mat4s_from_transforms_scalar(const transform_t* transforms,
+    const int32_t* indices, uint32_t count, mat4f_t* out_poses);
+void mat4s_multiply_parents_scalar(const mat4f_t* parents,
+    const int32_t* parent_indices, const mat4f_t* root,
+    const mat4f_t* locals, uint32_t count, mat4f_t* out_poses);
+
 typedef struct {
     vec3f_t center;
     vec3f_t extents;
@@ -48,11 +81,30 @@ typedef struct {
     vec2f_t max;
 } aabb_t;
 
+/**
+ * Bounding box of the points referenced by indices. Points are
+ * strided, and, when SIMD is available, loaded 4 floats at a time,
+ * so, the stride must be at least 16 bytes for the last point
+ * not to be read past the end of the array.
+ */
+box_t box_from_indexed_points(const vec3f_t* points, size_t stride,
+    const uint32_t* indices, uint32_t num_indices);
+
+/**
+ * Smallest box containing both the boxes.
+ */
+box_t box_merge(box_t a, box_t b);
+
 typedef struct {
     vec3f_t center;
     mfloat_t radius;
 } sphere_t;
 
+/**
+ * Smallest sphere containing both the spheres.
+ */
+sphere_t sphere_merge(sphere_t a, sphere_t b);
+
 // nx + ny + nz + d = 0
 typedef struct {
     vec3f_t normal;
@@ -61,6 +113,40 @@ typedef struct {
 
 vec3f_t plane_project_point(plane_t plane, vec3f_t point);
 
+// planes face inward: left, right, bottom, top, near, far
+typedef struct {
+    plane_t planes[6];
+} frustum_t;
+
+/**
+ * Extract the clipping planes of a view projection matrix,
+ * in the space the matrix transforms from.
+ */
+frustum_t frustum_from_matrix(mat4f_t view_proj);
+
+/**
+ * Returns false if the sphere is entirely outside of any plane.
+ */
+bool frustum_test_sphere(const frustum_t* frustum, sphere_t sphere);
+
+/**
+ * Returns false if the box is entirely outside of any plane.
+ */
+bool frustum_test_box(const frustum_t* frustum, box_t box);
+
+/**
+ * Batched frustum tests, out_visible[i] being true unless spheres[i],
+ * or boxes[i] if boxes is not NULL, is entirely outside of any plane.
+ * Bounds are tested 4 or 8 at a time, as mat4s_from_transforms does.
+ */
+void frustum_test_bounds(const frustum_t* frustum, const sphere_t* spheres,
+    const box_t* boxes, uint32_t count, bool* out_visible);
+
+// one bound at a time, the reference of frustum_test_bounds
+void frustum_test_bounds_scalar(const frustum_t* frustum,
+    const sphere_t* spheres, const box_t* boxes, uint32_t count,
+    bool* out_visible);
+
 typedef struct {
     mfloat_t x;
     mfloat_t y;
@@ -27,6 +27,23 @@
 
 #define _IS_POWER_OF_TWO(a) ((a) ? !(a & (a - 1)) : 0)
 
+/**
+ * Relaxed atomic increment, counters are only read as statistics
+ */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define _VIEWER_ATOMIC_INC(p) _InterlockedIncrement64((volatile __int64*)(p))
+#define _VIEWER_ATOMIC_LOAD(p) ((uint64_t)*(volatile __int64*)(p))
+#elif defined(__clang__) || defined(__GNUC__)
+#define _VIEWER_ATOMIC_INC(p) __atomic_fetch_add((p), 1, __ATOMIC_RELAXED)
+#define _VIEWER_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#else
+#define _VIEWER_ATOMIC_INC(p) (++*(p))
+#define _VIEWER_ATOMIC_LOAD(p) (*(p))
+#endif
+
+static memory_stats_t _memory_stats = {0};
+
 /**
  * Provide a default implementation for allocations
  */
@@ -155,7 +172,12 @@ static void* _memory_realloc_aligned(void* ptr, size_t sz, size_t al)  {
 #endif // VIEWER_ALIGNED_MALLOC/REALLOC/FREE
 
 void * memory_aligned_malloc(size_t sz, size_t al) {
-    return VIEWER_ALIGNED_MALLOC(sz, al);
+    void* ptr = VIEWER_ALIGNED_MALLOC(sz, al);
+    if (ptr) {
+        _VIEWER_ATOMIC_INC(&_memory_stats.allocations);
+    }
+
+    return ptr;
 }
 
 void * memory_aligned_calloc(size_t cnt, size_t sz, size_t al) {
@@ -169,7 +191,20 @@ void * memory_aligned_calloc(size_t cnt, size_t sz, size_t al) {
 }
 
 void * memory_aligned_realloc(void* ptr, size_t sz, size_t al) {
-    return VIEWER_ALIGNED_REALLOC(ptr, sz, al);
+    void* nptr = VIEWER_ALIGNED_REALLOC(ptr, sz, al);
+    if (!ptr) {
+        if (nptr) {
+            _VIEWER_ATOMIC_INC(&_memory_stats.allocations);
+        }
+    }
+    else if (!sz) {
+        _VIEWER_ATOMIC_INC(&_memory_stats.frees);
+    }
+    else if (nptr) {
+        _VIEWER_ATOMIC_INC(&_memory_stats.reallocations);
+    }
+
+    return nptr;
 }
 
 void * memory_malloc(size_t sz) {
@@ -186,4 +221,13 @@ void * memory_realloc(void* ptr, size_t sz) {
 
 void memory_free(void* ptr) {
     VIEWER_ALIGNED_FREE(ptr);
+    _VIEWER_ATOMIC_INC(&_memory_stats.frees);
+}
+
+memory_stats_t memory_get_stats(void) {
+    return (memory_stats_t){
+        .allocations = _VIEWER_ATOMIC_LOAD(&_memory_stats.allocations),
+        .reallocations = _VIEWER_ATOMIC_LOAD(&_memory_stats.reallocations),
+        .frees = _VIEWER_ATOMIC_LOAD(&_memory_stats.frees)
+    };
 }
@@ -23,6 +23,17 @@ void * memory_calloc(size_t cnt, size_t sz);
 void * memory_realloc(void* ptr, size_t sz);
 void memory_free(void* ptr);
 
+// counters of the calls made through this interface, since the
+// start of the program, allocations made by third party libraries
+// with their own allocator are not accounted for.
+typedef struct {
+    uint64_t allocations;   // new blocks, including realloc of NULL
+    uint64_t reallocations; // resized blocks
+    uint64_t frees;         // released blocks, including realloc to 0
+} memory_stats_t;
+
+memory_stats_t memory_get_stats(void);
+
 /**
  * Generic simple and minimal allocator interface expected to work as `realloc`.
  * 
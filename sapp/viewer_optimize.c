@@ -0,0 +1,303 @@
+#include "viewer_optimize.h"
+#include "viewer_memory.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+// weights of the vertex scores, as tuned by Forsyth
+#define OPTIMIZE_CACHE_DECAY_POWER 1.5f
+#define OPTIMIZE_LAST_TRIANGLE_SCORE 0.75f
+#define OPTIMIZE_VALENCE_BOOST_SCALE 2.0f
+#define OPTIMIZE_VALENCE_BOOST_POWER 0.5f
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+static uint32_t hash_bytes(const uint8_t* bytes, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t b = 0; b < size; ++b) {
+        hash = (hash ^ bytes[b]) * 16777619u;
+    }
+
+    return hash;
+}
+
+uint32_t optimize_weld_vertices(void* vertices, size_t vertex_size,
+    uint32_t num_vertices, uint32_t* indices, uint32_t num_indices) {
+    assert(vertices && vertex_size > 0 && indices);
+
+    uint32_t table_size = 1;
+    while (table_size < 2 * num_vertices) {
+        table_size *= 2;
+    }
+
+    uint32_t* table = memory_malloc(sizeof(uint32_t) * table_size);
+    uint32_t* remap = memory_malloc(sizeof(uint32_t) * num_vertices);
+    if (!table || !remap) {
+        if (table) memory_free(table);
+        if (remap) memory_free(remap);
+        return num_vertices;
+    }
+
+    memset(table, 0xff, sizeof(uint32_t) * table_size);
+
+    // the table refers to the vertices already compacted, which
+    // are never overwritten, as they are moved backwards only
+    uint8_t* bytes = (uint8_t*)vertices;
+    uint32_t num_welded = 0;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        const uint8_t* vertex = bytes + vertex_size * v;
+        uint32_t slot = hash_bytes(vertex, vertex_size) & (table_size - 1);
+        while (table[slot] != UINT32_MAX && memcmp(
+            bytes + vertex_size * table[slot], vertex, vertex_size) != 0) {
+            slot = (slot + 1) & (table_size - 1);
+        }
+
+        if (table[slot] == UINT32_MAX) {
+            table[slot] = num_welded;
+            memmove(bytes + vertex_size * num_welded, vertex, vertex_size);
+            ++num_welded;
+        }
+
+        remap[v] = table[slot];
+    }
+
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        assert(indices[i] < num_vertices);
+        indices[i] = remap[indices[i]];
+    }
+
+    memory_free(table);
+    memory_free(remap);
+    return num_welded;
+}
+
+// vertices score higher the more recently they have been used, with
+// those of the last triangle slightly penalised, not to favour strips,
+// and the fewer triangles are left around them, not to leave any
+// single triangle behind, that would need them to be transformed again.
+static float vertex_score(int32_t cache_position, uint32_t num_live) {
+    if (num_live == 0) {
+        return -1.f;
+    }
+
+    float score = 0.f;
+    if (cache_position >= 0 && cache_position < 3) {
+        score = OPTIMIZE_LAST_TRIANGLE_SCORE;
+    }
+    else if (cache_position >= 3) {
+        float scale = 1.f / (OPTIMIZE_VERTEX_CACHE_SIZE - 3);
+        score = powf(1.f - (cache_position - 3) * scale,
+            OPTIMIZE_CACHE_DECAY_POWER);
+    }
+
+    return score + OPTIMIZE_VALENCE_BOOST_SCALE
+        * powf((float)num_live, -OPTIMIZE_VALENCE_BOOST_POWER);
+}
+
+// move the triangle at the end of the live ones around the vertex
+static void retire_triangle(uint32_t* triangles, uint32_t* num_live,
+    uint32_t triangle) {
+    for (uint32_t t = 0; t < *num_live; ++t) {
+        if (triangles[t] == triangle) {
+            triangles[t] = triangles[*num_live - 1];
+            triangles[*num_live - 1] = triangle;
+            --*num_live;
+            return;
+        }
+    }
+}
+
+bool optimize_vertex_cache(uint32_t* indices, uint32_t num_indices,
+    uint32_t num_vertices) {
+    assert(indices && num_indices % 3 == 0);
+
+    uint32_t num_triangles = num_indices / 3;
+    if (num_triangles < 2) {
+        return true;
+    }
+
+    uint32_t* source = memory_malloc(sizeof(uint32_t) * num_indices);
+    uint32_t* offsets = memory_malloc(sizeof(uint32_t) * (num_vertices + 1));
+    uint32_t* adjacency = memory_malloc(sizeof(uint32_t) * num_indices);
+    uint32_t* num_live = memory_calloc(num_vertices, sizeof(uint32_t));
+    int32_t* cache_positions = memory_malloc(sizeof(int32_t) * num_vertices);
+    float* vertex_scores = memory_malloc(sizeof(float) * num_vertices);
+    float* triangle_scores = memory_calloc(num_triangles, sizeof(float));
+    uint8_t* emitted = memory_calloc(num_triangles, sizeof(uint8_t));
+
+    bool allocated = source && offsets && adjacency && num_live
+        && cache_positions && vertex_scores && triangle_scores && emitted;
+    if (allocated) {
+        memcpy(source, indices, sizeof(uint32_t) * num_indices);
+
+        // triangles around each vertex, the live ones first
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            assert(indices[i] < num_vertices);
+            ++num_live[indices[i]];
+        }
+
+        offsets[0] = 0;
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            offsets[v + 1] = offsets[v] + num_live[v];
+            num_live[v] = 0;
+        }
+
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            uint32_t v = source[i];
+            adjacency[offsets[v] + num_live[v]++] = i / 3;
+        }
+
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            cache_positions[v] = -1;
+            vertex_scores[v] = vertex_score(-1, num_live[v]);
+        }
+
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            triangle_scores[i / 3] += vertex_scores[source[i]];
+        }
+    }
+
+    uint32_t best = UINT32_MAX;
+    float best_score = -1.f;
+    for (uint32_t t = 0; allocated && t < num_triangles; ++t) {
+        if (triangle_scores[t] > best_score) {
+            best = t;
+            best_score = triangle_scores[t];
+        }
+    }
+
+    uint32_t cache[OPTIMIZE_VERTEX_CACHE_SIZE + 3];
+    uint32_t cache_size = 0;
+    uint32_t next_triangle = 0;
+    for (uint32_t t = 0; allocated && t < num_triangles; ++t) {
+        // when no triangle is left around the cached
+        // vertices, carry on with the first one left
+        if (best == UINT32_MAX) {
+            while (emitted[next_triangle]) {
+                ++next_triangle;
+            }
+
+            best = next_triangle;
+        }
+
+        const uint32_t* triangle = &source[3 * best];
+        memcpy(&indices[3 * t], triangle, sizeof(uint32_t) * 3);
+        emitted[best] = 1;
+
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t v = triangle[k];
+            retire_triangle(&adjacency[offsets[v]], &num_live[v], best);
+        }
+
+        // the triangle vertices move to the front of the cache,
+        // pushing the least recently used ones out of it
+        uint32_t new_cache[OPTIMIZE_VERTEX_CACHE_SIZE + 3];
+        uint32_t new_cache_size = 0;
+        for (uint32_t k = 0; k < 3; ++k) {
+            bool cached = false;
+            for (uint32_t c = 0; c < new_cache_size; ++c) {
+                cached = cached || new_cache[c] == triangle[k];
+            }
+
+            if (!cached) {
+                new_cache[new_cache_size++] = triangle[k];
+            }
+        }
+
+        for (uint32_t c = 0; c < cache_size; ++c) {
+            uint32_t v = cache[c];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                new_cache[new_cache_size++] = v;
+            }
+        }
+
+        // rescore the vertices which have moved, and their triangles
+        for (uint32_t c = 0; c < new_cache_size; ++c) {
+            uint32_t v = new_cache[c];
+            cache_positions[v] = (c < OPTIMIZE_VERTEX_CACHE_SIZE) ? (int32_t)c : -1;
+
+            float score = vertex_score(cache_positions[v], num_live[v]);
+            float delta = score - vertex_scores[v];
+            vertex_scores[v] = score;
+
+            const uint32_t* triangles = &adjacency[offsets[v]];
+            for (uint32_t l = 0; l < num_live[v]; ++l) {
+                triangle_scores[triangles[l]] += delta;
+            }
+        }
+
+        cache_size = (new_cache_size < OPTIMIZE_VERTEX_CACHE_SIZE)
+            ? new_cache_size : OPTIMIZE_VERTEX_CACHE_SIZE;
+        memcpy(cache, new_cache, sizeof(uint32_t) * cache_size);
+
+        // the next triangle is the best one around the cached vertices
+        best = UINT32_MAX;
+        best_score = -1.f;
+        for (uint32_t c = 0; c < cache_size; ++c) {
+            uint32_t v = cache[c];
+            const uint32_t* triangles = &adjacency[offsets[v]];
+            for (uint32_t l = 0; l < num_live[v]; ++l) {
+                if (triangle_scores[triangles[l]] > best_score) {
+                    best = triangles[l];
+                    best_score = triangle_scores[triangles[l]];
+                }
+            }
+        }
+    }
+
+    if (source) memory_free(source);
+    if (offsets) memory_free(offsets);
+    if (adjacency) memory_free(adjacency);
+    if (num_live) memory_free(num_live);
+    if (cache_positions) memory_free(cache_positions);
+    if (vertex_scores) memory_free(vertex_scores);
+    if (triangle_scores) memory_free(triangle_scores);
+    if (emitted) memory_free(emitted);
+    return allocated;
+}
+
+uint32_t optimize_vertex_fetch(void* vertices, size_t vertex_size,
+    uint32_t num_vertices, uint32_t* indices, uint32_t num_indices) {
+    assert(vertices && vertex_size > 0 && indices);
+
+    uint32_t* remap = memory_malloc(sizeof(uint32_t) * num_vertices);
+    uint8_t* reordered = memory_malloc(vertex_size * num_vertices);
+    if (!remap || !reordered) {
+        if (remap) memory_free(remap);
+        if (reordered) memory_free(reordered);
+        return num_vertices;
+    }
+
+    memset(remap, 0xff, sizeof(uint32_t) * num_vertices);
+
+    uint32_t num_used = 0;
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        uint32_t v = indices[i];
+        assert(v < num_vertices);
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = num_used++;
+        }
+
+        indices[i] = remap[v];
+    }
+
+    const uint8_t* bytes = (const uint8_t*)vertices;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        if (remap[v] != UINT32_MAX) {
+            memcpy(reordered + vertex_size * remap[v],
+                bytes + vertex_size * v, vertex_size);
+        }
+    }
+
+    memcpy(vertices, reordered, vertex_size * num_used);
+    memory_free(remap);
+    memory_free(reordered);
+    return num_used;
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
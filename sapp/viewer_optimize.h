@@ -0,0 +1,54 @@
+#pragma once
+/**
+ * Mesh optimisations for the GPU vertex pipeline
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// size of the post transform cache the triangles are ordered for,
+// which is a fair approximation of the one of most GPUs.
+#define OPTIMIZE_VERTEX_CACHE_SIZE 32
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Merge the vertices which are bitwise identical, keeping the first
+ * of each, and remap the indices to the ones left. Vertices are
+ * compacted in place, in the same order.
+ *
+ * @return The number of vertices left, which is num_vertices when
+ *  nothing can be merged, or there is not enough memory to.
+ */
+uint32_t optimize_weld_vertices(void* vertices, size_t vertex_size,
+    uint32_t num_vertices, uint32_t* indices, uint32_t num_indices);
+
+/**
+ * Reorder the triangles in place, so that they reuse the vertices
+ * recently transformed as much as possible, following the linear-speed
+ * vertex cache optimisation by Tom Forsyth. Triangles are not rotated,
+ * so that their winding is preserved.
+ *
+ * @return false if there is not enough memory, and the
+ *  triangles are left as they are.
+ */
+bool optimize_vertex_cache(uint32_t* indices, uint32_t num_indices,
+    uint32_t num_vertices);
+
+/**
+ * Reorder the vertices in place, in the order the triangles first use
+ * them, and remap the indices accordingly. Vertices which are not used
+ * by any triangle are dropped.
+ *
+ * @return The number of vertices left, which is num_vertices when
+ *  there is not enough memory to reorder them.
+ */
+uint32_t optimize_vertex_fetch(void* vertices, size_t vertex_size,
+    uint32_t num_vertices, uint32_t* indices, uint32_t num_indices);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,813 @@
+#include "viewer_ply.h"
+#include "viewer_log.h"
+#include "viewer_memory.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PLY_MAX_LINE 256
+#define PLY_MAX_NAME 32
+#define PLY_BLOCK_SIZE 65536    // vertices per job
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+typedef enum {
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+    PLY_TYPE_INVALID
+} __ply_type_t;
+
+static const struct {
+    const char* name;
+    __ply_type_t type;
+} __ply_type_names[] = {
+    {"char", PLY_INT8}, {"int8", PLY_INT8},
+    {"uchar", PLY_UINT8}, {"uint8", PLY_UINT8},
+    {"short", PLY_INT16}, {"int16", PLY_INT16},
+    {"ushort", PLY_UINT16}, {"uint16", PLY_UINT16},
+    {"int", PLY_INT32}, {"int32", PLY_INT32},
+    {"uint", PLY_UINT32}, {"uint32", PLY_UINT32},
+    {"float", PLY_FLOAT32}, {"float32", PLY_FLOAT32},
+    {"double", PLY_FLOAT64}, {"float64", PLY_FLOAT64}
+};
+
+static const uint32_t __ply_type_sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+typedef struct {
+    char name[PLY_MAX_NAME];
+    __ply_type_t type;          // of the list items, for lists
+    __ply_type_t count_type;    // PLY_TYPE_INVALID if not a list
+    uint32_t offset;            // within the element, if it has no lists
+} __ply_property_t;
+
+typedef struct {
+    char name[PLY_MAX_NAME];
+    uint32_t count;
+    __ply_property_t properties[PLY_MAX_PROPERTIES];
+    uint32_t num_properties;
+    uint32_t stride;            // 0 if the element has lists
+    const uint8_t* data;
+    size_t size;
+} __ply_element_t;
+
+// a vertex property, and where it is
+typedef struct {
+    const uint8_t* data;        // NULL if the vertices have none
+    __ply_type_t type;
+} __ply_attribute_t;
+
+typedef struct {
+    const ply_data_t* data;
+    ply_model_t* model;
+    __ply_element_t elements[PLY_MAX_ELEMENTS];
+    uint32_t num_elements;
+    bool swap;                  // the file endianness is not the host one
+    const __ply_element_t* vertex;
+    uint32_t vertex_stride;
+    __ply_attribute_t positions[3];
+    __ply_attribute_t colors[4];
+    __ply_attribute_t normals[3];
+    __ply_attribute_t uvs[2];
+} __ply_t;
+
+static __ply_type_t __ply_parse_type(const char* name) {
+    for (size_t t = 0; t < sizeof(__ply_type_names) / sizeof(__ply_type_names[0]); ++t) {
+        if (strcmp(name, __ply_type_names[t].name) == 0) {
+            return __ply_type_names[t].type;
+        }
+    }
+
+    return PLY_TYPE_INVALID;
+}
+
+static bool __ply_host_big_endian(void) {
+    const uint16_t one = 1;
+    return *(const uint8_t*)&one == 0;
+}
+
+static double __ply_read(const uint8_t* p, __ply_type_t type, bool swap) {
+    uint8_t bytes[8];
+    uint32_t size = __ply_type_sizes[type];
+    for (uint32_t b = 0; b < size; ++b) {
+        bytes[b] = p[swap ? size - 1 - b : b];
+    }
+
+    switch (type) {
+        case PLY_INT8: return (double)(int8_t)bytes[0];
+        case PLY_UINT8: return (double)bytes[0];
+        case PLY_INT16: { int16_t v; memcpy(&v, bytes, 2); return (double)v; }
+        case PLY_UINT16: { uint16_t v; memcpy(&v, bytes, 2); return (double)v; }
+        case PLY_INT32: { int32_t v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_UINT32: { uint32_t v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_FLOAT32: { float v; memcpy(&v, bytes, 4); return (double)v; }
+        case PLY_FLOAT64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.;
+    }
+}
+
+// the next line of the header, without its line ending,
+// truncated to the line size. lines must end with a newline.
+static bool __ply_next_line(const char* text, size_t size, size_t* pos,
+    char* line, size_t line_size) {
+    size_t start = *pos;
+    size_t end = start;
+    while (end < size && text[end] != '\n') {
+        ++end;
+    }
+
+    if (end == size) {
+        return false;
+    }
+
+    size_t length = end - start;
+    if (length > 0 && text[start + length - 1] == '\r') {
+        --length;
+    }
+
+    length = (length < line_size) ? length : line_size - 1;
+    memcpy(line, text + start, length);
+    line[length] = '\0';
+    *pos = end + 1;
+    return true;
+}
+
+static ply_result_t __ply_parse_header(__ply_t* g, size_t* out_body) {
+    const char* text = (const char*)g->data->ply_data;
+    size_t size = g->data->data_size;
+    size_t pos = 0;
+    char line[PLY_MAX_LINE];
+
+    if (!__ply_next_line(text, size, &pos, line, PLY_MAX_LINE)
+        || strcmp(line, "ply") != 0) {
+        return PLY_RESULT_INVALID_FILE;
+    }
+
+    bool has_format = false;
+    __ply_element_t* element = NULL;
+    while (__ply_next_line(text, size, &pos, line, PLY_MAX_LINE)) {
+        char keyword[PLY_MAX_NAME] = {0};
+        if (sscanf(line, "%31s", keyword) != 1
+            || strcmp(keyword, "comment") == 0
+            || strcmp(keyword, "obj_info") == 0) {
+            continue;
+        }
+
+        if (strcmp(keyword, "end_header") == 0) {
+            *out_body = pos;
+            return has_format ? PLY_RESULT_OK : PLY_RESULT_INVALID_FILE;
+        }
+
+        if (strcmp(keyword, "format") == 0) {
+            char format[PLY_MAX_NAME] = {0};
+            if (sscanf(line, "%*s %31s", format) != 1) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+
+            if (strcmp(format, "binary_little_endian") == 0) {
+                g->swap = __ply_host_big_endian();
+            }
+            else if (strcmp(format, "binary_big_endian") == 0) {
+                g->swap = !__ply_host_big_endian();
+            }
+            else {
+                return PLY_RESULT_UNSUPPORTED;
+            }
+
+            has_format = true;
+        }
+        else if (strcmp(keyword, "element") == 0) {
+            if (g->num_elements == PLY_MAX_ELEMENTS) {
+                return PLY_RESULT_UNSUPPORTED;
+            }
+
+            element = &g->elements[g->num_elements++];
+            unsigned long long count = 0;
+            if (sscanf(line, "%*s %31s %llu", element->name, &count) != 2) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+
+            if (count > UINT32_MAX) {
+                return PLY_RESULT_UNSUPPORTED;
+            }
+
+            element->count = (uint32_t)count;
+        }
+        else if (strcmp(keyword, "property") == 0) {
+            if (!element) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+
+            if (element->num_properties == PLY_MAX_PROPERTIES) {
+                return PLY_RESULT_UNSUPPORTED;
+            }
+
+            __ply_property_t* property =
+                &element->properties[element->num_properties++];
+            char type[PLY_MAX_NAME] = {0};
+            char count_type[PLY_MAX_NAME] = {0};
+            if (sscanf(line, "%*s %31s", type) != 1) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+
+            if (strcmp(type, "list") == 0) {
+                if (sscanf(line, "%*s %*s %31s %31s %31s",
+                    count_type, type, property->name) != 3) {
+                    return PLY_RESULT_INVALID_FILE;
+                }
+
+                property->count_type = __ply_parse_type(count_type);
+                if (property->count_type == PLY_TYPE_INVALID
+                    || property->count_type == PLY_FLOAT32
+                    || property->count_type == PLY_FLOAT64) {
+                    return PLY_RESULT_INVALID_FILE;
+                }
+            }
+            else {
+                if (sscanf(line, "%*s %*s %31s", property->name) != 1) {
+                    return PLY_RESULT_INVALID_FILE;
+                }
+
+                property->count_type = PLY_TYPE_INVALID;
+            }
+
+            property->type = __ply_parse_type(type);
+            if (property->type == PLY_TYPE_INVALID) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+        }
+        else {
+            return PLY_RESULT_INVALID_FILE;
+        }
+    }
+
+    return PLY_RESULT_INVALID_FILE;
+}
+
+// elements with lists have no fixed stride, and are walked item by
+// item, calling back for the list named, if any, on every item
+typedef bool (*__ply_list_func_t)(__ply_t* g, const uint8_t* items,
+    uint32_t count, __ply_type_t type, void* user_data);
+
+static bool __ply_walk_element(__ply_t* g, const __ply_element_t* element,
+    const uint8_t* data, size_t available, const char* list_name,
+    __ply_list_func_t func, void* user_data, size_t* out_size) {
+    size_t pos = 0;
+    for (uint32_t i = 0; i < element->count; ++i) {
+        for (uint32_t p = 0; p < element->num_properties; ++p) {
+            const __ply_property_t* property = &element->properties[p];
+            if (property->count_type == PLY_TYPE_INVALID) {
+                pos += __ply_type_sizes[property->type];
+                if (pos > available) {
+                    return false;
+                }
+                continue;
+            }
+
+            uint32_t count_size = __ply_type_sizes[property->count_type];
+            if (pos + count_size > available) {
+                return false;
+            }
+
+            double count = __ply_read(data + pos, property->count_type, g->swap);
+            pos += count_size;
+            if (count < 0.) {
+                return false;
+            }
+
+            size_t items_size = (size_t)count * __ply_type_sizes[property->type];
+            if (items_size > available - pos) {
+                return false;
+            }
+
+            if (func && list_name && strcmp(property->name, list_name) == 0
+                && !func(g, data + pos, (uint32_t)count, property->type, user_data)) {
+                return false;
+            }
+
+            pos += items_size;
+        }
+    }
+
+    *out_size = pos;
+    return true;
+}
+
+// locate the data of each element, which come one after the other
+static ply_result_t __ply_layout_elements(__ply_t* g, size_t body) {
+    const uint8_t* data = (const uint8_t*)g->data->ply_data;
+    size_t size = g->data->data_size;
+    size_t pos = body;
+
+    for (uint32_t e = 0; e < g->num_elements; ++e) {
+        __ply_element_t* element = &g->elements[e];
+        bool has_lists = false;
+        uint32_t stride = 0;
+        for (uint32_t p = 0; p < element->num_properties; ++p) {
+            __ply_property_t* property = &element->properties[p];
+            has_lists |= property->count_type != PLY_TYPE_INVALID;
+            property->offset = stride;
+            stride += __ply_type_sizes[property->type];
+        }
+
+        element->stride = has_lists ? 0 : stride;
+        element->data = data + pos;
+        if (has_lists) {
+            if (!__ply_walk_element(g, element, element->data, size - pos,
+                NULL, NULL, NULL, &element->size)) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+        }
+        else {
+            uint64_t element_size = (uint64_t)stride * element->count;
+            if (element_size > size - pos) {
+                return PLY_RESULT_INVALID_FILE;
+            }
+
+            element->size = (size_t)element_size;
+        }
+
+        pos += element->size;
+    }
+
+    return PLY_RESULT_OK;
+}
+
+static const __ply_element_t* __ply_find_element(const __ply_t* g,
+    const char* name) {
+    for (uint32_t e = 0; e < g->num_elements; ++e) {
+        if (strcmp(g->elements[e].name, name) == 0) {
+            return &g->elements[e];
+        }
+    }
+
+    return NULL;
+}
+
+// the first of the names the vertices have a scalar property of
+static __ply_attribute_t __ply_find_attribute(const __ply_t* g,
+    const char* const* names, uint32_t num_names) {
+    for (uint32_t n = 0; n < num_names; ++n) {
+        for (uint32_t p = 0; p < g->vertex->num_properties; ++p) {
+            const __ply_property_t* property = &g->vertex->properties[p];
+            if (strcmp(property->name, names[n]) == 0) {
+                return (__ply_attribute_t){
+                    .data = g->vertex->data + property->offset,
+                    .type = property->type
+                };
+            }
+        }
+    }
+
+    return (__ply_attribute_t){0};
+}
+
+// whether the attributes are consecutive values of the given type,
+// which can be read in place, as they are in the host endianness
+static bool __ply_is_packed(const __ply_t* g,
+    const __ply_attribute_t* attributes, uint32_t count, __ply_type_t type) {
+    for (uint32_t a = 0; a < count; ++a) {
+        if (attributes[a].type != type || (a > 0 && attributes[a].data
+            != attributes[a - 1].data + __ply_type_sizes[type])) {
+            return false;
+        }
+    }
+
+    return !g->swap || __ply_type_sizes[type] == 1;
+}
+
+static void __ply_find_attributes(__ply_t* g) {
+    static const char* const x_names[] = {"x"};
+    static const char* const y_names[] = {"y"};
+    static const char* const z_names[] = {"z"};
+    static const char* const r_names[] = {"red", "diffuse_red", "r"};
+    static const char* const g_names[] = {"green", "diffuse_green", "g"};
+    static const char* const b_names[] = {"blue", "diffuse_blue", "b"};
+    static const char* const a_names[] = {"alpha", "diffuse_alpha", "a"};
+    static const char* const nx_names[] = {"nx", "normal_x"};
+    static const char* const ny_names[] = {"ny", "normal_y"};
+    static const char* const nz_names[] = {"nz", "normal_z"};
+    static const char* const u_names[] = {"u", "s", "texture_u", "texture_s"};
+    static const char* const v_names[] = {"v", "t", "texture_v", "texture_t"};
+
+    g->positions[0] = __ply_find_attribute(g, x_names, 1);
+    g->positions[1] = __ply_find_attribute(g, y_names, 1);
+    g->positions[2] = __ply_find_attribute(g, z_names, 1);
+    g->colors[0] = __ply_find_attribute(g, r_names, 3);
+    g->colors[1] = __ply_find_attribute(g, g_names, 3);
+    g->colors[2] = __ply_find_attribute(g, b_names, 3);
+    g->colors[3] = __ply_find_attribute(g, a_names, 3);
+    g->normals[0] = __ply_find_attribute(g, nx_names, 2);
+    g->normals[1] = __ply_find_attribute(g, ny_names, 2);
+    g->normals[2] = __ply_find_attribute(g, nz_names, 2);
+    g->uvs[0] = __ply_find_attribute(g, u_names, 4);
+    g->uvs[1] = __ply_find_attribute(g, v_names, 4);
+}
+
+static double __ply_read_attribute(const __ply_t* g,
+    const __ply_attribute_t* attribute, uint32_t vertex) {
+    return __ply_read(attribute->data + (size_t)vertex * g->vertex_stride,
+        attribute->type, g->swap);
+}
+
+// colors of any type into bytes, floats are within [0, 1]
+static uint8_t __ply_read_color(const __ply_t* g,
+    const __ply_attribute_t* attribute, uint32_t vertex) {
+    double value = __ply_read_attribute(g, attribute, vertex);
+    switch (attribute->type) {
+        case PLY_FLOAT32: case PLY_FLOAT64: value *= 255.; break;
+        case PLY_UINT16: case PLY_INT16: value /= 257.; break;
+        default: break;
+    }
+
+    return (uint8_t)((value < 0.) ? 0. : ((value > 255.) ? 255. : value + .5));
+}
+
+// convert the attributes which cannot be read in place
+static void __ply_attributes_job(void* user_data, uint32_t block) {
+    __ply_t* g = (__ply_t*)user_data;
+    ply_model_t* model = g->model;
+    uint32_t begin = block * PLY_BLOCK_SIZE;
+    uint32_t end = (model->num_vertices - begin > PLY_BLOCK_SIZE)
+        ? begin + PLY_BLOCK_SIZE : model->num_vertices;
+
+    if (model->owned_positions) {
+        float* positions = (float*)model->owned_positions;
+        for (uint32_t v = begin; v < end; ++v) {
+            for (int32_t c = 0; c < 3; ++c) {
+                positions[3 * v + c] =
+                    (float)__ply_read_attribute(g, &g->positions[c], v);
+            }
+        }
+    }
+
+    if (model->owned_colors) {
+        uint8_t* colors = model->owned_colors;
+        for (uint32_t v = begin; v < end; ++v) {
+            for (int32_t c = 0; c < 3; ++c) {
+                colors[4 * v + c] = __ply_read_color(g, &g->colors[c], v);
+            }
+
+            colors[4 * v + 3] = g->colors[3].data
+                ? __ply_read_color(g, &g->colors[3], v) : 0xff;
+        }
+    }
+}
+
+static void __ply_vertices_job(void* user_data, uint32_t block) {
+    __ply_t* g = (__ply_t*)user_data;
+    ply_model_t* model = g->model;
+    uint32_t begin = block * PLY_BLOCK_SIZE;
+    uint32_t end = (model->num_vertices - begin > PLY_BLOCK_SIZE)
+        ? begin + PLY_BLOCK_SIZE : model->num_vertices;
+
+    bool has_normals = g->normals[0].data && g->normals[1].data
+        && g->normals[2].data;
+    bool has_uvs = g->uvs[0].data && g->uvs[1].data;
+
+    for (uint32_t v = begin; v < end; ++v) {
+        vertex_t* vertex = &model->vertices[v];
+        memcpy(&vertex->pos, model->positions
+            + (size_t)v * model->position_stride, sizeof(float) * 3);
+
+        vertex->norm = has_normals
+            ? svec3(
+                (mfloat_t)__ply_read_attribute(g, &g->normals[0], v),
+                (mfloat_t)__ply_read_attribute(g, &g->normals[1], v),
+                (mfloat_t)__ply_read_attribute(g, &g->normals[2], v))
+            : svec3_zero();
+
+        // texture coordinates are bottom-up
+        vertex->uv = has_uvs
+            ? svec2(
+                (mfloat_t)__ply_read_attribute(g, &g->uvs[0], v),
+                1.f - (mfloat_t)__ply_read_attribute(g, &g->uvs[1], v))
+            : svec2(0.f, 0.f);
+    }
+}
+
+typedef struct {
+    uint32_t num_indices;
+    bool invalid;
+} __ply_faces_t;
+
+// faces are fans, of count - 2 triangles each
+static bool __ply_count_face(__ply_t* g, const uint8_t* items,
+    uint32_t count, __ply_type_t type, void* user_data) {
+    (void)g; (void)items; (void)type;
+    __ply_faces_t* faces = (__ply_faces_t*)user_data;
+    if (count >= 3) {
+        uint64_t num_indices = faces->num_indices + 3 * (uint64_t)(count - 2);
+        if (num_indices > UINT32_MAX) {
+            return false;
+        }
+
+        faces->num_indices = (uint32_t)num_indices;
+    }
+
+    return true;
+}
+
+static bool __ply_add_face(__ply_t* g, const uint8_t* items,
+    uint32_t count, __ply_type_t type, void* user_data) {
+    __ply_faces_t* faces = (__ply_faces_t*)user_data;
+    ply_model_t* model = g->model;
+    uint32_t size = __ply_type_sizes[type];
+
+    uint32_t first = 0;
+    uint32_t previous = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        double value = __ply_read(items + (size_t)i * size, type, g->swap);
+        if (value < 0. || value >= (double)model->num_vertices) {
+            faces->invalid = true;
+            return false;
+        }
+
+        uint32_t index = (uint32_t)value;
+        if (i == 0) {
+            first = index;
+        }
+        else if (i >= 2) {
+            uint32_t* triangle = &model->indices[faces->num_indices];
+            triangle[0] = first;
+            triangle[1] = previous;
+            triangle[2] = index;
+            faces->num_indices += 3;
+        }
+
+        previous = index;
+    }
+
+    return true;
+}
+
+static ply_result_t __ply_load_faces(__ply_t* g,
+    const __ply_element_t* face) {
+    ply_model_t* model = g->model;
+    const char* list_name = "vertex_indices";
+    bool has_list = false;
+    for (uint32_t p = 0; p < face->num_properties; ++p) {
+        has_list |= strcmp(face->properties[p].name, list_name) == 0;
+    }
+
+    if (!has_list) {
+        list_name = "vertex_index";
+    }
+
+    size_t size;
+    __ply_faces_t faces = {0};
+    if (!__ply_walk_element(g, face, face->data, face->size, list_name,
+        __ply_count_face, &faces, &size)) {
+        return PLY_RESULT_UNSUPPORTED;
+    }
+
+    if (faces.num_indices == 0) {
+        return PLY_RESULT_OK;
+    }
+
+    model->indices = memory_malloc(sizeof(uint32_t) * faces.num_indices);
+    if (!model->indices) {
+        return PLY_RESULT_OUT_OF_MEMORY;
+    }
+
+    faces.num_indices = 0;
+    if (!__ply_walk_element(g, face, face->data, face->size, list_name,
+        __ply_add_face, &faces, &size)) {
+        return PLY_RESULT_INVALID_FILE;
+    }
+
+    model->num_indices = faces.num_indices;
+    return PLY_RESULT_OK;
+}
+
+// area weighted, as the faces cross products are twice their area
+static void __ply_compute_normals(ply_model_t* model) {
+    vertex_t* vertices = model->vertices;
+    for (uint32_t i = 0; i + 2 < model->num_indices; i += 3) {
+        vertex_t* v0 = &vertices[model->indices[i]];
+        vertex_t* v1 = &vertices[model->indices[i + 1]];
+        vertex_t* v2 = &vertices[model->indices[i + 2]];
+        vec3f_t normal = svec3_cross(
+            svec3_subtract(v1->pos, v0->pos),
+            svec3_subtract(v2->pos, v0->pos));
+
+        v0->norm = svec3_add(v0->norm, normal);
+        v1->norm = svec3_add(v1->norm, normal);
+        v2->norm = svec3_add(v2->norm, normal);
+    }
+
+    // vertices of no face, or of degenerate ones only, keep a null normal
+    for (uint32_t v = 0; v < model->num_vertices; ++v) {
+        if (svec3_dot(vertices[v].norm, vertices[v].norm) > MFLT_EPSILON) {
+            vertices[v].norm = svec3_normalize(vertices[v].norm);
+        }
+    }
+}
+
+static ply_result_t __ply_load(__ply_t* g) {
+    ply_model_t* model = g->model;
+
+    size_t body = 0;
+    ply_result_t result = __ply_parse_header(g, &body);
+    if (result != PLY_RESULT_OK) {
+        return result;
+    }
+
+    result = __ply_layout_elements(g, body);
+    if (result != PLY_RESULT_OK) {
+        return result;
+    }
+
+    g->vertex = __ply_find_element(g, "vertex");
+    if (!g->vertex || g->vertex->count == 0) {
+        return PLY_RESULT_INVALID_FILE;
+    }
+
+    if (g->vertex->stride == 0) {
+        return PLY_RESULT_UNSUPPORTED;
+    }
+
+    g->vertex_stride = g->vertex->stride;
+    __ply_find_attributes(g);
+    if (!g->positions[0].data || !g->positions[1].data || !g->positions[2].data) {
+        return PLY_RESULT_INVALID_FILE;
+    }
+
+    model->num_vertices = g->vertex->count;
+    uint32_t num_blocks = (model->num_vertices + PLY_BLOCK_SIZE - 1)
+        / PLY_BLOCK_SIZE;
+
+    // positions and colors are read in place whenever they can be
+    if (__ply_is_packed(g, g->positions, 3, PLY_FLOAT32)) {
+        model->positions = g->positions[0].data;
+        model->position_stride = g->vertex_stride;
+    }
+    else {
+        model->owned_positions = memory_malloc(
+            sizeof(float) * 3 * (size_t)model->num_vertices);
+        if (!model->owned_positions) {
+            return PLY_RESULT_OUT_OF_MEMORY;
+        }
+
+        model->positions = (const uint8_t*)model->owned_positions;
+        model->position_stride = sizeof(float) * 3;
+    }
+
+    if (g->colors[0].data && g->colors[1].data && g->colors[2].data) {
+        uint32_t components = g->colors[3].data ? 4 : 3;
+        if (__ply_is_packed(g, g->colors, components, PLY_UINT8)) {
+            model->colors = g->colors[0].data;
+            model->color_stride = g->vertex_stride;
+            model->color_components = components;
+        }
+        else {
+            model->owned_colors = memory_malloc(4 * (size_t)model->num_vertices);
+            if (!model->owned_colors) {
+                return PLY_RESULT_OUT_OF_MEMORY;
+            }
+
+            model->colors = model->owned_colors;
+            model->color_stride = 4;
+            model->color_components = 4;
+        }
+    }
+
+    if (model->owned_positions || model->owned_colors) {
+        jobs_parallel_for(g->data->jobs, __ply_attributes_job, g, num_blocks);
+    }
+
+    // the faces make a mesh of the vertices
+    const __ply_element_t* face = __ply_find_element(g, "face");
+    if (!face || face->count == 0) {
+        return PLY_RESULT_OK;
+    }
+
+    result = __ply_load_faces(g, face);
+    if (result != PLY_RESULT_OK || model->num_indices == 0) {
+        return result;
+    }
+
+    model->vertices = memory_malloc(sizeof(vertex_t) * model->num_vertices);
+    if (!model->vertices) {
+        return PLY_RESULT_OUT_OF_MEMORY;
+    }
+
+    jobs_parallel_for(g->data->jobs, __ply_vertices_job, g, num_blocks);
+    if (!g->normals[0].data || !g->normals[1].data || !g->normals[2].data) {
+        __ply_compute_normals(model);
+    }
+
+    return PLY_RESULT_OK;
+}
+
+ply_result_t ply_load(const ply_data_t* data, ply_model_t* out_model) {
+    assert(data && data->ply_data && out_model);
+    memset(out_model, 0, sizeof(ply_model_t));
+    trace_printf(&out_model->trace, "%s", data->label ? data->label : "ply");
+    out_model->num_lods = data->num_lods;
+
+    __ply_t g = {
+        .data = data,
+        .model = out_model
+    };
+
+    ply_result_t result = __ply_load(&g);
+    if (result == PLY_RESULT_OK) {
+        LOG_INFO("PLY model loaded (%s): vertices=%u, triangles=%u%s%s\n",
+            out_model->trace.name, out_model->num_vertices,
+            out_model->num_indices / 3,
+            out_model->colors ? ", colors" : "",
+            out_model->owned_positions ? "" : ", mapped");
+    }
+    else {
+        LOG_WARN("WARN: Cannot load PLY model (%s), error %d\n",
+            out_model->trace.name, result);
+    }
+
+    return result;
+}
+
+void ply_release(ply_model_t* model) {
+    assert(model);
+
+    if (model->vertices) {
+        memory_free(model->vertices);
+    }
+
+    if (model->indices) {
+        memory_free(model->indices);
+    }
+
+    if (model->owned_positions) {
+        memory_free(model->owned_positions);
+    }
+
+    if (model->owned_colors) {
+        memory_free(model->owned_colors);
+    }
+
+    memset(model, 0, sizeof(ply_model_t));
+}
+
+model_id_t ply_make_model(geometry_pass_t* pass, const ply_model_t* model) {
+    assert(pass && model);
+
+    model_id_t model_id = {.id = HANDLE_INVALID_ID};
+    if (!model->vertices || model->num_indices == 0) {
+        return model_id;
+    }
+
+    mesh_id_t mesh_id = geometry_pass_make_mesh(pass, &(mesh_desc_t){
+        .vertices = model->vertices,
+        .num_vertices = model->num_vertices,
+        .indices = model->indices,
+        .num_indices = model->num_indices,
+        .num_lods = model->num_lods > 0 ? model->num_lods : 1,
+        .layout = VERTEX_LAYOUT_DEFAULT,
+        .label = model->trace.name
+    });
+
+    if (!handle_is_valid(mesh_id, GEOMETRY_PASS_MAX_MESHES)) {
+        return model_id;
+    }
+
+    model_id = geometry_pass_create_model(pass, &(model_desc_t){
+        .mesh = mesh_id,
+        .material = geometry_pass_get_default_material(pass),
+        .label = model->trace.name
+    });
+
+    // the mesh would be left behind otherwise
+    if (!handle_is_valid(model_id, GEOMETRY_PASS_MAX_MODELS)) {
+        geometry_pass_destroy_mesh(pass, mesh_id);
+    }
+
+    return model_id;
+}
+
+point_cloud_id_t ply_make_point_cloud(geometry_pass_t* pass,
+    const ply_model_t* model) {
+    assert(pass && model);
+
+    return geometry_pass_make_point_cloud(pass, &(point_cloud_desc_t){
+        .positions = model->positions,
+        .position_stride = model->position_stride,
+        .colors = model->colors,
+        .color_stride = model->color_stride,
+        .color_components = model->color_components,
+        .num_points = model->num_vertices,
+        .label = model->trace.name
+    });
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
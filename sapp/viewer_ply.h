@@ -0,0 +1,79 @@
+#pragma once
+ /**
+  * Binary PLY loader, of point clouds and meshes
+  */
+
+#include "viewer_geometry_pass.h"
+#include "viewer_jobs.h"
+
+#define PLY_MAX_ELEMENTS 8      // per file
+#define PLY_MAX_PROPERTIES 32   // per element
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// vertex attributes are strided views, within the file data itself
+// when their layout allows it, i.e. consecutive little-endian floats
+// for positions, and bytes for colors, and converted copies otherwise.
+// meshes are the vertices of files with faces, which are triangulated.
+typedef struct {
+    const uint8_t* positions;   // 3 floats each, which need not be aligned
+    uint32_t position_stride;
+    const uint8_t* colors;      // NULL if the vertices have no color
+    uint32_t color_stride;
+    uint32_t color_components;  // 3: rgb, 4: rgba
+    uint32_t num_vertices;
+    vertex_t* vertices;         // NULL if there are no faces
+    uint32_t* indices;
+    uint32_t num_indices;
+    void* owned_positions;      // NULL if the positions are the file ones
+    uint8_t* owned_colors;      // NULL if the colors are the file ones
+    uint32_t num_lods;          // levels of detail to generate for the mesh
+    trace_t trace;
+} ply_model_t;
+
+// ply_data is not copied, and it must be kept alive
+// for as long as the model views of it are used.
+typedef struct {
+    jobs_t* jobs;               // optional
+    const void* ply_data;
+    size_t data_size;
+    uint32_t num_lods;          // levels of detail, 1 for the mesh only
+    const char* label;
+} ply_data_t;
+
+typedef enum {
+    PLY_RESULT_OK,
+    PLY_RESULT_INVALID_FILE,
+    PLY_RESULT_UNSUPPORTED,
+    PLY_RESULT_OUT_OF_MEMORY
+} ply_result_t;
+
+/**
+ * Load the vertices of the file, and, if it has faces, the mesh made
+ * of them, whose vertices are converted to vertex_t on jobs, and whose
+ * normals are computed from the faces if the vertices have none.
+ * ASCII files are not supported. The model must be released with
+ * ply_release, even if it fails.
+ */
+ply_result_t ply_load(const ply_data_t* data, ply_model_t* out_model);
+
+void ply_release(ply_model_t* model);
+
+/**
+ * Make the model of the mesh, drawn with the default material,
+ * invalid if the file has no faces.
+ */
+model_id_t ply_make_model(geometry_pass_t* pass, const ply_model_t* model);
+
+/**
+ * Make a point cloud of the vertices, which are read straight from the
+ * file data, if they have not been converted, while it is built.
+ */
+point_cloud_id_t ply_make_point_cloud(geometry_pass_t* pass,
+    const ply_model_t* model);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -49,31 +49,69 @@ void render_end() {
     sg_commit();
 }
 
-void render_pass_draw(const render_pass_t* pass) {
-    assert(pass);
+static bool ubo_is_valid(const ubo_t* ubo) {
+    return ubo->data && ubo->size > 0 && ubo->index >= 0;
+}
+
+static void render_pass_apply_pipeline(const render_pass_t* pass,
+    int32_t pipeline_index) {
 
     // pipeline
-    sg_apply_pipeline(pass->pipeline);
+    sg_apply_pipeline(pass->pipelines[pipeline_index]);
+
+    // uniforms need to be applied again after each pipeline switch
 
     // vertex stage uniforms
     const ubo_t* vs_ubo = &pass->uniforms.vs_ubo;
-    if (vs_ubo->data && vs_ubo->size > 0 && vs_ubo->index >= 0) {
+    if (ubo_is_valid(vs_ubo)) {
         sg_apply_uniforms(SG_SHADERSTAGE_VS,
             vs_ubo->index, vs_ubo->data, vs_ubo->size);
     }
 
     // fragment stage uniforms
     const ubo_t* fs_ubo = &pass->uniforms.fs_ubo;
-    if (fs_ubo->data && fs_ubo->size > 0 && fs_ubo->index >= 0) {
+    if (ubo_is_valid(fs_ubo)) {
         sg_apply_uniforms(SG_SHADERSTAGE_FS,
             fs_ubo->index, fs_ubo->data, fs_ubo->size);
     }
+}
+
+void render_pass_draw(const render_pass_t* pass) {
+    assert(pass);
+
+    // draw calls are batched by pipeline, so that,
+    // each pipeline is applied at most once per pass
+    for (int32_t p = 0; p < RENDER_PASS_MAX_PIPELINES; ++p) {
+        if (pass->pipelines[p].id == SG_INVALID_ID) {
+            continue;
+        }
+
+        bool pipeline_applied = false;
+
+        // iterate through the draw calls, apply
+        // corresponding binding data, and draw
+        for (int32_t j = 0; j < RENDER_PASS_MAX_DRAW_CALLS; ++j) {
+            const draw_call_t* draw_call = &pass->draws[j];
+            // e.g. levels of detail no instance is drawn with
+            if (draw_call->pipeline_index != p
+                || draw_call_is_empty(draw_call)
+                || draw_call->num_instances == 0) {
+                continue;
+            }
+
+            if (!pipeline_applied) {
+                render_pass_apply_pipeline(pass, p);
+                pipeline_applied = true;
+            }
+
+            // per draw vertex stage uniforms
+            if (ubo_is_valid(&draw_call->vs_ubo)) {
+                sg_apply_uniforms(SG_SHADERSTAGE_VS,
+                    draw_call->vs_ubo.index,
+                    draw_call->vs_ubo.data,
+                    draw_call->vs_ubo.size);
+            }
 
-    // iterate through the draw calls, apply
-    // corresponding binding data, and draw
-    for (int32_t j = 0; j < RENDER_PASS_MAX_DRAW_CALLS; ++j) {
-        const draw_call_t* draw_call = &pass->draws[j];
-        if (!draw_call_is_empty(draw_call)) {
             sg_apply_bindings(&draw_call->bindings);
             sg_draw(
                 draw_call->indices_offset,
@@ -7,37 +7,43 @@
 #include "viewer_handle.h"
 #include "viewer_math.h"
 
-#define RENDER_PASS_MAX_DRAW_CALLS 16
+#define RENDER_PASS_MAX_DRAW_CALLS 512
+#define RENDER_PASS_MAX_PIPELINES 4
 #define RENDER_CTX_MAX_PASSES 8
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
+typedef struct {
+    const uint8_t* data;
+    int32_t size;
+    int32_t index;
+} ubo_t;
+
 typedef struct {
     int32_t indices_offset;
     int32_t num_indices;
     int32_t num_instances;
+    int32_t pipeline_index; // index into render_pass_t pipelines
+    ubo_t vs_ubo;           // optional per draw vertex stage uniforms
     sg_bindings bindings;
 } draw_call_t;
 
 void draw_call_reset(draw_call_t* dc);
 bool draw_call_is_empty(const draw_call_t* dc);
 
-typedef struct {
-    const uint8_t* data;
-    int32_t size;
-    int32_t index;
-} ubo_t;
-
 typedef struct {
     ubo_t vs_ubo;
     ubo_t fs_ubo;
 } uniforms_t;
 
+// draw calls are batched by pipeline. pipelines can share
+// shaders, which are stored only once, then, shaders entries
+// can be invalid while the corresponding pipeline is not.
 typedef struct {
-    sg_shader shader;
-    sg_pipeline pipeline;
+    sg_shader shaders[RENDER_PASS_MAX_PIPELINES];
+    sg_pipeline pipelines[RENDER_PASS_MAX_PIPELINES];
     uniforms_t uniforms;
     draw_call_t draws[RENDER_PASS_MAX_DRAW_CALLS];
     trace_t trace;
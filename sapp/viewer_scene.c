@@ -1,8 +1,15 @@
 #include "viewer_scene.h"
+#include "viewer_log.h"
+#include "viewer_memory.h"
 
 #include <assert.h>
 #include <string.h> // memcmp
-#include <stdlib.h> // qsort
+#include <float.h> // FLT_MAX
+
+// moved nodes composed at once, whose poses stay in the cache
+#define SCENE_POSE_BATCH 256
+// bounds tested against the view at once
+#define SCENE_CULL_BATCH 256
 
 #if defined(__cplusplus)
 extern "C" {
@@ -14,21 +21,6 @@ static const transform_t transform_default = {
     .rotation = {0.f,0.f,0.f,1.f},
 };
 
-static const node_t node_empty = {
-    .transform = {
-        .position = {0.f,0.f,0.f},
-        .scale = {1.f,1.f,1.f},
-        .rotation = {0.f,0.f,0.f,1.f},
-    },
-    .model_id = {HANDLE_INVALID_ID},
-    .parent_id = {HANDLE_INVALID_ID}
-};
-
-static bool node_is_empty(const node_t* node) {
-    assert(node);
-    return memcmp(node, &node_empty, sizeof(node_t)) == 0;
-}
-
 void scene_init(scene_t* scene) {
     assert(scene);
 
@@ -46,207 +38,566 @@ void scene_init(scene_t* scene) {
     };
 
     scene->root = smat4_identity();
-    
-    for (int32_t i = 0; i < SCENE_MAX_NODES; ++i) {
-        scene->nodes[i] = node_empty;
-    }
+    scene->nodes = (scene_nodes_t){
+        .first_free = HANDLE_INVALID_ID
+    };
 }
 
 void scene_cleanup(scene_t* scene) {
     assert(scene);
 
-    for (int32_t i = 0; i < SCENE_MAX_NODES; ++i) {
-        scene->nodes[i] = node_empty;
+    scene_nodes_t* nodes = &scene->nodes;
+    void* streams[] = {
+        nodes->transforms, nodes->parents, nodes->models, nodes->colors,
+        nodes->tiles, nodes->lods, nodes->traces, nodes->next_free,
+        nodes->ranks, nodes->order, nodes->parent_ranks, nodes->poses,
+        nodes->spheres, nodes->boxes, nodes->dirty
+    };
+
+    for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); ++s) {
+        if (streams[s]) {
+            memory_free(streams[s]);
+        }
+    }
+
+    scene->nodes = (scene_nodes_t){
+        .first_free = HANDLE_INVALID_ID
+    };
+}
+
+static bool grow_stream(void** stream, size_t size, uint32_t capacity) {
+    void* grown = memory_realloc(*stream, size * capacity);
+    if (!grown) {
+        return false;
+    }
+
+    *stream = grown;
+    return true;
+}
+
+// streams which could grow keep their new size, even if
+// others could not, as the capacity is that of the smallest
+static bool reserve_nodes(scene_nodes_t* nodes, uint32_t count) {
+    if (count <= nodes->capacity) {
+        return true;
+    }
+
+    if (count > SCENE_MAX_NODES) {
+        return false;
+    }
+
+    uint32_t capacity = nodes->capacity ? nodes->capacity : SCENE_MIN_NODES;
+    while (capacity < count) {
+        capacity *= 2;
+    }
+
+    capacity = (capacity < SCENE_MAX_NODES) ? capacity : SCENE_MAX_NODES;
+    if (!grow_stream((void**)&nodes->transforms, sizeof(transform_t), capacity)
+        || !grow_stream((void**)&nodes->parents, sizeof(node_id_t), capacity)
+        || !grow_stream((void**)&nodes->models, sizeof(model_id_t), capacity)
+        || !grow_stream((void**)&nodes->colors, sizeof(vec4f_t), capacity)
+        || !grow_stream((void**)&nodes->tiles, sizeof(vec4f_t), capacity)
+        || !grow_stream((void**)&nodes->lods, sizeof(int32_t), capacity)
+        || !grow_stream((void**)&nodes->traces, sizeof(trace_t), capacity)
+        || !grow_stream((void**)&nodes->next_free, sizeof(int32_t), capacity)
+        || !grow_stream((void**)&nodes->ranks, sizeof(int32_t), capacity)
+        || !grow_stream((void**)&nodes->order, sizeof(int32_t), capacity)
+        || !grow_stream((void**)&nodes->parent_ranks, sizeof(int32_t), capacity)
+        || !grow_stream((void**)&nodes->poses, sizeof(mat4f_t), capacity)
+        || !grow_stream((void**)&nodes->spheres, sizeof(sphere_t), capacity)
+        || !grow_stream((void**)&nodes->boxes, sizeof(box_t), capacity)
+        || !grow_stream((void**)&nodes->dirty, sizeof(bool), capacity)) {
+        LOG_WARN("WARN: Cannot grow the scene nodes to %u\n", capacity);
+        return false;
+    }
+
+    nodes->capacity = capacity;
+    return true;
+}
+
+static bool node_is_alive(const scene_nodes_t* nodes, int32_t node) {
+    return node >= 0 && (uint32_t)node < nodes->num_slots
+        && nodes->next_free[node] == SCENE_NODE_ALIVE;
+}
+
+// free slots first, then fresh ones, which must have been reserved
+static node_id_t take_slot(scene_nodes_t* nodes) {
+    node_id_t node_id = {.id = nodes->first_free};
+    if (node_id.id != HANDLE_INVALID_ID) {
+        nodes->first_free = nodes->next_free[node_id.id];
+    }
+    else {
+        assert(nodes->num_slots < nodes->capacity);
+        node_id.id = (int32_t)nodes->num_slots++;
+    }
+
+    nodes->next_free[node_id.id] = SCENE_NODE_ALIVE;
+    ++nodes->num_nodes;
+    return node_id;
+}
+
+// close the holes left by removed nodes, in a single pass keeping
+// the order, where parents are moved before their children are
+static void compact_ranks(scene_nodes_t* nodes) {
+    uint32_t count = 0;
+    for (uint32_t r = 0; r < nodes->num_ranks; ++r) {
+        int32_t n = nodes->order[r];
+        if (n == HANDLE_INVALID_ID) {
+            continue;
+        }
+
+        if (count != r) {
+            nodes->order[count] = n;
+            nodes->poses[count] = nodes->poses[r];
+            nodes->spheres[count] = nodes->spheres[r];
+            nodes->boxes[count] = nodes->boxes[r];
+            nodes->dirty[count] = nodes->dirty[r];
+        }
+
+        int32_t parent = nodes->parents[n].id;
+        nodes->parent_ranks[count] = (parent == HANDLE_INVALID_ID)
+            ? -1 : nodes->ranks[parent];
+        nodes->ranks[n] = (int32_t)count++;
+    }
+
+    nodes->num_ranks = count;
+}
+
+// nodes are ranked last, after their parent
+static void init_node(scene_t* scene, node_id_t node_id,
+    const node_desc_t* desc, node_id_t parent) {
+    scene_nodes_t* nodes = &scene->nodes;
+    int32_t n = node_id.id;
+    nodes->transforms[n] = desc->transform;
+    nodes->parents[n] = parent;
+    nodes->models[n] = desc->model;
+    nodes->colors[n] = desc->color;
+    nodes->tiles[n] = desc->tile;
+    nodes->lods[n] = 0;
+    trace_printf(&nodes->traces[n], "%s", desc->label ? desc->label : "");
+
+    assert(nodes->num_ranks < nodes->capacity);
+    int32_t r = (int32_t)nodes->num_ranks++;
+    nodes->ranks[n] = r;
+    nodes->order[r] = n;
+    nodes->parent_ranks[r] = (parent.id == HANDLE_INVALID_ID)
+        ? -1 : nodes->ranks[parent.id];
+    nodes->poses[r] = smat4_identity();
+    nodes->spheres[r] = (sphere_t){0};
+    nodes->boxes[r] = (box_t){0};
+    nodes->dirty[r] = true;
+    nodes->changed = true;
+}
+
+// if the parent node is empty, then,
+// detach and add the node to root.
+static node_id_t valid_parent(const scene_t* scene, node_id_t parent) {
+    if (node_is_alive(&scene->nodes, parent.id)) {
+        return parent;
     }
+
+    return (node_id_t){.id = HANDLE_INVALID_ID};
 }
 
 node_id_t scene_add_node(scene_t* scene, const node_desc_t* desc) {
     assert(scene && desc);
 
-    node_id_t node_id = {
-        .id = HANDLE_INVALID_ID
-    };
+    node_id_t node_id;
+    if (!scene_add_nodes(scene, desc, NULL, 1, &node_id)) {
+        return (node_id_t){.id = HANDLE_INVALID_ID};
+    }
 
-    // search for an empty slot
-    for (int32_t i = 0; i < SCENE_MAX_NODES; ++i) {
+    return node_id;
+}
 
-        // if we find an empty slot, store the index and break the loop
-        if (node_is_empty(&scene->nodes[i])) {
-            node_id.id = i;
-            break;
+bool scene_add_nodes(scene_t* scene, const node_desc_t* descs,
+    const int32_t* parent_indices, uint32_t count, node_id_t* out_nodes) {
+    assert(scene && (descs || count == 0) && out_nodes);
+
+    // fresh slots needed once the free ones are taken
+    scene_nodes_t* nodes = &scene->nodes;
+    uint32_t num_free = nodes->num_slots - nodes->num_nodes;
+    uint32_t num_fresh = (count > num_free) ? count - num_free : 0;
+    if ((uint64_t)nodes->num_slots + num_fresh > SCENE_MAX_NODES
+        || !reserve_nodes(nodes, nodes->num_slots + num_fresh)) {
+        for (uint32_t n = 0; n < count; ++n) {
+            out_nodes[n].id = HANDLE_INVALID_ID;
         }
+
+        return false;
     }
 
-    // no free slot available
-    if (node_id.id == HANDLE_INVALID_ID) {
-        return node_id;
+    // there is always room for the live nodes
+    if (nodes->num_ranks + count > nodes->capacity) {
+        compact_ranks(nodes);
     }
 
-    // if the parent node is empty, then,
-    // detach and add this node to root.
-    node_id_t parent = {.id = HANDLE_INVALID_ID};
-    if (handle_is_valid(desc->parent, SCENE_MAX_NODES)
-        && !node_is_empty(&scene->nodes[desc->parent.id])) {
-        parent = desc->parent;
+    for (uint32_t n = 0; n < count; ++n) {
+        int32_t parent_index = parent_indices ? parent_indices[n] : -1;
+        assert(parent_index < (int32_t)n);
+
+        // parents are resolved before the slot is taken,
+        // as a free slot could otherwise be its own parent
+        node_id_t parent = (parent_index >= 0)
+            ? out_nodes[parent_index]
+            : valid_parent(scene, descs[n].parent);
+        out_nodes[n] = take_slot(nodes);
+        init_node(scene, out_nodes[n], &descs[n], parent);
     }
 
-    node_t *node = &scene->nodes[node_id.id];
-    *node = (node_t){
-        .model_id = desc->model,
-        .transform = desc->transform,
-        .color = desc->color,
-        .tile = desc->tile,
-        .parent_id = parent
-    };
+    return true;
+}
 
-    trace_printf(&node->trace, desc->label);
-    return node_id;
+static void free_node(scene_nodes_t* nodes, int32_t node) {
+    // its model loses an instance
+    if (handle_is_valid(nodes->models[node], GEOMETRY_PASS_MAX_MODELS)) {
+        nodes->model_dirty[nodes->models[node].id] = true;
+    }
+
+    // leave a hole in the order
+    nodes->order[nodes->ranks[node]] = HANDLE_INVALID_ID;
+    nodes->ranks[node] = HANDLE_INVALID_ID;
+
+    // free node's slot
+    nodes->parents[node].id = HANDLE_INVALID_ID;
+    nodes->models[node].id = HANDLE_INVALID_ID;
+    nodes->transforms[node] = transform_default;
+    nodes->next_free[node] = nodes->first_free;
+    nodes->first_free = node;
+    --nodes->num_nodes;
 }
 
 void scene_remove_node(scene_t* scene, node_id_t node, bool recursive) {
     assert(scene);
 
-    if (handle_is_valid(node, SCENE_MAX_NODES)) {
-        node_t* node_ptr = &scene->nodes[node.id];
-        if (!node_is_empty(node_ptr)) {
-            node_id_t parent = node_ptr->parent_id;
-
-            // search for all nodes that have this as parent
-            for (int32_t i = 0; i < SCENE_MAX_NODES; ++i) {
-                if (i != node.id) {
-                    node_t* child_ptr = &scene->nodes[i];
-                    if (child_ptr->parent_id.id == node.id) {           
-                        if (recursive) {
-                            // remove all the children if requested
-                            scene_remove_node(scene, (node_id_t){.id=i}, true);
-                        }
-                        else {
-                            // reattach the child to the parent of this node
-                            child_ptr->parent_id = parent;
-                        }
-                    }
-                }
-            }
+    scene_nodes_t* nodes = &scene->nodes;
+    if (!node_is_alive(nodes, node.id)) {
+        return;
+    }
+
+    int32_t rank = nodes->ranks[node.id];
+    node_id_t parent = nodes->parents[node.id];
+    int32_t parent_rank = nodes->parent_ranks[rank];
+    free_node(nodes, node.id);
+    nodes->changed = true;
+
+    // descendants are ranked after the node, and their parents before
+    // them, so that a single pass finds all of them. live nodes whose
+    // parent has no node left lost it to this removal.
+    for (uint32_t r = (uint32_t)rank + 1; r < nodes->num_ranks; ++r) {
+        int32_t n = nodes->order[r];
+        int32_t pr = nodes->parent_ranks[r];
+        if (n == HANDLE_INVALID_ID || pr < rank
+            || nodes->order[pr] != HANDLE_INVALID_ID) {
+            continue;
+        }
 
-            // free node's slot
-            *node_ptr = node_empty;
+        if (recursive) {
+            // remove all the children if requested
+            free_node(nodes, n);
+        }
+        else if (pr == rank) {
+            // reattach the child to the parent of this node
+            nodes->parents[n] = parent;
+            nodes->parent_ranks[r] = parent_rank;
+            nodes->dirty[r] = true;
         }
     }
 }
 
 bool scene_node_is_alive(const scene_t* scene, node_id_t node) {
     assert(scene);
+    return node_is_alive(&scene->nodes, node.id);
+}
 
-    if (handle_is_valid(node, SCENE_MAX_NODES)) {
-        const node_t* node_ptr = &scene->nodes[node.id];
-        return !node_is_empty(node_ptr);
-    }
+void scene_set_node_transform(scene_t* scene, node_id_t node,
+    transform_t transform) {
+    assert(scene);
 
-    return false;
+    scene_nodes_t* nodes = &scene->nodes;
+    if (node_is_alive(nodes, node.id)) {
+        nodes->transforms[node.id] = transform;
+        nodes->dirty[nodes->ranks[node.id]] = true;
+        nodes->changed = true;
+    }
 }
 
-typedef struct {
-    mat4f_t pose;
-    transform_t transform;
-    vec4f_t color;
-    vec4f_t tile;
-    node_id_t node;
-    node_id_t parent;
-    model_id_t model;
-} node_link_t;
+transform_t scene_get_node_transform(const scene_t* scene, node_id_t node) {
+    assert(scene);
+
+    const scene_nodes_t* nodes = &scene->nodes;
+    return node_is_alive(nodes, node.id)
+        ? nodes->transforms[node.id] : transform_default;
+}
 
 typedef struct {
     instance_t instances[GEOMETRY_PASS_MAX_INSTANCES];
+    int32_t lods[GEOMETRY_PASS_MAX_INSTANCES];
     int32_t instances_count;
 } bucket_t;
 
-static int32_t node_link_compare(const void* a, const void* b) {
-    const node_link_t* a_link = a;
-    const node_link_t* b_link = b;
-    return a_link->parent.id - b_link->parent.id;
+static vec3f_t transform_point(const mfloat_t* m, vec3f_t p) {
+    return (vec3f_t){
+        .x = m[0] * p.x + m[4] * p.y + m[8] * p.z + m[12],
+        .y = m[1] * p.x + m[5] * p.y + m[9] * p.z + m[13],
+        .z = m[2] * p.x + m[6] * p.y + m[10] * p.z + m[14]
+    };
 }
 
-static void update_instances(const scene_t* scene, geometry_pass_t* pass) {
-    node_link_t links[SCENE_MAX_NODES] = {0};
-    int32_t nodes_count = 0;
-
-    // copy nodes to the link array
-    for (int32_t i = 0; i < SCENE_MAX_NODES; ++i) {
-        const node_t* node_ptr = &scene->nodes[i];
-        if (!node_is_empty(node_ptr)) {
-            links[nodes_count] = (node_link_t){
-                .transform = node_ptr->transform,
-                .color = node_ptr->color,
-                .tile = node_ptr->tile,
-                .node = (node_id_t){.id=i},
-                .model = node_ptr->model_id,
-                .parent = node_ptr->parent_id
-            };
-
-            ++nodes_count;
+// bounds of the model placed by the pose, the sphere being scaled by
+// the largest axis scale, and the box being the one around the placed
+// box, whose extents are those of the absolute axes
+static void place_bounds(const mat4f_t* pose, const model_t* model,
+    sphere_t* out_sphere, box_t* out_box) {
+    const mfloat_t* m = pose->v;
+    mfloat_t scale = 0.f;
+    for (int32_t c = 0; c < 3; ++c) {
+        mfloat_t axis = svec3_length(svec3(m[4 * c], m[4 * c + 1], m[4 * c + 2]));
+        scale = (axis > scale) ? axis : scale;
+    }
+
+    *out_sphere = (sphere_t){
+        .center = transform_point(m, model->bsphere.center),
+        .radius = model->bsphere.radius * scale
+    };
+
+    vec3f_t e = model->bbox.extents;
+    *out_box = (box_t){
+        .center = transform_point(m, model->bbox.center),
+        .extents = {
+            .x = MFABS(m[0]) * e.x + MFABS(m[4]) * e.y + MFABS(m[8]) * e.z,
+            .y = MFABS(m[1]) * e.x + MFABS(m[5]) * e.y + MFABS(m[9]) * e.z,
+            .z = MFABS(m[2]) * e.x + MFABS(m[6]) * e.y + MFABS(m[10]) * e.z
         }
+    };
+}
+
+// radius of the bounds in clip space, relative to half the viewport
+static mfloat_t projected_size(const sphere_t* bounds, const mat4f_t* proj,
+    vec3f_t eye_pos) {
+    // orthographic projections do not depend on distance
+    if (proj->m44 != 0.f) {
+        return bounds->radius * proj->m22;
     }
 
-    // early exit if no nodes in the scene
-    if (nodes_count == 0) {
+    mfloat_t distance = svec3_distance(bounds->center, eye_pos);
+    return (distance > bounds->radius)
+        ? bounds->radius * proj->m22 / distance
+        : FLT_MAX;
+}
+
+// coarsest level whose switch size the node is below of,
+// where the switch sizes are moved away from the current level
+static int32_t select_lod(mfloat_t size, int32_t current_lod) {
+    int32_t lod = 0;
+    mfloat_t switch_size = SCENE_LOD_SCREEN_SIZE;
+    while (lod + 1 < GEOMETRY_PASS_MAX_LODS) {
+        mfloat_t hysteresis = (lod + 1 <= current_lod)
+            ? 1.f + SCENE_LOD_HYSTERESIS
+            : 1.f - SCENE_LOD_HYSTERESIS;
+        if (size >= switch_size * hysteresis) {
+            break;
+        }
+
+        switch_size *= .5f;
+        ++lod;
+    }
+
+    return lod;
+}
+
+// poses of the moved nodes of consecutive ranks, whose local
+// poses are composed at once, and then transformed into model
+// space by multiplying them by their parent pose, in as few
+// batches as possible, each of them after those of the parents
+static void compose_poses(scene_t* scene, uint32_t begin, uint32_t end) {
+    scene_nodes_t* nodes = &scene->nodes;
+    mat4s_from_transforms(nodes->transforms, nodes->order + begin,
+        end - begin, nodes->poses + begin);
+
+    uint32_t first = begin;
+    for (uint32_t r = begin + 1; r <= end; ++r) {
+        if (r == end || nodes->parent_ranks[r] >= (int32_t)first) {
+            mat4s_multiply_parents(nodes->poses, nodes->parent_ranks + first,
+                &scene->root, nodes->poses + first, r - first,
+                nodes->poses + first);
+            first = r;
+        }
+    }
+}
+
+static void update_instances(scene_t* scene, geometry_pass_t* pass,
+    const mat4f_t* proj, const frustum_t* frustum) {
+    scene_nodes_t* nodes = &scene->nodes;
+
+    // every pose moves along with the root, and every level
+    // of detail, and cluster, depends on the view
+    bool root_moved = memcmp(&scene->root, &nodes->root, sizeof(mat4f_t)) != 0;
+    bool view_moved = memcmp(&pass->globals.view_proj, &nodes->view_proj,
+        sizeof(mat4f_t)) != 0;
+
+    // models whose instances are submitted again
+    bool model_dirty[GEOMETRY_PASS_MAX_MODELS];
+    bool any_model_dirty = false;
+    for (int32_t m = 0; m < GEOMETRY_PASS_MAX_MODELS; ++m) {
+        model_dirty[m] = nodes->model_dirty[m] || view_moved
+            || pass->models[m].revision != nodes->model_revisions[m];
+        any_model_dirty |= model_dirty[m];
+    }
+
+    // nothing to do for still scenes seen from the same point
+    if (!nodes->changed && !root_moved && !any_model_dirty) {
         return;
     }
 
-    // sort link array by parent id, this way
-    // the transformation of a parent will always be
-    // up to date when computing ita children ones.
-    qsort(links, nodes_count, sizeof(node_link_t), node_link_compare);
+    if (nodes->num_ranks != nodes->num_nodes) {
+        compact_ranks(nodes);
+    }
+
+    // dirtiness goes down the hierarchy along with the transformation,
+    // parents come first, therefore, their flag is always up to date
+    for (uint32_t r = 0; r < nodes->num_ranks; ++r) {
+        int32_t parent_rank = nodes->parent_ranks[r];
+        nodes->dirty[r] = nodes->dirty[r] || root_moved
+            || (parent_rank >= 0 && nodes->dirty[parent_rank]);
+    }
 
-    // while traversing the links list bucket
-    // bucket for later render procerssing
-    bucket_t buckets[GEOMETRY_PASS_MAX_MODELS] = {0};
+    // calculate affine transformation for each node moved,
+    // in batches of consecutive ranks
+    for (uint32_t begin = 0; begin < nodes->num_ranks;) {
+        if (!nodes->dirty[begin]) {
+            ++begin;
+            continue;
+        }
 
-    // calculate affine transformation for each node
-    for (int32_t l = 0; l < nodes_count; ++l) {
-        node_link_t* link = &links[l];
-    
-        mat4f_t local_pose = transform_to_mat4(link->transform);
+        uint32_t end = begin + 1;
+        while (end < nodes->num_ranks && nodes->dirty[end]
+            && end - begin < SCENE_POSE_BATCH) {
+            ++end;
+        }
+
+        compose_poses(scene, begin, end);
+        begin = end;
+    }
 
-        // transform local pose into model space
-        // by multiplying it by its parent pose
-        if (!handle_is_valid(link->parent, SCENE_MAX_NODES)) {
-            link->pose = smat4_multiply(scene->root, local_pose);
+    for (uint32_t r = 0; r < nodes->num_ranks; ++r) {
+        // nodes without model only place their children
+        int32_t n = nodes->order[r];
+        model_id_t model = nodes->models[n];
+        if (!handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)
+            || (!nodes->dirty[r] && !model_dirty[model.id])) {
+            continue;
         }
-        else {
-            // because node links have been sorted by parent id
-            // we need to find the node that corresponds to the
-            // parent we are looking for
-            for (int32_t n = 0; n < SCENE_MAX_NODES; ++n) {
-                const node_link_t* elem = &links[n];
-                if (elem->node.id == link->parent.id) {
-                    link->pose = smat4_multiply(elem->pose, local_pose);
-                    break;
-                }
-            }
+
+        place_bounds(&nodes->poses[r], &pass->models[model.id],
+            &nodes->spheres[r], &nodes->boxes[r]);
+        model_dirty[model.id] = true;
+    }
+
+    for (int32_t m = 0; m < GEOMETRY_PASS_MAX_MODELS; ++m) {
+        if (model_dirty[m]) {
+            nodes->model_visible[m] = nodes->model_culled[m] = 0;
+            nodes->model_dropped[m] = 0;
         }
+    }
 
-        // set instance data for render model
-        assert(handle_is_valid(link->model, GEOMETRY_PASS_MAX_MODELS));
-        bucket_t* bucket = &buckets[link->model.id];
-        bucket->instances[bucket->instances_count++] = (instance_t){
-            .color = link->color,
-            .uv_scale_pan = link->tile,
-            .pose = link->pose,
-            .normal = smat4_transpose(smat4_inverse(link->pose))
-        };
+    // while traversing the nodes, bucket the visible instances of the
+    // dirty models, only, whose bounds are tested a batch at a time.
+    // the bounds of the other nodes are stale, but never used.
+    bucket_t buckets[GEOMETRY_PASS_MAX_MODELS] = {0};
+    bool visible[SCENE_CULL_BATCH];
+    for (uint32_t begin = 0; begin < nodes->num_ranks;
+        begin += SCENE_CULL_BATCH) {
+        uint32_t end = (nodes->num_ranks - begin > SCENE_CULL_BATCH)
+            ? begin + SCENE_CULL_BATCH : nodes->num_ranks;
+        frustum_test_bounds(frustum, nodes->spheres + begin,
+            nodes->boxes + begin, end - begin, visible);
+
+        for (uint32_t r = begin; r < end; ++r) {
+            nodes->dirty[r] = false;
+
+            int32_t n = nodes->order[r];
+            model_id_t model = nodes->models[n];
+            if (!handle_is_valid(model, GEOMETRY_PASS_MAX_MODELS)
+                || !model_dirty[model.id]) {
+                continue;
+            }
+
+            if (!visible[r - begin]) {
+                ++nodes->model_culled[model.id];
+                continue;
+            }
+
+            // level of detail by the size on screen, which is
+            // remembered by the node, to switch with hysteresis
+            nodes->lods[n] = select_lod(projected_size(&nodes->spheres[r],
+                proj, scene->camera.eye_pos), nodes->lods[n]);
+
+            // set instance data for render model, as long as it has
+            // room for them, the rest are counted, but not drawn
+            bucket_t* bucket = &buckets[model.id];
+            if (bucket->instances_count == GEOMETRY_PASS_MAX_INSTANCES) {
+                ++nodes->model_dropped[model.id];
+                continue;
+            }
+
+            bucket->lods[bucket->instances_count] = nodes->lods[n];
+            bucket->instances[bucket->instances_count++] =
+                geometry_pass_pack_instance(&nodes->poses[r],
+                    nodes->colors[n], nodes->tiles[n]);
+            ++nodes->model_visible[model.id];
+        }
     }
 
-    // upload instance data to geometry pass
+    // upload instance data to geometry pass, sorted by level of
+    // detail, for dirty models, even if they have none left
     for (int32_t b = 0; b < GEOMETRY_PASS_MAX_MODELS; ++b) {
         const bucket_t* bucket = &buckets[b];
-        if (bucket->instances_count > 0) {
-            geometry_pass_update_model_instances(pass, (model_id_t){.id=b},
-                bucket->instances, bucket->instances_count);
+        if (!model_dirty[b] || pass->models[b].num_draws == 0) {
+            continue;
+        }
+
+        uint32_t lod_counts[GEOMETRY_PASS_MAX_LODS] = {0};
+        for (int32_t i = 0; i < bucket->instances_count; ++i) {
+            ++lod_counts[bucket->lods[i]];
+        }
+
+        uint32_t lod_offsets[GEOMETRY_PASS_MAX_LODS] = {0};
+        for (int32_t l = 1; l < GEOMETRY_PASS_MAX_LODS; ++l) {
+            lod_offsets[l] = lod_offsets[l - 1] + lod_counts[l - 1];
         }
+
+        instance_t sorted[GEOMETRY_PASS_MAX_INSTANCES];
+        for (int32_t i = 0; i < bucket->instances_count; ++i) {
+            sorted[lod_offsets[bucket->lods[i]]++] = bucket->instances[i];
+        }
+
+        geometry_pass_update_model_lod_instances(pass, (model_id_t){.id=b},
+            sorted, lod_counts);
+    }
+
+    memset(nodes->model_dirty, 0, sizeof(nodes->model_dirty));
+    uint32_t num_dropped = nodes->num_dropped;
+    nodes->num_visible = nodes->num_culled = nodes->num_dropped = 0;
+    for (int32_t m = 0; m < GEOMETRY_PASS_MAX_MODELS; ++m) {
+        nodes->model_revisions[m] = pass->models[m].revision;
+        nodes->num_visible += nodes->model_visible[m];
+        nodes->num_culled += nodes->model_culled[m];
+        nodes->num_dropped += nodes->model_dropped[m];
+    }
+
+    // only when it changes, not to repeat it every frame the view moves
+    if (nodes->num_dropped > 0 && nodes->num_dropped != num_dropped) {
+        LOG_WARN("WARN: Too many instances in view, %u not drawn\n",
+            nodes->num_dropped);
     }
+
+    nodes->root = scene->root;
+    nodes->view_proj = pass->globals.view_proj;
+    nodes->changed = false;
 }
 
-void scene_update_geometry_pass(const scene_t* scene, geometry_pass_t* pass) {
+void scene_update_geometry_pass(scene_t* scene, geometry_pass_t* pass) {
     assert(scene && pass);
 
     mat4f_t proj = smat4_identity();
@@ -280,7 +631,9 @@ void scene_update_geometry_pass(const scene_t* scene, geometry_pass_t* pass) {
         .eye_pos = scene->camera.eye_pos,
     };
 
-    update_instances(scene, pass);
+    // in scene space, as the poses are
+    frustum_t frustum = frustum_from_matrix(pass->globals.view_proj);
+    update_instances(scene, pass, &proj, &frustum);
 }
 
 #if defined(__cplusplus)
@@ -7,7 +7,17 @@
 #include "viewer_math.h"
 #include "viewer_geometry_pass.h"
 
-#define SCENE_MAX_NODES 128     // Max number of objects per scene
+#define SCENE_MAX_NODES (1 << 24)   // Max number of objects per scene
+#define SCENE_MIN_NODES 128         // initial capacity of the node streams
+#define SCENE_NODE_ALIVE (-2)       // free list link of the live nodes
+
+// nodes are drawn with the next coarser level of detail every time
+// their projected bounding radius, relative to half the viewport
+// height, halves below this size. the hysteresis widens each switch
+// size in the direction of the current level, to avoid popping back
+// and forth when the size hovers around it.
+#define SCENE_LOD_SCREEN_SIZE 0.5f
+#define SCENE_LOD_HYSTERESIS 0.1f
 
 #if defined(__cplusplus)
 extern "C" {
@@ -27,21 +37,64 @@ typedef struct {
     trace_t trace;
 } shape_t;
 
+// nodes are stored as structure of arrays, one stream per attribute,
+// so that updates only touch the streams they need. streams grow
+// together, doubling their capacity, and the slots of removed nodes
+// are linked in a free list, reused first, so that nodes are added
+// and removed in constant time.
+// slot streams are indexed by node id, while rank streams follow the
+// hierarchy order, where parents always come before their children,
+// and which refer to their parents by rank. nodes are appended to the
+// order, whose parents are already in it, and leave holes when
+// removed, which are closed by the next update.
+// poses are only recomputed for the nodes moved since the last update,
+// and their subtrees, and instances only submitted for the models of
+// the nodes moved, added or removed, unless the view or root changed.
+// instances whose bounds are outside of the view are not submitted.
 typedef struct {
-    transform_t transform;
+    // slot streams
+    transform_t* transforms;
+    node_id_t* parents;
+    model_id_t* models;
 
     // @note:
     // texture tile information is already part of the cluster,
     // while the color is deprecated, and both should be removed.
     // as a replacement, the node should keep a list of shapes.
     // e.g. shape_t shapes[SCENE_MAX_NODE_SHAPES]
-    vec4f_t color;
-    vec4f_t tile;
-    
-    model_id_t model_id;
-    node_id_t parent_id;
-    trace_t trace;
-} node_t;
+    vec4f_t* colors;
+    vec4f_t* tiles;
+
+    int32_t* lods;          // level of detail of the last update
+    trace_t* traces;
+    int32_t* next_free;     // next free slot, SCENE_NODE_ALIVE if taken
+    int32_t* ranks;         // in the hierarchy order
+
+    // rank streams
+    int32_t* order;         // node of each rank, HANDLE_INVALID_ID if none
+    int32_t* parent_ranks;  // -1 for roots
+    mat4f_t* poses;         // in scene space, of the last update
+    sphere_t* spheres;      // model bounds, in scene space too
+    box_t* boxes;
+    bool* dirty;            // moved since the last update
+
+    uint32_t capacity;
+    uint32_t num_slots;     // slots ever taken, free or not
+    uint32_t num_nodes;     // live nodes
+    uint32_t num_ranks;     // ranks taken, holes included
+    int32_t first_free;     // HANDLE_INVALID_ID if none
+    bool changed;           // nodes added, removed or moved since
+    bool model_dirty[GEOMETRY_PASS_MAX_MODELS];   // instances removed
+    uint32_t model_revisions[GEOMETRY_PASS_MAX_MODELS]; // submitted for
+    uint32_t model_visible[GEOMETRY_PASS_MAX_MODELS];   // instances submitted
+    uint32_t model_culled[GEOMETRY_PASS_MAX_MODELS];    // outside of the view
+    uint32_t model_dropped[GEOMETRY_PASS_MAX_MODELS];   // in it, past the max
+    uint32_t num_visible;   // instances of all the models
+    uint32_t num_culled;
+    uint32_t num_dropped;
+    mat4f_t root;           // of the last update
+    mat4f_t view_proj;
+} scene_nodes_t;
 
 typedef struct {
     vec3f_t target;
@@ -61,12 +114,14 @@ typedef struct {
 } light_t;
 
 typedef struct {
-    node_t nodes[SCENE_MAX_NODES];
+    scene_nodes_t nodes;
     camera_t camera;
     light_t light;
     mat4f_t root;
 } scene_t;
 
+// the node streams are allocated as nodes are added,
+// and only released by scene_cleanup.
 void scene_init(scene_t* scene);
 void scene_cleanup(scene_t* scene);
 
@@ -80,10 +135,29 @@ typedef struct {
 } node_desc_t;
 
 node_id_t scene_add_node(scene_t* scene, const node_desc_t* desc);
+
+/**
+ * Add count nodes at once, growing the streams once for all of them,
+ * which are all added, or none if there is no room for them all. The
+ * parent of each node is either the index, in parent_indices, of one
+ * of those added along with it, which must come before it, or, if it
+ * is -1, or parent_indices is NULL, the desc parent, already in the
+ * scene. out_nodes receives the ids of the nodes, in the descs order.
+ */
+bool scene_add_nodes(scene_t* scene, const node_desc_t* descs,
+    const int32_t* parent_indices, uint32_t count, node_id_t* out_nodes);
+
 void scene_remove_node(scene_t* scene, node_id_t node, bool recursive);
 bool scene_node_is_alive(const scene_t* scene, node_id_t node);
 
-void scene_update_geometry_pass(const scene_t* scene, geometry_pass_t* pass);
+// transforms must be set through here, rather than in the stream,
+// for the node and its subtree to be moved by the next update
+void scene_set_node_transform(scene_t* scene, node_id_t node,
+    transform_t transform);
+transform_t scene_get_node_transform(const scene_t* scene, node_id_t node);
+
+// nodes levels of detail are selected by their projected size
+void scene_update_geometry_pass(scene_t* scene, geometry_pass_t* pass);
 
 #if defined(__cplusplus)
 } // extern "C"
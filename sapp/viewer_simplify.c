@@ -0,0 +1,356 @@
+#include "viewer_simplify.h"
+#include "viewer_memory.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SIMPLIFY_MAX_PASSES 32
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// symmetric 4x4 matrix, accumulating the squared distances
+// from the planes of the triangles around a vertex.
+typedef struct {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+} quadric_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+} collapse_t;
+
+static void quadric_add(quadric_t* q, const quadric_t* other) {
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+}
+
+static void quadric_from_plane(quadric_t* q, double a, double b,
+    double c, double d, double weight) {
+    *q = (quadric_t){
+        .a2 = weight * a * a, .ab = weight * a * b,
+        .ac = weight * a * c, .ad = weight * a * d,
+        .b2 = weight * b * b, .bc = weight * b * c, .bd = weight * b * d,
+        .c2 = weight * c * c, .cd = weight * c * d,
+        .d2 = weight * d * d
+    };
+}
+
+static double quadric_error(const quadric_t* q, vec3f_t p) {
+    double x = p.x, y = p.y, z = p.z;
+    double error = q->a2 * x * x + 2. * q->ab * x * y + 2. * q->ac * x * z
+        + 2. * q->ad * x + q->b2 * y * y + 2. * q->bc * y * z + 2. * q->bd * y
+        + q->c2 * z * z + 2. * q->cd * z + q->d2;
+    return error < 0. ? 0. : error;
+}
+
+static vec3f_t triangle_normal(vec3f_t p0, vec3f_t p1, vec3f_t p2) {
+    return svec3_cross(svec3_subtract(p1, p0), svec3_subtract(p2, p0));
+}
+
+static int32_t edge_compare(const void* a, const void* b) {
+    uint64_t ea = *(const uint64_t*)a;
+    uint64_t eb = *(const uint64_t*)b;
+    return (ea > eb) - (ea < eb);
+}
+
+static int32_t collapse_compare(const void* a, const void* b) {
+    float ca = ((const collapse_t*)a)->cost;
+    float cb = ((const collapse_t*)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+// undirected edge key, the smaller vertex in the high bits
+static uint64_t edge_key(uint32_t a, uint32_t b) {
+    return (a < b)
+        ? ((uint64_t)a << 32) | b
+        : ((uint64_t)b << 32) | a;
+}
+
+// collect the edges of the triangles, sorted and with repetitions
+static uint32_t collect_edges(const uint32_t* tris, uint32_t num_indices,
+    uint64_t* edges) {
+    for (uint32_t t = 0; t < num_indices; t += 3) {
+        edges[t + 0] = edge_key(tris[t + 0], tris[t + 1]);
+        edges[t + 1] = edge_key(tris[t + 1], tris[t + 2]);
+        edges[t + 2] = edge_key(tris[t + 2], tris[t + 0]);
+    }
+
+    qsort(edges, num_indices, sizeof(uint64_t), edge_compare);
+    return num_indices;
+}
+
+// triangles around each vertex, as a compressed list
+static void build_adjacency(const uint32_t* tris, uint32_t num_indices,
+    uint32_t num_vertices, uint32_t* offsets, uint32_t* adjacency) {
+    memset(offsets, 0, sizeof(uint32_t) * (num_vertices + 1));
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        ++offsets[tris[i] + 1];
+    }
+
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        offsets[v + 1] += offsets[v];
+    }
+
+    // fill while moving the offsets forward, then restore them
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        adjacency[offsets[tris[i]]++] = i / 3;
+    }
+
+    for (uint32_t v = num_vertices; v > 0; --v) {
+        offsets[v] = offsets[v - 1];
+    }
+
+    offsets[0] = 0;
+}
+
+// the collapse is rejected if any of the remaining triangles
+// around the vertex would flip, or degenerate to a sliver.
+static bool collapse_is_valid(uint32_t from, uint32_t to,
+    const vec3f_t* positions, const uint32_t* remap, const uint32_t* tris,
+    const uint32_t* offsets, const uint32_t* adjacency) {
+    for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a) {
+        const uint32_t* tri = &tris[3 * adjacency[a]];
+        uint32_t v[3] = {remap[tri[0]], remap[tri[1]], remap[tri[2]]};
+
+        // triangles on the edge are removed by the collapse
+        if (v[0] == to || v[1] == to || v[2] == to) {
+            continue;
+        }
+
+        vec3f_t before = triangle_normal(positions[v[0]],
+            positions[v[1]], positions[v[2]]);
+
+        for (int32_t k = 0; k < 3; ++k) {
+            v[k] = (v[k] == from) ? to : v[k];
+        }
+
+        vec3f_t after = triangle_normal(positions[v[0]],
+            positions[v[1]], positions[v[2]]);
+
+        if (svec3_dot(before, after) <= 0.f) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t simplify_mesh(const vec3f_t* points, size_t stride,
+    uint32_t num_points, const uint32_t* indices, uint32_t num_indices,
+    uint32_t target_indices, uint32_t* dst) {
+    assert(points && indices && dst);
+    assert(num_indices % 3 == 0);
+
+    if (num_indices <= target_indices) {
+        memmove(dst, indices, sizeof(uint32_t) * num_indices);
+        return num_indices;
+    }
+
+    // work on the vertices referenced by the triangles only
+    uint32_t max_vertices = (num_points < num_indices) ? num_points : num_indices;
+    int32_t* local_of = memory_malloc(sizeof(int32_t) * num_points);
+    uint32_t* globals = memory_malloc(sizeof(uint32_t) * max_vertices);
+    vec3f_t* positions = memory_malloc(sizeof(vec3f_t) * max_vertices);
+    quadric_t* quadrics = memory_calloc(max_vertices, sizeof(quadric_t));
+    uint8_t* locked = memory_calloc(max_vertices, sizeof(uint8_t));
+    uint8_t* touched = memory_malloc(sizeof(uint8_t) * max_vertices);
+    uint32_t* remap = memory_malloc(sizeof(uint32_t) * max_vertices);
+    uint32_t* offsets = memory_malloc(sizeof(uint32_t) * (max_vertices + 1));
+    uint32_t* tris = memory_malloc(sizeof(uint32_t) * num_indices);
+    uint32_t* adjacency = memory_malloc(sizeof(uint32_t) * num_indices);
+    uint64_t* edges = memory_malloc(sizeof(uint64_t) * num_indices);
+    collapse_t* collapses = memory_malloc(sizeof(collapse_t) * num_indices);
+
+    bool allocated = local_of && globals && tris && positions && quadrics
+        && locked && touched && remap && offsets && adjacency && edges
+        && collapses;
+
+    // without memory to simplify, return the triangles as they are
+    uint32_t num_tris_indices = num_indices;
+    if (!allocated) {
+        memmove(dst, indices, sizeof(uint32_t) * num_indices);
+        num_tris_indices = 0;
+    }
+    else {
+        memset(local_of, 0xFF, sizeof(int32_t) * num_points);
+    }
+
+    uint32_t num_vertices = 0;
+    for (uint32_t i = 0; i < num_tris_indices; ++i) {
+        uint32_t v = indices[i];
+        assert(v < num_points);
+        if (local_of[v] < 0) {
+            local_of[v] = (int32_t)num_vertices;
+            globals[num_vertices] = v;
+            positions[num_vertices] = *(const vec3f_t*)
+                ((const uint8_t*)points + v * stride);
+            ++num_vertices;
+        }
+
+        tris[i] = (uint32_t)local_of[v];
+    }
+
+    // area weighted quadrics of the triangles planes
+    for (uint32_t t = 0; t < num_tris_indices; t += 3) {
+        vec3f_t normal = triangle_normal(positions[tris[t + 0]],
+            positions[tris[t + 1]], positions[tris[t + 2]]);
+        mfloat_t length = svec3_length(normal);
+        if (length <= 0.f) {
+            continue;
+        }
+
+        normal = svec3_multiply_f(normal, 1.f / length);
+        quadric_t q;
+        quadric_from_plane(&q, normal.x, normal.y, normal.z,
+            -svec3_dot(normal, positions[tris[t]]), .5 * length);
+
+        for (int32_t k = 0; k < 3; ++k) {
+            quadric_add(&quadrics[tris[t + k]], &q);
+        }
+    }
+
+    // edges not shared by exactly two triangles are
+    // borders, or non-manifold, whose vertices stay put.
+    uint32_t num_edges = collect_edges(tris, num_tris_indices, edges);
+    for (uint32_t e = 0; e < num_edges;) {
+        uint32_t run = 1;
+        while (e + run < num_edges && edges[e + run] == edges[e]) {
+            ++run;
+        }
+
+        if (run != 2) {
+            locked[edges[e] >> 32] = 1;
+            locked[edges[e] & 0xFFFFFFFF] = 1;
+        }
+
+        e += run;
+    }
+
+    // each pass collapses the cheapest edges, touching every
+    // vertex at most once, then removes degenerate triangles.
+    for (uint32_t pass = 0; pass < SIMPLIFY_MAX_PASSES
+        && num_tris_indices > target_indices; ++pass) {
+        build_adjacency(tris, num_tris_indices, num_vertices,
+            offsets, adjacency);
+
+        num_edges = collect_edges(tris, num_tris_indices, edges);
+        uint32_t num_collapses = 0;
+        for (uint32_t e = 0; e < num_edges; ++e) {
+            if (e > 0 && edges[e] == edges[e - 1]) {
+                continue;
+            }
+
+            uint32_t a = (uint32_t)(edges[e] >> 32);
+            uint32_t b = (uint32_t)(edges[e] & 0xFFFFFFFF);
+            if (locked[a] && locked[b]) {
+                continue;
+            }
+
+            quadric_t q = quadrics[a];
+            quadric_add(&q, &quadrics[b]);
+
+            double cost_ab = locked[a] ? -1. : quadric_error(&q, positions[b]);
+            double cost_ba = locked[b] ? -1. : quadric_error(&q, positions[a]);
+            bool collapse_ab = cost_ba < 0. || (cost_ab >= 0. && cost_ab <= cost_ba);
+
+            collapses[num_collapses++] = (collapse_t){
+                .from = collapse_ab ? a : b,
+                .to = collapse_ab ? b : a,
+                .cost = (float)(collapse_ab ? cost_ab : cost_ba)
+            };
+        }
+
+        qsort(collapses, num_collapses, sizeof(collapse_t), collapse_compare);
+
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            remap[v] = v;
+        }
+
+        memset(touched, 0, sizeof(uint8_t) * num_vertices);
+
+        uint32_t removed = 0;
+        uint32_t collapsed = 0;
+        for (uint32_t c = 0; c < num_collapses
+            && num_tris_indices - removed > target_indices; ++c) {
+            uint32_t from = collapses[c].from;
+            uint32_t to = collapses[c].to;
+            if (touched[from] || touched[to]) {
+                continue;
+            }
+
+            if (!collapse_is_valid(from, to, positions, remap,
+                tris, offsets, adjacency)) {
+                continue;
+            }
+
+            // triangles sharing the edge are those removed
+            for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a) {
+                const uint32_t* tri = &tris[3 * adjacency[a]];
+                if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                    removed += 3;
+                }
+            }
+
+            remap[from] = to;
+            quadric_add(&quadrics[to], &quadrics[from]);
+            touched[from] = touched[to] = 1;
+            ++collapsed;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        uint32_t kept = 0;
+        for (uint32_t t = 0; t < num_tris_indices; t += 3) {
+            uint32_t v0 = remap[tris[t + 0]];
+            uint32_t v1 = remap[tris[t + 1]];
+            uint32_t v2 = remap[tris[t + 2]];
+            if (v0 != v1 && v1 != v2 && v2 != v0) {
+                tris[kept++] = v0;
+                tris[kept++] = v1;
+                tris[kept++] = v2;
+            }
+        }
+
+        num_tris_indices = kept;
+    }
+
+    if (allocated) {
+        for (uint32_t i = 0; i < num_tris_indices; ++i) {
+            dst[i] = globals[tris[i]];
+        }
+    }
+    else {
+        num_tris_indices = num_indices;
+    }
+
+    if (local_of) memory_free(local_of);
+    if (globals) memory_free(globals);
+    if (tris) memory_free(tris);
+    if (positions) memory_free(positions);
+    if (quadrics) memory_free(quadrics);
+    if (locked) memory_free(locked);
+    if (touched) memory_free(touched);
+    if (remap) memory_free(remap);
+    if (offsets) memory_free(offsets);
+    if (adjacency) memory_free(adjacency);
+    if (edges) memory_free(edges);
+    if (collapses) memory_free(collapses);
+
+    return num_tris_indices;
+}
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+/**
+ * Quadric error metric mesh simplification
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "viewer_math.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Reduce the triangles down to about target_indices, collapsing
+ * vertices onto their neighbours, in order of least quadric error.
+ * The result references a subset of the same vertices, therefore,
+ * it can share the vertex buffer with the source. Vertices on open
+ * borders are kept in place, so that adjacent pieces of a mesh,
+ * simplified separately, stay connected.
+ *
+ * @param points Vertex positions, stride bytes apart.
+ * @param dst Must have room for num_indices indices.
+ * @return The number of indices written to dst, which can be
+ *  greater than target_indices when no further collapse is allowed.
+ */
+uint32_t simplify_mesh(const vec3f_t* points, size_t stride,
+    uint32_t num_points, const uint32_t* indices, uint32_t num_indices,
+    uint32_t target_indices, uint32_t* dst);
+
+#if defined(__cplusplus)
+} // extern "C"
+#endif
@@ -16,6 +16,16 @@ typedef struct {
     
     uint32_t stored_frames;
     uint32_t max_frames;
+
+    // points of the point clouds drawn in the last frame, out of all
+    uint32_t drawn_points;
+    uint32_t total_points;
+
+    // scene nodes instances, drawn, culled, or in the view but past
+    // the max instances of their model, of the last update
+    uint32_t visible_nodes;
+    uint32_t culled_nodes;
+    uint32_t dropped_nodes;
 } stats_t;
 
 /**
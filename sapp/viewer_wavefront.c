@@ -1,11 +1,19 @@
 #include "viewer_wavefront.h"
 #include "viewer_file.h"
 #include "viewer_memory.h"
+#include "viewer_image.h"
 #include "viewer_log.h"
+#include "viewer_optimize.h"
 
 #include "tinyobj_loader_c.h"
+#include "texture_atlas.h"
+#include "cute_path.h"
+#include "stb_image.h"
+#include "stb_image_resize.h"
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(__cplusplus)
@@ -19,251 +27,3355 @@ static void __wf_print_shapes(tinyobj_shape_t* shapes, size_t num_shapes) {
     }
 }
 
-wavefront_result_t wavefront_parse_obj(const wavefront_data_t* data,
-    wavefront_model_t* model) {
-    assert(data && model);
-
-    tinyobj_attrib_t attribs;
-    
-    tinyobj_shape_t* shapes = NULL;
-    size_t num_shapes = 0;
+// tinyobj shapes are defined in surface lines units
+static uint32_t __wf_find_shape(const tinyobj_shape_t* shapes,
+    size_t num_shapes, uint32_t shape, uint32_t surface_line) {
+    while (shape + 1 < num_shapes &&
+        surface_line >= shapes[shape].face_offset + shapes[shape].length) {
+        ++shape;
+    }
 
-    tinyobj_material_t* materials = NULL;
-    size_t num_materials = 0;
+    return shape;
+}
 
-    // load wavefront data
-    {
-        if (!(data->import_options & WAVEFRONT_IMPORT_TRIANGULATE)) {
-            LOG_WARN("WARN: Non triangulated is not supported yet¬\n");
-            return WAVEFRONT_RESULT_INVALID_OBJECT;
+// opens a new shape, growing the shapes array as needed
+static wavefront_shape_t* __wf_push_shape(const wavefront_data_t* data,
+    wavefront_model_t* model, uint32_t* capacity) {
+    if ((uint32_t)model->num_shapes == *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity * 2 : 16;
+        wavefront_shape_t* shapes = data->allocator(model->shapes,
+            sizeof(wavefront_shape_t) * new_capacity);
+        if (!shapes) {
+            return NULL;
         }
 
-        int32_t parse_result = tinyobj_parse_obj(
-            &attribs, &shapes, &num_shapes, &materials,
-            &num_materials, data->obj_data, data->data_size,
-            TINYOBJ_FLAG_TRIANGULATE);
+        model->shapes = shapes;
+        *capacity = new_capacity;
+    }
 
-        if (parse_result != TINYOBJ_SUCCESS) {
-            return WAVEFRONT_RESULT_INVALID_OBJECT;
+    wavefront_shape_t* shape = &model->shapes[model->num_shapes++];
+    memset(shape, 0, sizeof(wavefront_shape_t));
+    shape->image_tile = (rect_t){.w = 1.f, .h = 1.f};
+    return shape;
+}
+
+// vertices range and bounds of the faces of each shape
+static void __wf_compute_shapes_bounds(const wavefront_mesh_t* mesh,
+    wavefront_shape_t* shapes, int32_t num_shapes) {
+    for (int32_t s = 0; s < num_shapes; ++s) {
+        wavefront_shape_t* shape = &shapes[s];
+        const uint32_t* indices = mesh->indices + 3 * shape->base_face_id;
+        uint32_t num_indices = 3 * shape->num_faces;
+
+        uint32_t min_vertex = UINT32_MAX;
+        uint32_t max_vertex = 0;
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            min_vertex = indices[i] < min_vertex ? indices[i] : min_vertex;
+            max_vertex = indices[i] > max_vertex ? indices[i] : max_vertex;
         }
 
-        LOG_INFO("Wavefront parsed object (shapes=%zd, materials=%zd)\n",
-            num_shapes, num_materials);
+        shape->base_vertex_id = min_vertex;
+        shape->num_vertices = max_vertex - min_vertex + 1;
+        shape->bbox = box_from_indexed_points(&mesh->vertices[0].pos,
+            sizeof(vertex_t), indices, num_indices);
+    }
+}
 
-        if (shapes != NULL && num_shapes > 0) {
-            __wf_print_shapes(shapes, num_shapes);
+// texture maps a material can reference
+typedef enum {
+    WF_MAP_DIFFUSE,         // rgba
+    WF_MAP_ALPHA,           // single channel
+    WF_MAP_SPECULAR,        // single channel, specular exponent
+    WF_MAP_BUMP,            // rgba, tangent space normals
+    WF_MAP_DISPLACEMENT,    // single channel
+    WF_MAP_COUNT
+} __wf_map_t;
+
+typedef struct {
+    char path[WAVEFRONT_MAX_PATH];
+    int32_t channels;
+    int32_t width;
+    int32_t height;
+    uint8_t* pixels;    // decoded by stb_image
+} __wf_texture_t;
+
+typedef struct {
+    const wavefront_data_t* data;
+    const tinyobj_material_t* materials;
+    wavefront_model_t* model;
+    __wf_texture_t* textures;
+    uint32_t num_textures;
+    int32_t (*material_maps)[WF_MAP_COUNT];
+    bool* material_failed;
+} __wf_textures_t;
+
+static const char* __wf_map_name(const tinyobj_material_t* mat, __wf_map_t map) {
+    switch (map) {
+        case WF_MAP_DIFFUSE: return mat->diffuse_texname;
+        case WF_MAP_ALPHA: return mat->alpha_texname;
+        case WF_MAP_SPECULAR: return mat->specular_highlight_texname;
+        case WF_MAP_BUMP: return mat->bump_texname;
+        case WF_MAP_DISPLACEMENT: return mat->displacement_texname;
+        default: return NULL;
+    }
+}
+
+static int32_t __wf_map_channels(__wf_map_t map) {
+    return (map == WF_MAP_DIFFUSE || map == WF_MAP_BUMP) ? 4 : 1;
+}
+
+// textures shared among materials are decoded only once
+static int32_t __wf_add_texture(__wf_textures_t* tex,
+    const char* name, int32_t channels) {
+    if (!name || !name[0]) {
+        return -1;
+    }
+
+    char path[WAVEFRONT_MAX_PATH];
+    const char* base_path = tex->data->base_path;
+    if (base_path && base_path[0]) {
+        snprintf(path, sizeof(path), "%s/%s", base_path, name);
+    }
+    else {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+
+    for (uint32_t t = 0; t < tex->num_textures; ++t) {
+        if (tex->textures[t].channels == channels
+            && strcmp(tex->textures[t].path, path) == 0) {
+            return (int32_t)t;
         }
-        else {
-            return WAVEFRONT_RESULT_INVALID_OBJECT;
+    }
+
+    __wf_texture_t* texture = &tex->textures[tex->num_textures];
+    memset(texture, 0, sizeof(__wf_texture_t));
+    memcpy(texture->path, path, sizeof(path));
+    texture->channels = channels;
+    return (int32_t)tex->num_textures++;
+}
+
+static void __wf_decode_texture_job(void* user_data, uint32_t index) {
+    __wf_textures_t* tex = (__wf_textures_t*)user_data;
+    __wf_texture_t* texture = &tex->textures[index];
+
+    int32_t file_channels = 0;
+    texture->pixels = stbi_load(texture->path, &texture->width,
+        &texture->height, &file_channels, texture->channels);
+
+    // images are stored with 16-bit dimensions
+    if (texture->pixels && (texture->width > UINT16_MAX
+        || texture->height > UINT16_MAX)) {
+        stbi_image_free(texture->pixels);
+        texture->pixels = NULL;
+    }
+}
+
+static const __wf_texture_t* __wf_material_texture(const __wf_textures_t* tex,
+    uint32_t material, __wf_map_t map) {
+    int32_t t = tex->material_maps[material][map];
+    return (t >= 0 && tex->textures[t].pixels) ? &tex->textures[t] : NULL;
+}
+
+static bool __wf_alloc_image(const wavefront_data_t* data,
+    wavefront_image_t* image, const __wf_texture_t* size_of) {
+    image->width = size_of ? (uint16_t)size_of->width : 1;
+    image->height = size_of ? (uint16_t)size_of->height : 1;
+    image->layers = 1;
+    image->pixels = data->allocator(NULL,
+        sizeof(uint32_t) * image->width * image->height);
+    return image->pixels != NULL;
+}
+
+// replace the image channel with the single channel texture,
+// which is resampled first, if its size differs from the image.
+static bool __wf_pack_texture(wavefront_image_t* image,
+    uint32_t channel, const __wf_texture_t* texture) {
+    assert(texture->channels == 1);
+
+    uint32_t num_pixels = (uint32_t)image->width * image->height;
+    const uint8_t* src = texture->pixels;
+    uint8_t* resampled = NULL;
+
+    if (texture->width != image->width || texture->height != image->height) {
+        resampled = memory_malloc(num_pixels);
+        if (!resampled || !stbir_resize_uint8(
+            texture->pixels, texture->width, texture->height, 0,
+            resampled, image->width, image->height, 0, 1)) {
+            if (resampled) {
+                memory_free(resampled);
+            }
+
+            return false;
         }
+
+        src = resampled;
     }
 
-    assert(attribs.num_vertices && attribs.num_faces);
+    image_pack_channel(image->pixels, num_pixels, channel, src);
 
-    wavefront_mesh_t* mesh = data->allocator(NULL, sizeof(wavefront_mesh_t));
-    mesh->num_indices = attribs.num_faces;
-    mesh->num_vertices = attribs.num_vertices;
+    if (resampled) {
+        memory_free(resampled);
+    }
 
-    mesh->vertices = data->allocator(NULL, sizeof(vertex_t) * mesh->num_vertices);
-    mesh->indices = data->allocator(NULL, sizeof(uint32_t) * mesh->num_indices);
+    return true;
+}
 
-    uint32_t i_idx = 0;
-    uint32_t face_offset = 0;
+static void __wf_pack_material_job(void* user_data, uint32_t m) {
+    __wf_textures_t* tex = (__wf_textures_t*)user_data;
+    const tinyobj_material_t* mat = &tex->materials[m];
+    const wavefront_data_t* data = tex->data;
+    wavefront_model_t* model = tex->model;
 
-    assert(attribs.num_face_num_verts > 0);
-    uint32_t num_surface_lines = (uint32_t)attribs.num_face_num_verts;
-    for (uint32_t i = 0; i < num_surface_lines; ++i) {
+    const __wf_texture_t* diffuse = __wf_material_texture(tex, m, WF_MAP_DIFFUSE);
+    const __wf_texture_t* alpha = __wf_material_texture(tex, m, WF_MAP_ALPHA);
+    const __wf_texture_t* specular = __wf_material_texture(tex, m, WF_MAP_SPECULAR);
+    const __wf_texture_t* bump = __wf_material_texture(tex, m, WF_MAP_BUMP);
+    const __wf_texture_t* disp = __wf_material_texture(tex, m, WF_MAP_DISPLACEMENT);
 
-        // number of vertices per face, likely 3 or 6
-        uint32_t surface_verts = (uint32_t)attribs.face_num_verts[i];
-        
-        // assume all triangle faces because
-        // of TINYOBJ_FLAG_TRIANGULATE
-        assert(surface_verts % 3 == 0);
+    bool succeeded = true;
 
-        // e.g. 2 triangles per quad
-        uint32_t num_surface_triangles = surface_verts / 3;
-        for (uint32_t f = 0; f < num_surface_triangles; ++f) {
-            uint32_t f_idx = 3 * f + face_offset;
+    // diffuse rgb, and transparency, from either the
+    // alpha map, the diffuse map, or the dissolve value.
+    wavefront_image_t* albedo = &model->diffuseRGB_alphaA[m];
+    if (__wf_alloc_image(data, albedo, diffuse ? diffuse : alpha)) {
+        uint32_t num_pixels = (uint32_t)albedo->width * albedo->height;
+        if (diffuse) {
+            memcpy(albedo->pixels, diffuse->pixels, sizeof(uint32_t) * num_pixels);
+        }
+        else {
+            image_fill(albedo->pixels, num_pixels, image_pack_rgba(
+                mat->diffuse[0], mat->diffuse[1], mat->diffuse[2], mat->dissolve));
+        }
 
-            // read all 3 vertex info at once
-            tinyobj_vertex_index_t idx0 = attribs.faces[f_idx + 0];
-            tinyobj_vertex_index_t idx1 = attribs.faces[f_idx + 1];
-            tinyobj_vertex_index_t idx2 = attribs.faces[f_idx + 2];
+        if (alpha) {
+            succeeded &= __wf_pack_texture(albedo, 3, alpha);
+        }
+        else if (diffuse && mat->dissolve < 1.f) {
+            image_fill_channel(albedo->pixels, num_pixels, 3,
+                (uint8_t)(image_pack_rgba(0.f, 0.f, 0.f, mat->dissolve) >> 24));
+        }
+    }
+    else {
+        succeeded = false;
+    }
 
-            // populate element indices array
-            mesh->indices[i_idx++] = idx0.v_idx;
+    // constant emission, as there is no emissive map,
+    // and normalised specular exponent [0, 1000]
+    wavefront_image_t* emissive = &model->emissiveXYZ_specularW[m];
+    if (__wf_alloc_image(data, emissive, specular)) {
+        uint32_t num_pixels = (uint32_t)emissive->width * emissive->height;
+        image_fill(emissive->pixels, num_pixels, image_pack_rgba(
+            mat->emission[0], mat->emission[1], mat->emission[2],
+            mat->shininess / 1000.f));
 
-            // by default the we expect counter clock wise
-            // trinangles, but objects can be defined differently.
-            // therefore, we need a way to make the model consistent
-            // with the face winding of the render pass.s
-            if (data->import_options & WAVEFRONT_IMPORT_REWIND_FACES) {
-                mesh->indices[i_idx++] = idx2.v_idx;
-                mesh->indices[i_idx++] = idx1.v_idx;
-            }
-            else {
-                mesh->indices[i_idx++] = idx1.v_idx;
-                mesh->indices[i_idx++] = idx2.v_idx;
-            }
+        if (specular) {
+            succeeded &= __wf_pack_texture(emissive, 3, specular);
+        }
+    }
+    else {
+        succeeded = false;
+    }
 
-            // normals, and tex coordinates can be <= positions.
-            // this allows us to duplicate normals and uv
-            // into the mesh vertex buffer without taking
-            // into consideration whether a normal or a set
-            // of uv have already been read.
-            assert(idx0.v_idx < mesh->num_vertices);
-            assert(idx1.v_idx < mesh->num_vertices);
-            assert(idx1.v_idx < mesh->num_vertices);
+    // normal xy from the bump map, displacement, and full ambient occlusion
+    wavefront_image_t* normal = &model->normalXY_dispZ_aoW[m];
+    if (__wf_alloc_image(data, normal, bump ? bump : disp)) {
+        uint32_t num_pixels = (uint32_t)normal->width * normal->height;
+        if (bump) {
+            memcpy(normal->pixels, bump->pixels, sizeof(uint32_t) * num_pixels);
+            image_fill_channel(normal->pixels, num_pixels, 2, 0);
+            image_fill_channel(normal->pixels, num_pixels, 3, 0xFF);
+        }
+        else {
+            image_fill(normal->pixels, num_pixels,
+                image_pack_rgba(.5f, .5f, 0.f, 1.f));
+        }
 
-            // set vertices positions
-            mesh->vertices[idx0.v_idx].pos = (vec3f_t){
-                .x = attribs.vertices[3 * idx0.v_idx + 0],
-                .y = attribs.vertices[3 * idx0.v_idx + 1],
-                .z = attribs.vertices[3 * idx0.v_idx + 2]
-            };
-            mesh->vertices[idx1.v_idx].pos = (vec3f_t){
-                .x = attribs.vertices[3 * idx1.v_idx + 0],
-                .y = attribs.vertices[3 * idx1.v_idx + 1],
-                .z = attribs.vertices[3 * idx1.v_idx + 2]
-            };
-            mesh->vertices[idx2.v_idx].pos = (vec3f_t){
-                .x = attribs.vertices[3 * idx2.v_idx + 0],
-                .y = attribs.vertices[3 * idx2.v_idx + 1],
-                .z = attribs.vertices[3 * idx2.v_idx + 2]
-            };
+        if (disp) {
+            succeeded &= __wf_pack_texture(normal, 2, disp);
+        }
+    }
+    else {
+        succeeded = false;
+    }
 
-            // set normals if provided and the
-            // flag on import options is not set
-            if (attribs.num_normals &&
-                !(data->import_options & WAVEFRONT_IMPORT_CALC_NORMALS)) {
+    tex->material_failed[m] = !succeeded;
+}
 
-                // if normals are provided, then all of them must be
-                assert(idx0.vn_idx >= 0 && idx1.vn_idx >= 0 && idx2.vn_idx >= 0);
-                mesh->vertices[idx0.v_idx].norm = (vec3f_t){
-                    .x = attribs.normals[3 * idx0.vn_idx + 0],
-                    .y = attribs.normals[3 * idx0.vn_idx + 1],
-                    .z = attribs.normals[3 * idx0.vn_idx + 2]
-                };
-                mesh->vertices[idx1.v_idx].norm = (vec3f_t){
-                    .x = attribs.normals[3 * idx1.vn_idx + 0],
-                    .y = attribs.normals[3 * idx1.vn_idx + 1],
-                    .z = attribs.normals[3 * idx1.vn_idx + 2]
-                };
-                mesh->vertices[idx2.v_idx].norm = (vec3f_t){
-                    .x = attribs.normals[3 * idx2.vn_idx + 0],
-                    .y = attribs.normals[3 * idx2.vn_idx + 1],
-                    .z = attribs.normals[3 * idx2.vn_idx + 2]
-                };
-            }
-            else {
-                // set normals to zero, as they
-                // will be computed later, once
-                // all faces are set finally.
-                mesh->vertices[idx0.v_idx].norm = svec3_zero();
-                mesh->vertices[idx1.v_idx].norm = svec3_zero();
-                mesh->vertices[idx2.v_idx].norm = svec3_zero();
-            }
+// decode all the referenced textures, then pack them into
+// the model images, both steps spread across the jobs.
+static bool __wf_load_materials(const wavefront_data_t* data,
+    const tinyobj_material_t* materials, uint32_t num_materials,
+    wavefront_model_t* model) {
 
-            if (data->import_options & WAVEFRONT_IMPORT_FLIP_NORMALS) {
-                mesh->vertices[idx0.v_idx].norm = svec3_multiply_f(
-                    mesh->vertices[idx0.v_idx].norm, -1.f
-                );
-                mesh->vertices[idx1.v_idx].norm = svec3_multiply_f(
-                    mesh->vertices[idx1.v_idx].norm, -1.f
-                );
-                mesh->vertices[idx2.v_idx].norm = svec3_multiply_f(
-                    mesh->vertices[idx1.v_idx].norm, -1.f
-                );
-            }
+    model->num_materials = 0;
+    if (num_materials == 0) {
+        return true;
+    }
 
-            // set texture coordinates
-            if (attribs.num_texcoords > 0) {
+    size_t images_size = sizeof(wavefront_image_t) * num_materials;
+    model->diffuseRGB_alphaA = data->allocator(NULL, images_size);
+    model->emissiveXYZ_specularW = data->allocator(NULL, images_size);
+    model->normalXY_dispZ_aoW = data->allocator(NULL, images_size);
 
-                // if texcoords are provided, then all of them must be
-                assert(idx0.vt_idx >= 0 && idx1.vt_idx >= 0 && idx2.vt_idx >= 0);
-                mesh->vertices[idx0.v_idx].uv = (vec2f_t){
-                    .x = attribs.texcoords[2 * idx0.vt_idx + 0],
-                    .y = attribs.texcoords[2 * idx0.vt_idx + 1]
-                };
-                mesh->vertices[idx1.v_idx].uv = (vec2f_t){
-                    .x = attribs.texcoords[2 * idx1.vt_idx + 0],
-                    .y = attribs.texcoords[2 * idx1.vt_idx + 1]
-                };
-                mesh->vertices[idx2.v_idx].uv = (vec2f_t){
-                    .x = attribs.texcoords[2 * idx2.vt_idx + 0],
-                    .y = attribs.texcoords[2 * idx2.vt_idx + 1]
-                };
+    __wf_textures_t tex = {
+        .data = data,
+        .materials = materials,
+        .model = model,
+        .textures = memory_malloc(
+            sizeof(__wf_texture_t) * num_materials * WF_MAP_COUNT),
+        .material_maps = memory_malloc(
+            sizeof(int32_t) * WF_MAP_COUNT * num_materials),
+        .material_failed = memory_calloc(num_materials, sizeof(bool))
+    };
+
+    bool succeeded = model->diffuseRGB_alphaA
+        && model->emissiveXYZ_specularW
+        && model->normalXY_dispZ_aoW
+        && tex.textures && tex.material_maps && tex.material_failed;
+
+    if (succeeded) {
+        memset(model->diffuseRGB_alphaA, 0, images_size);
+        memset(model->emissiveXYZ_specularW, 0, images_size);
+        memset(model->normalXY_dispZ_aoW, 0, images_size);
+        model->num_materials = (int32_t)num_materials;
+
+        // collect the textures to decode
+        bool ignore_textures = data->import_options
+            & WAVEFRONT_IMPORT_IGNORE_TEXTURES;
+        for (uint32_t m = 0; m < num_materials; ++m) {
+            for (int32_t map = 0; map < WF_MAP_COUNT; ++map) {
+                tex.material_maps[m][map] = ignore_textures ? -1
+                    : __wf_add_texture(&tex,
+                        __wf_map_name(&materials[m], (__wf_map_t)map),
+                        __wf_map_channels((__wf_map_t)map));
             }
-            else {
-                // if no texture coordinates are provided,
-                // then set uv to zero and recompute them
-                // based on material colors, later in the
-                // the process.
-                mesh->vertices[idx0.v_idx].uv = svec2_zero();
-                mesh->vertices[idx1.v_idx].uv = svec2_zero();
-                mesh->vertices[idx2.v_idx].uv = svec2_zero();
+        }
+
+        jobs_parallel_for(data->jobs, __wf_decode_texture_job,
+            &tex, tex.num_textures);
+
+        for (uint32_t t = 0; t < tex.num_textures; ++t) {
+            if (!tex.textures[t].pixels) {
+                LOG_WARN("WARN: Cannot load texture (%s)\n",
+                    tex.textures[t].path);
             }
+        }
+
+        jobs_parallel_for(data->jobs, __wf_pack_material_job,
+            &tex, num_materials);
 
-            // @todo: compute shapes and associate materials
-            // @note: materials and shapes are associated to surfaces (i),
-            //  not single triangles (f), as one surface line can contain at
-            //  most one material, and being part of one object group at a time
+        for (uint32_t m = 0; m < num_materials; ++m) {
+            if (tex.material_failed[m]) {
+                LOG_WARN("WARN: Not enough memory for material (%s)\n",
+                    materials[m].name);
+            }
         }
 
-        face_offset += surface_verts;
+        LOG_INFO("Wavefront loaded %d materials, %d textures (%s)\n",
+            num_materials, tex.num_textures, data->label);
     }
 
-    assert(face_offset == mesh->num_indices);
-    assert(i_idx == face_offset);
+    for (uint32_t t = 0; t < tex.num_textures; ++t) {
+        if (tex.textures[t].pixels) {
+            stbi_image_free(tex.textures[t].pixels);
+        }
+    }
 
-    if (face_offset > 0)
-    {
-        model->allocator = data->allocator;
-        model->mesh = mesh;
-        trace_printf(&model->trace, "%s", data->label);
+    if (tex.textures) memory_free(tex.textures);
+    if (tex.material_maps) memory_free(tex.material_maps);
+    if (tex.material_failed) memory_free(tex.material_failed);
+    return succeeded;
+}
 
-        return WAVEFRONT_RESULT_OK;
+// place of a material's images within the atlas layers
+typedef struct {
+    int32_t material;
+    int32_t width;      // of the images, without gutter
+    int32_t height;
+    ta_rect_t rect;     // with gutter
+    int32_t layer;
+} __wf_atlas_tile_t;
+
+// taller images first, for the atlas to be packed tighter
+static int __wf_compare_tiles(const void* a, const void* b) {
+    const __wf_atlas_tile_t* ta = (const __wf_atlas_tile_t*)a;
+    const __wf_atlas_tile_t* tb = (const __wf_atlas_tile_t*)b;
+    if (ta->height != tb->height) {
+        return tb->height - ta->height;
     }
 
-    return WAVEFRONT_RESULT_MESH_MALFORMED;
+    return tb->width - ta->width;
 }
 
-void wavefront_release_obj(wavefront_model_t* model) {
-    assert(model && model->mesh);
-    
-    // release mesh resources
-    model->allocator(model->mesh->indices, 0);
-    model->allocator(model->mesh->vertices, 0);
-    model->allocator(model->mesh, 0);
-    model->mesh = NULL;
+// materials drawn through uvs outside [0, 1] cannot be packed, as
+// they would sample their neighbours, rather than repeat themselves.
+static bool __wf_can_pack_atlas(const wavefront_model_t* model) {
+    const wavefront_mesh_t* mesh = model->mesh;
+    const mfloat_t epsilon = 1e-3f;
 
-    // release material's images
-    model->allocator(model->diffuseRGB_alphaA, 0);
-    model->allocator(model->emissiveXYZ_specularW, 0);
-    model->allocator(model->normalXY_dispZ_aoW, 0);
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        const wavefront_shape_t* shape = &model->shapes[s];
+        if (shape->material_id < 0) {
+            return false;
+        }
 
-    // release shapes
-    model->allocator(model->shapes, 0);
+        const uint32_t* indices = mesh->indices + 3 * shape->base_face_id;
+        for (uint32_t i = 0; i < 3 * shape->num_faces; ++i) {
+            vec2f_t uv = mesh->vertices[indices[i]].uv;
+            if (uv.x < -epsilon || uv.x > 1.f + epsilon
+                || uv.y < -epsilon || uv.y > 1.f + epsilon) {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
-model_id_t wavefront_make_model(geometry_pass_t* pass,
-    const wavefront_model_t* model) {
-    assert(pass && model);
+// size of the material images within the atlas, shrunk
+// to fit a layer, keeping their aspect ratio.
+static void __wf_atlas_tile_size(const wavefront_data_t* data,
+    const wavefront_image_t* image, __wf_atlas_tile_t* tile) {
+    int32_t max_width = data->atlas_width - 2 * WAVEFRONT_ATLAS_GUTTER;
+    int32_t max_height = data->atlas_height - 2 * WAVEFRONT_ATLAS_GUTTER;
 
-    return geometry_pass_create_model(pass, &(model_desc_t){
-        .material = geometry_pass_get_default_material(pass),
-        .mesh = geometry_pass_make_mesh(pass, &(mesh_desc_t){
-            .vertices = model->mesh->vertices,
-            .num_vertices = model->mesh->num_vertices,
-            .indices = model->mesh->indices,
-            .num_indices = model->mesh->num_indices,
-            .label = model->trace.name
-        }),
-        .label = model->trace.name
+    tile->width = image->width;
+    tile->height = image->height;
+    if (tile->width > max_width) {
+        tile->height = tile->height * max_width / tile->width;
+        tile->width = max_width;
+    }
+
+    if (tile->height > max_height) {
+        tile->width = tile->width * max_height / tile->height;
+        tile->height = max_height;
+    }
+
+    tile->width = tile->width > 0 ? tile->width : 1;
+    tile->height = tile->height > 0 ? tile->height : 1;
+}
+
+// assign each tile a layer, and a place within it, opening a new
+// layer whenever a tile does not fit any of the previous ones.
+// returns the number of layers, 0 if they are not enough.
+static int32_t __wf_pack_tiles(const wavefront_data_t* data,
+    __wf_atlas_tile_t* tiles, int32_t num_tiles) {
+    void* layers[WAVEFRONT_ATLAS_MAX_LAYERS] = {0};
+    int32_t num_layers = 0;
+    bool packed = true;
+
+    for (int32_t t = 0; t < num_tiles && packed; ++t) {
+        __wf_atlas_tile_t* tile = &tiles[t];
+        int32_t width = tile->width + 2 * WAVEFRONT_ATLAS_GUTTER;
+        int32_t height = tile->height + 2 * WAVEFRONT_ATLAS_GUTTER;
+
+        int id = 0;
+        for (tile->layer = 0; tile->layer < num_layers; ++tile->layer) {
+            id = ta_push_pixels(layers[tile->layer], NULL, width, height);
+            if (id) {
+                break;
+            }
+        }
+
+        if (!id && num_layers < WAVEFRONT_ATLAS_MAX_LAYERS) {
+            layers[num_layers] = ta_init(data->atlas_width,
+                data->atlas_height, NULL, NULL, NULL);
+            if (layers[num_layers]) {
+                tile->layer = num_layers++;
+                id = ta_push_pixels(layers[tile->layer], NULL, width, height);
+            }
+        }
+
+        packed = id != 0;
+        if (packed) {
+            ta_get_rect_from_texid(layers[tile->layer],
+                (unsigned long)id, &tile->rect);
+        }
+    }
+
+    for (int32_t l = 0; l < num_layers; ++l) {
+        ta_destroy(layers[l]);
+    }
+
+    return packed ? num_layers : 0;
+}
+
+// copy the image into its tile, resampling it to the tile size
+// first, if needed, then extend its borders over the gutter.
+static bool __wf_blit_tile(const wavefront_image_t* image, const __wf_atlas_tile_t* tile,
+    wavefront_image_t* atlas) {
+    const uint32_t* src = image->pixels;
+    uint32_t* resampled = NULL;
+
+    if (image->width != tile->width || image->height != tile->height) {
+        resampled = memory_malloc(sizeof(uint32_t) * tile->width * tile->height);
+        if (!resampled || !stbir_resize_uint8(
+            (const uint8_t*)image->pixels, image->width, image->height, 0,
+            (uint8_t*)resampled, tile->width, tile->height, 0, 4)) {
+            if (resampled) {
+                memory_free(resampled);
+            }
+
+            return false;
+        }
+
+        src = resampled;
+    }
+
+    uint32_t* layer = atlas->pixels
+        + (size_t)tile->layer * atlas->width * atlas->height;
+    for (int32_t y = 0; y < tile->rect.h; ++y) {
+        int32_t src_y = y - WAVEFRONT_ATLAS_GUTTER;
+        src_y = src_y < 0 ? 0 : (src_y >= tile->height ? tile->height - 1 : src_y);
+
+        uint32_t* dst = layer + (size_t)(tile->rect.y + y) * atlas->width
+            + tile->rect.x;
+        const uint32_t* row = src + (size_t)src_y * tile->width;
+        for (int32_t x = 0; x < tile->rect.w; ++x) {
+            int32_t src_x = x - WAVEFRONT_ATLAS_GUTTER;
+            src_x = src_x < 0 ? 0 : (src_x >= tile->width ? tile->width - 1 : src_x);
+            dst[x] = row[src_x];
+        }
+    }
+
+    if (resampled) {
+        memory_free(resampled);
+    }
+
+    return true;
+}
+
+static bool __wf_grow_atlas_vertices(const wavefront_data_t* data,
+    wavefront_mesh_t* mesh, int32_t** owners, uint32_t** duplicates,
+    uint32_t* capacity) {
+    uint32_t new_capacity = *capacity * 2;
+    vertex_t* vertices = data->allocator(mesh->vertices,
+        sizeof(vertex_t) * new_capacity);
+    if (!vertices) {
+        return false;
+    }
+
+    mesh->vertices = vertices;
+    int32_t* new_owners = memory_realloc(*owners,
+        sizeof(int32_t) * new_capacity);
+    if (!new_owners) {
+        return false;
+    }
+
+    *owners = new_owners;
+    uint32_t* new_duplicates = memory_realloc(*duplicates,
+        sizeof(uint32_t) * new_capacity);
+    if (!new_duplicates) {
+        return false;
+    }
+
+    *duplicates = new_duplicates;
+    *capacity = new_capacity;
+    return true;
+}
+
+// remap the uvs of the shapes into their material tile. vertices
+// shared by shapes of different materials are duplicated, as
+// the uvs of each of them point to a different tile.
+static bool __wf_remap_atlas_uvs(const wavefront_data_t* data,
+    wavefront_model_t* model, const __wf_atlas_tile_t* material_tiles,
+    int32_t num_layers) {
+    wavefront_mesh_t* mesh = model->mesh;
+    uint32_t num_vertices = mesh->num_vertices;
+
+    // tile each vertex has been remapped to, and the next
+    // duplicate of the same source vertex, for another tile.
+    uint32_t capacity = num_vertices;
+    int32_t* owners = memory_malloc(sizeof(int32_t) * capacity);
+    uint32_t* duplicates = memory_malloc(sizeof(uint32_t) * capacity);
+    vec2f_t* source_uvs = memory_malloc(sizeof(vec2f_t) * num_vertices);
+    bool succeeded = owners && duplicates && source_uvs;
+
+    if (succeeded) {
+        memset(owners, 0xff, sizeof(int32_t) * capacity);
+        memset(duplicates, 0xff, sizeof(uint32_t) * capacity);
+        for (uint32_t v = 0; v < num_vertices; ++v) {
+            source_uvs[v] = mesh->vertices[v].uv;
+        }
+    }
+
+    for (int32_t s = 0; s < model->num_shapes && succeeded; ++s) {
+        wavefront_shape_t* shape = &model->shapes[s];
+        const __wf_atlas_tile_t* tile = &material_tiles[shape->material_id];
+
+        shape->image_tile = (rect_t){
+            .x = (mfloat_t)(tile->rect.x + WAVEFRONT_ATLAS_GUTTER) / data->atlas_width,
+            .y = (mfloat_t)(tile->rect.y + WAVEFRONT_ATLAS_GUTTER) / data->atlas_height,
+            .w = (mfloat_t)tile->width / data->atlas_width,
+            .h = (mfloat_t)tile->height / data->atlas_height
+        };
+
+        shape->image_layer = tile->layer;
+
+        uint32_t* indices = mesh->indices + 3 * shape->base_face_id;
+        for (uint32_t i = 0; i < 3 * shape->num_faces && succeeded; ++i) {
+            // the copy of the vertex for this tile, if any, or the last one
+            uint32_t source = indices[i];
+            uint32_t v = source;
+            while (owners[v] >= 0 && owners[v] != tile->material
+                && duplicates[v] != UINT32_MAX) {
+                v = duplicates[v];
+            }
+
+            if (owners[v] >= 0 && owners[v] != tile->material) {
+                if (mesh->num_vertices == capacity) {
+                    succeeded = __wf_grow_atlas_vertices(data, mesh,
+                        &owners, &duplicates, &capacity);
+                    if (!succeeded) {
+                        break;
+                    }
+                }
+
+                uint32_t duplicate = mesh->num_vertices++;
+                mesh->vertices[duplicate] = mesh->vertices[source];
+                owners[duplicate] = -1;
+                duplicates[duplicate] = UINT32_MAX;
+                duplicates[v] = duplicate;
+                v = duplicate;
+            }
+
+            indices[i] = v;
+            if (owners[v] < 0) {
+                vec2f_t uv = source_uvs[source];
+                uv.x = uv.x < 0.f ? 0.f : (uv.x > 1.f ? 1.f : uv.x);
+                uv.y = uv.y < 0.f ? 0.f : (uv.y > 1.f ? 1.f : uv.y);
+                uv.x = shape->image_tile.x + uv.x * shape->image_tile.w;
+                uv.y = shape->image_tile.y + uv.y * shape->image_tile.h;
+                if (num_layers > 1) {
+                    uv.x += 2.f * (mfloat_t)tile->layer + .5f;
+                }
+
+                mesh->vertices[v].uv = uv;
+                owners[v] = tile->material;
+            }
+        }
+    }
+
+    if (owners) memory_free(owners);
+    if (duplicates) memory_free(duplicates);
+    if (source_uvs) memory_free(source_uvs);
+    return succeeded;
+}
+
+// pack the images of all the materials into the layers of a single
+// one, which all the shapes are then drawn with. the model is left
+// as it is, if it cannot be packed, but on running out of memory.
+static bool __wf_pack_atlas(const wavefront_data_t* data,
+    wavefront_model_t* model) {
+    if (!(data->import_options & WAVEFRONT_IMPORT_PACK_ATLAS)
+        || model->num_materials < 2
+        || data->atlas_width <= 2 * WAVEFRONT_ATLAS_GUTTER
+        || data->atlas_height <= 2 * WAVEFRONT_ATLAS_GUTTER) {
+        return true;
+    }
+
+    for (int32_t m = 0; m < model->num_materials; ++m) {
+        if (!model->diffuseRGB_alphaA[m].pixels
+            || !model->emissiveXYZ_specularW[m].pixels
+            || !model->normalXY_dispZ_aoW[m].pixels) {
+            return true;
+        }
+    }
+
+    if (!__wf_can_pack_atlas(model)) {
+        LOG_INFO("Wavefront materials of (%s) not packed,"
+            " as their uvs repeat\n", data->label);
+        return true;
+    }
+
+    int32_t num_tiles = model->num_materials;
+    __wf_atlas_tile_t* tiles = memory_malloc(sizeof(__wf_atlas_tile_t) * num_tiles);
+    if (!tiles) {
+        return false;
+    }
+
+    // all the images of a material are packed within the same tile,
+    // which takes the size of the albedo, as the most detailed one.
+    for (int32_t m = 0; m < num_tiles; ++m) {
+        tiles[m] = (__wf_atlas_tile_t){.material = m};
+        __wf_atlas_tile_size(data, &model->diffuseRGB_alphaA[m], &tiles[m]);
+    }
+
+    qsort(tiles, (size_t)num_tiles, sizeof(__wf_atlas_tile_t), __wf_compare_tiles);
+    int32_t num_layers = __wf_pack_tiles(data, tiles, num_tiles);
+    if (num_layers == 0) {
+        LOG_INFO("Wavefront materials of (%s) not packed,"
+            " as they do not fit %d layers\n", data->label,
+            WAVEFRONT_ATLAS_MAX_LAYERS);
+        memory_free(tiles);
+        return true;
+    }
+
+    // back to material order, to be looked up by the shapes
+    __wf_atlas_tile_t* material_tiles = memory_malloc(
+        sizeof(__wf_atlas_tile_t) * num_tiles);
+    if (!material_tiles) {
+        memory_free(tiles);
+        return false;
+    }
+
+    for (int32_t t = 0; t < num_tiles; ++t) {
+        material_tiles[tiles[t].material] = tiles[t];
+    }
+
+    memory_free(tiles);
+
+    wavefront_image_t* images[] = {
+        model->diffuseRGB_alphaA,
+        model->emissiveXYZ_specularW,
+        model->normalXY_dispZ_aoW
+    };
+
+    const int32_t num_images = sizeof(images) / sizeof(images[0]);
+    wavefront_image_t atlases[sizeof(images) / sizeof(images[0])] = {0};
+    size_t atlas_pixels = (size_t)data->atlas_width * data->atlas_height * num_layers;
+
+    bool succeeded = true;
+    for (int32_t i = 0; i < num_images && succeeded; ++i) {
+        atlases[i] = (wavefront_image_t){
+            .width = (uint16_t)data->atlas_width,
+            .height = (uint16_t)data->atlas_height,
+            .layers = (uint16_t)num_layers,
+            .pixels = data->allocator(NULL, sizeof(uint32_t) * atlas_pixels)
+        };
+
+        succeeded = atlases[i].pixels != NULL;
+        if (succeeded) {
+            memset(atlases[i].pixels, 0, sizeof(uint32_t) * atlas_pixels);
+        }
+
+        for (int32_t m = 0; m < num_tiles && succeeded; ++m) {
+            succeeded = __wf_blit_tile(&images[i][m],
+                &material_tiles[m], &atlases[i]);
+        }
+    }
+
+    succeeded = succeeded && __wf_remap_atlas_uvs(data, model,
+        material_tiles, num_layers);
+    memory_free(material_tiles);
+
+    if (!succeeded) {
+        for (int32_t i = 0; i < num_images; ++i) {
+            if (atlases[i].pixels) {
+                data->allocator(atlases[i].pixels, 0);
+            }
+        }
+
+        return false;
+    }
+
+    // the atlas replaces all the materials
+    for (int32_t i = 0; i < num_images; ++i) {
+        for (int32_t m = 0; m < model->num_materials; ++m) {
+            data->allocator(images[i][m].pixels, 0);
+        }
+
+        images[i][0] = atlases[i];
+    }
+
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        model->shapes[s].material_id = 0;
+    }
+
+    LOG_INFO("Wavefront packed %d materials into %d layers (%s)\n",
+        model->num_materials, num_layers, data->label);
+
+    model->num_materials = 1;
+    model->uv_layers = num_layers > 1;
+    __wf_compute_shapes_bounds(model->mesh, model->shapes, model->num_shapes);
+    return true;
+}
+
+// shapes repeated under rigid transforms are found by hashing what
+// these leave unchanged, faces, uvs and distances from the centroid,
+// and then by fitting the transform between shapes of the same hash.
+typedef struct {
+    uint64_t hash;
+    int32_t shape;
+} __wf_shape_hash_t;
+
+static int __wf_compare_shape_hashes(const void* a, const void* b) {
+    const __wf_shape_hash_t* ha = (const __wf_shape_hash_t*)a;
+    const __wf_shape_hash_t* hb = (const __wf_shape_hash_t*)b;
+    if (ha->hash != hb->hash) {
+        return ha->hash < hb->hash ? -1 : 1;
+    }
+
+    return ha->shape - hb->shape;
+}
+
+static uint64_t __wf_hash(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t b = 0; b < size; ++b) {
+        hash = (hash ^ bytes[b]) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// number the vertices of the shape in order of first reference, which
+// is the same for repeats of the same topology. out_corners holds the
+// local vertex of each index, out_vertices the mesh vertex of each
+// local one, and remap, one per mesh vertex, is left as it was given.
+static uint32_t __wf_localize_shape(const wavefront_mesh_t* mesh,
+    const wavefront_shape_t* shape, uint32_t* remap,
+    uint32_t* out_corners, uint32_t* out_vertices) {
+    const uint32_t* indices = mesh->indices + 3 * shape->base_face_id;
+    uint32_t num_vertices = 0;
+    for (uint32_t i = 0; i < 3 * shape->num_faces; ++i) {
+        uint32_t v = indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = num_vertices;
+            out_vertices[num_vertices++] = v;
+        }
+
+        out_corners[i] = remap[v];
+    }
+
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        remap[out_vertices[v]] = UINT32_MAX;
+    }
+
+    return num_vertices;
+}
+
+static vec3f_t __wf_centroid(const wavefront_mesh_t* mesh,
+    const uint32_t* vertices, uint32_t num_vertices) {
+    vec3f_t centroid = svec3_zero();
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        centroid = svec3_add(centroid, mesh->vertices[vertices[v]].pos);
+    }
+
+    return svec3_divide_f(centroid, (mfloat_t)num_vertices);
+}
+
+static uint64_t __wf_hash_shape(const wavefront_mesh_t* mesh,
+    const wavefront_shape_t* shape, const uint32_t* corners,
+    const uint32_t* vertices, uint32_t num_vertices) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = __wf_hash(hash, &shape->material_id, sizeof(shape->material_id));
+    hash = __wf_hash(hash, &num_vertices, sizeof(num_vertices));
+    hash = __wf_hash(hash, corners, sizeof(uint32_t) * 3 * shape->num_faces);
+
+    vec3f_t centroid = __wf_centroid(mesh, vertices, num_vertices);
+    mfloat_t radius = 0.f;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        mfloat_t distance = svec3_distance(mesh->vertices[vertices[v]].pos, centroid);
+        radius = distance > radius ? distance : radius;
+    }
+
+    // distances relative to the radius, coarse enough for the noise
+    // of the coordinates not to change them, most of the times.
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        const vertex_t* vertex = &mesh->vertices[vertices[v]];
+        mfloat_t distance = svec3_distance(vertex->pos, centroid);
+        uint32_t quantized = radius > 0.f
+            ? (uint32_t)(distance / radius * 1024.f + .5f) : 0;
+        hash = __wf_hash(hash, &vertex->uv, sizeof(vertex->uv));
+        hash = __wf_hash(hash, &quantized, sizeof(quantized));
+    }
+
+    return hash;
+}
+
+// rotation frame of the shape, out of the vertex farthest from the
+// centroid and the one farthest from the line between the two of them.
+static bool __wf_shape_frame(const wavefront_mesh_t* mesh,
+    const uint32_t* vertices, uint32_t first, uint32_t second,
+    vec3f_t centroid, vec3f_t* out_axes) {
+    vec3f_t u = svec3_subtract(mesh->vertices[vertices[first]].pos, centroid);
+    vec3f_t w = svec3_subtract(mesh->vertices[vertices[second]].pos, centroid);
+    vec3f_t n = svec3_cross(u, w);
+    mfloat_t u_length = svec3_length(u);
+    mfloat_t n_length = svec3_length(n);
+    if (u_length <= 0.f || n_length <= 0.f) {
+        return false;
+    }
+
+    out_axes[0] = svec3_divide_f(u, u_length);
+    out_axes[2] = svec3_divide_f(n, n_length);
+    out_axes[1] = svec3_cross(out_axes[2], out_axes[0]);
+    return true;
+}
+
+static vec3f_t __wf_rotate(const vec3f_t* rotation, vec3f_t v) {
+    return svec3_add(svec3_add(
+        svec3_multiply_f(rotation[0], v.x),
+        svec3_multiply_f(rotation[1], v.y)),
+        svec3_multiply_f(rotation[2], v.z));
+}
+
+// transform of the prototype vertices into the repeat ones, which
+// are in the same order, if all of them match it closely enough.
+static bool __wf_fit_transform(const wavefront_mesh_t* mesh,
+    const uint32_t* prototype, const uint32_t* repeat,
+    uint32_t num_vertices, transform_t* out_transform) {
+    vec3f_t prototype_centroid = __wf_centroid(mesh, prototype, num_vertices);
+    vec3f_t repeat_centroid = __wf_centroid(mesh, repeat, num_vertices);
+
+    uint32_t first = 0;
+    mfloat_t radius = 0.f;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        mfloat_t distance = svec3_distance(
+            mesh->vertices[prototype[v]].pos, prototype_centroid);
+        if (distance > radius) {
+            radius = distance;
+            first = v;
+        }
+    }
+
+    vec3f_t axis = svec3_subtract(mesh->vertices[prototype[first]].pos,
+        prototype_centroid);
+    uint32_t second = 0;
+    mfloat_t max_area = 0.f;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        mfloat_t area = svec3_length(svec3_cross(axis, svec3_subtract(
+            mesh->vertices[prototype[v]].pos, prototype_centroid)));
+        if (area > max_area) {
+            max_area = area;
+            second = v;
+        }
+    }
+
+    vec3f_t prototype_axes[3];
+    vec3f_t repeat_axes[3];
+    if (!__wf_shape_frame(mesh, prototype, first, second,
+            prototype_centroid, prototype_axes)
+        || !__wf_shape_frame(mesh, repeat, first, second,
+            repeat_centroid, repeat_axes)) {
+        return false;
+    }
+
+    // columns of the rotation from the prototype frame to the repeat one
+    vec3f_t rotation[3];
+    for (int32_t c = 0; c < 3; ++c) {
+        vec3f_t column = svec3_zero();
+        for (int32_t a = 0; a < 3; ++a) {
+            column = svec3_add(column, svec3_multiply_f(repeat_axes[a],
+                prototype_axes[a].v[c]));
+        }
+
+        rotation[c] = column;
+    }
+
+    const mfloat_t tolerance = 1e-3f * radius;
+    for (uint32_t v = 0; v < num_vertices; ++v) {
+        const vertex_t* a = &mesh->vertices[prototype[v]];
+        const vertex_t* b = &mesh->vertices[repeat[v]];
+        vec3f_t pos = svec3_add(__wf_rotate(rotation,
+            svec3_subtract(a->pos, prototype_centroid)), repeat_centroid);
+        if (svec3_distance(pos, b->pos) > tolerance
+            || svec3_distance(__wf_rotate(rotation, a->norm), b->norm) > 1e-2f) {
+            return false;
+        }
+    }
+
+    *out_transform = (transform_t){
+        .position = svec3_subtract(repeat_centroid,
+            __wf_rotate(rotation, prototype_centroid)),
+        .scale = svec3_one(),
+        .rotation = squat_from_axes(rotation[0], rotation[1], rotation[2])
+    };
+
+    return true;
+}
+
+// state of the instances detection, one entry per shape
+typedef struct {
+    const wavefront_data_t* data;
+    wavefront_model_t* model;
+    __wf_shape_hash_t* hashes;
+    int32_t* prototypes;        // shape repeated, -1 if none
+    int32_t* num_repeats;       // of the prototypes, themselves included
+    transform_t* transforms;    // from the prototype
+    uint32_t* remap;            // one per mesh vertex
+    uint32_t* corners;          // of two shapes, one after the other
+    uint32_t* vertices;
+    uint32_t max_corners;
+} __wf_instancing_t;
+
+// group the shapes of the same hash run with the first of them they
+// are a repeat of, up to the instances a model can draw.
+static void __wf_group_repeats(__wf_instancing_t* inst,
+    int32_t first, int32_t last) {
+    const wavefront_mesh_t* mesh = inst->model->mesh;
+    const wavefront_shape_t* shapes = inst->model->shapes;
+    uint32_t* prototype_corners = inst->corners;
+    uint32_t* repeat_corners = inst->corners + inst->max_corners;
+    uint32_t* prototype_vertices = inst->vertices;
+    uint32_t* repeat_vertices = inst->vertices + inst->max_corners;
+
+    for (int32_t p = first; p < last; ++p) {
+        int32_t prototype = inst->hashes[p].shape;
+        if (inst->prototypes[prototype] >= 0) {
+            continue;
+        }
+
+        const wavefront_shape_t* shape = &shapes[prototype];
+        uint32_t num_corners = 3 * shape->num_faces;
+        uint32_t num_vertices = __wf_localize_shape(mesh, shape,
+            inst->remap, prototype_corners, prototype_vertices);
+
+        for (int32_t r = p + 1; r < last
+            && inst->num_repeats[prototype] < GEOMETRY_PASS_MAX_INSTANCES; ++r) {
+            int32_t repeat = inst->hashes[r].shape;
+            if (inst->prototypes[repeat] >= 0
+                || shapes[repeat].num_faces != shape->num_faces
+                || shapes[repeat].material_id != shape->material_id
+                || __wf_localize_shape(mesh, &shapes[repeat], inst->remap,
+                    repeat_corners, repeat_vertices) != num_vertices
+                || memcmp(prototype_corners, repeat_corners,
+                    sizeof(uint32_t) * num_corners) != 0
+                || !__wf_fit_transform(mesh, prototype_vertices,
+                    repeat_vertices, num_vertices, &inst->transforms[repeat])) {
+                continue;
+            }
+
+            if (inst->num_repeats[prototype] == 0) {
+                inst->prototypes[prototype] = prototype;
+                inst->num_repeats[prototype] = 1;
+                inst->transforms[prototype] = (transform_t){
+                    .scale = svec3_one(),
+                    .rotation = squat_null()
+                };
+            }
+
+            inst->prototypes[repeat] = prototype;
+            ++inst->num_repeats[prototype];
+        }
+    }
+}
+
+// faces saved by drawing the repeats of a prototype as instances
+typedef struct {
+    int32_t prototype;
+    uint32_t saved_faces;
+} __wf_instance_group_t;
+
+static int __wf_compare_groups(const void* a, const void* b) {
+    const __wf_instance_group_t* ga = (const __wf_instance_group_t*)a;
+    const __wf_instance_group_t* gb = (const __wf_instance_group_t*)b;
+    if (ga->saved_faces != gb->saved_faces) {
+        return ga->saved_faces > gb->saved_faces ? -1 : 1;
+    }
+
+    return ga->prototype - gb->prototype;
+}
+
+// keep the groups saving the most faces, as many as the limits of
+// prototypes and instances allow, and ungroup the shapes of the others.
+static int32_t __wf_select_groups(__wf_instancing_t* inst,
+    __wf_instance_group_t* groups) {
+    const wavefront_model_t* model = inst->model;
+    int32_t num_groups = 0;
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        if (inst->prototypes[s] == s) {
+            groups[num_groups++] = (__wf_instance_group_t){
+                .prototype = s,
+                .saved_faces = (uint32_t)(inst->num_repeats[s] - 1)
+                    * model->shapes[s].num_faces
+            };
+        }
+    }
+
+    qsort(groups, (size_t)num_groups, sizeof(__wf_instance_group_t),
+        __wf_compare_groups);
+
+    int32_t num_selected = 0;
+    int32_t num_instances = 0;
+    for (int32_t g = 0; g < num_groups; ++g) {
+        int32_t prototype = groups[g].prototype;
+        if (num_selected < WAVEFRONT_MAX_PROTOTYPES && num_instances
+            + inst->num_repeats[prototype] <= WAVEFRONT_MAX_INSTANCES) {
+            num_instances += inst->num_repeats[prototype];
+            groups[num_selected++] = groups[g];
+        }
+        else {
+            inst->num_repeats[prototype] = 0;
+        }
+    }
+
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        int32_t prototype = inst->prototypes[s];
+        if (prototype >= 0 && inst->num_repeats[prototype] == 0) {
+            inst->prototypes[s] = -1;
+        }
+    }
+
+    return num_selected;
+}
+
+// rebuild the mesh without the repeats, with the faces of the shapes
+// which are not instanced first, and then those of the prototypes, and
+// vertices in order of first reference, not to keep unused ones.
+static bool __wf_rebuild_instanced_mesh(__wf_instancing_t* inst,
+    const __wf_instance_group_t* groups, int32_t num_groups) {
+    const wavefront_data_t* data = inst->data;
+    wavefront_model_t* model = inst->model;
+    wavefront_mesh_t* mesh = model->mesh;
+
+    int32_t num_shapes = 0;
+    int32_t num_instances = 0;
+    uint32_t num_indices = 0;
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        if (inst->prototypes[s] < 0 || inst->prototypes[s] == s) {
+            ++num_shapes;
+            num_indices += 3 * model->shapes[s].num_faces;
+        }
+
+        num_instances += inst->prototypes[s] >= 0 ? 1 : 0;
+    }
+
+    wavefront_shape_t* shapes = data->allocator(NULL,
+        sizeof(wavefront_shape_t) * num_shapes);
+    wavefront_instance_t* instances = data->allocator(NULL,
+        sizeof(wavefront_instance_t) * num_instances);
+    uint32_t* indices = data->allocator(NULL, sizeof(uint32_t) * num_indices);
+    vertex_t* vertices = data->allocator(NULL,
+        sizeof(vertex_t) * mesh->num_vertices);
+    if (!shapes || !instances || !indices || !vertices) {
+        if (shapes) data->allocator(shapes, 0);
+        if (instances) data->allocator(instances, 0);
+        if (indices) data->allocator(indices, 0);
+        if (vertices) data->allocator(vertices, 0);
+        return false;
+    }
+
+    num_shapes = 0;
+    num_indices = 0;
+    num_instances = 0;
+    uint32_t num_vertices = 0;
+    for (int32_t stage = 0; stage < 2; ++stage) {
+        int32_t count = stage == 0 ? model->num_shapes : num_groups;
+        for (int32_t c = 0; c < count; ++c) {
+            int32_t s = stage == 0 ? c : groups[c].prototype;
+            if (stage == 0 && inst->prototypes[s] >= 0) {
+                continue;
+            }
+
+            wavefront_shape_t* shape = &shapes[num_shapes];
+            *shape = model->shapes[s];
+            shape->base_face_id = num_indices / 3;
+            shape->instanced = stage == 1;
+
+            const uint32_t* source = mesh->indices + 3 * model->shapes[s].base_face_id;
+            for (uint32_t i = 0; i < 3 * shape->num_faces; ++i) {
+                uint32_t v = source[i];
+                if (inst->remap[v] == UINT32_MAX) {
+                    inst->remap[v] = num_vertices;
+                    vertices[num_vertices++] = mesh->vertices[v];
+                }
+
+                indices[num_indices++] = inst->remap[v];
+            }
+
+            // the prototype comes first, among its repeats
+            for (int32_t r = s; stage == 1 && r < model->num_shapes; ++r) {
+                if (inst->prototypes[r] == s) {
+                    instances[num_instances++] = (wavefront_instance_t){
+                        .shape_id = num_shapes,
+                        .transform = inst->transforms[r]
+                    };
+                }
+            }
+
+            ++num_shapes;
+        }
+    }
+
+    data->allocator(mesh->indices, 0);
+    data->allocator(mesh->vertices, 0);
+    data->allocator(model->shapes, 0);
+
+    mesh->indices = indices;
+    mesh->num_indices = num_indices;
+    mesh->vertices = vertices;
+    mesh->num_vertices = num_vertices;
+    model->shapes = shapes;
+    model->num_shapes = num_shapes;
+    model->instances = instances;
+    model->num_instances = num_instances;
+
+    __wf_compute_shapes_bounds(mesh, model->shapes, model->num_shapes);
+    return true;
+}
+
+// replace the shapes repeated under rigid transforms with instances
+// of the first of them. the model is left as it is, if none is found,
+// or there is not enough memory to detect them.
+static bool __wf_detect_instances(const wavefront_data_t* data,
+    wavefront_model_t* model) {
+    if (!(data->import_options & WAVEFRONT_IMPORT_DETECT_INSTANCES)
+        || model->num_shapes < 2) {
+        return true;
+    }
+
+    const wavefront_mesh_t* mesh = model->mesh;
+    uint32_t max_corners = 0;
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        uint32_t num_corners = 3 * model->shapes[s].num_faces;
+        max_corners = num_corners > max_corners ? num_corners : max_corners;
+    }
+
+    int32_t num_shapes = model->num_shapes;
+    __wf_instancing_t inst = {
+        .data = data,
+        .model = model,
+        .hashes = memory_malloc(sizeof(__wf_shape_hash_t) * num_shapes),
+        .prototypes = memory_malloc(sizeof(int32_t) * num_shapes),
+        .num_repeats = memory_calloc(num_shapes, sizeof(int32_t)),
+        .transforms = memory_malloc(sizeof(transform_t) * num_shapes),
+        .remap = memory_malloc(sizeof(uint32_t) * mesh->num_vertices),
+        .corners = memory_malloc(sizeof(uint32_t) * 2 * max_corners),
+        .vertices = memory_malloc(sizeof(uint32_t) * 2 * max_corners),
+        .max_corners = max_corners
+    };
+
+    __wf_instance_group_t* groups = memory_malloc(
+        sizeof(__wf_instance_group_t) * num_shapes);
+
+    bool succeeded = inst.hashes && inst.prototypes && inst.num_repeats
+        && inst.transforms && inst.remap && inst.corners && inst.vertices
+        && groups;
+
+    int32_t num_hashes = 0;
+    if (succeeded) {
+        memset(inst.prototypes, 0xff, sizeof(int32_t) * num_shapes);
+        memset(inst.remap, 0xff, sizeof(uint32_t) * mesh->num_vertices);
+
+        // small shapes are not worth a model of their own
+        for (int32_t s = 0; s < num_shapes; ++s) {
+            const wavefront_shape_t* shape = &model->shapes[s];
+            if (shape->num_faces >= WAVEFRONT_INSTANCE_MIN_FACES) {
+                uint32_t num_vertices = __wf_localize_shape(mesh, shape,
+                    inst.remap, inst.corners, inst.vertices);
+                inst.hashes[num_hashes++] = (__wf_shape_hash_t){
+                    .hash = __wf_hash_shape(mesh, shape, inst.corners,
+                        inst.vertices, num_vertices),
+                    .shape = s
+                };
+            }
+        }
+
+        qsort(inst.hashes, (size_t)num_hashes, sizeof(__wf_shape_hash_t),
+            __wf_compare_shape_hashes);
+
+        for (int32_t first = 0, last = 1; first < num_hashes; first = last++) {
+            while (last < num_hashes
+                && inst.hashes[last].hash == inst.hashes[first].hash) {
+                ++last;
+            }
+
+            __wf_group_repeats(&inst, first, last);
+        }
+
+        int32_t num_groups = __wf_select_groups(&inst, groups);
+        if (num_groups > 0) {
+            succeeded = __wf_rebuild_instanced_mesh(&inst, groups, num_groups);
+            if (succeeded) {
+                LOG_INFO("Wavefront instanced %d shapes, %d times (%s)\n",
+                    num_groups, model->num_instances, data->label);
+            }
+        }
+    }
+
+    if (inst.hashes) memory_free(inst.hashes);
+    if (inst.prototypes) memory_free(inst.prototypes);
+    if (inst.num_repeats) memory_free(inst.num_repeats);
+    if (inst.transforms) memory_free(inst.transforms);
+    if (inst.remap) memory_free(inst.remap);
+    if (inst.corners) memory_free(inst.corners);
+    if (inst.vertices) memory_free(inst.vertices);
+    if (groups) memory_free(groups);
+    return succeeded;
+}
+
+// state of the fused parser, which reads the object in a single
+// pass, emitting the final vertices and indices straight away.
+// vertices are those of the position lines, which faces assign
+// normals and uvs to, from the only pools kept for them.
+// faces can be dropped from the mesh, once streamed, and then
+// the first of its indices is the face after them.
+typedef struct {
+    const wavefront_data_t* data;
+    wavefront_model_t* model;
+    wavefront_mesh_t* mesh;
+    uint32_t first_face;
+    uint32_t vertices_capacity;
+    uint32_t indices_capacity;
+    uint32_t shapes_capacity;
+    float* normals;     // xyz
+    uint32_t num_normals;
+    uint32_t normals_capacity;
+    float* uvs;         // uv
+    uint32_t num_uvs;
+    uint32_t uvs_capacity;
+    tinyobj_material_t* materials;
+    size_t num_materials;
+    int32_t material;   // of the following faces, -1 if none
+    trace_t group;      // of the following faces
+    bool group_changed;
+} __wf_parser_t;
+
+// make room for count more elements, growing by doubling, up
+// to the most elements that 32-bit indices can refer to.
+static bool __wf_reserve(const wavefront_data_t* data, void** array,
+    uint32_t* capacity, uint32_t size, uint32_t count, size_t element_size) {
+    uint64_t required = (uint64_t)size + count;
+    if (required <= *capacity) {
+        return true;
+    }
+
+    if (required > UINT32_MAX) {
+        return false;
+    }
+
+    uint64_t new_capacity = *capacity ? (uint64_t)*capacity * 2 : 1024;
+    while (new_capacity < required) {
+        new_capacity *= 2;
+    }
+
+    if (new_capacity > UINT32_MAX) {
+        new_capacity = UINT32_MAX;
+    }
+
+    if (new_capacity > SIZE_MAX / element_size) {
+        return false;
+    }
+
+    void* new_array = data->allocator(*array, element_size * (size_t)new_capacity);
+    if (!new_array) {
+        return false;
+    }
+
+    *array = new_array;
+    *capacity = (uint32_t)new_capacity;
+    return true;
+}
+
+static bool __wf_is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* __wf_skip_spaces(const char* p, const char* end) {
+    while (p < end && __wf_is_space(*p)) {
+        ++p;
+    }
+
+    return p;
+}
+
+// powers of ten exactly representable by doubles
+static const double __wf_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// decimal number, with optional fraction and exponent, as written by
+// modelling tools. a missing number reads as zero, consuming nothing.
+static const char* __wf_parse_float(const char* p, const char* end, float* out) {
+    p = __wf_skip_spaces(p, end);
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    // up to 19 significant digits fit the mantissa, the rest scale it
+    uint64_t mantissa = 0;
+    int32_t exponent = 0;
+    int32_t digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+        if (digits < 19) mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+        else ++exponent;
+    }
+
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+                --exponent;
+            }
+        }
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative_exponent = *p++ == '-';
+        }
+
+        int32_t value = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            value = (value < 1000) ? value * 10 + (*p - '0') : value;
+        }
+
+        exponent += negative_exponent ? -value : value;
+    }
+
+    double value = (double)mantissa;
+    while (exponent < -22) {
+        value /= 1e22;
+        exponent += 22;
+    }
+
+    while (exponent > 22) {
+        value *= 1e22;
+        exponent -= 22;
+    }
+
+    value = (exponent < 0)
+        ? value / __wf_pow10[-exponent]
+        : value * __wf_pow10[exponent];
+
+    *out = (float)(negative ? -value : value);
+    return p;
+}
+
+static const char* __wf_parse_int(const char* p, const char* end, int64_t* out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p++ == '-';
+    }
+
+    int64_t value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+        value = (value <= UINT32_MAX) ? value * 10 + (*p - '0') : value;
+    }
+
+    *out = negative ? -value : value;
+    return p;
+}
+
+// obj indices are 1-based, or relative to the end if negative,
+// resolved against the count of the elements defined so far.
+// returns -1 if missing, or out of range.
+static int64_t __wf_resolve_index(int64_t index, uint32_t count) {
+    int64_t resolved = (index > 0) ? index - 1 : (int64_t)count + index;
+    return (index != 0 && resolved >= 0 && resolved < count) ? resolved : -1;
+}
+
+// rest of the line, without trailing spaces
+static void __wf_parse_name(const char* p, const char* end,
+    char* name, size_t size) {
+    p = __wf_skip_spaces(p, end);
+    const char* last = end;
+    while (last > p && __wf_is_space(last[-1])) {
+        --last;
+    }
+
+    size_t length = (size_t)(last - p);
+    length = (length < size - 1) ? length : size - 1;
+    memcpy(name, p, length);
+    name[length] = '\0';
+}
+
+// assign the corner's attributes to its vertex, returning its index,
+// or -1 if any of the indices is out of range.
+static int64_t __wf_parse_corner(__wf_parser_t* parser,
+    const char** cursor, const char* end) {
+    const wavefront_data_t* data = parser->data;
+    wavefront_mesh_t* mesh = parser->mesh;
+    const char* p = *cursor;
+
+    int64_t v = 0, vt = 0, vn = 0;
+    p = __wf_parse_int(p, end, &v);
+    if (p < end && *p == '/') {
+        p = __wf_parse_int(p + 1, end, &vt);
+        if (p < end && *p == '/') {
+            p = __wf_parse_int(p + 1, end, &vn);
+        }
+    }
+
+    *cursor = p;
+
+    int64_t vertex = __wf_resolve_index(v, mesh->num_vertices);
+    if (vertex < 0) {
+        return -1;
+    }
+
+    vertex_t* dst = &mesh->vertices[vertex];
+    if (vt) {
+        int64_t uv = __wf_resolve_index(vt, parser->num_uvs);
+        if (uv < 0) {
+            return -1;
+        }
+
+        // images are stored top row first, while
+        // wavefront v coordinate goes bottom up.
+        dst->uv = (vec2f_t){
+            .x = parser->uvs[2 * uv + 0],
+            .y = 1.f - parser->uvs[2 * uv + 1]
+        };
+    }
+
+    // without normals, they are left to zero, to be computed later
+    if (vn && !(data->import_options & WAVEFRONT_IMPORT_CALC_NORMALS)) {
+        int64_t normal = __wf_resolve_index(vn, parser->num_normals);
+        if (normal < 0) {
+            return -1;
+        }
+
+        mfloat_t sign = (data->import_options & WAVEFRONT_IMPORT_FLIP_NORMALS)
+            ? -1.f : 1.f;
+        dst->norm = (vec3f_t){
+            .x = sign * parser->normals[3 * normal + 0],
+            .y = sign * parser->normals[3 * normal + 1],
+            .z = sign * parser->normals[3 * normal + 2]
+        };
+    }
+
+    return vertex;
+}
+
+// a new shape begins whenever either the object
+// group or the material of the faces changes.
+static bool __wf_open_shape(__wf_parser_t* parser) {
+    wavefront_model_t* model = parser->model;
+    wavefront_shape_t* shape = model->num_shapes > 0
+        ? &model->shapes[model->num_shapes - 1] : NULL;
+    if (shape && !parser->group_changed
+        && shape->material_id == parser->material) {
+        return true;
+    }
+
+    shape = __wf_push_shape(parser->data, model, &parser->shapes_capacity);
+    if (!shape) {
+        LOG_WARN("WARN: Not enough memory for shapes of (%s)\n",
+            parser->data->label);
+        return false;
+    }
+
+    shape->material_id = parser->material;
+    shape->base_face_id = parser->first_face + parser->mesh->num_indices / 3;
+    trace_copy(&shape->trace, &parser->group);
+    parser->group_changed = false;
+    return true;
+}
+
+// triangulate the face as a fan around its first corner
+static wavefront_result_t __wf_parse_face(__wf_parser_t* parser,
+    const char* p, const char* end) {
+    const wavefront_data_t* data = parser->data;
+    wavefront_model_t* model = parser->model;
+    wavefront_mesh_t* mesh = parser->mesh;
+
+    bool rewind = data->import_options & WAVEFRONT_IMPORT_REWIND_FACES;
+    int64_t first = -1;
+    int64_t previous = -1;
+    uint32_t corners = 0;
+
+    for (p = __wf_skip_spaces(p, end); p < end; p = __wf_skip_spaces(p, end)) {
+        int64_t vertex = __wf_parse_corner(parser, &p, end);
+        if (vertex < 0) {
+            return WAVEFRONT_RESULT_FACES_OUT_OF_RANGE;
+        }
+
+        // skip whatever follows an unexpected character
+        while (p < end && !__wf_is_space(*p)) {
+            ++p;
+        }
+
+        if (corners >= 2) {
+            if (!__wf_open_shape(parser)
+                || !__wf_reserve(data, (void**)&mesh->indices,
+                &parser->indices_capacity, mesh->num_indices, 3,
+                sizeof(uint32_t))) {
+                return WAVEFRONT_RESULT_MESH_MALFORMED;
+            }
+
+            // by default counter clockwise triangles are expected,
+            // while objects can be defined with the other winding
+            uint32_t* triangle = &mesh->indices[mesh->num_indices];
+            triangle[0] = (uint32_t)first;
+            triangle[1] = (uint32_t)(rewind ? vertex : previous);
+            triangle[2] = (uint32_t)(rewind ? previous : vertex);
+            mesh->num_indices += 3;
+            model->shapes[model->num_shapes - 1].num_faces++;
+        }
+
+        first = (corners == 0) ? vertex : first;
+        previous = vertex;
+        ++corners;
+    }
+
+    return WAVEFRONT_RESULT_OK;
+}
+
+// materials are looked for next to the object first, as textures
+static void __wf_parse_mtllib(__wf_parser_t* parser,
+    const char* p, const char* end) {
+    if (parser->materials) {
+        LOG_WARN("WARN: Only the first material library is loaded (%s)\n",
+            parser->data->label);
+        return;
+    }
+
+    char name[WAVEFRONT_MAX_PATH];
+    __wf_parse_name(p, end, name, sizeof(name));
+
+    char path[WAVEFRONT_MAX_PATH];
+    const char* base_path = parser->data->base_path;
+    if (base_path && base_path[0]) {
+        snprintf(path, sizeof(path), "%s/%s", base_path, name);
+    }
+    else {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+
+    if (tinyobj_parse_mtl_file(&parser->materials,
+        &parser->num_materials, path) != TINYOBJ_SUCCESS
+        && tinyobj_parse_mtl_file(&parser->materials,
+        &parser->num_materials, name) != TINYOBJ_SUCCESS) {
+        LOG_WARN("WARN: Cannot load material library (%s)\n", path);
+        parser->materials = NULL;
+        parser->num_materials = 0;
+    }
+}
+
+static void __wf_parse_usemtl(__wf_parser_t* parser,
+    const char* p, const char* end) {
+    char name[WAVEFRONT_MAX_PATH];
+    __wf_parse_name(p, end, name, sizeof(name));
+
+    parser->material = -1;
+    for (size_t m = 0; m < parser->num_materials; ++m) {
+        if (parser->materials[m].name
+            && strcmp(parser->materials[m].name, name) == 0) {
+            parser->material = (int32_t)m;
+            break;
+        }
+    }
+}
+
+static wavefront_result_t __wf_parse_line(__wf_parser_t* parser,
+    const char* p, const char* end) {
+    const wavefront_data_t* data = parser->data;
+    wavefront_mesh_t* mesh = parser->mesh;
+
+    p = __wf_skip_spaces(p, end);
+    if (end - p < 2) {
+        return WAVEFRONT_RESULT_OK;
+    }
+
+    if (p[0] == 'v' && __wf_is_space(p[1])) {
+        if (!__wf_reserve(data, (void**)&mesh->vertices,
+            &parser->vertices_capacity, mesh->num_vertices, 1,
+            sizeof(vertex_t))) {
+            return WAVEFRONT_RESULT_MESH_MALFORMED;
+        }
+
+        vertex_t* vertex = &mesh->vertices[mesh->num_vertices++];
+        memset(vertex, 0, sizeof(vertex_t));
+        p = __wf_parse_float(p + 1, end, &vertex->pos.x);
+        p = __wf_parse_float(p, end, &vertex->pos.y);
+        __wf_parse_float(p, end, &vertex->pos.z);
+    }
+    else if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && __wf_is_space(p[2])) {
+        if (!__wf_reserve(data, (void**)&parser->normals,
+            &parser->normals_capacity, parser->num_normals, 1,
+            3 * sizeof(float))) {
+            return WAVEFRONT_RESULT_MESH_MALFORMED;
+        }
+
+        float* normal = &parser->normals[3 * parser->num_normals++];
+        p = __wf_parse_float(p + 2, end, &normal[0]);
+        p = __wf_parse_float(p, end, &normal[1]);
+        __wf_parse_float(p, end, &normal[2]);
+    }
+    else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && __wf_is_space(p[2])) {
+        if (!__wf_reserve(data, (void**)&parser->uvs,
+            &parser->uvs_capacity, parser->num_uvs, 1, 2 * sizeof(float))) {
+            return WAVEFRONT_RESULT_MESH_MALFORMED;
+        }
+
+        float* uv = &parser->uvs[2 * parser->num_uvs++];
+        p = __wf_parse_float(p + 2, end, &uv[0]);
+        __wf_parse_float(p, end, &uv[1]);
+    }
+    else if (p[0] == 'f' && __wf_is_space(p[1])) {
+        return __wf_parse_face(parser, p + 1, end);
+    }
+    else if ((p[0] == 'o' || p[0] == 'g') && __wf_is_space(p[1])) {
+        char name[TRACE_MAX_NAME_CHARS];
+        __wf_parse_name(p + 1, end, name, sizeof(name));
+        trace_printf(&parser->group, "%s", name[0] ? name : data->label);
+        parser->group_changed = true;
+    }
+    else if (end - p > 7 && strncmp(p, "usemtl", 6) == 0 && __wf_is_space(p[6])) {
+        __wf_parse_usemtl(parser, p + 6, end);
+    }
+    else if (end - p > 7 && strncmp(p, "mtllib", 6) == 0 && __wf_is_space(p[6])) {
+        __wf_parse_mtllib(parser, p + 6, end);
+    }
+
+    return WAVEFRONT_RESULT_OK;
+}
+
+static wavefront_result_t __wf_parser_begin(const wavefront_data_t* data,
+    wavefront_model_t* model, __wf_parser_t* parser) {
+    assert(data && model && parser);
+
+    if (!(data->import_options & WAVEFRONT_IMPORT_TRIANGULATE)) {
+        LOG_WARN("WARN: Non triangulated is not supported yet\n");
+        return WAVEFRONT_RESULT_INVALID_OBJECT;
+    }
+
+    wavefront_mesh_t* mesh = data->allocator(NULL, sizeof(wavefront_mesh_t));
+    if (!mesh) {
+        return WAVEFRONT_RESULT_MESH_MALFORMED;
+    }
+
+    memset(mesh, 0, sizeof(wavefront_mesh_t));
+    model->shapes = NULL;
+    model->num_shapes = 0;
+    model->allocator = data->allocator;
+    model->mesh = mesh;
+    model->num_lods = (data->import_options & WAVEFRONT_IMPORT_GENERATE_LODS)
+        ? GEOMETRY_PASS_MAX_LODS : 1;
+    trace_printf(&model->trace, "%s", data->label);
+
+    *parser = (__wf_parser_t){
+        .data = data,
+        .model = model,
+        .mesh = mesh,
+        .material = -1
+    };
+
+    trace_printf(&parser->group, "%s", data->label);
+    return WAVEFRONT_RESULT_OK;
+}
+
+// parse the lines between cursor and end, the last of which
+// does not need to be terminated, as it ends the text anyway.
+static wavefront_result_t __wf_parse_lines(__wf_parser_t* parser,
+    const char* cursor, const char* end) {
+    wavefront_result_t result = WAVEFRONT_RESULT_OK;
+    while (cursor < end && result == WAVEFRONT_RESULT_OK) {
+        const char* line_end = memchr(cursor, '\n', (size_t)(end - cursor));
+        line_end = line_end ? line_end : end;
+
+        // comments and the null terminator are skipped altogether
+        if (*cursor != '#' && *cursor != '\0') {
+            result = __wf_parse_line(parser, cursor, line_end);
+        }
+
+        cursor = line_end + 1;
+    }
+
+    return result;
+}
+
+// release the parser, and the mesh too if the result is a failure.
+// shapes bounds are computed only if no face has been streamed.
+static wavefront_result_t __wf_parser_end(__wf_parser_t* parser,
+    wavefront_result_t result, tinyobj_material_t** out_materials,
+    size_t* out_num_materials) {
+    const wavefront_data_t* data = parser->data;
+    wavefront_model_t* model = parser->model;
+    wavefront_mesh_t* mesh = parser->mesh;
+
+    if (parser->normals) data->allocator(parser->normals, 0);
+    if (parser->uvs) data->allocator(parser->uvs, 0);
+
+    uint32_t num_faces = parser->first_face + mesh->num_indices / 3;
+    if (result == WAVEFRONT_RESULT_OK
+        && (num_faces == 0 || model->num_shapes == 0)) {
+        result = WAVEFRONT_RESULT_INVALID_OBJECT;
+    }
+
+    if (result != WAVEFRONT_RESULT_OK) {
+        LOG_WARN("WARN: Cannot parse object (%s), error %d\n",
+            data->label, result);
+        if (mesh->vertices) data->allocator(mesh->vertices, 0);
+        if (mesh->indices) data->allocator(mesh->indices, 0);
+        if (model->shapes) data->allocator(model->shapes, 0);
+        if (parser->materials) {
+            tinyobj_materials_free(parser->materials, parser->num_materials);
+        }
+
+        data->allocator(mesh, 0);
+        model->mesh = NULL;
+        model->shapes = NULL;
+        model->num_shapes = 0;
+        return result;
+    }
+
+    LOG_INFO("Wavefront parsed object (vertices=%u, faces=%u, materials=%zd)\n",
+        mesh->num_vertices, num_faces, parser->num_materials);
+
+    if (parser->first_face == 0) {
+        __wf_compute_shapes_bounds(mesh, model->shapes, model->num_shapes);
+    }
+
+    LOG_INFO("Wavefront built %d shapes for (%s)\n",
+        model->num_shapes, data->label);
+
+    *out_materials = parser->materials;
+    *out_num_materials = parser->num_materials;
+    return WAVEFRONT_RESULT_OK;
+}
+
+// parse the object into mesh and shapes in a single pass, without
+// intermediate face arrays. returns the materials, like tinyobj.
+static wavefront_result_t __wf_parse_geometry_fused(const wavefront_data_t* data,
+    wavefront_model_t* model, tinyobj_material_t** out_materials,
+    size_t* out_num_materials) {
+    __wf_parser_t parser;
+    wavefront_result_t result = __wf_parser_begin(data, model, &parser);
+    if (result != WAVEFRONT_RESULT_OK) {
+        return result;
+    }
+
+    const char* cursor = (const char*)data->obj_data;
+    result = __wf_parse_lines(&parser, cursor, cursor + data->data_size);
+    return __wf_parser_end(&parser, result, out_materials, out_num_materials);
+}
+
+// parse the object with tinyobj into mesh and shapes, leaving
+// materials, which are returned to be loaded, to the caller to release.
+static wavefront_result_t __wf_parse_geometry_tinyobj(const wavefront_data_t* data,
+    wavefront_model_t* model, tinyobj_material_t** out_materials,
+    size_t* out_num_materials) {
+    assert(data && model);
+
+    tinyobj_attrib_t attribs;
+    
+    tinyobj_shape_t* shapes = NULL;
+    size_t num_shapes = 0;
+
+    tinyobj_material_t* materials = NULL;
+    size_t num_materials = 0;
+
+    // load wavefront data
+    {
+        if (!(data->import_options & WAVEFRONT_IMPORT_TRIANGULATE)) {
+            LOG_WARN("WARN: Non triangulated is not supported yet¬\n");
+            return WAVEFRONT_RESULT_INVALID_OBJECT;
+        }
+
+        int32_t parse_result = tinyobj_parse_obj(
+            &attribs, &shapes, &num_shapes, &materials,
+            &num_materials, data->obj_data, data->data_size,
+            TINYOBJ_FLAG_TRIANGULATE);
+
+        if (parse_result != TINYOBJ_SUCCESS) {
+            return WAVEFRONT_RESULT_INVALID_OBJECT;
+        }
+
+        LOG_INFO("Wavefront parsed object (shapes=%zd, materials=%zd)\n",
+            num_shapes, num_materials);
+
+        if (shapes != NULL && num_shapes > 0) {
+            __wf_print_shapes(shapes, num_shapes);
+        }
+        else {
+            return WAVEFRONT_RESULT_INVALID_OBJECT;
+        }
+    }
+
+    assert(attribs.num_vertices && attribs.num_faces);
+
+    wavefront_mesh_t* mesh = data->allocator(NULL, sizeof(wavefront_mesh_t));
+    mesh->num_indices = attribs.num_faces;
+    mesh->num_vertices = attribs.num_vertices;
+
+    mesh->vertices = data->allocator(NULL, sizeof(vertex_t) * mesh->num_vertices);
+    mesh->indices = data->allocator(NULL, sizeof(uint32_t) * mesh->num_indices);
+
+    uint32_t i_idx = 0;
+    uint32_t face_offset = 0;
+
+    // shapes are built while walking through surface lines
+    model->shapes = NULL;
+    model->num_shapes = 0;
+    uint32_t shapes_capacity = 0;
+    uint32_t tinyobj_shape = 0;
+    wavefront_shape_t* shape = NULL;
+
+    assert(attribs.num_face_num_verts > 0);
+    uint32_t num_surface_lines = (uint32_t)attribs.num_face_num_verts;
+    for (uint32_t i = 0; i < num_surface_lines; ++i) {
+
+        // number of vertices per face, likely 3 or 6
+        uint32_t surface_verts = (uint32_t)attribs.face_num_verts[i];
+        
+        // assume all triangle faces because
+        // of TINYOBJ_FLAG_TRIANGULATE
+        assert(surface_verts % 3 == 0);
+
+        // e.g. 2 triangles per quad
+        uint32_t num_surface_triangles = surface_verts / 3;
+
+        // a new shape begins whenever either the object
+        // group or the material of the surface changes.
+        uint32_t surface_shape = __wf_find_shape(shapes, num_shapes,
+            tinyobj_shape, i);
+        int32_t surface_material = attribs.material_ids
+            ? attribs.material_ids[i] : -1;
+        if (!shape || surface_shape != tinyobj_shape
+            || surface_material != shape->material_id) {
+            shape = __wf_push_shape(data, model, &shapes_capacity);
+            if (!shape) {
+                LOG_WARN("WARN: Not enough memory for shapes of (%s)\n",
+                    data->label);
+                return WAVEFRONT_RESULT_MESH_MALFORMED;
+            }
+
+            shape->material_id = surface_material;
+            shape->base_face_id = i_idx / 3;
+            trace_printf(&shape->trace, "%s",
+                shapes[surface_shape].name ? shapes[surface_shape].name : data->label);
+            tinyobj_shape = surface_shape;
+        }
+
+        shape->num_faces += num_surface_triangles;
+        for (uint32_t f = 0; f < num_surface_triangles; ++f) {
+            uint32_t f_idx = 3 * f + face_offset;
+
+            // read all 3 vertex info at once
+            tinyobj_vertex_index_t idx0 = attribs.faces[f_idx + 0];
+            tinyobj_vertex_index_t idx1 = attribs.faces[f_idx + 1];
+            tinyobj_vertex_index_t idx2 = attribs.faces[f_idx + 2];
+
+            // populate element indices array
+            mesh->indices[i_idx++] = idx0.v_idx;
+
+            // by default the we expect counter clock wise
+            // trinangles, but objects can be defined differently.
+            // therefore, we need a way to make the model consistent
+            // with the face winding of the render pass.s
+            if (data->import_options & WAVEFRONT_IMPORT_REWIND_FACES) {
+                mesh->indices[i_idx++] = idx2.v_idx;
+                mesh->indices[i_idx++] = idx1.v_idx;
+            }
+            else {
+                mesh->indices[i_idx++] = idx1.v_idx;
+                mesh->indices[i_idx++] = idx2.v_idx;
+            }
+
+            // normals, and tex coordinates can be <= positions.
+            // this allows us to duplicate normals and uv
+            // into the mesh vertex buffer without taking
+            // into consideration whether a normal or a set
+            // of uv have already been read.
+            assert(idx0.v_idx < mesh->num_vertices);
+            assert(idx1.v_idx < mesh->num_vertices);
+            assert(idx1.v_idx < mesh->num_vertices);
+
+            // set vertices positions
+            mesh->vertices[idx0.v_idx].pos = (vec3f_t){
+                .x = attribs.vertices[3 * idx0.v_idx + 0],
+                .y = attribs.vertices[3 * idx0.v_idx + 1],
+                .z = attribs.vertices[3 * idx0.v_idx + 2]
+            };
+            mesh->vertices[idx1.v_idx].pos = (vec3f_t){
+                .x = attribs.vertices[3 * idx1.v_idx + 0],
+                .y = attribs.vertices[3 * idx1.v_idx + 1],
+                .z = attribs.vertices[3 * idx1.v_idx + 2]
+            };
+            mesh->vertices[idx2.v_idx].pos = (vec3f_t){
+                .x = attribs.vertices[3 * idx2.v_idx + 0],
+                .y = attribs.vertices[3 * idx2.v_idx + 1],
+                .z = attribs.vertices[3 * idx2.v_idx + 2]
+            };
+
+            // set normals if provided and the
+            // flag on import options is not set
+            if (attribs.num_normals &&
+                !(data->import_options & WAVEFRONT_IMPORT_CALC_NORMALS)) {
+
+                // if normals are provided, then all of them must be
+                assert(idx0.vn_idx >= 0 && idx1.vn_idx >= 0 && idx2.vn_idx >= 0);
+                mesh->vertices[idx0.v_idx].norm = (vec3f_t){
+                    .x = attribs.normals[3 * idx0.vn_idx + 0],
+                    .y = attribs.normals[3 * idx0.vn_idx + 1],
+                    .z = attribs.normals[3 * idx0.vn_idx + 2]
+                };
+                mesh->vertices[idx1.v_idx].norm = (vec3f_t){
+                    .x = attribs.normals[3 * idx1.vn_idx + 0],
+                    .y = attribs.normals[3 * idx1.vn_idx + 1],
+                    .z = attribs.normals[3 * idx1.vn_idx + 2]
+                };
+                mesh->vertices[idx2.v_idx].norm = (vec3f_t){
+                    .x = attribs.normals[3 * idx2.vn_idx + 0],
+                    .y = attribs.normals[3 * idx2.vn_idx + 1],
+                    .z = attribs.normals[3 * idx2.vn_idx + 2]
+                };
+            }
+            else {
+                // set normals to zero, as they
+                // will be computed later, once
+                // all faces are set finally.
+                mesh->vertices[idx0.v_idx].norm = svec3_zero();
+                mesh->vertices[idx1.v_idx].norm = svec3_zero();
+                mesh->vertices[idx2.v_idx].norm = svec3_zero();
+            }
+
+            if (data->import_options & WAVEFRONT_IMPORT_FLIP_NORMALS) {
+                mesh->vertices[idx0.v_idx].norm = svec3_multiply_f(
+                    mesh->vertices[idx0.v_idx].norm, -1.f
+                );
+                mesh->vertices[idx1.v_idx].norm = svec3_multiply_f(
+                    mesh->vertices[idx1.v_idx].norm, -1.f
+                );
+                mesh->vertices[idx2.v_idx].norm = svec3_multiply_f(
+                    mesh->vertices[idx1.v_idx].norm, -1.f
+                );
+            }
+
+            // set texture coordinates
+            if (attribs.num_texcoords > 0) {
+
+                // if texcoords are provided, then all of them must be
+                assert(idx0.vt_idx >= 0 && idx1.vt_idx >= 0 && idx2.vt_idx >= 0);
+                // images are stored top row first, while
+                // wavefront v coordinate goes bottom up.
+                mesh->vertices[idx0.v_idx].uv = (vec2f_t){
+                    .x = attribs.texcoords[2 * idx0.vt_idx + 0],
+                    .y = 1.f - attribs.texcoords[2 * idx0.vt_idx + 1]
+                };
+                mesh->vertices[idx1.v_idx].uv = (vec2f_t){
+                    .x = attribs.texcoords[2 * idx1.vt_idx + 0],
+                    .y = 1.f - attribs.texcoords[2 * idx1.vt_idx + 1]
+                };
+                mesh->vertices[idx2.v_idx].uv = (vec2f_t){
+                    .x = attribs.texcoords[2 * idx2.vt_idx + 0],
+                    .y = 1.f - attribs.texcoords[2 * idx2.vt_idx + 1]
+                };
+            }
+            else {
+                // if no texture coordinates are provided,
+                // then set uv to zero and recompute them
+                // based on material colors, later in the
+                // the process.
+                mesh->vertices[idx0.v_idx].uv = svec2_zero();
+                mesh->vertices[idx1.v_idx].uv = svec2_zero();
+                mesh->vertices[idx2.v_idx].uv = svec2_zero();
+            }
+        }
+
+        face_offset += surface_verts;
+    }
+
+    assert(face_offset == mesh->num_indices);
+    assert(i_idx == face_offset);
+
+    if (face_offset > 0)
+    {
+        __wf_compute_shapes_bounds(mesh, model->shapes, model->num_shapes);
+        LOG_INFO("Wavefront built %d shapes for (%s)\n",
+            model->num_shapes, data->label);
+
+        tinyobj_attrib_free(&attribs);
+        tinyobj_shapes_free(shapes, num_shapes);
+        *out_materials = materials;
+        *out_num_materials = num_materials;
+
+        model->allocator = data->allocator;
+        model->mesh = mesh;
+        model->num_lods = (data->import_options & WAVEFRONT_IMPORT_GENERATE_LODS)
+            ? GEOMETRY_PASS_MAX_LODS : 1;
+        trace_printf(&model->trace, "%s", data->label);
+
+        return WAVEFRONT_RESULT_OK;
+    }
+
+    return WAVEFRONT_RESULT_MESH_MALFORMED;
+}
+
+static wavefront_result_t __wf_parse_geometry(const wavefront_data_t* data,
+    wavefront_model_t* model, tinyobj_material_t** out_materials,
+    size_t* out_num_materials) {
+    if (data->import_options & WAVEFRONT_IMPORT_USE_TINYOBJ) {
+        return __wf_parse_geometry_tinyobj(data, model,
+            out_materials, out_num_materials);
+    }
+
+    return __wf_parse_geometry_fused(data, model,
+        out_materials, out_num_materials);
+}
+
+// weld the vertices which are identical, order the faces of each
+// shape for the vertex cache, and then the vertices in order of use.
+// shapes are optimised on their own, as they are drawn separately.
+static bool __wf_optimize_mesh(const wavefront_data_t* data,
+    wavefront_model_t* model) {
+    if (!(data->import_options & WAVEFRONT_IMPORT_OPTIMIZE_MESH)) {
+        return true;
+    }
+
+    wavefront_mesh_t* mesh = model->mesh;
+    uint32_t num_vertices = mesh->num_vertices;
+    mesh->num_vertices = optimize_weld_vertices(mesh->vertices,
+        sizeof(vertex_t), mesh->num_vertices, mesh->indices, mesh->num_indices);
+
+    bool succeeded = true;
+    for (int32_t s = 0; s < model->num_shapes && succeeded; ++s) {
+        const wavefront_shape_t* shape = &model->shapes[s];
+        succeeded = optimize_vertex_cache(
+            mesh->indices + 3 * shape->base_face_id,
+            3 * shape->num_faces, mesh->num_vertices);
+    }
+
+    mesh->num_vertices = optimize_vertex_fetch(mesh->vertices,
+        sizeof(vertex_t), mesh->num_vertices, mesh->indices, mesh->num_indices);
+
+    // vertices have moved, and so have the shapes ones
+    __wf_compute_shapes_bounds(mesh, model->shapes, model->num_shapes);
+    LOG_INFO("Wavefront optimised mesh of (%s), vertices %u -> %u\n",
+        data->label, num_vertices, mesh->num_vertices);
+
+    return succeeded;
+}
+
+wavefront_result_t wavefront_parse_obj(const wavefront_data_t* data,
+    wavefront_model_t* model) {
+    assert(data && model);
+
+    tinyobj_material_t* materials = NULL;
+    size_t num_materials = 0;
+    model->instances = NULL;
+    model->num_instances = 0;
+
+    wavefront_result_t result = __wf_parse_geometry(data, model,
+        &materials, &num_materials);
+    if (result != WAVEFRONT_RESULT_OK) {
+        return result;
+    }
+
+    if (!__wf_detect_instances(data, model)) {
+        LOG_WARN("WARN: Not enough memory to detect instances of (%s)\n",
+            data->label);
+    }
+
+    // shapes without material are drawn with the default one
+    if (!__wf_load_materials(data, materials,
+        (uint32_t)num_materials, model)) {
+        LOG_WARN("WARN: Not enough memory for materials of (%s)\n",
+            data->label);
+    }
+    else if (!__wf_pack_atlas(data, model)) {
+        LOG_WARN("WARN: Not enough memory to pack materials of (%s)\n",
+            data->label);
+    }
+
+    if (!__wf_optimize_mesh(data, model)) {
+        LOG_WARN("WARN: Not enough memory to optimise the mesh of (%s)\n",
+            data->label);
+    }
+
+    tinyobj_materials_free(materials, num_materials);
+    return WAVEFRONT_RESULT_OK;
+}
+
+void wavefront_release_obj(wavefront_model_t* model) {
+    assert(model && model->mesh);
+    
+    // release mesh resources, already gone if streamed from file
+    if (model->mesh->indices) model->allocator(model->mesh->indices, 0);
+    if (model->mesh->vertices) model->allocator(model->mesh->vertices, 0);
+    model->allocator(model->mesh, 0);
+    model->mesh = NULL;
+
+    // release material's images
+    for (int32_t m = 0; m < model->num_materials; ++m) {
+        model->allocator(model->diffuseRGB_alphaA[m].pixels, 0);
+        model->allocator(model->emissiveXYZ_specularW[m].pixels, 0);
+        model->allocator(model->normalXY_dispZ_aoW[m].pixels, 0);
+    }
+
+    model->allocator(model->diffuseRGB_alphaA, 0);
+    model->allocator(model->emissiveXYZ_specularW, 0);
+    model->allocator(model->normalXY_dispZ_aoW, 0);
+    model->num_materials = 0;
+
+    // release shapes
+    model->allocator(model->shapes, 0);
+    if (model->instances) {
+        model->allocator(model->instances, 0);
+        model->instances = NULL;
+        model->num_instances = 0;
+    }
+}
+
+// the default material is returned for those without images
+static material_id_t __wf_make_material(geometry_pass_t* pass,
+    const wavefront_model_t* model, int32_t m) {
+    const wavefront_image_t* albedo = &model->diffuseRGB_alphaA[m];
+    const wavefront_image_t* emissive = &model->emissiveXYZ_specularW[m];
+    if (!albedo->pixels || !emissive->pixels) {
+        return geometry_pass_get_default_material(pass);
+    }
+
+    trace_t mat_trace;
+    trace_printf(&mat_trace, "%s-mat%d", model->trace.name, m);
+
+    material_id_t mat = geometry_pass_make_material(pass, &(material_desc_t){
+        .albedo = &(image_desc_t){
+            .width = albedo->width,
+            .height = albedo->height,
+            .layers = albedo->layers,
+            .pixels = albedo->pixels
+        },
+        .emissive = &(image_desc_t){
+            .width = emissive->width,
+            .height = emissive->height,
+            .layers = emissive->layers,
+            .pixels = emissive->pixels
+        },
+        .label = mat_trace.name
+    });
+
+    if (!handle_is_valid(mat, GEOMETRY_PASS_MAX_MATERIALS)) {
+        return geometry_pass_get_default_material(pass);
+    }
+
+    return mat;
+}
+
+// consecutive shapes sharing the same material are drawn as a single
+// submesh, with its levels of detail, as long as there are enough
+// draws for all of them. models packed into an atlas have only one.
+// instanced shapes, whose faces follow the others, are left out.
+static bool __wf_build_model_mesh(jobs_t* jobs, const wavefront_model_t* model,
+    vertex_layout_t layout, mesh_data_t* out_data, int32_t* out_submesh_materials,
+    uint32_t* out_num_submeshes) {
+    mesh_submesh_desc_t submeshes[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes = 0;
+    uint32_t num_indices = 0;
+    bool too_many_submeshes = false;
+    for (int32_t s = 0; s < model->num_shapes; ++s) {
+        const wavefront_shape_t* shape = &model->shapes[s];
+        if (shape->instanced) {
+            break;
+        }
+
+        num_indices += 3 * shape->num_faces;
+        if (too_many_submeshes) {
+            continue;
+        }
+
+        if (num_submeshes > 0
+            && out_submesh_materials[num_submeshes - 1] == shape->material_id) {
+            submeshes[num_submeshes - 1].num_elements += 3 * shape->num_faces;
+            continue;
+        }
+
+        if (num_submeshes == GEOMETRY_PASS_MAX_MESH_RANGES) {
+            LOG_WARN("WARN: Too many materials in (%s), drawn as a whole\n",
+                model->trace.name);
+            too_many_submeshes = true;
+            num_submeshes = 0;
+            continue;
+        }
+
+        out_submesh_materials[num_submeshes] = shape->material_id;
+        submeshes[num_submeshes++] = (mesh_submesh_desc_t){
+            .base_element = 3 * shape->base_face_id,
+            .num_elements = 3 * shape->num_faces
+        };
+    }
+
+    *out_num_submeshes = num_submeshes;
+    if (num_indices == 0) {
+        return false;
+    }
+
+    // vertices of the instanced shapes follow the others as well
+    uint32_t num_vertices = model->mesh->num_vertices;
+    if (model->num_instances > 0) {
+        num_vertices = 0;
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            uint32_t v = model->mesh->indices[i] + 1;
+            num_vertices = v > num_vertices ? v : num_vertices;
+        }
+    }
+
+    // each level of detail of each submesh is drawn separately
+    uint32_t num_lods = GEOMETRY_PASS_MAX_MODEL_DRAWS
+        / (num_submeshes ? num_submeshes : 1);
+    if (num_lods > model->num_lods) {
+        num_lods = model->num_lods;
+    }
+
+    return geometry_pass_build_mesh(jobs, &(mesh_desc_t){
+        .vertices = model->mesh->vertices,
+        .num_vertices = num_vertices,
+        .indices = model->mesh->indices,
+        .num_indices = num_indices,
+        .submeshes = num_submeshes ? submeshes : NULL,
+        .num_submeshes = num_submeshes,
+        .num_lods = num_lods,
+        .layout = layout,
+        .uv_layers = model->uv_layers,
+        .label = model->trace.name
+    }, out_data);
+}
+
+// create a geometry pass material for each object material
+static int32_t __wf_make_materials(geometry_pass_t* pass,
+    const wavefront_model_t* model, material_id_t* out_materials) {
+    int32_t num_materials = model->num_materials;
+    if (num_materials > GEOMETRY_PASS_MAX_MATERIALS) {
+        LOG_WARN("WARN: Too many materials (%d) in (%s);"
+            " only %d will be created\n", num_materials,
+            model->trace.name, GEOMETRY_PASS_MAX_MATERIALS);
+        num_materials = GEOMETRY_PASS_MAX_MATERIALS;
+    }
+
+    for (int32_t m = 0; m < num_materials; ++m) {
+        out_materials[m] = __wf_make_material(pass, model, m);
+    }
+
+    return num_materials;
+}
+
+static model_id_t __wf_create_model(geometry_pass_t* pass,
+    const wavefront_model_t* model, mesh_id_t mesh,
+    const material_id_t* materials, int32_t num_materials,
+    const int32_t* submesh_object_materials, uint32_t num_submeshes) {
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+
+    // submeshes are drawn with their own material
+    material_id_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    for (uint32_t s = 0; s < num_submeshes; ++s) {
+        int32_t m = submesh_object_materials[s];
+        submesh_materials[s] = (m >= 0 && m < num_materials)
+            ? materials[m] : default_material;
+    }
+
+    return geometry_pass_create_model(pass, &(model_desc_t){
+        .material = default_material,
+        .mesh = mesh,
+        .submesh_materials = num_submeshes ? submesh_materials : NULL,
+        .num_submesh_materials = num_submeshes,
+        .label = model->trace.name
+    });
+}
+
+// create materials, mesh buffers and the model, from
+// the mesh data built out of the model, and released.
+static model_id_t __wf_upload_model(geometry_pass_t* pass,
+    const wavefront_model_t* model, mesh_data_t* mesh_data,
+    const int32_t* submesh_object_materials, uint32_t num_submeshes) {
+    mesh_id_t mesh = geometry_pass_upload_mesh(pass, mesh_data);
+    if (mesh.id == HANDLE_INVALID_ID) {
+        return (model_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    int32_t num_materials = __wf_make_materials(pass, model, materials);
+    return __wf_create_model(pass, model, mesh, materials, num_materials,
+        submesh_object_materials, num_submeshes);
+}
+
+// instanced shapes are made into a model of their own, out of the
+// range of vertices they refer to, for all their instances to draw.
+static model_id_t __wf_make_shape_model(geometry_pass_t* pass,
+    const wavefront_model_t* model, int32_t s,
+    const material_id_t* materials, int32_t num_materials) {
+    const wavefront_shape_t* shape = &model->shapes[s];
+    const uint32_t* source = model->mesh->indices + 3 * shape->base_face_id;
+    uint32_t num_indices = 3 * shape->num_faces;
+
+    uint32_t* indices = memory_malloc(sizeof(uint32_t) * num_indices);
+    if (!indices) {
+        return (model_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        indices[i] = source[i] - shape->base_vertex_id;
+    }
+
+    trace_t shape_trace;
+    trace_printf(&shape_trace, "%s-%s", model->trace.name, shape->trace.name);
+
+    mesh_data_t mesh_data;
+    bool built = geometry_pass_build_mesh(pass->jobs, &(mesh_desc_t){
+        .vertices = model->mesh->vertices + shape->base_vertex_id,
+        .num_vertices = shape->num_vertices,
+        .indices = indices,
+        .num_indices = num_indices,
+        .num_lods = model->num_lods,
+        .uv_layers = model->uv_layers,
+        .label = shape_trace.name
+    }, &mesh_data);
+
+    memory_free(indices);
+    if (!built) {
+        return (model_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    mesh_id_t mesh = geometry_pass_upload_mesh(pass, &mesh_data);
+    if (mesh.id == HANDLE_INVALID_ID) {
+        return (model_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    int32_t m = shape->material_id;
+    return geometry_pass_create_model(pass, &(model_desc_t){
+        .material = (m >= 0 && m < num_materials)
+            ? materials[m] : geometry_pass_get_default_material(pass),
+        .mesh = mesh,
+        .label = shape_trace.name
     });
 }
 
+model_id_t wavefront_make_model(geometry_pass_t* pass,
+    const wavefront_model_t* model) {
+    return wavefront_make_models(pass, model, NULL);
+}
+
+model_id_t wavefront_make_models(geometry_pass_t* pass,
+    const wavefront_model_t* model, model_id_t* out_shape_models) {
+    assert(pass && model);
+
+    model_id_t model_id = {.id = HANDLE_INVALID_ID};
+    bool has_instances = out_shape_models && model->num_instances > 0;
+    if (out_shape_models) {
+        for (int32_t s = 0; s < model->num_shapes; ++s) {
+            out_shape_models[s] = (model_id_t){.id = HANDLE_INVALID_ID};
+        }
+    }
+
+    mesh_data_t mesh_data;
+    int32_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes = 0;
+    mesh_id_t mesh = {.id = HANDLE_INVALID_ID};
+    if (__wf_build_model_mesh(pass->jobs, model, VERTEX_LAYOUT_DEFAULT, &mesh_data,
+        submesh_materials, &num_submeshes)) {
+        mesh = geometry_pass_upload_mesh(pass, &mesh_data);
+    }
+
+    if (mesh.id == HANDLE_INVALID_ID && !has_instances) {
+        return model_id;
+    }
+
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    int32_t num_materials = __wf_make_materials(pass, model, materials);
+    if (mesh.id != HANDLE_INVALID_ID) {
+        model_id = __wf_create_model(pass, model, mesh, materials,
+            num_materials, submesh_materials, num_submeshes);
+    }
+
+    for (int32_t s = 0; s < model->num_shapes && has_instances; ++s) {
+        if (model->shapes[s].instanced) {
+            out_shape_models[s] = __wf_make_shape_model(pass, model, s,
+                materials, num_materials);
+        }
+    }
+
+    return model_id;
+}
+
+bool wavefront_build_mesh(jobs_t* jobs, const wavefront_model_t* model,
+    vertex_layout_t layout, mesh_data_t* out_data,
+    int32_t* out_submesh_materials, uint32_t* out_num_submeshes) {
+    assert(model && model->mesh && out_data);
+    assert(out_submesh_materials && out_num_submeshes);
+    return __wf_build_model_mesh(jobs, model, layout, out_data,
+        out_submesh_materials, out_num_submeshes);
+}
+
+// streamed meshes are built from a run of consecutive faces, with
+// their own vertices, and the shapes crossing them as submeshes.
+// they are built by the import task, and only uploaded afterwards.
+typedef struct {
+    vertex_t* vertices;         // referred to by the mesh data
+    mesh_data_t mesh_data;
+    int32_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes;
+} __wf_chunk_t;
+
+typedef struct {
+    wavefront_data_t data;
+    trace_t label;
+    char base_path[WAVEFRONT_MAX_PATH];
+    char obj_filename[WAVEFRONT_MAX_PATH];
+    wavefront_model_t model;
+    jobs_task_t task;
+
+    // written by the import task, under the mutex
+    jobs_mutex_t mutex;
+    __wf_chunk_t chunks[WAVEFRONT_STREAM_MAX_CHUNKS];
+    uint32_t num_chunks;
+    bool materials_ready;
+    bool failed;
+    bool cancel;
+
+    // owned by the thread updating the stream
+    uint32_t num_uploaded;
+    model_id_t model_id;
+    material_id_t materials[GEOMETRY_PASS_MAX_MATERIALS];
+    int32_t num_materials;
+    int32_t draw_materials[GEOMETRY_PASS_MAX_MODEL_DRAWS];  // obj ones
+    int32_t num_draws;
+} __wf_stream_t;
+
+static void __wf_free_chunk(const wavefront_data_t* data, __wf_chunk_t* chunk) {
+    if (chunk->vertices) {
+        geometry_pass_release_mesh_data(&chunk->mesh_data);
+        data->allocator(chunk->vertices, 0);
+    }
+
+    *chunk = (__wf_chunk_t){0};
+}
+
+// cuts the faces into chunks while they are being parsed, the
+// shapes of which are final only once the whole object is.
+typedef struct {
+    __wf_stream_t* stream;
+    const wavefront_mesh_t* mesh;
+    uint32_t* remap;            // chunk vertex of each mesh one, if any
+    uint32_t remap_size;
+    uint32_t chunk_faces;
+    uint32_t max_chunks;
+    uint32_t max_draws;         // of each chunk, its mesh ranges
+    uint32_t num_chunks;
+    int32_t shape;              // first one not entirely cut yet
+} __wf_chunker_t;
+
+// chunks grow beyond their default size, rather than
+// exceeding the number of meshes a model can be made of.
+static void __wf_plan_chunks(__wf_chunker_t* chunker, uint64_t num_faces) {
+    uint64_t chunk_faces = WAVEFRONT_STREAM_CHUNK_FACES;
+    if ((num_faces + chunk_faces - 1) / chunk_faces > WAVEFRONT_STREAM_MAX_CHUNKS) {
+        chunk_faces = (num_faces + WAVEFRONT_STREAM_MAX_CHUNKS - 1)
+            / WAVEFRONT_STREAM_MAX_CHUNKS;
+    }
+
+    if (chunk_faces > UINT32_MAX / 3) {
+        chunk_faces = UINT32_MAX / 3;
+    }
+
+    uint64_t max_chunks = (num_faces + chunk_faces - 1) / chunk_faces;
+    chunker->chunk_faces = (uint32_t)chunk_faces;
+    chunker->max_chunks = max_chunks > 1 ? (uint32_t)max_chunks : 1;
+    chunker->max_draws = GEOMETRY_PASS_MAX_MODEL_DRAWS / chunker->max_chunks;
+}
+
+// copy the faces into the chunk, remapping their vertices to the
+// chunk's ones, then restore the remap table entries it has used.
+static bool __wf_build_chunk(const wavefront_data_t* data,
+    const wavefront_mesh_t* mesh, const uint32_t* indices, uint32_t num_indices,
+    uint32_t* remap, uint32_t* out_indices, uint32_t* out_num_vertices,
+    __wf_chunk_t* chunk) {
+    uint32_t num_vertices = 0;
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        uint32_t v = indices[i];
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = num_vertices++;
+        }
+
+        out_indices[i] = remap[v];
+    }
+
+    // counted first, as chunks of large objects are large too
+    chunk->vertices = data->allocator(NULL, sizeof(vertex_t) * num_vertices);
+    if (chunk->vertices) {
+        for (uint32_t i = 0; i < num_indices; ++i) {
+            chunk->vertices[out_indices[i]] = mesh->vertices[indices[i]];
+        }
+    }
+
+    for (uint32_t i = 0; i < num_indices; ++i) {
+        remap[indices[i]] = UINT32_MAX;
+    }
+
+    *out_num_vertices = num_vertices;
+    return chunk->vertices != NULL;
+}
+
+// the draws of the model are shared evenly by the chunks, and
+// consecutive shapes of the same material share theirs. as for
+// whole models, when there are more shapes than draws, the chunk
+// is drawn as a whole, with the default material.
+// each submesh level is a single draw, as chunks are never split
+// into 16-bit ranges, whatever their number of vertices.
+static uint32_t __wf_chunk_submeshes(__wf_chunker_t* chunker,
+    uint32_t first_face, uint32_t num_faces, bool parsed,
+    __wf_chunk_t* chunk, mesh_submesh_desc_t* out_submeshes) {
+    const wavefront_model_t* model = &chunker->stream->model;
+    uint32_t max_draws = chunker->max_draws;
+    uint32_t chunk_end = first_face + num_faces;
+    uint32_t num_submeshes = 0;
+    bool too_many = false;
+
+    // shapes are sorted by face, and they can cross chunks,
+    // while the last one can still grow until parsing ends.
+    int32_t s = chunker->shape;
+    for (; s < model->num_shapes; ++s) {
+        const wavefront_shape_t* shape = &model->shapes[s];
+        uint32_t shape_end = shape->base_face_id + shape->num_faces;
+        uint32_t begin = shape->base_face_id > first_face
+            ? shape->base_face_id : first_face;
+        uint32_t end = shape_end < chunk_end ? shape_end : chunk_end;
+        if (begin >= end) {
+            break;
+        }
+
+        if (num_submeshes > 0
+            && chunk->submesh_materials[num_submeshes - 1] == shape->material_id) {
+            out_submeshes[num_submeshes - 1].num_elements += 3 * (end - begin);
+        }
+        else if (num_submeshes < max_draws) {
+            chunk->submesh_materials[num_submeshes] = shape->material_id;
+            out_submeshes[num_submeshes++] = (mesh_submesh_desc_t){
+                .base_element = 3 * (begin - first_face),
+                .num_elements = 3 * (end - begin)
+            };
+        }
+        else {
+            too_many = true;
+        }
+
+        if (shape_end > chunk_end || (!parsed && s == model->num_shapes - 1)) {
+            break;
+        }
+    }
+
+    chunker->shape = s;
+    if (too_many) {
+        LOG_WARN("WARN: Too many shapes in chunk %d of (%s), drawn as a whole\n",
+            chunker->num_chunks, chunker->stream->data.label);
+        num_submeshes = 0;
+    }
+
+    // levels of detail share the draws left by the submeshes
+    uint32_t num_lods = max_draws / (num_submeshes ? num_submeshes : 1);
+    num_lods = num_lods < model->num_lods ? num_lods : model->num_lods;
+    chunk->num_submeshes = num_submeshes;
+    return num_lods > 0 ? num_lods : 1;
+}
+
+// build the next chunk from the faces given, and publish it.
+// returns false if it could not be, or the stream is cancelled.
+static bool __wf_cut_chunk(__wf_chunker_t* chunker, const uint32_t* indices,
+    uint32_t first_face, uint32_t num_faces, bool parsed) {
+    __wf_stream_t* stream = chunker->stream;
+    const wavefront_data_t* data = &stream->data;
+    const wavefront_mesh_t* mesh = chunker->mesh;
+
+    // vertices keep being added, while the object is parsed
+    if (chunker->remap_size < mesh->num_vertices) {
+        uint32_t* remap = data->allocator(chunker->remap,
+            sizeof(uint32_t) * mesh->num_vertices);
+        if (!remap) {
+            LOG_WARN("WARN: Not enough memory to stream (%s)\n", data->label);
+            return false;
+        }
+
+        memset(remap + chunker->remap_size, 0xff,
+            sizeof(uint32_t) * (mesh->num_vertices - chunker->remap_size));
+        chunker->remap = remap;
+        chunker->remap_size = mesh->num_vertices;
+    }
+
+    __wf_chunk_t chunk = {0};
+    mesh_submesh_desc_t submeshes[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_lods = __wf_chunk_submeshes(chunker, first_face, num_faces,
+        parsed, &chunk, submeshes);
+
+    uint32_t num_indices = 3 * num_faces;
+    uint32_t num_vertices = 0;
+    uint32_t* chunk_indices = data->allocator(NULL, sizeof(uint32_t) * num_indices);
+    bool built = chunk_indices && __wf_build_chunk(data, mesh, indices,
+        num_indices, chunker->remap, chunk_indices, &num_vertices, &chunk);
+
+    trace_t chunk_trace;
+    trace_printf(&chunk_trace, "%s-chunk%d", stream->label.name, chunker->num_chunks);
+
+    // the mesh data copies the indices, while it refers to the vertices
+    if (built) {
+        built = geometry_pass_build_mesh(data->jobs, &(mesh_desc_t){
+            .vertices = chunk.vertices,
+            .num_vertices = num_vertices,
+            .indices = chunk_indices,
+            .num_indices = num_indices,
+            .submeshes = chunk.num_submeshes ? submeshes : NULL,
+            .num_submeshes = chunk.num_submeshes,
+            .num_lods = num_lods,
+            .unsplit = true,
+            .label = chunk_trace.name
+        }, &chunk.mesh_data);
+
+        if (!built) {
+            data->allocator(chunk.vertices, 0);
+            chunk.vertices = NULL;
+        }
+    }
+
+    if (chunk_indices) {
+        data->allocator(chunk_indices, 0);
+    }
+
+    if (!built) {
+        LOG_WARN("WARN: Not enough memory to stream (%s)\n", chunk_trace.name);
+        __wf_free_chunk(data, &chunk);
+        return false;
+    }
+
+    // or the model would refuse the chunk
+    assert(chunk.mesh_data.mesh.num_ranges <= chunker->max_draws);
+
+    jobs_mutex_lock(&stream->mutex);
+    bool cancel = stream->cancel;
+    if (!cancel) {
+        stream->chunks[stream->num_chunks++] = chunk;
+    }
+    jobs_mutex_unlock(&stream->mutex);
+
+    if (cancel) {
+        __wf_free_chunk(data, &chunk);
+        return false;
+    }
+
+    ++chunker->num_chunks;
+    return true;
+}
+
+static void __wf_gather_chunks(__wf_stream_t* stream) {
+    const wavefront_mesh_t* mesh = stream->model.mesh;
+    uint32_t total_faces = mesh->num_indices / 3;
+
+    __wf_chunker_t chunker = {.stream = stream, .mesh = mesh};
+    __wf_plan_chunks(&chunker, total_faces);
+
+    for (uint32_t first_face = 0; first_face < total_faces;) {
+        uint32_t num_faces = total_faces - first_face;
+        if (num_faces > chunker.chunk_faces) {
+            num_faces = chunker.chunk_faces;
+        }
+
+        if (!__wf_cut_chunk(&chunker, mesh->indices + 3 * first_face,
+            first_face, num_faces, true)) {
+            break;
+        }
+
+        first_face += num_faces;
+    }
+
+    if (chunker.remap) {
+        stream->data.allocator(chunker.remap, 0);
+    }
+}
+
+// cut the parsed faces into chunks, as long as there are enough of
+// them, or all of them once parsed, and drop them from the mesh.
+// the last chunk available takes whatever faces are left.
+static bool __wf_cut_parsed_faces(__wf_chunker_t* chunker,
+    __wf_parser_t* parser, bool parsed) {
+    wavefront_mesh_t* mesh = parser->mesh;
+    uint32_t num_faces = mesh->num_indices / 3;
+    while (num_faces > 0) {
+        bool last = chunker->num_chunks + 1 >= chunker->max_chunks;
+        uint32_t cut_faces = (last || num_faces < chunker->chunk_faces)
+            ? num_faces : chunker->chunk_faces;
+        if (!parsed && (last || cut_faces < chunker->chunk_faces)) {
+            break;
+        }
+
+        if (!__wf_cut_chunk(chunker, mesh->indices, parser->first_face,
+            cut_faces, parsed)) {
+            return false;
+        }
+
+        num_faces -= cut_faces;
+        memmove(mesh->indices, mesh->indices + 3 * cut_faces,
+            sizeof(uint32_t) * 3 * num_faces);
+        mesh->num_indices = 3 * num_faces;
+        parser->first_face += cut_faces;
+    }
+
+    return true;
+}
+
+// the object is read in blocks, the complete lines of which are
+// parsed straight away, while the last one is kept for the next.
+// the number of faces is estimated from the file size, to size the
+// chunks, which are cut as soon as enough faces are parsed.
+static wavefront_result_t __wf_stream_obj_file(__wf_stream_t* stream,
+    tinyobj_material_t** out_materials, size_t* out_num_materials) {
+    const wavefront_data_t* data = &stream->data;
+    file_t file = file_open(data->obj_filename, FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(file)) {
+        LOG_WARN("WARN: Cannot open (%s)\n", data->obj_filename);
+        return WAVEFRONT_RESULT_INVALID_OBJECT;
+    }
+
+    __wf_parser_t parser;
+    wavefront_result_t result = __wf_parser_begin(data, &stream->model, &parser);
+    if (result != WAVEFRONT_RESULT_OK) {
+        file_close(file);
+        return result;
+    }
+
+    int64_t obj_size = file_size(file);
+    __wf_chunker_t chunker = {.stream = stream, .mesh = parser.mesh};
+    __wf_plan_chunks(&chunker, obj_size > 0
+        ? (uint64_t)obj_size / WAVEFRONT_STREAM_FACE_BYTES : 0);
+
+    size_t capacity = WAVEFRONT_STREAM_READ_SIZE;
+    char* buffer = data->allocator(NULL, capacity);
+    result = buffer ? WAVEFRONT_RESULT_OK : WAVEFRONT_RESULT_MESH_MALFORMED;
+
+    size_t pending = 0;
+    bool streaming = true;
+    bool eof = false;
+    while (result == WAVEFRONT_RESULT_OK && streaming && !eof) {
+        // lines longer than the buffer make it grow
+        if (pending == capacity) {
+            char* grown = data->allocator(buffer, 2 * capacity);
+            if (!grown) {
+                result = WAVEFRONT_RESULT_MESH_MALFORMED;
+                break;
+            }
+
+            buffer = grown;
+            capacity *= 2;
+        }
+
+        size_t size = pending + file_read(file, buffer + pending, capacity - pending);
+        eof = size < capacity;
+
+        size_t parsed = size;
+        while (!eof && parsed > 0 && buffer[parsed - 1] != '\n') {
+            --parsed;
+        }
+
+        result = __wf_parse_lines(&parser, buffer, buffer + parsed);
+        pending = size - parsed;
+        memmove(buffer, buffer + parsed, pending);
+
+        if (result == WAVEFRONT_RESULT_OK) {
+            streaming = __wf_cut_parsed_faces(&chunker, &parser, eof);
+        }
+    }
+
+    if (buffer) data->allocator(buffer, 0);
+    if (chunker.remap) data->allocator(chunker.remap, 0);
+    file_close(file);
+
+    result = __wf_parser_end(&parser, result, out_materials, out_num_materials);
+
+    // whatever has been streamed is not needed anymore
+    wavefront_mesh_t* mesh = stream->model.mesh;
+    if (result == WAVEFRONT_RESULT_OK) {
+        if (mesh->vertices) data->allocator(mesh->vertices, 0);
+        if (mesh->indices) data->allocator(mesh->indices, 0);
+        mesh->vertices = NULL;
+        mesh->num_vertices = 0;
+        mesh->indices = NULL;
+        mesh->num_indices = 0;
+    }
+
+    return result;
+}
+
+static void __wf_stream_job(void* user_data, uint32_t index) {
+    (void)index;
+    __wf_stream_t* stream = (__wf_stream_t*)user_data;
+
+    tinyobj_material_t* materials = NULL;
+    size_t num_materials = 0;
+
+    // geometry first, so that it can be drawn while
+    // textures are still being decoded.
+    wavefront_result_t result = WAVEFRONT_RESULT_OK;
+    if (!stream->data.obj_data && stream->data.obj_filename) {
+        result = __wf_stream_obj_file(stream, &materials, &num_materials);
+    }
+    else {
+        result = __wf_parse_geometry(&stream->data, &stream->model,
+            &materials, &num_materials);
+        if (result == WAVEFRONT_RESULT_OK) {
+            __wf_gather_chunks(stream);
+        }
+    }
+
+    if (result != WAVEFRONT_RESULT_OK) {
+        LOG_WARN("WARN: Failed to parse (%s), error %d\n",
+            stream->data.label, result);
+        jobs_mutex_lock(&stream->mutex);
+        stream->failed = true;
+        jobs_mutex_unlock(&stream->mutex);
+        return;
+    }
+
+    jobs_mutex_lock(&stream->mutex);
+    bool cancel = stream->cancel;
+    jobs_mutex_unlock(&stream->mutex);
+
+    if (!cancel && !__wf_load_materials(&stream->data, materials,
+        (uint32_t)num_materials, &stream->model)) {
+        LOG_WARN("WARN: Not enough memory for materials of (%s)\n",
+            stream->data.label);
+    }
+
+    tinyobj_materials_free(materials, num_materials);
+
+    jobs_mutex_lock(&stream->mutex);
+    stream->materials_ready = true;
+    jobs_mutex_unlock(&stream->mutex);
+}
+
+bool wavefront_stream_begin(wavefront_stream_t* stream,
+    const wavefront_data_t* data) {
+    assert(stream && data && data->allocator);
+
+    __wf_stream_t* impl = data->allocator(NULL, sizeof(__wf_stream_t));
+    if (!impl) {
+        return false;
+    }
+
+    memset(impl, 0, sizeof(__wf_stream_t));
+    impl->model_id = (model_id_t){.id = HANDLE_INVALID_ID};
+    if (!jobs_mutex_init(&impl->mutex)) {
+        data->allocator(impl, 0);
+        return false;
+    }
+
+    // keep our own copy of the strings. materials are never packed,
+    // as the uvs have been uploaded by the time textures are decoded.
+    impl->data = *data;
+    impl->data.import_options &= (uint16_t)~WAVEFRONT_IMPORT_PACK_ATLAS;
+    trace_printf(&impl->label, "%s", data->label ? data->label : "wavefront");
+    impl->data.label = impl->label.name;
+    if (data->base_path) {
+        snprintf(impl->base_path, WAVEFRONT_MAX_PATH, "%s", data->base_path);
+        impl->data.base_path = impl->base_path;
+    }
+
+    if (data->obj_filename) {
+        snprintf(impl->obj_filename, WAVEFRONT_MAX_PATH, "%s", data->obj_filename);
+        impl->data.obj_filename = impl->obj_filename;
+    }
+
+    stream->impl = impl;
+    impl->task = jobs_run_async(data->jobs, __wf_stream_job, impl);
+    return true;
+}
+
+static void __wf_stream_upload_chunk(__wf_stream_t* stream,
+    geometry_pass_t* pass, __wf_chunk_t* chunk) {
+    mesh_id_t mesh = geometry_pass_upload_mesh(pass, &chunk->mesh_data);
+    if (mesh.id == HANDLE_INVALID_ID) {
+        LOG_WARN("WARN: Failed to make mesh (%s)\n", chunk->mesh_data.mesh.trace.name);
+        return;
+    }
+
+    // materials not created yet are replaced by the default one
+    material_id_t default_material = geometry_pass_get_default_material(pass);
+    material_id_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    for (uint32_t s = 0; s < chunk->num_submeshes; ++s) {
+        int32_t m = chunk->submesh_materials[s];
+        submesh_materials[s] = (m >= 0 && m < stream->num_materials)
+            ? stream->materials[m] : default_material;
+    }
+
+    model_desc_t model_desc = {
+        .material = default_material,
+        .mesh = mesh,
+        .submesh_materials = chunk->num_submeshes ? submesh_materials : NULL,
+        .num_submesh_materials = chunk->num_submeshes,
+        .label = stream->label.name
+    };
+
+    if (stream->model_id.id == HANDLE_INVALID_ID) {
+        stream->model_id = geometry_pass_create_model(pass, &model_desc);
+        if (stream->model_id.id == HANDLE_INVALID_ID) {
+            LOG_WARN("WARN: Failed to create model (%s)\n", stream->label.name);
+            geometry_pass_destroy_mesh(pass, mesh);
+            return;
+        }
+    }
+    else if (!geometry_pass_append_model_mesh(pass, stream->model_id,
+        &model_desc)) {
+        LOG_WARN("WARN: Failed to append mesh (%s) to model (%s)\n",
+            chunk->mesh_data.mesh.trace.name, stream->label.name);
+        geometry_pass_destroy_mesh(pass, mesh);
+        return;
+    }
+
+    // draws follow the mesh ranges, remember which
+    // obj material they need, to bind it later on.
+    const mesh_t* mesh_ptr = &pass->meshes[mesh.id];
+    for (uint32_t r = 0; r < mesh_ptr->num_ranges; ++r) {
+        int32_t submesh = mesh_ptr->ranges[r].submesh;
+        assert(stream->num_draws < GEOMETRY_PASS_MAX_MODEL_DRAWS);
+        stream->draw_materials[stream->num_draws++] =
+            (submesh >= 0 && (uint32_t)submesh < chunk->num_submeshes)
+            ? chunk->submesh_materials[submesh] : -1;
+    }
+}
+
+static void __wf_stream_upload_material(__wf_stream_t* stream,
+    geometry_pass_t* pass) {
+    int32_t m = stream->num_materials++;
+    material_id_t material = __wf_make_material(pass, &stream->model, m);
+    stream->materials[m] = material;
+
+    // rebind what has been drawn with the default material
+    if (material.id == geometry_pass_get_default_material(pass).id) {
+        return;
+    }
+
+    for (int32_t d = 0; d < stream->num_draws; ++d) {
+        if (stream->draw_materials[d] == m) {
+            geometry_pass_set_model_draw_material(pass,
+                stream->model_id, d, material);
+        }
+    }
+}
+
+static uint32_t __wf_material_bytes(const wavefront_model_t* model, int32_t m) {
+    const wavefront_image_t* albedo = &model->diffuseRGB_alphaA[m];
+    const wavefront_image_t* emissive = &model->emissiveXYZ_specularW[m];
+    return sizeof(uint32_t) * ((uint32_t)albedo->width * albedo->height * albedo->layers
+        + (uint32_t)emissive->width * emissive->height * emissive->layers);
+}
+
+wavefront_stream_status_t wavefront_stream_update(wavefront_stream_t* stream,
+    geometry_pass_t* pass, uint32_t max_upload_bytes) {
+    assert(stream && stream->impl && pass);
+    __wf_stream_t* impl = (__wf_stream_t*)stream->impl;
+
+    jobs_mutex_lock(&impl->mutex);
+    uint32_t num_chunks = impl->num_chunks;
+    bool materials_ready = impl->materials_ready;
+    bool failed = impl->failed;
+    jobs_mutex_unlock(&impl->mutex);
+
+    if (failed) {
+        return WAVEFRONT_STREAM_FAILED;
+    }
+
+    // published chunks are not touched by the import task anymore
+    uint32_t uploaded_bytes = 0;
+    while (impl->num_uploaded < num_chunks
+        && (uploaded_bytes == 0 || uploaded_bytes < max_upload_bytes)) {
+        uint32_t c = impl->num_uploaded++;
+        __wf_chunk_t* chunk = &impl->chunks[c];
+        uploaded_bytes += chunk->mesh_data.vertices_size
+            + chunk->mesh_data.indices_size;
+
+        // the mesh data is released by the upload, but the vertices
+        __wf_stream_upload_chunk(impl, pass, chunk);
+        impl->data.allocator(chunk->vertices, 0);
+        *chunk = (__wf_chunk_t){0};
+    }
+
+    // once textures are decoded, the model is complete
+    if (!materials_ready) {
+        return WAVEFRONT_STREAM_PENDING;
+    }
+
+    int32_t num_materials = impl->model.num_materials;
+    if (num_materials > GEOMETRY_PASS_MAX_MATERIALS) {
+        num_materials = GEOMETRY_PASS_MAX_MATERIALS;
+    }
+
+    while (impl->num_materials < num_materials
+        && (uploaded_bytes == 0 || uploaded_bytes < max_upload_bytes)) {
+        uploaded_bytes += __wf_material_bytes(&impl->model, impl->num_materials);
+        __wf_stream_upload_material(impl, pass);
+    }
+
+    if (impl->num_uploaded < num_chunks || impl->num_materials < num_materials) {
+        return WAVEFRONT_STREAM_PENDING;
+    }
+
+    if (impl->model_id.id == HANDLE_INVALID_ID) {
+        return WAVEFRONT_STREAM_FAILED;
+    }
+
+    return WAVEFRONT_STREAM_COMPLETED;
+}
+
+model_id_t wavefront_stream_model(const wavefront_stream_t* stream) {
+    assert(stream && stream->impl);
+    const __wf_stream_t* impl = (const __wf_stream_t*)stream->impl;
+    return impl->model_id;
+}
+
+void wavefront_stream_end(wavefront_stream_t* stream) {
+    assert(stream);
+    __wf_stream_t* impl = (__wf_stream_t*)stream->impl;
+    if (!impl) {
+        return;
+    }
+
+    jobs_mutex_lock(&impl->mutex);
+    impl->cancel = true;
+    jobs_mutex_unlock(&impl->mutex);
+
+    jobs_wait(impl->data.jobs, impl->task);
+
+    for (uint32_t c = impl->num_uploaded; c < impl->num_chunks; ++c) {
+        __wf_free_chunk(&impl->data, &impl->chunks[c]);
+    }
+
+    if (impl->model.mesh) {
+        wavefront_release_obj(&impl->model);
+    }
+
+    jobs_mutex_cleanup(&impl->mutex);
+
+    memory_allocator_t allocator = impl->data.allocator;
+    allocator(impl, 0);
+    stream->impl = NULL;
+}
+
+typedef enum {
+    __WF_FILE_PENDING,
+    __WF_FILE_IMPORTED,     // parsed, and its mesh built
+    __WF_FILE_FAILED,
+    __WF_FILE_MADE          // into a model, or it has failed to
+} __wf_file_state_t;
+
+typedef struct {
+    char filename[WAVEFRONT_MAX_PATH];
+    wavefront_model_t model;
+    mesh_data_t mesh_data;
+    int32_t submesh_materials[GEOMETRY_PASS_MAX_MESH_RANGES];
+    uint32_t num_submeshes;
+    model_id_t model_id;
+    __wf_file_state_t state;    // under the batch mutex
+} __wf_batch_file_t;
+
+typedef struct {
+    wavefront_batch_desc_t desc;
+    __wf_batch_file_t* files;
+    jobs_task_t tasks[JOBS_MAX_WORKERS];
+    uint32_t num_tasks;
+
+    // shared by the import tasks, under the mutex
+    jobs_mutex_t mutex;
+    uint32_t next_file;
+    bool cancel;
+
+    // owned by the thread updating the batch
+    uint32_t num_made;
+} __wf_batch_t;
+
+// read, parse, and build the mesh of the file, all of which can
+// run on any thread, leaving to the update to create its buffers.
+static bool __wf_import_file(const wavefront_batch_desc_t* desc,
+    __wf_batch_file_t* file) {
+    file_t file_model = file_open(file->filename,
+        FILE_OPEN_READ|FILE_OPEN_BINARY);
+    if (!file_is_valid(file_model)) {
+        LOG_WARN("WARN: Cannot open (%s)\n", file->filename);
+        return false;
+    }
+
+    char* buffer_data = NULL;
+    size_t buffer_size = 0;
+    int32_t read = file_readall(file_model, &buffer_data, &buffer_size,
+        desc->allocator);
+    file_close(file_model);
+
+    if (read != FILE_READALL_OK) {
+        LOG_WARN("WARN: Cannot read (%s)\n", file->filename);
+        if (buffer_data) {
+            desc->allocator(buffer_data, 0);
+        }
+
+        return false;
+    }
+
+    trace_t name;
+    path_pop(file->filename, NULL, name.name);
+    path_pop_ext(name.name, name.name, NULL);
+
+    // textures are relative to the object file
+    char dir[WAVEFRONT_MAX_PATH] = {0};
+    path_pop(file->filename, dir, NULL);
+
+    // nested parallel fors run serially, the
+    // files themselves are imported in parallel.
+    wavefront_result_t result = wavefront_parse_obj(&(wavefront_data_t){
+        .allocator = desc->allocator,
+        .jobs = desc->jobs,
+        .base_path = dir,
+        .obj_data = buffer_data,
+        .data_size = buffer_size,
+        .atlas_width = desc->atlas_width,
+        .atlas_height = desc->atlas_height,
+        .import_options = desc->import_options
+            & ~WAVEFRONT_IMPORT_DETECT_INSTANCES,
+        .label = name.name
+    }, &file->model);
+
+    desc->allocator(buffer_data, 0);
+    if (result != WAVEFRONT_RESULT_OK) {
+        return false;
+    }
+
+    if (!__wf_build_model_mesh(desc->jobs, &file->model,
+        VERTEX_LAYOUT_DEFAULT, &file->mesh_data, file->submesh_materials, &file->num_submeshes)) {
+        wavefront_release_obj(&file->model);
+        return false;
+    }
+
+    return true;
+}
+
+// each task imports one file after another, until none is left
+static void __wf_batch_job(void* user_data, uint32_t index) {
+    (void)index;
+    __wf_batch_t* batch = (__wf_batch_t*)user_data;
+
+    for (;;) {
+        jobs_mutex_lock(&batch->mutex);
+        bool cancel = batch->cancel;
+        uint32_t f = batch->next_file;
+        if (!cancel && f < batch->desc.num_files) {
+            ++batch->next_file;
+        }
+        jobs_mutex_unlock(&batch->mutex);
+
+        if (cancel || f >= batch->desc.num_files) {
+            return;
+        }
+
+        __wf_batch_file_t* file = &batch->files[f];
+        bool imported = __wf_import_file(&batch->desc, file);
+
+        jobs_mutex_lock(&batch->mutex);
+        file->state = imported ? __WF_FILE_IMPORTED : __WF_FILE_FAILED;
+        jobs_mutex_unlock(&batch->mutex);
+    }
+}
+
+bool wavefront_batch_begin(wavefront_batch_t* batch,
+    const wavefront_batch_desc_t* desc) {
+    assert(batch && desc && desc->allocator);
+    assert(desc->filenames || desc->num_files == 0);
+
+    __wf_batch_t* impl = desc->allocator(NULL, sizeof(__wf_batch_t));
+    if (!impl) {
+        return false;
+    }
+
+    memset(impl, 0, sizeof(__wf_batch_t));
+    impl->desc = *desc;
+    impl->files = desc->num_files ? desc->allocator(NULL,
+        sizeof(__wf_batch_file_t) * desc->num_files) : NULL;
+    if ((desc->num_files && !impl->files) || !jobs_mutex_init(&impl->mutex)) {
+        if (impl->files) {
+            desc->allocator(impl->files, 0);
+        }
+
+        desc->allocator(impl, 0);
+        return false;
+    }
+
+    // keep our own copy of the file names
+    memset(impl->files, 0, sizeof(__wf_batch_file_t) * desc->num_files);
+    for (uint32_t f = 0; f < desc->num_files; ++f) {
+        snprintf(impl->files[f].filename, WAVEFRONT_MAX_PATH,
+            "%s", desc->filenames[f]);
+        impl->files[f].model_id = (model_id_t){.id = HANDLE_INVALID_ID};
+    }
+
+    impl->desc.filenames = NULL;
+    batch->impl = impl;
+
+    // one task per worker, which without any,
+    // imports all the files straight away.
+    uint32_t num_tasks = jobs_num_workers(desc->jobs);
+    num_tasks = num_tasks < desc->num_files ? num_tasks : desc->num_files;
+    num_tasks = num_tasks > 0 ? num_tasks : 1;
+    for (uint32_t t = 0; t < num_tasks; ++t) {
+        impl->tasks[impl->num_tasks++] = jobs_run_async(desc->jobs,
+            __wf_batch_job, impl);
+    }
+
+    return true;
+}
+
+uint32_t wavefront_batch_update(wavefront_batch_t* batch,
+    geometry_pass_t* pass, uint32_t max_models) {
+    assert(batch && batch->impl && pass);
+    __wf_batch_t* impl = (__wf_batch_t*)batch->impl;
+
+    // models are made in the same order as the files have been given,
+    // once imported, files are not touched by the import tasks anymore
+    uint32_t num_made = 0;
+    for (uint32_t f = 0; f < impl->desc.num_files; ++f) {
+        if (max_models > 0 && num_made >= max_models) {
+            break;
+        }
+
+        __wf_batch_file_t* file = &impl->files[f];
+        jobs_mutex_lock(&impl->mutex);
+        __wf_file_state_t state = file->state;
+        jobs_mutex_unlock(&impl->mutex);
+
+        if (state == __WF_FILE_IMPORTED) {
+            file->model_id = __wf_upload_model(pass, &file->model,
+                &file->mesh_data, file->submesh_materials, file->num_submeshes);
+            wavefront_release_obj(&file->model);
+            ++num_made;
+        }
+
+        if (state == __WF_FILE_IMPORTED || state == __WF_FILE_FAILED) {
+            file->state = __WF_FILE_MADE;
+            impl->num_made++;
+        }
+    }
+
+    return impl->desc.num_files - impl->num_made;
+}
+
+model_id_t wavefront_batch_model(const wavefront_batch_t* batch, uint32_t file) {
+    assert(batch && batch->impl);
+    const __wf_batch_t* impl = (const __wf_batch_t*)batch->impl;
+    assert(file < impl->desc.num_files);
+    return impl->files[file].model_id;
+}
+
+void wavefront_batch_end(wavefront_batch_t* batch) {
+    assert(batch);
+    __wf_batch_t* impl = (__wf_batch_t*)batch->impl;
+    if (!impl) {
+        return;
+    }
+
+    jobs_mutex_lock(&impl->mutex);
+    impl->cancel = true;
+    jobs_mutex_unlock(&impl->mutex);
+
+    for (uint32_t t = 0; t < impl->num_tasks; ++t) {
+        jobs_wait(impl->desc.jobs, impl->tasks[t]);
+    }
+
+    for (uint32_t f = 0; f < impl->desc.num_files; ++f) {
+        __wf_batch_file_t* file = &impl->files[f];
+        if (file->state == __WF_FILE_IMPORTED) {
+            geometry_pass_release_mesh_data(&file->mesh_data);
+            wavefront_release_obj(&file->model);
+        }
+    }
+
+    jobs_mutex_cleanup(&impl->mutex);
+
+    memory_allocator_t allocator = impl->desc.allocator;
+    if (impl->files) {
+        allocator(impl->files, 0);
+    }
+
+    allocator(impl, 0);
+    batch->impl = NULL;
+}
+
 #if defined(__cplusplus)
 }
 #endif
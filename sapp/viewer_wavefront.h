@@ -5,6 +5,18 @@
 
 #include "viewer_geometry_pass.h"
 #include "viewer_memory.h"
+#include "viewer_jobs.h"
+
+#define WAVEFRONT_MAX_PATH 1024
+#define WAVEFRONT_STREAM_CHUNK_FACES 16384  // faces per streamed mesh
+#define WAVEFRONT_STREAM_MAX_CHUNKS 8       // meshes per streamed model
+#define WAVEFRONT_STREAM_READ_SIZE (4 << 20) // bytes read at once from files
+#define WAVEFRONT_STREAM_FACE_BYTES 64      // of obj text, to size chunks
+#define WAVEFRONT_ATLAS_MAX_LAYERS 8        // array layers of packed materials
+#define WAVEFRONT_ATLAS_GUTTER 2            // texels around each packed image
+#define WAVEFRONT_INSTANCE_MIN_FACES 16     // of shapes to be instanced
+#define WAVEFRONT_MAX_PROTOTYPES 8          // instanced shapes per object
+#define WAVEFRONT_MAX_INSTANCES 64          // of all the instanced shapes
 
 #if defined(__cplusplus)
 extern "C" {
@@ -12,35 +24,55 @@ extern "C" {
 
 typedef struct {
     vertex_t* vertices;
-    int32_t num_vertices;
+    uint32_t num_vertices;
     uint32_t* indices;
     uint32_t num_indices;
 } wavefront_mesh_t;
 
+// consecutive faces sharing the same object
+// group and material, drawn as a single submesh
 typedef struct {
     box_t bbox;
-    rect_t image_tile;
+    rect_t image_tile;      // of the material, once packed into the atlas
+    int32_t image_layer;
+    int32_t material_id;    // obj material index, -1 if none
     uint32_t base_vertex_id;
     uint32_t num_vertices;
     uint32_t base_face_id;
     uint32_t num_faces;
+    bool instanced;         // drawn by its instances, not by the object
     trace_t trace;
 } wavefront_shape_t;
 
+// a repeat of an instanced shape, the first of which is the shape
+// itself, with the transform from where the shape is to the repeat.
+typedef struct {
+    int32_t shape_id;
+    transform_t transform;
+} wavefront_instance_t;
+
 typedef struct {
     uint16_t width;
     uint16_t height;
+    uint16_t layers;
     uint32_t* pixels;
 } wavefront_image_t;
 
+// images are arrays of num_materials entries, one
+// for each material of the object, in the same order.
 typedef struct {
     memory_allocator_t allocator;
     wavefront_mesh_t* mesh;
     wavefront_image_t* diffuseRGB_alphaA;
     wavefront_image_t* emissiveXYZ_specularW;
     wavefront_image_t* normalXY_dispZ_aoW;
+    int32_t num_materials;
     wavefront_shape_t* shapes;
     int32_t num_shapes;
+    wavefront_instance_t* instances;
+    int32_t num_instances;
+    uint32_t num_lods;  // levels of detail to generate for the mesh
+    bool uv_layers;     // whether u holds the atlas layer, see mesh_desc_t
     trace_t trace;
 } wavefront_model_t;
 
@@ -51,17 +83,42 @@ typedef enum {
     WAVEFRONT_IMPORT_FLIP_NORMALS       = 0x04,
     WAVEFRONT_IMPORT_IGNORE_TEXTURES    = 0x08,
     WAVEFRONT_IMPORT_REWIND_FACES       = 0x10,
+    WAVEFRONT_IMPORT_GENERATE_LODS      = 0x20,
+    WAVEFRONT_IMPORT_USE_TINYOBJ        = 0x40, // instead of the fused parser
+    WAVEFRONT_IMPORT_PACK_ATLAS         = 0x80,
+    WAVEFRONT_IMPORT_DETECT_INSTANCES   = 0x100,
+    WAVEFRONT_IMPORT_OPTIMIZE_MESH      = 0x200,
     WAVEFRONT_IMPORT_DEFAULT            = 
-       WAVEFRONT_IMPORT_TRIANGULATE
+       WAVEFRONT_IMPORT_TRIANGULATE |
+       WAVEFRONT_IMPORT_GENERATE_LODS |
+       WAVEFRONT_IMPORT_PACK_ATLAS
 } wavefront_import_options_t;
 
+// when jobs are given, textures are decoded in parallel,
+// therefore, the allocator is required to be thread safe.
+// with WAVEFRONT_IMPORT_PACK_ATLAS, the images of all the materials
+// are packed into the layers of a single material, each atlas_width
+// by atlas_height, and the uvs of the shapes are remapped into them.
+// objects whose uvs repeat, or with shapes without material, are not,
+// and neither are streamed ones, whose geometry is drawn before.
+// with WAVEFRONT_IMPORT_DETECT_INSTANCES, shapes repeated under rigid
+// transforms are kept only once, and listed as the object instances,
+// while their faces are moved after those of the other shapes.
+// with WAVEFRONT_IMPORT_OPTIMIZE_MESH, identical vertices are welded,
+// the faces of each shape are ordered for the vertex cache, and the
+// vertices in the order faces use them, which is worth it offline.
+// streams can read the object from obj_filename, instead of obj_data,
+// which is then never held in memory as a whole.
 typedef struct {
     memory_allocator_t allocator;
+    jobs_t* jobs;               // optional
+    const char* base_path;      // textures are relative to, optional
     const void* obj_data;
-    int32_t data_size;
+    size_t data_size;
+    const char* obj_filename;   // streams only, if obj_data is NULL
     int32_t atlas_width;
     int32_t atlas_height;
-    uint8_t import_options;
+    uint16_t import_options;
     const char* label;
 } wavefront_data_t;
 
@@ -78,13 +135,130 @@ wavefront_result_t wavefront_parse_obj(const wavefront_data_t* data,
 
 void wavefront_release_obj(wavefront_model_t* obj);
 
-// because each model can store only one texture per object,
-// if a multiple texture/material object is provided, then,
-// these need to be combined into a single atlas texture,
-// and vertices' uvs need to be adjusted accordingly.
+// each object material becomes a geometry pass material, and
+// shapes are drawn with their own, or the default one if none.
+// consecutive shapes of the same material share their draws.
+// levels of detail are limited by the draws available to the model.
 model_id_t wavefront_make_model(geometry_pass_t* pass,
     const wavefront_model_t* model);
 
+/**
+ * Make the object model, as wavefront_make_model, and a model for each
+ * of the instanced shapes, which share the object materials. Models are
+ * returned for each shape in out_shape_models, invalid for the shapes
+ * which are not instanced, and the object model is invalid as well, if
+ * all of its shapes are instanced.
+ */
+model_id_t wavefront_make_models(geometry_pass_t* pass,
+    const wavefront_model_t* model, model_id_t* out_shape_models);
+
+/**
+ * Build the object mesh, as wavefront_make_model does, without creating
+ * any resource, therefore, from any thread, or offline. The object must
+ * be kept alive until the mesh data is either uploaded or released.
+ * Each submesh gets the obj material it is drawn with, -1 if none, in
+ * out_submesh_materials, which must have GEOMETRY_PASS_MAX_MESH_RANGES.
+ */
+bool wavefront_build_mesh(jobs_t* jobs, const wavefront_model_t* model,
+    vertex_layout_t layout, mesh_data_t* out_data,
+    int32_t* out_submesh_materials, uint32_t* out_num_submeshes);
+
+typedef struct {
+    void* impl;
+} wavefront_stream_t;
+
+typedef enum {
+    WAVEFRONT_STREAM_PENDING,
+    WAVEFRONT_STREAM_COMPLETED,
+    WAVEFRONT_STREAM_FAILED
+} wavefront_stream_status_t;
+
+/**
+ * Start importing the object in background, on the data's jobs, which
+ * can be NULL to import it straight away. The object is split into
+ * chunks of faces, which are uploaded one after another, therefore,
+ * the model can be drawn before it is complete, first with the default
+ * material, and then with its own, once textures have been decoded.
+ * Label, base path and obj filename are copied, while obj data must be
+ * kept alive until the stream ends. WAVEFRONT_IMPORT_PACK_ATLAS is
+ * ignored, each material being drawn on its own.
+ * Objects streamed from file are read in blocks of
+ * WAVEFRONT_STREAM_READ_SIZE, and chunks are cut while they are being
+ * parsed, with their size estimated from the file one, so that only the
+ * vertices are kept whole, as any face can refer to them.
+ */
+bool wavefront_stream_begin(wavefront_stream_t* stream,
+    const wavefront_data_t* data);
+
+/**
+ * Upload the chunks, and the materials, which are ready. It is meant
+ * to be called once per frame, from the thread owning the pass, and it
+ * stops uploading as soon as max_upload_bytes are exceeded, though at
+ * least one chunk, or material, is uploaded on each call.
+ */
+wavefront_stream_status_t wavefront_stream_update(wavefront_stream_t* stream,
+    geometry_pass_t* pass, uint32_t max_upload_bytes);
+
+/**
+ * The streamed model, invalid until the first chunk has been uploaded.
+ */
+model_id_t wavefront_stream_model(const wavefront_stream_t* stream);
+
+/**
+ * Cancel the import, if still running, wait for it and release the
+ * stream. Whatever has already been uploaded is owned by the pass.
+ */
+void wavefront_stream_end(wavefront_stream_t* stream);
+
+typedef struct {
+    void* impl;
+} wavefront_batch_t;
+
+// all files are imported with the same options, while their
+// textures are relative to each of them. file names are copied.
+// instances are not detected, as each file makes a single model.
+typedef struct {
+    memory_allocator_t allocator;   // thread safe
+    jobs_t* jobs;                   // optional
+    const char* const* filenames;
+    uint32_t num_files;
+    int32_t atlas_width;
+    int32_t atlas_height;
+    uint16_t import_options;
+} wavefront_batch_desc_t;
+
+/**
+ * Start importing the files in background, on one task for each of
+ * the jobs workers, which take a file after another, reading, parsing
+ * it and building its mesh. Without workers, the files are imported
+ * straight away. Parallel fors of the single imports run serially,
+ * as long as the workers are busy with other files.
+ */
+bool wavefront_batch_begin(wavefront_batch_t* batch,
+    const wavefront_batch_desc_t* desc);
+
+/**
+ * Create the resources of the models imported so far, at most
+ * max_models of them, or all if 0. It is meant to be called once per
+ * frame, from the thread owning the pass, and it returns the number
+ * of files whose models are still to be made, 0 once the batch is done.
+ */
+uint32_t wavefront_batch_update(wavefront_batch_t* batch,
+    geometry_pass_t* pass, uint32_t max_models);
+
+/**
+ * Model of the file at the given index, which is invalid until
+ * it has been made, or if the file has failed to be imported.
+ */
+model_id_t wavefront_batch_model(const wavefront_batch_t* batch,
+    uint32_t file);
+
+/**
+ * Cancel the files not imported yet, wait for those being imported,
+ * and release the batch. Models already made are owned by the pass.
+ */
+void wavefront_batch_end(wavefront_batch_t* batch);
+
 #if defined(__cplusplus)
 }
 #endif